@@ -0,0 +1,315 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *        contributors may be used to endorse or promote products derived
+ *        from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_direct_lookup.c -- pool lookup in object dereference benchmark
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "libpmemobj.h"
+#include "benchmark.h"
+
+/*
+ * The number of dereferences performed in a single operation, the cost of
+ * a single one is too small to be measured separately.
+ */
+#define OPERATION_REPEAT_COUNT 10000
+
+/* upper bound of the pool space taken by a single benchmark object */
+#define OBJ_SPACE 256
+
+/*
+ * prog_args - command line parsed arguments
+ */
+struct prog_args {
+	char *mode;		/* dereference mode */
+	unsigned n_pools;	/* number of pools to spread objects over */
+	unsigned n_objs;	/* number of objects in each pool */
+};
+
+/*
+ * obj_bench - variables used in benchmark, passed within functions
+ */
+struct obj_bench {
+	PMEMobjpool **pops;		/* persistent pool handles */
+	char **fnames;			/* pool file names */
+	PMEMoid *oids;			/* objects in randomized order */
+	size_t n_oids;			/* total number of objects */
+	int by_oid;			/* use pmemobj_pool_by_oid */
+	struct prog_args *pa;		/* prog_args structure */
+	volatile uint64_t sink;		/* keeps the loads from being elided */
+};
+
+/*
+ * direct_close -- (internal) closes the first n pools, removes the files of
+ *	the additional ones and frees the file names
+ */
+static void
+direct_close(struct obj_bench *ob, unsigned n)
+{
+	for (unsigned i = 0; i < n; i++) {
+		pmemobj_close(ob->pops[i]);
+		if (i > 0)
+			unlink(ob->fnames[i]);
+	}
+
+	for (unsigned i = 0; i < ob->pa->n_pools; i++)
+		free(ob->fnames[i]);
+}
+
+/*
+ * direct_alloc -- (internal) allocates the objects and shuffles their handles
+ */
+static int
+direct_alloc(struct obj_bench *ob, unsigned seed)
+{
+	unsigned n_pools = ob->pa->n_pools;
+
+	for (size_t i = 0; i < ob->n_oids; i++) {
+		PMEMobjpool *pop = ob->pops[i % n_pools];
+		if (pmemobj_alloc(pop, &ob->oids[i], sizeof(uint64_t), 0,
+				NULL, NULL) != 0) {
+			perror("pmemobj_alloc");
+			return -1;
+		}
+	}
+
+	for (size_t i = ob->n_oids - 1; i > 0; i--) {
+		size_t j = (size_t)rand_r(&seed) % (i + 1);
+		PMEMoid tmp = ob->oids[i];
+		ob->oids[i] = ob->oids[j];
+		ob->oids[j] = tmp;
+	}
+
+	return 0;
+}
+
+/*
+ * direct_init -- benchmark initialization
+ */
+static int
+direct_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	assert(bench != NULL);
+	assert(args != NULL);
+	assert(args->opts != NULL);
+
+	struct obj_bench *ob = calloc(1, sizeof(struct obj_bench));
+	if (ob == NULL) {
+		perror("calloc");
+		return -1;
+	}
+	pmembench_set_priv(bench, ob);
+
+	ob->pa = args->opts;
+	size_t psize = args->is_poolset ? 0 :
+		PMEMOBJ_MIN_POOL + (size_t)ob->pa->n_objs * OBJ_SPACE;
+
+	if (strcmp(ob->pa->mode, "direct") == 0) {
+		ob->by_oid = 0;
+	} else if (strcmp(ob->pa->mode, "pool-by-oid") == 0) {
+		ob->by_oid = 1;
+	} else {
+		fprintf(stderr, "wrong mode\n");
+		goto err;
+	}
+
+	if (args->is_poolset && ob->pa->n_pools > 1) {
+		fprintf(stderr, "multiple pools require a regular file\n");
+		goto err;
+	}
+
+	ob->n_oids = (size_t)ob->pa->n_pools * ob->pa->n_objs;
+	ob->oids = calloc(ob->n_oids, sizeof(*ob->oids));
+	ob->pops = calloc(ob->pa->n_pools, sizeof(*ob->pops));
+	ob->fnames = calloc(ob->pa->n_pools, sizeof(*ob->fnames));
+	if (ob->oids == NULL || ob->pops == NULL || ob->fnames == NULL) {
+		perror("calloc");
+		goto err_free;
+	}
+
+	size_t fname_len = strlen(args->fname) + 12;
+	for (unsigned i = 0; i < ob->pa->n_pools; i++) {
+		ob->fnames[i] = malloc(fname_len);
+		if (ob->fnames[i] == NULL) {
+			perror("malloc");
+			direct_close(ob, 0);
+			goto err_free;
+		}
+
+		if (i == 0)
+			snprintf(ob->fnames[i], fname_len, "%s", args->fname);
+		else
+			snprintf(ob->fnames[i], fname_len, "%s.%u",
+				args->fname, i);
+	}
+
+	unsigned i;
+	for (i = 0; i < ob->pa->n_pools; i++) {
+		ob->pops[i] = pmemobj_create(ob->fnames[i],
+				"obj_direct", psize, args->fmode);
+		if (ob->pops[i] == NULL) {
+			fprintf(stderr, "%s\n", pmemobj_errormsg());
+			goto err_close;
+		}
+	}
+
+	if (direct_alloc(ob, args->seed) != 0)
+		goto err_close;
+
+	return 0;
+
+err_close:
+	direct_close(ob, i);
+err_free:
+	free(ob->oids);
+	free(ob->pops);
+	free(ob->fnames);
+err:
+	free(ob);
+	return -1;
+}
+
+/*
+ * direct_exit -- benchmark clean up
+ */
+static int
+direct_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	struct obj_bench *ob = pmembench_get_priv(bench);
+
+	direct_close(ob, ob->pa->n_pools);
+	free(ob->oids);
+	free(ob->pops);
+	free(ob->fnames);
+	free(ob);
+
+	return 0;
+}
+
+/*
+ * direct_op -- dereferences a series of object handles
+ */
+static int
+direct_op(struct benchmark *bench, struct operation_info *info)
+{
+	struct obj_bench *ob = pmembench_get_priv(bench);
+	size_t idx = ((size_t)info->worker->index * OPERATION_REPEAT_COUNT +
+			info->index) % ob->n_oids;
+	uint64_t sum = 0;
+
+	for (int i = 0; i < OPERATION_REPEAT_COUNT; i++) {
+		PMEMoid oid = ob->oids[idx];
+		uint64_t *val;
+
+		if (ob->by_oid)
+			val = (uint64_t *)((uintptr_t)pmemobj_pool_by_oid(oid)
+					+ oid.off);
+		else
+			val = pmemobj_direct(oid);
+
+		sum += *val;
+
+		if (++idx == ob->n_oids)
+			idx = 0;
+	}
+
+	ob->sink = sum;
+
+	return 0;
+}
+
+/* structure defining command line arguments */
+static struct benchmark_clo direct_clo[] = {
+	{
+		.opt_short	= 'M',
+		.opt_long	= "mode",
+		.descr		= "The dereference mode: direct or pool-by-oid",
+		.type		= CLO_TYPE_STR,
+		.off		= clo_field_offset(struct prog_args, mode),
+		.def		= "direct",
+	},
+	{
+		.opt_short	= 'p',
+		.opt_long	= "pools",
+		.descr		= "The number of pools the objects are spread"
+					" over",
+		.type		= CLO_TYPE_UINT,
+		.off		= clo_field_offset(struct prog_args, n_pools),
+		.def		= "1",
+		.type_uint	= {
+			.size	= clo_field_size(struct prog_args, n_pools),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 1,
+			.max	= UINT_MAX
+		}
+	},
+	{
+		.opt_short	= 'o',
+		.opt_long	= "objects",
+		.descr		= "The number of objects in each pool",
+		.type		= CLO_TYPE_UINT,
+		.off		= clo_field_offset(struct prog_args, n_objs),
+		.def		= "1024",
+		.type_uint	= {
+			.size	= clo_field_size(struct prog_args, n_objs),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 1,
+			.max	= UINT_MAX
+		}
+	},
+};
+
+/*
+ * stores information about object dereference benchmark
+ */
+static struct benchmark_info direct_info = {
+	.name		= "obj_direct_lookup",
+	.brief		= "Benchmark for pool lookup in pmemobj_direct",
+	.init		= direct_init,
+	.exit		= direct_exit,
+	.multithread	= true,
+	.multiops	= true,
+	.operation	= direct_op,
+	.measure_time	= true,
+	.clos		= direct_clo,
+	.nclos		= ARRAY_SIZE(direct_clo),
+	.opts_size	= sizeof(struct prog_args),
+	.rm_file	= true,
+	.allow_poolset	= true,
+};
+
+REGISTER_BENCHMARK(direct_info);
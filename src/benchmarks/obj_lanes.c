@@ -36,11 +36,13 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <unistd.h>
 
 #include "libpmemobj.h"
 #include "benchmark.h"
 #include "lane.h"
+#include "obj.h"
 
 /*
  * The number of times to repeat the operation, used to get more accurate
@@ -54,13 +56,16 @@
  */
 struct prog_args {
 	char *lane_section_name;	/* lane section to be held */
+	unsigned n_lanes;		/* number of lanes to use, 0 for all */
+	unsigned n_pools;		/* number of pools to cycle through */
 };
 
 /*
  * obj_bench - variables used in benchmark, passed within functions
  */
 struct obj_bench {
-	PMEMobjpool *pop;			/* persistent pool handle */
+	PMEMobjpool **pops;			/* persistent pool handles */
+	char **fnames;				/* pool file names */
 	struct prog_args *pa;			/* prog_args structure */
 	enum lane_section_type lane_type;	/* lane section to be held */
 };
@@ -82,6 +87,23 @@ parse_lane_section(const char *arg)
 		return MAX_LANE_SECTION;
 }
 
+/*
+ * lanes_close -- (internal) closes the first n pools, removes the files of
+ *	the additional ones and frees the file names
+ */
+static void
+lanes_close(struct obj_bench *ob, unsigned n)
+{
+	for (unsigned i = 0; i < n; i++) {
+		pmemobj_close(ob->pops[i]);
+		if (i > 0)
+			unlink(ob->fnames[i]);
+	}
+
+	for (unsigned i = 0; i < ob->pa->n_pools; i++)
+		free(ob->fnames[i]);
+}
+
 /*
  * lanes_init -- benchmark initialization
  */
@@ -102,11 +124,8 @@ lanes_init(struct benchmark *bench, struct benchmark_args *args)
 	ob->pa = args->opts;
 	size_t psize = args->is_poolset ? 0 : PMEMOBJ_MIN_POOL;
 
-	/* create pmemobj pool */
-	ob->pop = pmemobj_create(args->fname,
-			"obj_lanes", psize, args->fmode);
-	if (ob->pop == NULL) {
-		fprintf(stderr, "%s\n", pmemobj_errormsg());
+	if (args->is_poolset && ob->pa->n_pools > 1) {
+		fprintf(stderr, "multiple pools require a regular file\n");
 		goto err;
 	}
 
@@ -116,8 +135,53 @@ lanes_init(struct benchmark *bench, struct benchmark_args *args)
 		goto err;
 	}
 
+	ob->pops = calloc(ob->pa->n_pools, sizeof(*ob->pops));
+	ob->fnames = calloc(ob->pa->n_pools, sizeof(*ob->fnames));
+	if (ob->pops == NULL || ob->fnames == NULL) {
+		perror("calloc");
+		goto err_free;
+	}
+
+	size_t fname_len = strlen(args->fname) + 12;
+	for (unsigned i = 0; i < ob->pa->n_pools; i++) {
+		ob->fnames[i] = malloc(fname_len);
+		if (ob->fnames[i] == NULL) {
+			perror("malloc");
+			lanes_close(ob, 0);
+			goto err_free;
+		}
+
+		if (i == 0)
+			snprintf(ob->fnames[i], fname_len, "%s", args->fname);
+		else
+			snprintf(ob->fnames[i], fname_len, "%s.%u",
+				args->fname, i);
+	}
+
+	unsigned i;
+	for (i = 0; i < ob->pa->n_pools; i++) {
+		/* create pmemobj pool */
+		ob->pops[i] = pmemobj_create(ob->fnames[i],
+				"obj_lanes", psize, args->fmode);
+		if (ob->pops[i] == NULL) {
+			fprintf(stderr, "%s\n", pmemobj_errormsg());
+			goto err_close;
+		}
+
+		/* limit the number of lanes to simulate oversubscription */
+		struct lane_descriptor *desc = &ob->pops[i]->lanes_desc;
+		if (ob->pa->n_lanes != 0 &&
+		    ob->pa->n_lanes < desc->runtime_nlanes)
+			desc->runtime_nlanes = ob->pa->n_lanes;
+	}
+
 	return 0;
 
+err_close:
+	lanes_close(ob, i);
+err_free:
+	free(ob->pops);
+	free(ob->fnames);
 err:
 	free(ob);
 	return -1;
@@ -131,7 +195,9 @@ lanes_exit(struct benchmark *bench, struct benchmark_args *args)
 {
 	struct obj_bench *ob = pmembench_get_priv(bench);
 
-	pmemobj_close(ob->pop);
+	lanes_close(ob, ob->pa->n_pools);
+	free(ob->pops);
+	free(ob->fnames);
 	free(ob);
 
 	return 0;
@@ -145,11 +211,14 @@ lanes_op(struct benchmark *bench, struct operation_info *info)
 {
 	struct obj_bench *ob = pmembench_get_priv(bench);
 	struct lane_section *section;
+	unsigned n_pools = ob->pa->n_pools;
 
 	for (int i = 0; i < OPERATION_REPEAT_COUNT; i++) {
-		lane_hold(ob->pop, &section, ob->lane_type);
+		PMEMobjpool *pop = ob->pops[(unsigned)i % n_pools];
 
-		lane_release(ob->pop);
+		lane_hold(pop, &section, ob->lane_type);
+
+		lane_release(pop);
 	}
 
 	return 0;
@@ -167,6 +236,36 @@ static struct benchmark_clo lanes_clo[] = {
 							lane_section_name),
 		.def		= "allocator",
 	},
+	{
+		.opt_short	= 'l',
+		.opt_long	= "lanes",
+		.descr		= "The number of lanes available in each pool,"
+					" 0 for all of them",
+		.type		= CLO_TYPE_UINT,
+		.off		= clo_field_offset(struct prog_args, n_lanes),
+		.def		= "0",
+		.type_uint	= {
+			.size	= clo_field_size(struct prog_args, n_lanes),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 0,
+			.max	= UINT_MAX
+		}
+	},
+	{
+		.opt_short	= 'p',
+		.opt_long	= "pools",
+		.descr		= "The number of pools used alternately by"
+					" each thread",
+		.type		= CLO_TYPE_UINT,
+		.off		= clo_field_offset(struct prog_args, n_pools),
+		.def		= "1",
+		.type_uint	= {
+			.size	= clo_field_size(struct prog_args, n_pools),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 1,
+			.max	= UINT_MAX
+		}
+	},
 };
 
 /*
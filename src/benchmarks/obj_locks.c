@@ -36,6 +36,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <pthread.h>
 
 #include "libpmemobj.h"
@@ -57,6 +58,7 @@
 	for (unsigned _i = 0; _i < (mb)->pa->n_locks; (_i)++) {\
 		type *_o = (type *)(&(mb)->locks[_i]);\
 		(flock)(__VA_ARGS__(_o));\
+		critical_section((mb)->pa->cs_len);\
 		(funlock)(__VA_ARGS__(_o));\
 	}\
 })
@@ -67,6 +69,7 @@
 		type *_o = (type *)(&(mb)->locks[_i]);\
 		(flock)(__VA_ARGS__(_o));\
 	}\
+	critical_section((mb)->pa->cs_len);\
 	for (unsigned _i = 0; _i < (mb)->pa->n_locks; (_i)++) {\
 		type *_o = (type *)(&(mb)->locks[_i]);\
 		(funlock)(__VA_ARGS__(_o));\
@@ -90,8 +93,22 @@ struct prog_args {
 	char *lock_mode;	/* "1by1" or "all-lock" */
 	char *lock_type;	/* "mutex", "rwlock" or "ram-mutex" */
 	bool use_rdlock;	/* use read lock, instead of write lock */
+	unsigned max_spin;	/* attempts to take a lock before sleeping */
+	unsigned cs_len;	/* length of the critical section */
+	bool print_stats;	/* print PMEM lock contention statistics */
 };
 
+/*
+ * critical_section -- simulates work done while holding the lock
+ */
+static inline void
+critical_section(unsigned len)
+{
+	volatile unsigned work = 0;
+	for (unsigned i = 0; i < len; ++i)
+		work++;
+}
+
 /*
  * mutex similar to PMEMmutex, but with pthread_mutex_t in RAM
  */
@@ -535,6 +552,34 @@ parse_benchmark_mode(const char *arg)
 		return NULL;
 }
 
+/*
+ * print_lock_stats -- prints the summed contention statistics of PMEM locks
+ */
+static void
+print_lock_stats(struct mutex_bench *mb)
+{
+	struct pobj_lock_stats sum = {0, 0, 0, 0};
+	struct pobj_lock_stats stats;
+
+	for (unsigned i = 0; i < mb->pa->n_locks; i++) {
+		if (mb->ops == &benchmark_ops[BENCH_MODE_MUTEX])
+			pmemobj_mutex_stats(mb->pop,
+				&mb->locks[i].pm_mutex, &stats);
+		else
+			pmemobj_rwlock_stats(mb->pop,
+				&mb->locks[i].pm_rwlock, &stats);
+
+		sum.acquired += stats.acquired;
+		sum.contended += stats.contended;
+		sum.spun += stats.spun;
+		sum.parked += stats.parked;
+	}
+
+	fprintf(stderr, "lock stats: acquired %" PRIu64 " contended %" PRIu64
+		" spun %" PRIu64 " parked %" PRIu64 "\n",
+		sum.acquired, sum.contended, sum.spun, sum.parked);
+}
+
 /*
  * locks_init -- allocates persistent memory, maps it, creates the appropriate
  * objects in the allocated memory and initializes them
@@ -570,6 +615,12 @@ locks_init(struct benchmark *bench, struct benchmark_args *args)
 		goto err_free_mb;
 	}
 
+	if (mb->pa->run_id_increment && args->n_threads > 1) {
+		fprintf(stderr, "run_id increment requires a single thread\n");
+		errno = EINVAL;
+		goto err_free_mb;
+	}
+
 	/* reserve some space for metadata */
 	size_t poolsize = mb->pa->n_locks * sizeof(lock_t) + PMEMOBJ_MIN_POOL;
 
@@ -592,6 +643,20 @@ locks_init(struct benchmark *bench, struct benchmark_args *args)
 		goto err_free_mb;
 	}
 
+	if (pmemobj_lock_set_max_spin(mb->pop, mb->pa->max_spin)) {
+		fprintf(stderr, "invalid spin count: %u\n", mb->pa->max_spin);
+		errno = EINVAL;
+		ret = -1;
+		goto err_free_pop;
+	}
+
+	if (mb->pa->print_stats &&
+			pmemobj_lock_stats_enable(mb->pop, 1)) {
+		ret = -1;
+		perror("pmemobj_lock_stats_enable");
+		goto err_free_pop;
+	}
+
 	mb->root = POBJ_ROOT(mb->pop, struct my_root);
 	assert(!TOID_IS_NULL(mb->root));
 
@@ -623,6 +688,10 @@ locks_exit(struct benchmark *bench, struct benchmark_args *args)
 	struct mutex_bench *mb = pmembench_get_priv(bench);
 	assert(mb != NULL);
 
+	if (mb->pa->print_stats && !mb->pa->use_pthread &&
+			mb->ops != &benchmark_ops[BENCH_MODE_VOLATILE_MUTEX])
+		print_lock_stats(mb);
+
 	mb->ops->bench_exit(mb);
 
 	pmemobj_close(mb->pop);
@@ -731,6 +800,46 @@ static struct benchmark_clo locks_clo[] = {
 		.off		= clo_field_offset(struct prog_args,
 							use_rdlock),
 	},
+	{
+		.opt_short	= 0,
+		.opt_long	= "max_spin",
+		.descr		= "The number of attempts to take a contended "
+					"PMEM lock before sleeping, 0 disables "
+					"spinning",
+		.def		= "10",
+		.off		= clo_field_offset(struct prog_args, max_spin),
+		.type		= CLO_TYPE_UINT,
+		.type_uint	= {
+			.size	= clo_field_size(struct prog_args, max_spin),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 0,
+			.max	= UINT_MAX
+		}
+	},
+	{
+		.opt_short	= 0,
+		.opt_long	= "cs_len",
+		.descr		= "The number of iterations of the busy loop "
+					"executed while holding the lock",
+		.def		= "0",
+		.off		= clo_field_offset(struct prog_args, cs_len),
+		.type		= CLO_TYPE_UINT,
+		.type_uint	= {
+			.size	= clo_field_size(struct prog_args, cs_len),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 0,
+			.max	= UINT_MAX
+		}
+	},
+	{
+		.opt_short	= 0,
+		.opt_long	= "stats",
+		.descr		= "Print the contention statistics of PMEM "
+					"locks",
+		.type		= CLO_TYPE_FLAG,
+		.off		= clo_field_offset(struct prog_args,
+							print_stats),
+	},
 };
 
 /* Stores information about benchmark. */
@@ -739,7 +848,7 @@ static struct benchmark_info locks_info = {
 	.brief		= "Benchmark for pmem locks operations",
 	.init		= locks_init,
 	.exit		= locks_exit,
-	.multithread	= false,
+	.multithread	= true,
 	.multiops	= true,
 	.operation	= locks_op,
 	.measure_time	= true,
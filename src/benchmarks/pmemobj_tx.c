@@ -130,6 +130,9 @@ struct obj_tx_args {
 	size_t obj_size;	/* size of each allocated object */
 	size_t n_ops;		/* number of operations */
 	int parse_mode;		/* type of parsing function */
+	bool tx_stats;		/* collect and print transaction statistics */
+	unsigned max_cached_range; /* largest snapshot in tx range cache */
+	bool huge_aligned;	/* align the heap chunks to huge pages */
 };
 
 /*
@@ -230,6 +233,40 @@ static struct benchmark_clo obj_tx_clo[] = {
 			.max	= UINT_MAX,
 		},
 	},
+	{
+		.opt_short	= 'S',
+		.opt_long	= "tx-stats",
+		.descr		= "Print transaction statistics to stderr",
+		.type		= CLO_TYPE_FLAG,
+		.off		= clo_field_offset(struct obj_tx_args,
+								tx_stats),
+	},
+	{
+		.opt_short	= 'C',
+		.opt_long	= "max-cached-range",
+		.type		= CLO_TYPE_UINT,
+		.descr		= "Largest snapshot stored in the transaction "
+				"range cache, 0 - library default",
+		.off		= clo_field_offset(struct obj_tx_args,
+						max_cached_range),
+		.def		= "0",
+		.type_uint	= {
+			.size	= clo_field_size(struct obj_tx_args,
+						max_cached_range),
+			.base	= CLO_INT_BASE_DEC|CLO_INT_BASE_HEX,
+			.min	= 0,
+			.max	= UINT_MAX,
+		},
+	},
+	{
+		.opt_short	= 'H',
+		.opt_long	= "huge-aligned",
+		.descr		= "Align the heap chunks of the pool to "
+				"huge pages",
+		.type		= CLO_TYPE_FLAG,
+		.off		= clo_field_offset(struct obj_tx_args,
+						huge_aligned),
+	},
 	/*
 	 * nclos field in benchmark_info structures is decremented to make this
 	 * options available only for obj_tx_alloc, obj_tx_free and
@@ -1125,14 +1162,33 @@ obj_tx_init(struct benchmark *bench, struct benchmark_args *args)
 
 		psize = 0;
 	}
-	obj_bench.pop = pmemobj_create(args->fname, LAYOUT_NAME,
-						psize, args->fmode);
+	struct pobj_pool_attr attr = {0, 0, 0, 0};
+	if (obj_bench.obj_args->huge_aligned)
+		attr.flags |= POBJ_POOL_HUGE_ALIGNED;
+
+	obj_bench.pop = pmemobj_create_attr(args->fname, LAYOUT_NAME,
+						psize, args->fmode, &attr);
 	if (obj_bench.pop == NULL) {
-		perror("pmemobj_create");
+		perror("pmemobj_create_attr");
 		goto free_all;
 	}
 
+	if (obj_bench.obj_args->tx_stats &&
+			pmemobj_tx_stats_enable(obj_bench.pop, 1) != 0) {
+		fprintf(stderr, "pmemobj_tx_stats_enable\n");
+		goto free_pop;
+	}
+
+	if (obj_bench.obj_args->max_cached_range != 0 &&
+			pmemobj_tx_set_max_cached_range(obj_bench.pop,
+			obj_bench.obj_args->max_cached_range) != 0) {
+		fprintf(stderr, "pmemobj_tx_set_max_cached_range\n");
+		goto free_pop;
+	}
+
 	return 0;
+free_pop:
+	pmemobj_close(obj_bench.pop);
 free_all:
 	free(obj_bench.sizes);
 free_random_types:
@@ -1141,6 +1197,51 @@ free_random_types:
 	return -1;
 }
 
+/*
+ * print_tx_stats -- prints transaction statistics collected in the pool
+ */
+static void
+print_tx_stats(PMEMobjpool *pop)
+{
+	static const char *hist_names[MAX_TX_STATS_HIST] = {
+		"snapshot-bytes",
+		"add-ranges",
+		"allocs",
+		"frees",
+		"commit-ns",
+	};
+
+	struct pobj_tx_stats stats;
+	if (pmemobj_tx_stats(pop, &stats) != 0) {
+		perror("pmemobj_tx_stats");
+		return;
+	}
+
+	uint64_t ncommits = stats.commits ? stats.commits : 1;
+
+	fprintf(stderr, "tx-stats: commits %ju aborts %ju add-ranges %ju "
+		"snapshot-bytes %ju allocs %ju frees %ju\n",
+		stats.commits, stats.aborts, stats.add_ranges,
+		stats.snapshot_bytes, stats.allocs, stats.frees);
+	fprintf(stderr, "tx-stats: avg commit-ns %ju pre-commit-ns %ju "
+		"post-commit-ns %ju\n",
+		stats.commit_ns / ncommits,
+		stats.pre_commit_ns / ncommits,
+		stats.post_commit_ns / ncommits);
+
+	for (int h = 0; h < MAX_TX_STATS_HIST; ++h) {
+		fprintf(stderr, "tx-stats: %s", hist_names[h]);
+		for (int b = 0; b < PMEMOBJ_TX_STATS_HIST_BUCKETS; ++b) {
+			if (stats.hist[h][b] == 0)
+				continue;
+
+			uint64_t lower = b == 0 ? 0 : 1ULL << (b - 1);
+			fprintf(stderr, " %ju:%ju", lower, stats.hist[h][b]);
+		}
+		fprintf(stderr, "\n");
+	}
+}
+
 /*
  * obj_tx_exit -- common part for the exit function of the transactional
  * benchmarks in their exit functions.
@@ -1149,8 +1250,12 @@ int
 obj_tx_exit(struct benchmark *bench, struct benchmark_args *args)
 {
 	struct obj_tx_bench *obj_bench = pmembench_get_priv(bench);
-	if (obj_bench->lib_mode != LIB_MODE_DRAM)
+	if (obj_bench->lib_mode != LIB_MODE_DRAM) {
+		if (obj_bench->obj_args->tx_stats)
+			print_tx_stats(obj_bench->pop);
+
 		pmemobj_close(obj_bench->pop);
+	}
 
 	free(obj_bench->sizes);
 	if (obj_bench->type_mode == NUM_MODE_RAND)
@@ -100,6 +100,66 @@ util_mutex_unlock(pthread_mutex_t *m)
 	}
 }
 
+/*
+ * util_rwlock_init -- pthread_rwlock_init variant that never fails from
+ * caller perspective. If pthread_rwlock_init failed, this function aborts
+ * the program.
+ */
+static inline void
+util_rwlock_init(pthread_rwlock_t *m, const pthread_rwlockattr_t *rwlockattr)
+{
+	int tmp = pthread_rwlock_init(m, rwlockattr);
+	if (tmp) {
+		errno = tmp;
+		FATAL("!pthread_rwlock_init");
+	}
+}
+
+/*
+ * util_rwlock_destroy -- pthread_rwlock_destroy variant that never fails from
+ * caller perspective. If pthread_rwlock_destroy failed, this function aborts
+ * the program.
+ */
+static inline void
+util_rwlock_destroy(pthread_rwlock_t *m)
+{
+	int tmp = pthread_rwlock_destroy(m);
+	if (tmp) {
+		errno = tmp;
+		FATAL("!pthread_rwlock_destroy");
+	}
+}
+
+/*
+ * util_rwlock_rdlock -- pthread_rwlock_rdlock variant that never fails from
+ * caller perspective. If pthread_rwlock_rdlock failed, this function aborts
+ * the program.
+ */
+static inline void
+util_rwlock_rdlock(pthread_rwlock_t *m)
+{
+	int tmp = pthread_rwlock_rdlock(m);
+	if (tmp) {
+		errno = tmp;
+		FATAL("!pthread_rwlock_rdlock");
+	}
+}
+
+/*
+ * util_rwlock_wrlock -- pthread_rwlock_wrlock variant that never fails from
+ * caller perspective. If pthread_rwlock_wrlock failed, this function aborts
+ * the program.
+ */
+static inline void
+util_rwlock_wrlock(pthread_rwlock_t *m)
+{
+	int tmp = pthread_rwlock_wrlock(m);
+	if (tmp) {
+		errno = tmp;
+		FATAL("!pthread_rwlock_wrlock");
+	}
+}
+
 /*
  * util_rwlock_unlock -- pthread_rwlock_unlock variant that never fails from
  * caller perspective. If pthread_rwlock_unlock failed, this function aborts
@@ -42,6 +42,15 @@
 #include <stdio.h>
 #include <ctype.h>
 
+#ifndef _WIN32
+#include <sched.h> /* on Windows sched_yield() comes from platform.h */
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) ||\
+	defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#endif
+
 extern unsigned long long Pagesize;
 extern unsigned long long Mmap_align;
 
@@ -121,6 +130,22 @@ util_get_printable_ascii(char c)
 #endif
 #endif
 
+/*
+ * util_cpu_relax -- tells the processor that the thread is busy-waiting
+ */
+static inline void
+util_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__) ||\
+	defined(_M_X64) || defined(_M_IX86)
+	_mm_pause();
+#elif defined(__aarch64__)
+	__asm__ volatile("yield" ::: "memory");
+#elif defined(__GNUC__)
+	__asm__ volatile("" ::: "memory");
+#endif
+}
+
 #ifndef _WIN32
 #define DIR_SEPARATOR '/'
 #else
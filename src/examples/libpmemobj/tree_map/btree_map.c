@@ -533,12 +533,30 @@ btree_map_remove(PMEMobjpool *pop, TOID(struct btree_map) map, uint64_t key)
 	return ret;
 }
 
+/*
+ * btree_map_prefetch_children -- (internal) starts loading all children of
+ *	the node, so that the one the search descends to is already on its way
+ *	when the keys of the node are compared
+ */
+static void
+btree_map_prefetch_children(TOID(struct tree_map_node) node)
+{
+	const struct tree_map_node *n = D_RO(node);
+	if (TOID_IS_NULL(n->slots[0])) /* leaf */
+		return;
+
+	for (int i = 0; i <= n->n; ++i)
+		TOID_PREFETCH(n->slots[i]);
+}
+
 /*
  * btree_map_get_in_node -- (internal) searches for a value in the node
  */
 static PMEMoid
 btree_map_get_in_node(TOID(struct tree_map_node) node, uint64_t key)
 {
+	btree_map_prefetch_children(node);
+
 	for (int i = 0; i <= D_RO(node)->n; ++i) {
 		if (NODE_CONTAINS_ITEM(node, i, key))
 			return D_RO(node)->items[i].value;
@@ -566,6 +584,8 @@ btree_map_get(PMEMobjpool *pop, TOID(struct btree_map) map, uint64_t key)
 static int
 btree_map_lookup_in_node(TOID(struct tree_map_node) node, uint64_t key)
 {
+	btree_map_prefetch_children(node);
+
 	for (int i = 0; i <= D_RO(node)->n; ++i) {
 		if (NODE_CONTAINS_ITEM(node, i, key))
 			return 1;
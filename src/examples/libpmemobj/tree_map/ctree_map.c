@@ -240,8 +240,15 @@ ctree_map_get_leaf(TOID(struct ctree_map) map, uint64_t key,
 	struct tree_map_entry *p = NULL;
 
 	TOID(struct tree_map_node) node;
-	while (!OID_IS_NULL(n->slot) &&
-				OID_INSTANCEOF(n->slot, struct tree_map_node)) {
+	while (!OID_IS_NULL(n->slot)) {
+		/*
+		 * The type check below reads the header of the object, start
+		 * loading the node itself in the meantime.
+		 */
+		pmemobj_prefetch(n->slot);
+		if (!OID_INSTANCEOF(n->slot, struct tree_map_node))
+			break;
+
 		TOID_ASSIGN(node, n->slot);
 
 		p = n;
@@ -324,10 +324,16 @@ rbtree_map_find_node(TOID(struct rbtree_map) map, uint64_t key)
 	TOID(struct tree_map_node) s = D_RO(map)->sentinel;
 
 	while (!NODE_IS_NULL(dst)) {
-		if (D_RO(dst)->key == key)
+		const struct tree_map_node *n = D_RO(dst);
+
+		/* start loading both children before the comparison */
+		TOID_PREFETCH(n->slots[RB_LEFT]);
+		TOID_PREFETCH(n->slots[RB_RIGHT]);
+
+		if (n->key == key)
 			return dst;
 
-		dst = D_RO(dst)->slots[key > D_RO(dst)->key];
+		dst = n->slots[key > n->key];
 	}
 
 	return TOID_NULL(struct tree_map_node);
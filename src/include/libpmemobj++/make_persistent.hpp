@@ -45,6 +45,7 @@
 #include "libpmemobj++/detail/pexceptions.hpp"
 #include "libpmemobj/tx_base.h"
 
+#include <cstddef>
 #include <new>
 
 namespace nvml
@@ -92,6 +93,49 @@ make_persistent(Args &&... args)
 	return ptr;
 }
 
+/**
+ * Transactionally allocate and construct an object of type T aligned to the
+ * given boundary.
+ *
+ * This function can be used to *transactionally* allocate an object with
+ * a stricter alignment than the default cache line alignment, for example
+ * to a page boundary. Cannot be used for array types.
+ *
+ * @param[in] alignment the alignment of the object, a power of two not
+ * larger than PMEMOBJ_MAX_ALIGNMENT.
+ * @param[in,out] args a list of parameters passed to the constructor.
+ *
+ * @return persistent_ptr<T> on success
+ *
+ * @throw transaction_scope_error if called outside of an active
+ * transaction
+ * @throw transaction_alloc_error on transactional allocation failure.
+ */
+template <typename T, typename... Args>
+typename detail::pp_if_not_array<T>::type
+make_persistent_aligned(std::size_t alignment, Args &&... args)
+{
+	if (pmemobj_tx_stage() != TX_STAGE_WORK)
+		throw transaction_scope_error(
+			"refusing to allocate "
+			"memory outside of transaction scope");
+
+	persistent_ptr<T> ptr = pmemobj_tx_alloc_aligned(
+		sizeof(T), alignment, detail::type_num<T>());
+
+	if (ptr == nullptr)
+		throw transaction_alloc_error("failed to allocate "
+					      "persistent memory object");
+	try {
+		new (ptr.get()) T(args...);
+	} catch (...) {
+		pmemobj_tx_free(*ptr.raw_ptr());
+		throw;
+	}
+
+	return ptr;
+}
+
 /**
  * Transactionally free an object of type T held in a persitent_ptr.
  *
@@ -248,6 +248,18 @@ public:
 		return (element_type *)pmemobj_direct(this->oid);
 	}
 
+	/**
+	 * Start loading the pointed-to object into the cache.
+	 *
+	 * A hint which lets the load overlap with other work done before
+	 * the object is accessed. Does nothing for a null pointer.
+	 */
+	void
+	prefetch() const noexcept
+	{
+		pmemobj_prefetch(this->oid);
+	}
+
 	/**
 	 * Swaps two persistent_ptr objects of the same type.
 	 */
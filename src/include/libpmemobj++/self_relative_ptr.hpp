@@ -0,0 +1,392 @@
+/*
+ * Copyright 2015-2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Self-relative persistent smart pointer.
+ */
+
+#ifndef PMEMOBJ_SELF_RELATIVE_PTR_HPP
+#define PMEMOBJ_SELF_RELATIVE_PTR_HPP
+
+#include <cstdint>
+#include <type_traits>
+
+#include "libpmemobj++/detail/common.hpp"
+#include "libpmemobj++/persistent_ptr.hpp"
+#include "libpmemobj/types.h"
+
+namespace nvml
+{
+
+namespace obj
+{
+
+/**
+ * Self-relative persistent pointer class.
+ *
+ * self_relative_ptr is a compact alternative to persistent_ptr for pointers
+ * between the objects of the same pool. Instead of the 16 byte PMEMoid it
+ * holds the 8 byte distance from its own address to the object, so it is
+ * dereferenced with a single addition, without looking up the pool.
+ * Because the stored value depends on where the pointer is, copying and
+ * assignment recalculate it, and the pointer can only be placed in the pool
+ * of the object it points to. Assignment within a transaction automatically
+ * registers the pointer in the undo log, the snapshot is restored at the
+ * same address, so it stays valid after a rollback.
+ * This type does NOT manage the life-cycle of the object.
+ */
+template <typename T>
+class self_relative_ptr {
+	template <typename Y>
+	friend class self_relative_ptr;
+
+public:
+	/**
+	 * Type of the pointed to object.
+	 */
+	typedef T element_type;
+
+	/**
+	 * Default constructor, creates a null pointer.
+	 */
+	self_relative_ptr() noexcept : off(0)
+	{
+		verify_type();
+	}
+
+	/**
+	 * Null constructor.
+	 */
+	self_relative_ptr(std::nullptr_t) noexcept : off(0)
+	{
+		verify_type();
+	}
+
+	/**
+	 * Direct pointer constructor.
+	 *
+	 * @param ptr address of an object of the pool the pointer is in
+	 */
+	explicit self_relative_ptr(element_type *ptr) noexcept
+	    : off(_pobj_relptr_off(&off, ptr))
+	{
+		verify_type();
+	}
+
+	/**
+	 * Persistent pointer constructor.
+	 *
+	 * Available only for convertible types.
+	 */
+	template <typename Y,
+		  typename = typename std::enable_if<
+			  std::is_convertible<Y *, T *>::value>::type>
+	self_relative_ptr(const persistent_ptr<Y> &r) noexcept
+	    : off(_pobj_relptr_off(&off, static_cast<T *>(r.get())))
+	{
+		verify_type();
+	}
+
+	/**
+	 * Copy constructor from a different self_relative_ptr<>.
+	 *
+	 * Available only for convertible types.
+	 */
+	template <typename Y,
+		  typename = typename std::enable_if<
+			  std::is_convertible<Y *, T *>::value>::type>
+	self_relative_ptr(const self_relative_ptr<Y> &r) noexcept
+	    : off(_pobj_relptr_off(&off, static_cast<T *>(r.get())))
+	{
+		verify_type();
+	}
+
+	/**
+	 * Copy constructor.
+	 *
+	 * Recalculates the distance for the address of the new pointer.
+	 */
+	self_relative_ptr(const self_relative_ptr &r) noexcept
+	    : off(_pobj_relptr_off(&off, r.get()))
+	{
+		verify_type();
+	}
+
+	/**
+	 * Assignment operator.
+	 *
+	 * Assignment within a transaction automatically registers this
+	 * operation so that a rollback is possible.
+	 *
+	 * @throw nvml::transaction_error when adding the object to the
+	 *	transaction failed.
+	 */
+	self_relative_ptr &
+	operator=(const self_relative_ptr &r)
+	{
+		return assign(r.get());
+	}
+
+	/**
+	 * Converting assignment operator from a different
+	 * self_relative_ptr<>.
+	 *
+	 * Available only for convertible types.
+	 *
+	 * @throw nvml::transaction_error when adding the object to the
+	 *	transaction failed.
+	 */
+	template <typename Y,
+		  typename = typename std::enable_if<
+			  std::is_convertible<Y *, T *>::value>::type>
+	self_relative_ptr &
+	operator=(const self_relative_ptr<Y> &r)
+	{
+		return assign(r.get());
+	}
+
+	/**
+	 * Assignment operator from a persistent_ptr<>.
+	 *
+	 * Available only for convertible types.
+	 *
+	 * @throw nvml::transaction_error when adding the object to the
+	 *	transaction failed.
+	 */
+	template <typename Y,
+		  typename = typename std::enable_if<
+			  std::is_convertible<Y *, T *>::value>::type>
+	self_relative_ptr &
+	operator=(const persistent_ptr<Y> &r)
+	{
+		return assign(r.get());
+	}
+
+	/**
+	 * Null assignment operator.
+	 *
+	 * @throw nvml::transaction_error when adding the object to the
+	 *	transaction failed.
+	 */
+	self_relative_ptr &
+	operator=(std::nullptr_t)
+	{
+		return assign(nullptr);
+	}
+
+	/**
+	 * Dereference operator.
+	 */
+	element_type &operator*() const noexcept
+	{
+		return *get();
+	}
+
+	/**
+	 * Member access operator.
+	 */
+	element_type *operator->() const noexcept
+	{
+		return get();
+	}
+
+	/**
+	 * Get a direct pointer.
+	 *
+	 * @return a direct pointer to the object.
+	 */
+	element_type *
+	get() const noexcept
+	{
+		return static_cast<element_type *>(_pobj_relptr_direct(&off));
+	}
+
+	/**
+	 * Get a persistent_ptr to the object.
+	 *
+	 * @return persistent pointer to the object, null if the pool of
+	 *	the object is not open.
+	 */
+	persistent_ptr<T>
+	to_persistent_ptr() const noexcept
+	{
+		return persistent_ptr<T>(pmemobj_oid(get()));
+	}
+
+	/**
+	 * Bool conversion operator.
+	 */
+	explicit operator bool() const noexcept
+	{
+		return off != 0;
+	}
+
+	/**
+	 * Get the stored distance.
+	 *
+	 * @return the distance from the address of the pointer to the
+	 *	object plus one, or zero for a null pointer
+	 */
+	int64_t
+	raw() const noexcept
+	{
+		return off;
+	}
+
+	/**
+	 * Swaps the objects two self_relative_ptr objects point to.
+	 *
+	 * @throw nvml::transaction_error when adding the pointers to the
+	 *	transaction failed.
+	 */
+	void
+	swap(self_relative_ptr &other)
+	{
+		element_type *ptr = get();
+		assign(other.get());
+		other.assign(ptr);
+	}
+
+private:
+	/* The distance to the object, plus one, zero means null. */
+	int64_t off;
+
+	/*
+	 * Points this pointer at the given address, registering it in
+	 * the active transaction first.
+	 */
+	self_relative_ptr &
+	assign(element_type *ptr)
+	{
+		detail::conditional_add_to_tx(this);
+		this->off = _pobj_relptr_off(&this->off, ptr);
+
+		return *this;
+	}
+
+	/*
+	 * C++ persistent memory support has following type limitations:
+	 * en.cppreference.com/w/cpp/types/is_polymorphic
+	 */
+	void
+	verify_type()
+	{
+		static_assert(!std::is_polymorphic<element_type>::value,
+			      "Polymorphic types are not supported");
+		static_assert(!std::is_array<element_type>::value,
+			      "Arrays are not supported");
+	}
+};
+
+/**
+ * Swaps the objects two self_relative_ptr objects point to.
+ *
+ * Non-member swap function as required by Swappable concept.
+ * en.cppreference.com/w/cpp/concept/Swappable
+ */
+template <class T>
+inline void
+swap(self_relative_ptr<T> &a, self_relative_ptr<T> &b)
+{
+	a.swap(b);
+}
+
+/**
+ * Equality operator.
+ *
+ * This checks if both pointers point to the same object.
+ */
+template <typename T, typename Y>
+inline bool
+operator==(const self_relative_ptr<T> &lhs,
+	   const self_relative_ptr<Y> &rhs) noexcept
+{
+	return lhs.get() == rhs.get();
+}
+
+/**
+ * Inequality operator.
+ */
+template <typename T, typename Y>
+inline bool
+operator!=(const self_relative_ptr<T> &lhs,
+	   const self_relative_ptr<Y> &rhs) noexcept
+{
+	return !(lhs == rhs);
+}
+
+/**
+ * Equality operator with nullptr.
+ */
+template <typename T>
+inline bool
+operator==(const self_relative_ptr<T> &lhs, std::nullptr_t) noexcept
+{
+	return !lhs;
+}
+
+/**
+ * Equality operator with nullptr.
+ */
+template <typename T>
+inline bool
+operator==(std::nullptr_t, const self_relative_ptr<T> &lhs) noexcept
+{
+	return !lhs;
+}
+
+/**
+ * Inequality operator with nullptr.
+ */
+template <typename T>
+inline bool
+operator!=(const self_relative_ptr<T> &lhs, std::nullptr_t) noexcept
+{
+	return static_cast<bool>(lhs);
+}
+
+/**
+ * Inequality operator with nullptr.
+ */
+template <typename T>
+inline bool
+operator!=(std::nullptr_t, const self_relative_ptr<T> &lhs) noexcept
+{
+	return static_cast<bool>(lhs);
+}
+
+} /* namespace obj */
+
+} /* namespace nvml */
+
+#endif /* PMEMOBJ_SELF_RELATIVE_PTR_HPP */
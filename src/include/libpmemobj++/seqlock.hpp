@@ -0,0 +1,232 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Pmem-resident sequence lock.
+ */
+
+#ifndef PMEMOBJ_SEQLOCK_HPP
+#define PMEMOBJ_SEQLOCK_HPP
+
+#include <cstdint>
+
+#include "libpmemobj++/detail/pexceptions.hpp"
+#include "libpmemobj/thread.h"
+#include "libpmemobj/tx_base.h"
+
+namespace nvml
+{
+
+namespace obj
+{
+
+/**
+ * Persistent memory resident sequence lock implementation.
+ *
+ * This class is an implementation of a PMEM-resident sequence lock for
+ * read-mostly data. Writers exclude each other and the lock satisfies
+ * the Lockable and StandardLayoutType concepts on the writer side.
+ * Readers never write to the lock, instead they retry the read if
+ * a writer modified the data in the meantime. The typical usage would be:
+ * @code
+ *	proot->lock.read([&] { copy = proot->data; });
+ *
+ *	std::lock_guard<nvobj::seqlock> guard(proot->lock);
+ *	proot->data = new_data;
+ * @endcode
+ */
+class seqlock {
+public:
+	/** Implementation defined handle to the native type. */
+	typedef PMEMseqlock *native_handle_type;
+
+	/**
+	 * Defaulted constructor.
+	 */
+	seqlock() noexcept = default;
+
+	/**
+	 * Defaulted destructor.
+	 */
+	~seqlock() = default;
+
+	/**
+	 * Lock the seqlock for writing.
+	 *
+	 * If a different thread already locked this seqlock, the calling
+	 * thread will spin until it is unlocked. If the same thread tries
+	 * to lock a seqlock it already owns, the behavior is undefined.
+	 *
+	 * @throw lock_error when an error occurs, this includes all
+	 * system related errors with the underlying implementation of
+	 * the seqlock.
+	 */
+	void
+	lock()
+	{
+		PMEMobjpool *pop = pmemobj_pool_by_ptr(this);
+		if (int ret = pmemobj_seqlock_write_lock(pop, &this->plock))
+			throw lock_error(ret, std::system_category(),
+					 "Failed to lock a seqlock.");
+	}
+
+	/**
+	 * Try to lock the seqlock for writing, returns regardless if
+	 * the lock succeeds.
+	 *
+	 * @return `true` on successful lock acquisition, `false`
+	 * otherwise.
+	 *
+	 * @throw lock_error when an error occurs, this includes all
+	 * system related errors with the underlying implementation of
+	 * the seqlock.
+	 */
+	bool
+	try_lock()
+	{
+		PMEMobjpool *pop = pmemobj_pool_by_ptr(this);
+		int ret = pmemobj_seqlock_write_trylock(pop, &this->plock);
+
+		if (ret == 0)
+			return true;
+		else if (ret == EBUSY)
+			return false;
+		else
+			throw lock_error(ret, std::system_category(),
+					 "Failed to lock a seqlock.");
+	}
+
+	/**
+	 * Unlocks the seqlock locked for writing.
+	 *
+	 * @throw lock_error when an error occurs, this includes all
+	 * system related errors with the underlying implementation of
+	 * the seqlock.
+	 */
+	void
+	unlock()
+	{
+		PMEMobjpool *pop = pmemobj_pool_by_ptr(this);
+		if (int ret = pmemobj_seqlock_write_unlock(pop, &this->plock))
+			throw lock_error(ret, std::system_category(),
+					 "Failed to unlock a seqlock.");
+	}
+
+	/**
+	 * Start a read-side critical section.
+	 *
+	 * Waits until there is no active writer.
+	 *
+	 * @return the sequence number to be passed to read_retry.
+	 */
+	uint64_t
+	read_begin() noexcept
+	{
+		PMEMobjpool *pop = pmemobj_pool_by_ptr(this);
+		return pmemobj_seqlock_read_begin(pop, &this->plock);
+	}
+
+	/**
+	 * End a read-side critical section.
+	 *
+	 * @return `true` if a writer modified the data since the matching
+	 * read_begin call and the read has to be repeated.
+	 */
+	bool
+	read_retry(uint64_t seq) noexcept
+	{
+		PMEMobjpool *pop = pmemobj_pool_by_ptr(this);
+		return pmemobj_seqlock_read_retry(pop, &this->plock, seq) != 0;
+	}
+
+	/**
+	 * Execute a read-side critical section until it observes
+	 * consistent data.
+	 *
+	 * The function object may be called multiple times and
+	 * may observe inconsistent data in all but the last call, so it
+	 * should only copy the protected data.
+	 */
+	template <typename F>
+	void
+	read(F &&f)
+	{
+		uint64_t seq;
+		do {
+			seq = this->read_begin();
+			f();
+		} while (this->read_retry(seq));
+	}
+
+	/**
+	 * Access a native handle to this seqlock.
+	 *
+	 * @return a pointer to PMEMseqlock.
+	 */
+	native_handle_type
+	native_handle() noexcept
+	{
+		return &this->plock;
+	}
+
+	/**
+	 * The type of lock needed for the transaction API.
+	 *
+	 * @return TX_LOCK_SEQLOCK
+	 */
+	enum pobj_tx_lock
+	lock_type() const noexcept
+	{
+		return TX_LOCK_SEQLOCK;
+	}
+
+	/**
+	 * Deleted assignment operator.
+	 */
+	seqlock &operator=(const seqlock &) = delete;
+
+	/**
+	 * Deleted copy constructor.
+	 */
+	seqlock(const seqlock &) = delete;
+
+private:
+	/** A PMEM-resident sequence lock. */
+	PMEMseqlock plock;
+};
+
+} /* namespace obj */
+
+} /* namespace nvml */
+
+#endif /* PMEMOBJ_SEQLOCK_HPP */
@@ -47,7 +47,8 @@ extern "C" {
  * Non-transactional atomic allocations
  *
  * Those functions can be used outside transactions. The allocations are always
- * aligned to the cache-line boundary.
+ * aligned to the cache-line boundary, or to 16 bytes in pools created with
+ * POBJ_POOL_COMPACT_HEADERS.
  */
 
 /*
@@ -65,6 +66,14 @@ int pmemobj_alloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 int pmemobj_zalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 	uint64_t type_num);
 
+/*
+ * Allocates a new object aligned to the given boundary, which has to be
+ * a power of two not larger than PMEMOBJ_MAX_ALIGNMENT.
+ */
+int pmemobj_alloc_aligned(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
+	size_t alignment, uint64_t type_num, pmemobj_constr constructor,
+	void *arg);
+
 /*
  * Resizes an existing object.
  */
@@ -88,6 +97,46 @@ int pmemobj_strdup(PMEMobjpool *pop, PMEMoid *oidp, const char *s,
  */
 void pmemobj_free(PMEMoid *oidp);
 
+/*
+ * Regions
+ *
+ * A region is an object from which other objects are allocated by bumping
+ * a pointer. The objects cannot be freed one by one, instead all of them are
+ * freed together with the region, or by resetting it. The objects allocated
+ * from a region are aligned to 16 bytes and do not have a type number.
+ * Concurrent use of one region has to be serialized by the application.
+ */
+
+/*
+ * Allocates a new region with space for size bytes of objects.
+ */
+int pmemobj_region_create(PMEMobjpool *pop, PMEMoid *regionp, size_t size,
+	uint64_t type_num);
+
+/*
+ * Allocates a new object from the region and calls a constructor function
+ * before returning. If interrupted, the space reserved for the object is
+ * reclaimed when the region is freed or reset.
+ */
+int pmemobj_region_alloc(PMEMoid region, PMEMoid *oidp, size_t size,
+	pmemobj_constr constructor, void *arg);
+
+/*
+ * Allocates a new zeroed object from the region.
+ */
+int pmemobj_region_zalloc(PMEMoid region, PMEMoid *oidp, size_t size);
+
+/*
+ * Frees all of the objects allocated from the region, the region stays
+ * allocated.
+ */
+void pmemobj_region_reset(PMEMoid region);
+
+/*
+ * Frees the region together with all of its objects.
+ */
+void pmemobj_region_free(PMEMoid *regionp);
+
 #ifdef __cplusplus
 }
 #endif
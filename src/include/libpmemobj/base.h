@@ -44,6 +44,10 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#ifdef _MSC_VER
+#include <xmmintrin.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -53,6 +57,7 @@ extern "C" {
 typedef struct pmemobjpool PMEMobjpool;
 
 #define PMEMOBJ_MAX_ALLOC_SIZE ((size_t)0x3FFDFFFC0)
+#define PMEMOBJ_MAX_ALIGNMENT ((size_t)(2 << 20)) /* 2 megabytes */
 
 /*
  * Persistent memory object
@@ -75,8 +80,25 @@ static const PMEMoid OID_NULL = { 0, 0 };
 PMEMobjpool *pmemobj_pool_by_ptr(const void *addr);
 PMEMobjpool *pmemobj_pool_by_oid(PMEMoid oid);
 
+/*
+ * Returns the handle of the object at the given address of an open pool.
+ */
+PMEMoid pmemobj_oid(const void *addr);
+
 #ifndef _WIN32
 
+/*
+ * Table of the open pools indexed by the low bits of their uuid_lo, used by
+ * the pmemobj_direct fast path. A slot which is not in use holds an uuid_lo
+ * value which indexes some other slot, so it never matches an object handle.
+ */
+#define _POBJ_POOL_TABLE_SIZE 64
+
+extern struct _pobj_pool_slot {
+	uint64_t uuid_lo;
+	PMEMobjpool *pop;
+} _pobj_pools[_POBJ_POOL_TABLE_SIZE];
+
 extern int _pobj_cache_invalidate;
 extern __thread struct _pobj_pcache {
 	PMEMobjpool *pop;
@@ -90,7 +112,17 @@ extern __thread struct _pobj_pcache {
 static inline void *
 pmemobj_direct(PMEMoid oid)
 {
-	if (oid.off == 0 || oid.pool_uuid_lo == 0)
+	if (oid.off == 0)
+		return NULL;
+
+	struct _pobj_pool_slot *slot =
+		&_pobj_pools[oid.pool_uuid_lo % _POBJ_POOL_TABLE_SIZE];
+
+	if (slot->uuid_lo == oid.pool_uuid_lo)
+		return (void *)((uintptr_t)slot->pop + oid.off);
+
+	/* the pool shares its slot with another one */
+	if (oid.pool_uuid_lo == 0)
 		return NULL;
 
 	if (_pobj_cache_invalidate != _pobj_cached_pool.invalidate ||
@@ -119,6 +151,37 @@ void *pmemobj_direct(PMEMoid oid);
 
 #endif /* _WIN32 */
 
+#ifndef _MSC_VER
+#define _POBJ_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define _POBJ_PREFETCH(addr) _mm_prefetch((const char *)(addr), _MM_HINT_T0)
+#endif
+
+/*
+ * Hints the processor to start loading the beginning of an object into
+ * the cache, so that the access to the object which follows later does not
+ * stall on the whole latency of the medium. It is only a hint, the contents
+ * of the memory are not affected and a null or stale handle is harmless.
+ */
+static inline void
+pmemobj_prefetch(PMEMoid oid)
+{
+	void *ptr = pmemobj_direct(oid);
+	if (ptr != NULL)
+		_POBJ_PREFETCH(ptr);
+}
+
+/*
+ * Prefetches all of the objects from the given array of handles, so that
+ * the loads of all of them are in flight at the same time.
+ */
+static inline void
+pmemobj_prefetch_n(const PMEMoid *oids, size_t noids)
+{
+	for (size_t i = 0; i < noids; ++i)
+		pmemobj_prefetch(oids[i]);
+}
+
 const char *pmemobj_errormsg(void);
 
 /*
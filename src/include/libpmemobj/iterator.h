@@ -47,25 +47,13 @@ extern "C" {
 static inline PMEMoid
 POBJ_FIRST_TYPE_NUM(PMEMobjpool *pop, uint64_t type_num)
 {
-	PMEMoid _pobj_ret = pmemobj_first(pop);
-
-	while (!OID_IS_NULL(_pobj_ret) &&
-			pmemobj_type_num(_pobj_ret) != type_num) {
-		_pobj_ret = pmemobj_next(_pobj_ret);
-	}
-	return _pobj_ret;
+	return pmemobj_first_type(pop, type_num);
 }
 
 static inline PMEMoid
 POBJ_NEXT_TYPE_NUM(PMEMoid o)
 {
-	PMEMoid _pobj_ret = o;
-
-	do {
-		_pobj_ret = pmemobj_next(_pobj_ret);\
-	} while (!OID_IS_NULL(_pobj_ret) &&
-			pmemobj_type_num(_pobj_ret) != pmemobj_type_num(o));
-	return _pobj_ret;
+	return pmemobj_next_type(o);
 }
 
 
@@ -94,16 +82,21 @@ for (_POBJ_DEBUG_NOTICE_IN_TX_FOR("POBJ_FOREACH_SAFE")\
  * Iterates through every object of the specified type.
  */
 #define POBJ_FOREACH_TYPE(pop, var)\
-POBJ_FOREACH(pop, (var).oid)\
-if (pmemobj_type_num((var).oid) == TOID_TYPE_NUM_OF(var))
+for (_POBJ_DEBUG_NOTICE_IN_TX_FOR("POBJ_FOREACH")\
+	(var).oid = pmemobj_first_type(pop, TOID_TYPE_NUM_OF(var));\
+		(var).oid.off != 0;\
+		(var).oid = pmemobj_next_type((var).oid))
 
 /*
  * Safe variant of POBJ_FOREACH_TYPE in which pmemobj_free on var
  * is allowed.
  */
 #define POBJ_FOREACH_SAFE_TYPE(pop, var, nvar)\
-POBJ_FOREACH_SAFE(pop, (var).oid, (nvar).oid)\
-if (pmemobj_type_num((var).oid) == TOID_TYPE_NUM_OF(var))
+for (_POBJ_DEBUG_NOTICE_IN_TX_FOR("POBJ_FOREACH_SAFE")\
+	(var).oid = pmemobj_first_type(pop, TOID_TYPE_NUM_OF(var));\
+		(var).oid.off != 0 &&\
+		((nvar).oid = pmemobj_next_type((var).oid), 1);\
+		(var).oid = (nvar).oid)
 
 #ifdef __cplusplus
 }
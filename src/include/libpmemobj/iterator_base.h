@@ -61,6 +61,48 @@ PMEMoid pmemobj_first(PMEMobjpool *pop);
  */
 PMEMoid pmemobj_next(PMEMoid oid);
 
+/*
+ * The following functions use a volatile index of objects by type number,
+ * built on first use with a single heap walk and then kept up to date by the
+ * allocator. Their cost depends only on the number of objects of the
+ * requested type.
+ */
+
+/*
+ * Returns the first object of the specified type number.
+ */
+PMEMoid pmemobj_first_type(PMEMobjpool *pop, uint64_t type_num);
+
+/*
+ * Returns the next object of the same type number.
+ */
+PMEMoid pmemobj_next_type(PMEMoid oid);
+
+/*
+ * Returns the number of objects of the specified type number.
+ */
+size_t pmemobj_type_count(PMEMobjpool *pop, uint64_t type_num);
+
+/*
+ * Called for each object visited by the parallel traversal, possibly from
+ * many threads at once. A non-zero return value stops the traversal.
+ */
+typedef int (*pmemobj_foreach_cb)(PMEMoid oid, void *arg);
+
+/*
+ * Calls cb for every object in the pool, using nthreads threads including
+ * the calling one. Returns 0 or the first non-zero value returned by cb.
+ */
+int pmemobj_foreach_parallel(PMEMobjpool *pop, unsigned nthreads,
+	pmemobj_foreach_cb cb, void *arg);
+
+/*
+ * Same as pmemobj_foreach_parallel, but visits only the objects of the
+ * specified type number.
+ */
+int pmemobj_foreach_type_parallel(PMEMobjpool *pop, uint64_t type_num,
+	unsigned nthreads, pmemobj_foreach_cb cb, void *arg);
+
 
 #ifdef __cplusplus
 }
@@ -61,6 +61,23 @@ int pmemobj_list_move(PMEMobjpool *pop, size_t pe_old_offset,
 	void *head_old, size_t pe_new_offset, void *head_new,
 	PMEMoid dest, int before, PMEMoid oid);
 
+/*
+ * Batch variants of the above, operating on an array of 'noids' existing
+ * objects under a single acquisition of the list locks. The first object is
+ * put at the destination and each of the following ones right after its
+ * predecessor. Each object is inserted, removed or moved atomically and as
+ * many of them as fit in the redo log of a lane share a single fail-safe step.
+ */
+int pmemobj_list_insert_batch(PMEMobjpool *pop, size_t pe_offset, void *head,
+	PMEMoid dest, int before, const PMEMoid *oids, size_t noids);
+
+int pmemobj_list_remove_batch(PMEMobjpool *pop, size_t pe_offset, void *head,
+	const PMEMoid *oids, size_t noids, int free);
+
+int pmemobj_list_move_batch(PMEMobjpool *pop, size_t pe_old_offset,
+	void *head_old, size_t pe_new_offset, void *head_new,
+	PMEMoid dest, int before, const PMEMoid *oids, size_t noids);
+
 #ifdef __cplusplus
 }
 #endif
@@ -57,6 +57,45 @@ PMEMobjpool *pmemobj_create(const char *path, const char *layout,
 void pmemobj_close(PMEMobjpool *pop);
 int pmemobj_check(const char *path, const char *layout);
 
+/*
+ * Pool creation parameters, zero means the default value.
+ *
+ * The number of lanes limits the number of transactions and atomic operations
+ * which can run concurrently in the pool. The lane section size sets the
+ * length of the redo logs of the list and allocator sections of each lane,
+ * a larger one lets a single list or heap operation modify more locations
+ * before it needs the extension redo log. The transaction section does not
+ * use the additional space, its undo log is allocated from the heap.
+ * The lane section size must be a multiple of 64 bytes, between 1 and 64 KB.
+ * The extension redo log is shared by all lanes and holds the atomic heap
+ * operations which are too large for the redo log of a lane, by default
+ * the pool has none.
+ * With POBJ_POOL_COMPACT_HEADERS in flags each object has a single 16 byte
+ * header, instead of the 64 bytes of the allocation and out-of-band headers,
+ * and the objects are 16 byte aligned. Such pools cannot be opened by older
+ * versions of the library.
+ * With POBJ_POOL_HUGE_ALIGNED the heap is padded so that its chunks start at
+ * a 2 MB boundary, which lets a DAX mapping back large objects with huge
+ * pages. This wastes up to 2 MB of the pool and has the same compatibility
+ * restriction.
+ */
+#define POBJ_POOL_COMPACT_HEADERS (1U << 0)
+#define POBJ_POOL_HUGE_ALIGNED (1U << 1)
+
+struct pobj_pool_attr {
+	unsigned nlanes;
+	size_t lane_section_size;
+	size_t ext_redo_entries;
+	unsigned flags;
+};
+
+/*
+ * Same as pmemobj_create, but allows to set the pool parameters which cannot
+ * be changed after the pool is created.
+ */
+PMEMobjpool *pmemobj_create_attr(const char *path, const char *layout,
+	size_t poolsize, mode_t mode, const struct pobj_pool_attr *attr);
+
 /*
  * If called for the first time on a newly created pool, the root object
  * of given size is allocated.  Otherwise, it returns the existing root object.
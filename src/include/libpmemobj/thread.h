@@ -61,6 +61,10 @@ typedef struct {
 	char padding[_POBJ_CL_ALIGNMENT];
 } PMEMcond;
 
+typedef struct {
+	char padding[_POBJ_CL_ALIGNMENT];
+} PMEMseqlock;
+
 void pmemobj_mutex_zero(PMEMobjpool *pop, PMEMmutex *mutexp);
 int pmemobj_mutex_lock(PMEMobjpool *pop, PMEMmutex *mutexp);
 int pmemobj_mutex_timedlock(PMEMobjpool *pop, PMEMmutex *__restrict mutexp,
@@ -90,6 +94,61 @@ int pmemobj_cond_timedwait(PMEMobjpool *pop, PMEMcond *__restrict condp,
 int pmemobj_cond_wait(PMEMobjpool *pop, PMEMcond *condp,
 	PMEMmutex *__restrict mutexp);
 
+/*
+ * Sequence lock.
+ *
+ * Readers never write to the lock, they retry the read-side critical section
+ * instead if a writer was active in the meantime:
+ *
+ *	uint64_t seq;
+ *	do {
+ *		seq = pmemobj_seqlock_read_begin(pop, &seqlock);
+ *		... copy the protected data ...
+ *	} while (pmemobj_seqlock_read_retry(pop, &seqlock, seq));
+ *
+ * Writers exclude each other and must not sleep while holding the lock.
+ */
+void pmemobj_seqlock_zero(PMEMobjpool *pop, PMEMseqlock *seqlockp);
+uint64_t pmemobj_seqlock_read_begin(PMEMobjpool *pop, PMEMseqlock *seqlockp);
+int pmemobj_seqlock_read_retry(PMEMobjpool *pop, PMEMseqlock *seqlockp,
+	uint64_t seq);
+int pmemobj_seqlock_write_lock(PMEMobjpool *pop, PMEMseqlock *seqlockp);
+int pmemobj_seqlock_write_trylock(PMEMobjpool *pop, PMEMseqlock *seqlockp);
+int pmemobj_seqlock_write_unlock(PMEMobjpool *pop, PMEMseqlock *seqlockp);
+
+/*
+ * Lock contention statistics
+ */
+struct pobj_lock_stats {
+	uint64_t acquired;	/* successful lock acquisitions */
+	uint64_t contended;	/* acquisitions which found the lock taken */
+	uint64_t spun;		/* contended acquisitions won by spinning */
+	uint64_t parked;	/* contended acquisitions which had to sleep */
+};
+
+/*
+ * Sets the number of attempts, with an exponential backoff between them,
+ * to take a contended mutex or rwlock before the thread goes to sleep.
+ * Zero disables spinning.
+ *
+ * If successful, returns zero. Otherwise, an error number is returned.
+ */
+int pmemobj_lock_set_max_spin(PMEMobjpool *pop, unsigned spins);
+
+/*
+ * Enables or disables collection of per-lock contention statistics
+ * in the pool. The statistics are kept in volatile memory only, for up to
+ * 4096 locks.
+ *
+ * If successful, returns zero. Otherwise, an error number is returned.
+ */
+int pmemobj_lock_stats_enable(PMEMobjpool *pop, int enable);
+
+int pmemobj_mutex_stats(PMEMobjpool *pop, PMEMmutex *mutexp,
+	struct pobj_lock_stats *stats);
+int pmemobj_rwlock_stats(PMEMobjpool *pop, PMEMrwlock *rwlockp,
+	struct pobj_lock_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -170,6 +170,10 @@ pmemobj_tx_free((o).oid)
 	TX_ADD_FIELD_DIRECT(p, field),\
 	(p)->field = value)
 
+#define TX_RELPTR_ASSIGN(p, ptr) (\
+	TX_ADD_DIRECT(&(p)),\
+	RELPTR_ASSIGN(p, ptr))
+
 static inline void *
 TX_MEMCPY(void *dest, const void *src, size_t num)
 {
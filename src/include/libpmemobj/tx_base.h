@@ -70,7 +70,8 @@ enum pobj_tx_stage pmemobj_tx_stage(void);
 enum pobj_tx_lock {
 	TX_LOCK_NONE,
 	TX_LOCK_MUTEX,	/* PMEMmutex */
-	TX_LOCK_RWLOCK	/* PMEMrwlock */
+	TX_LOCK_RWLOCK,	/* PMEMrwlock */
+	TX_LOCK_SEQLOCK	/* PMEMseqlock */
 };
 
 /*
@@ -161,6 +162,26 @@ int pmemobj_tx_add_range(PMEMoid oid, uint64_t off, size_t size);
  */
 int pmemobj_tx_add_range_direct(const void *ptr, size_t size);
 
+/*
+ * Takes a "snapshot" of the given memory region, copies 'num' bytes from
+ * 'src' to it and makes the new contents persistent, bypassing the CPU cache
+ * when possible. The range is not flushed again on commit, so any further
+ * modification of it with regular stores within the same transaction has to
+ * be preceded by pmemobj_tx_add_range or pmemobj_tx_add_range_direct.
+ *
+ * If successful, returns zero.
+ * Otherwise, state changes to TX_STAGE_ONABORT and an error number is returned.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+int pmemobj_tx_memcpy(void *dest, const void *src, size_t num);
+
+/*
+ * Same as pmemobj_tx_memcpy, but fills the memory region with the constant
+ * byte 'c'.
+ */
+int pmemobj_tx_memset(void *dest, int c, size_t num);
+
 /*
  * Transactionally allocates a new object.
  *
@@ -181,6 +202,29 @@ PMEMoid pmemobj_tx_alloc(size_t size, uint64_t type_num);
  */
 PMEMoid pmemobj_tx_zalloc(size_t size, uint64_t type_num);
 
+/*
+ * Transactionally allocates a new object aligned to the given boundary, which
+ * has to be a power of two not larger than PMEMOBJ_MAX_ALIGNMENT.
+ *
+ * If successful, returns PMEMoid.
+ * Otherwise, state changes to TX_STAGE_ONABORT and an OID_NULL is returned.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+PMEMoid pmemobj_tx_alloc_aligned(size_t size, size_t alignment,
+	uint64_t type_num);
+
+/*
+ * Transactionally allocates a new zeroed object aligned to the given boundary.
+ *
+ * If successful, returns PMEMoid.
+ * Otherwise, state changes to TX_STAGE_ONABORT and an OID_NULL is returned.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+PMEMoid pmemobj_tx_zalloc_aligned(size_t size, size_t alignment,
+	uint64_t type_num);
+
 /*
  * Transactionally resizes an existing object.
  *
@@ -221,6 +265,112 @@ PMEMoid pmemobj_tx_strdup(const char *s, uint64_t type_num);
  */
 int pmemobj_tx_free(PMEMoid oid);
 
+/*
+ * Transactionally allocates a new region with space for size bytes of objects.
+ *
+ * If successful, returns PMEMoid.
+ * Otherwise, state changes to TX_STAGE_ONABORT and an OID_NULL is returned.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+PMEMoid pmemobj_tx_region_create(size_t size, uint64_t type_num);
+
+/*
+ * Transactionally allocates a new object from the region.
+ *
+ * If successful, returns PMEMoid.
+ * Otherwise, state changes to TX_STAGE_ONABORT and an OID_NULL is returned.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+PMEMoid pmemobj_tx_region_alloc(PMEMoid region, size_t size);
+
+/*
+ * Transactionally allocates a new zeroed object from the region.
+ *
+ * If successful, returns PMEMoid.
+ * Otherwise, state changes to TX_STAGE_ONABORT and an OID_NULL is returned.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+PMEMoid pmemobj_tx_region_zalloc(PMEMoid region, size_t size);
+
+/*
+ * Transactionally frees the region together with all of its objects.
+ *
+ * If successful, returns zero.
+ * Otherwise, state changes to TX_STAGE_ONABORT and an error number is returned.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+int pmemobj_tx_region_free(PMEMoid region);
+
+/*
+ * Transaction statistics
+ *
+ * Each histogram bucket n > 0 counts samples in the range [2^(n-1), 2^n),
+ * bucket 0 counts zero samples and the last bucket also counts all of the
+ * samples that are too large to fit in the preceding ones.
+ */
+#define PMEMOBJ_TX_STATS_HIST_BUCKETS 32
+
+enum pobj_tx_stats_hist {
+	TX_STATS_HIST_SNAPSHOT_BYTES,	/* bytes snapshotted per transaction */
+	TX_STATS_HIST_ADD_RANGES,	/* add range calls per transaction */
+	TX_STATS_HIST_ALLOCS,		/* allocations per transaction */
+	TX_STATS_HIST_FREES,		/* frees per transaction */
+	TX_STATS_HIST_COMMIT_NS,	/* commit latency in nanoseconds */
+
+	MAX_TX_STATS_HIST
+};
+
+struct pobj_tx_stats {
+	uint64_t commits;	/* committed outermost transactions */
+	uint64_t aborts;	/* aborted outermost transactions */
+	uint64_t add_ranges;	/* pmemobj_tx_add_range* calls */
+	uint64_t snapshot_bytes; /* bytes saved in the undo log */
+	uint64_t allocs;	/* transactional allocations */
+	uint64_t frees;		/* transactional frees */
+	uint64_t pre_commit_ns;	/* time spent in the pre-commit phase */
+	uint64_t post_commit_ns; /* time spent in the post-commit phase */
+	uint64_t commit_ns;	/* total time spent committing */
+
+	uint64_t hist[MAX_TX_STATS_HIST][PMEMOBJ_TX_STATS_HIST_BUCKETS];
+};
+
+/*
+ * Enables or disables collection of the transaction statistics in the pool.
+ * The statistics are collected separately for each lane and only transactions
+ * started after this call are affected.
+ *
+ * If successful, returns zero. Otherwise, an error number is returned.
+ */
+int pmemobj_tx_stats_enable(PMEMobjpool *pop, int enable);
+
+/*
+ * Sums up the transaction statistics collected in all of the lanes of
+ * the pool. The result is not an atomic snapshot if transactions are running
+ * concurrently.
+ *
+ * If successful, returns zero. Otherwise, an error number is returned.
+ */
+int pmemobj_tx_stats(PMEMobjpool *pop, struct pobj_tx_stats *stats);
+
+/*
+ * Zeroes the transaction statistics of the pool. Must not be called while
+ * there are transactions running in the pool.
+ */
+void pmemobj_tx_stats_reset(PMEMobjpool *pop);
+
+/*
+ * Sets the size of the largest snapshot which is stored directly in the undo
+ * log range cache of the pool. Larger snapshots require a separate
+ * allocation each. By default, only snapshots of up to 32 bytes are cached.
+ *
+ * If successful, returns zero. Otherwise, an error number is returned.
+ */
+int pmemobj_tx_set_max_cached_range(PMEMobjpool *pop, size_t size);
+
 #ifdef __cplusplus
 }
 #endif
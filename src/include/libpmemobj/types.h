@@ -134,6 +134,11 @@ TOID(t)\
  */
 #define TOID_IS_NULL(o)	((o).oid.off == 0)
 
+/*
+ * Starts loading the object into the cache
+ */
+#define TOID_PREFETCH(o) pmemobj_prefetch((o).oid)
+
 /*
  * Validates whether type number stored in typed OID is the same
  * as type number stored in object's metadata
@@ -208,6 +213,64 @@ TOID_DECLARE_ROOT(t);
 #define D_RW	DIRECT_RW
 #define D_RO	DIRECT_RO
 
+/*
+ * Self-relative pointer to an object of the same pool
+ *
+ * It holds the distance from its own address to the object, plus one so that
+ * zero means NULL. It takes 8 bytes and is resolved with a single addition,
+ * without the pool lookup, but it's valid only where it was written. It must
+ * not be copied by assignment, use RELPTR_COPY instead. Undo log snapshots
+ * restore it at the same address, so it can be modified in transactions.
+ */
+#define RELPTR(t)\
+union {\
+	int64_t off;\
+	t *_type;\
+}
+
+static inline void *
+_pobj_relptr_direct(const int64_t *self)
+{
+	if (*self == 0)
+		return NULL;
+
+	return (char *)self + *self - 1;
+}
+
+static inline int64_t
+_pobj_relptr_off(const int64_t *self, const void *ptr)
+{
+	if (ptr == NULL)
+		return 0;
+
+	return (const char *)ptr - (const char *)self + 1;
+}
+
+#define RELPTR_IS_NULL(p) ((p).off == 0)
+
+#define RELPTR_EQUALS(lhs, rhs)\
+(_pobj_relptr_direct(&(lhs).off) == _pobj_relptr_direct(&(rhs).off))
+
+/* the conditional only checks that the pointer is of a compatible type */
+#define RELPTR_ASSIGN(p, ptr)\
+((p).off = _pobj_relptr_off(&(p).off, 1 ? (ptr) : (p)._type))
+
+#define RELPTR_OID(p) pmemobj_oid(_pobj_relptr_direct(&(p).off))
+
+/*
+ * XXX - the typed direct pointers are not available when compiled using VC++
+ *       as C code (/TC), same as DIRECT_RW and DIRECT_RO.
+ */
+#if !defined(_MSC_VER) || defined(__cplusplus)
+
+#define RELPTR_D_RW(p) ((__typeof__((p)._type))_pobj_relptr_direct(&(p).off))
+#define RELPTR_D_RO(p)\
+((const __typeof__(*(p)._type) *)_pobj_relptr_direct(&(p).off))
+
+#define RELPTR_COPY(dst, src) RELPTR_ASSIGN(dst, RELPTR_D_RW(src))
+
+#endif /* !defined(_MSC_VER) || defined(__cplusplus) */
+
 #ifdef __cplusplus
 }
 #endif
@@ -253,6 +253,43 @@ static struct {
 	{&container_ctree_ops, bucket_tree_create, bucket_tree_delete},
 };
 
+/*
+ * bucket_run_bitmap_init -- (internal) calculates the bitmap definition of
+ *	the runs of the bucket
+ */
+static void
+bucket_run_bitmap_init(struct bucket_run *b, size_t unit_size,
+	unsigned nallocs)
+{
+	/*
+	 * The number of possible allocations from a run is, in other words,
+	 * the amount of bits in the bitmap.
+	 */
+	b->bitmap_nallocs = nallocs;
+
+	/*
+	 * The two other numbers that define our bitmap is the size of the
+	 * array that represents the bitmap and the last value of that array
+	 * with the bits that exceed number of blocks marked as set (1).
+	 */
+	ASSERT(unit_size >= RUN_MIN_BLOCK_SIZE);
+	unsigned nvals = (unsigned)RUN_BITMAP_VALUES(unit_size);
+	ASSERT(b->bitmap_nallocs <= nvals * BITS_PER_VALUE);
+	unsigned unused_bits = nvals * BITS_PER_VALUE - b->bitmap_nallocs;
+
+	unsigned unused_values = unused_bits / BITS_PER_VALUE;
+
+	ASSERT(nvals >= unused_values);
+	b->bitmap_nval = nvals - unused_values;
+
+	ASSERT(unused_bits >= unused_values * BITS_PER_VALUE);
+	unused_bits -= unused_values * BITS_PER_VALUE;
+
+	b->bitmap_lastval = unused_bits ?
+		(((1ULL << unused_bits) - 1ULL) <<
+			(BITS_PER_VALUE - unused_bits)) : 0;
+}
+
 /*
  * bucket_run_create -- (internal) creates a run bucket
  *
@@ -274,37 +311,35 @@ bucket_run_create(size_t unit_size, unsigned unit_max)
 
 	b->super.type = BUCKET_RUN;
 	b->unit_max = unit_max;
+	b->run_flags = 0;
 
 	/*
 	 * Here the bitmap definition is calculated based on the size of the
 	 * available memory and the size of a memory block - the result of
 	 * dividing those two numbers is the number of possible allocations from
-	 * that block, and in other words, the amount of bits in the bitmap.
+	 * that block.
 	 */
-	ASSERT(RUN_NALLOCS(unit_size) <= UINT32_MAX);
-	b->bitmap_nallocs = (unsigned)(RUN_NALLOCS(unit_size));
+	bucket_run_bitmap_init(b, unit_size, (unsigned)RUN_NALLOCS(unit_size));
 
-	/*
-	 * The two other numbers that define our bitmap is the size of the
-	 * array that represents the bitmap and the last value of that array
-	 * with the bits that exceed number of blocks marked as set (1).
-	 */
-	ASSERT(b->bitmap_nallocs <= RUN_BITMAP_SIZE);
-	unsigned unused_bits = RUN_BITMAP_SIZE - b->bitmap_nallocs;
-
-	unsigned unused_values = unused_bits / BITS_PER_VALUE;
-
-	ASSERT(MAX_BITMAP_VALUES >= unused_values);
-	b->bitmap_nval = MAX_BITMAP_VALUES - unused_values;
+	return &b->super;
+}
 
-	ASSERT(unused_bits >= unused_values * BITS_PER_VALUE);
-	unused_bits -= unused_values * BITS_PER_VALUE;
+/*
+ * bucket_run_align -- makes the runs of the bucket align the objects in their
+ *	blocks to the unit size, see RUN_ALIGNED_OFFSET
+ */
+void
+bucket_run_align(struct bucket *b)
+{
+	ASSERTeq(b->type, BUCKET_RUN);
+	struct bucket_run *r = (struct bucket_run *)b;
 
-	b->bitmap_lastval = unused_bits ?
-		(((1ULL << unused_bits) - 1ULL) <<
-			(BITS_PER_VALUE - unused_bits)) : 0;
+	ASSERTeq(b->unit_size & (b->unit_size - 1), 0);
+	ASSERT(!RUN_HAS_EXT_BITMAP(b->unit_size));
 
-	return &b->super;
+	r->run_flags |= CHUNK_FLAG_ALIGNED;
+	bucket_run_bitmap_init(r, b->unit_size,
+		(unsigned)RUN_ALIGNED_NALLOCS(b->unit_size));
 }
 
 /*
@@ -43,8 +43,13 @@
 
 #include "memblock.h"
 
-#define RUN_NALLOCS(_bs)\
-((RUNSIZE / ((_bs))))
+/*
+ * Number of blocks in a run.
+ */
+#define RUN_NALLOCS(_bs) ((RUNSIZE - RUN_DATA_OFFSET(_bs)) / (_bs))
+
+/* the moved first block of an aligned run costs at most a single block */
+#define RUN_ALIGNED_NALLOCS(_bs) (RUN_NALLOCS(_bs) - 1)
 
 #define CALC_SIZE_IDX(_unit_size, _size)\
 ((uint32_t)(((_size - 1) / _unit_size) + 1))
@@ -130,11 +135,18 @@ struct bucket_run {
 	 * Maximum multiplication factor of unit_size for allocations.
 	 */
 	unsigned unit_max;
+
+	/*
+	 * Flags of the chunk header of the runs of this bucket.
+	 */
+	uint16_t run_flags;
 };
 
 struct bucket *bucket_new(uint8_t id, enum bucket_type type,
 	enum block_container_type ctype, size_t unit_size, unsigned unit_max);
 
+void bucket_run_align(struct bucket *b);
+
 void bucket_delete(struct bucket *b);
 
 #endif
@@ -0,0 +1,298 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * flusher.c -- parallel flush helper threads
+ *
+ * The flusher is a small pool of threads that split the work of flushing
+ * large memory ranges. Each submitted range is divided into cache line
+ * aligned chunks which are queued for the helper threads, while the
+ * submitting thread itself also executes queued chunks while it waits.
+ *
+ * Flush instructions are only guaranteed to be complete after a fence issued
+ * by the same thread, so every helper drains its own flushes before reporting
+ * the chunk as done. The caller still has to drain after flusher_wait to
+ * cover the chunks it has flushed itself.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sys/param.h>
+#include <stdint.h>
+
+#include "flusher.h"
+#include "out.h"
+#include "sys_util.h"
+#include "util.h"
+
+#define FLUSHER_MAX_JOBS 256
+#define FLUSHER_CHUNK_ALIGN ((uintptr_t)64) /* cache line size */
+#define FLUSHER_MIN_CHUNK (64 * 1024)
+
+struct flusher_job {
+	const struct pmem_ops *p_ops;
+	const void *addr;
+	size_t len;
+	struct flusher_req *req;
+};
+
+struct flusher {
+	pthread_mutex_t lock;
+	pthread_cond_t work; /* signaled when new jobs are queued */
+	pthread_cond_t done; /* signaled when a request is completed */
+
+	struct flusher_job jobs[FLUSHER_MAX_JOBS]; /* circular job queue */
+	unsigned head;
+	unsigned njobs;
+
+	int stop;
+	unsigned nthreads;
+	pthread_t threads[];
+};
+
+/*
+ * flusher_job_pop -- (internal) removes the oldest job from the queue
+ *
+ * Must be called with the flusher lock held.
+ */
+static void
+flusher_job_pop(struct flusher *f, struct flusher_job *job)
+{
+	ASSERTne(f->njobs, 0);
+
+	*job = f->jobs[f->head];
+	f->head = (f->head + 1) % FLUSHER_MAX_JOBS;
+	f->njobs--;
+}
+
+/*
+ * flusher_job_run -- (internal) flushes the chunk and marks it as done
+ *
+ * Must be called without the flusher lock held, returns with the lock held.
+ */
+static void
+flusher_job_run(struct flusher *f, struct flusher_job *job)
+{
+	pmemops_flush(job->p_ops, job->addr, job->len);
+	pmemops_drain(job->p_ops);
+
+	util_mutex_lock(&f->lock);
+	ASSERTne(job->req->pending, 0);
+	if (--job->req->pending == 0)
+		pthread_cond_broadcast(&f->done);
+}
+
+/*
+ * flusher_worker -- (internal) helper thread main loop
+ */
+static void *
+flusher_worker(void *arg)
+{
+	struct flusher *f = arg;
+	struct flusher_job job;
+
+	util_mutex_lock(&f->lock);
+	while (!f->stop) {
+		if (f->njobs == 0) {
+			pthread_cond_wait(&f->work, &f->lock);
+			continue;
+		}
+
+		flusher_job_pop(f, &job);
+		util_mutex_unlock(&f->lock);
+
+		flusher_job_run(f, &job);
+	}
+	util_mutex_unlock(&f->lock);
+
+	return NULL;
+}
+
+/*
+ * flusher_stop -- (internal) stops and joins the first nthreads threads
+ */
+static void
+flusher_stop(struct flusher *f, unsigned nthreads)
+{
+	util_mutex_lock(&f->lock);
+	f->stop = 1;
+	pthread_cond_broadcast(&f->work);
+	util_mutex_unlock(&f->lock);
+
+	for (unsigned i = 0; i < nthreads; ++i)
+		pthread_join(f->threads[i], NULL);
+}
+
+/*
+ * flusher_new -- creates a new flusher with the given number of threads
+ */
+struct flusher *
+flusher_new(unsigned nthreads)
+{
+	LOG(3, "nthreads %u", nthreads);
+
+	ASSERTne(nthreads, 0);
+
+	struct flusher *f = Zalloc(sizeof(*f) +
+		nthreads * sizeof(pthread_t));
+	if (f == NULL) {
+		ERR("!Zalloc");
+		return NULL;
+	}
+
+	util_mutex_init(&f->lock, NULL);
+	pthread_cond_init(&f->work, NULL);
+	pthread_cond_init(&f->done, NULL);
+
+	int ret;
+	for (f->nthreads = 0; f->nthreads < nthreads; ++f->nthreads) {
+		ret = pthread_create(&f->threads[f->nthreads], NULL,
+			flusher_worker, f);
+		if (ret != 0) {
+			errno = ret;
+			ERR("!pthread_create");
+			goto error_thread_create;
+		}
+	}
+
+	return f;
+
+error_thread_create:
+	flusher_stop(f, f->nthreads);
+	pthread_cond_destroy(&f->done);
+	pthread_cond_destroy(&f->work);
+	util_mutex_destroy(&f->lock);
+	Free(f);
+	errno = ret;
+	return NULL;
+}
+
+/*
+ * flusher_delete -- stops the helper threads and frees the flusher
+ */
+void
+flusher_delete(struct flusher *f)
+{
+	LOG(3, "f %p", f);
+
+	flusher_stop(f, f->nthreads);
+
+	ASSERTeq(f->njobs, 0);
+
+	pthread_cond_destroy(&f->done);
+	pthread_cond_destroy(&f->work);
+	util_mutex_destroy(&f->lock);
+	Free(f);
+}
+
+/*
+ * flusher_req_init -- initializes an empty request
+ */
+void
+flusher_req_init(struct flusher_req *req)
+{
+	req->pending = 0;
+}
+
+/*
+ * flusher_flush -- splits the memory range into chunks and queues them
+ *
+ * Chunks that do not fit in the queue are flushed immediately by the caller.
+ */
+void
+flusher_flush(struct flusher *f, struct flusher_req *req,
+	const struct pmem_ops *p_ops, const void *addr, size_t len)
+{
+	LOG(15, "f %p req %p addr %p len %zu", f, req, addr, len);
+
+	/* the caller is also helping, hence the additional chunk */
+	size_t chunk = len / (f->nthreads + 1);
+	if (chunk < FLUSHER_MIN_CHUNK)
+		chunk = FLUSHER_MIN_CHUNK;
+	chunk = roundup(chunk, FLUSHER_CHUNK_ALIGN);
+
+	const char *begin = addr;
+	const char *end = begin + len;
+
+	util_mutex_lock(&f->lock);
+	while (begin != end && f->njobs != FLUSHER_MAX_JOBS) {
+		/* cache line aligned boundaries avoid double flushes */
+		const char *next = (const char *)roundup(
+			(uintptr_t)begin + chunk, FLUSHER_CHUNK_ALIGN);
+		if (next > end)
+			next = end;
+
+		struct flusher_job *job = &f->jobs[
+			(f->head + f->njobs) % FLUSHER_MAX_JOBS];
+		job->p_ops = p_ops;
+		job->addr = begin;
+		job->len = (size_t)(next - begin);
+		job->req = req;
+
+		f->njobs++;
+		req->pending++;
+		begin = next;
+	}
+	pthread_cond_broadcast(&f->work);
+	util_mutex_unlock(&f->lock);
+
+	if (begin != end)
+		pmemops_flush(p_ops, begin, (size_t)(end - begin));
+}
+
+/*
+ * flusher_wait -- waits until all of the chunks of the request are flushed
+ *
+ * Instead of idly waiting, the caller executes queued jobs, which might also
+ * belong to requests of other threads.
+ */
+void
+flusher_wait(struct flusher *f, struct flusher_req *req)
+{
+	LOG(15, "f %p req %p", f, req);
+
+	struct flusher_job job;
+
+	util_mutex_lock(&f->lock);
+	while (req->pending != 0) {
+		if (f->njobs == 0) {
+			pthread_cond_wait(&f->done, &f->lock);
+			continue;
+		}
+
+		flusher_job_pop(f, &job);
+		util_mutex_unlock(&f->lock);
+
+		flusher_job_run(f, &job);
+	}
+	util_mutex_unlock(&f->lock);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * flusher.h -- internal definitions for the parallel flush helper threads
+ */
+
+#ifndef LIBPMEMOBJ_FLUSHER_H
+#define LIBPMEMOBJ_FLUSHER_H 1
+
+#include <stddef.h>
+
+#include "pmemops.h"
+
+struct flusher;
+
+/*
+ * Tracks completion of all of the chunks submitted on behalf of a single
+ * caller, must be initialized with flusher_req_init before first use.
+ */
+struct flusher_req {
+	unsigned pending; /* number of chunks not yet flushed */
+};
+
+struct flusher *flusher_new(unsigned nthreads);
+void flusher_delete(struct flusher *f);
+
+void flusher_req_init(struct flusher_req *req);
+void flusher_flush(struct flusher *f, struct flusher_req *req,
+	const struct pmem_ops *p_ops, const void *addr, size_t len);
+void flusher_wait(struct flusher *f, struct flusher_req *req);
+
+#endif
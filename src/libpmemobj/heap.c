@@ -35,14 +35,15 @@
  */
 
 #include <errno.h>
-#include <sys/queue.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <string.h>
 
+#include "ctree.h"
 #include "heap.h"
 #include "out.h"
 #include "sys_util.h"
+#include "uuid.h"
 #include "valgrind_internal.h"
 
 #define MAX_RUN_LOCKS 1024
@@ -68,6 +69,9 @@
 
 #define BIT_IS_CLR(a, i)	(!((a) & (1ULL << (i))))
 
+#define PMALLOC_PTR_TO_OFF(heap, ptr)\
+	((uintptr_t)(ptr) - (uintptr_t)(heap->base))
+
 /*
  * Value used to mark a reserved spot in the bucket array.
  */
@@ -84,10 +88,30 @@
  */
 #define MAX_RUN_WASTED_BYTES 1024
 
+/*
+ * Heaps with compact headers have allocation classes for the smallest objects
+ * which are not a multiple of the allocation block size. Sizes up to
+ * SMALL_CLASS_MAX_SIZE are mapped to the buckets in steps of SMALL_CLASS_UNIT
+ * bytes in such heaps.
+ */
+#define SMALL_CLASS_UNIT 16
+#define SMALL_CLASS_MAX_SIZE 128
+#define SIZE_TO_SMALL_UNITS(_s) (1 + (((_s) - 1) / SMALL_CLASS_UNIT))
+
 /*
  * Converts size (in bytes) to bucket index.
  */
-#define SIZE_TO_BID(_h, _s) ((_h)->bucket_map[SIZE_TO_ALLOC_BLOCKS(_s)])
+#define SIZE_TO_BID(_h, _s) ((_s) <= (_h)->small_map_max_size ?\
+	(_h)->small_bucket_map[SIZE_TO_SMALL_UNITS(_s)] :\
+	(_h)->bucket_map[SIZE_TO_ALLOC_BLOCKS(_s)])
+
+/*
+ * Heaps which allow objects with a stricter alignment than the one of the
+ * allocation headers have an allocation class for each power of two between
+ * these two, the objects allocated from those are aligned to the unit size.
+ */
+#define ALIGNED_CLASS_MIN_SHIFT 7 /* 128 bytes */
+#define ALIGNED_CLASS_MAX_SHIFT 15 /* 32 kilobytes */
 
 /*
  * Allocation categories are used for allocation classes generation. Each one
@@ -117,10 +141,26 @@ static struct {
 	{256, 4}
 };
 
-struct active_run {
-	uint32_t chunk_id;
-	uint32_t zone_id;
-	SLIST_ENTRY(active_run) run;
+/*
+ * Runs which are not used by any of the buckets are ranked by the number of
+ * their free units, the fullest ones are reused first so that the others have
+ * a chance to become empty and be turned back into chunks.
+ */
+#define RUN_RANK_KEY(_free, _zone_id, _chunk_id)\
+	(((uint64_t)(_free) << 48) | ((uint64_t)(_zone_id) << 16) | (_chunk_id))
+#define RUN_RANK_ZONE_ID(_key) ((uint32_t)((_key) >> 16))
+#define RUN_RANK_CHUNK_ID(_key) ((uint32_t)((_key) & UINT16_MAX))
+
+/*
+ * Number of empty runs of each allocation class which are not turned back into
+ * chunks right away, so that alternating allocations and frees don't
+ * have to create and degrade the same run over and over again.
+ */
+#define MAX_EMPTY_RUNS 2
+
+struct empty_runs {
+	unsigned n;
+	struct memory_block runs[MAX_EMPTY_RUNS];
 };
 
 struct bucket_cache {
@@ -130,10 +170,17 @@ struct bucket_cache {
 struct heap_rt {
 	struct bucket *default_bucket;
 	struct bucket *buckets[MAX_BUCKETS];
-	/* runs are lazy-loaded, removed from this list on-demand */
-	SLIST_HEAD(arun, active_run) active_runs[MAX_BUCKETS];
-	pthread_mutex_t active_run_lock;
+	/* runs are lazy-loaded, removed from these trees on-demand */
+	struct ctree *active_runs[MAX_BUCKETS];
+	/* empty runs kept by each class, degraded when memory runs out */
+	struct empty_runs empty_runs[MAX_BUCKETS];
+	pthread_mutex_t active_run_lock; /* protects both of the above */
 	uint8_t *bucket_map;
+	/* used instead of the bucket map for sizes up to small_map_max_size */
+	uint8_t small_bucket_map[SMALL_CLASS_MAX_SIZE / SMALL_CLASS_UNIT + 1];
+	size_t small_map_max_size;
+	/* buckets of the aligned classes, indexed by log2 of the unit size */
+	uint8_t aligned_bucket_map[ALIGNED_CLASS_MAX_SHIFT + 1];
 	pthread_mutex_t run_locks[MAX_RUN_LOCKS];
 	unsigned max_zone;
 	unsigned zones_exhausted;
@@ -142,11 +189,19 @@ struct heap_rt {
 	struct bucket_cache *caches;
 	unsigned ncaches;
 	uint32_t last_drained[MAX_BUCKETS];
+
+	pthread_mutex_t zone_lock; /* serializes formatting of the zones */
+	pthread_t formatter; /* background zone formatting thread */
+	int formatter_running;
+	int formatter_stop;
 };
 
 static __thread unsigned Cache_idx = UINT32_MAX;
 static unsigned Next_cache_idx;
 
+/* format all of the zones in the background once the heap is booted */
+static int Zone_preformat;
+
 /*
  * bucket_group_init -- (internal) creates new bucket group instance
  */
@@ -248,8 +303,28 @@ heap_chunk_init(struct palloc_heap *heap, struct chunk_header *hdr,
 	heap_chunk_write_footer(hdr, size_idx);
 }
 
+/*
+ * heap_zone_is_formatted -- (internal) checks whether the zone was formatted
+ *	as a part of this heap
+ *
+ * Zones are formatted on demand, the space of a zone that was never used can
+ * contain anything, including a zone header left by a previous pool.
+ */
+static int
+heap_zone_is_formatted(struct heap_layout *layout, uint32_t zone_id)
+{
+	struct zone_header *hdr = &ZID_TO_ZONE(layout, zone_id)->header;
+	VALGRIND_DO_MAKE_MEM_DEFINED(hdr, sizeof(*hdr));
+
+	return hdr->magic == ZONE_HEADER_MAGIC &&
+		hdr->format_id == layout->header.zone_format_id;
+}
+
 /*
  * heap_zone_init -- (internal) writes zone's first chunk and header
+ *
+ * The magic is written last, a zone interrupted while being formatted is
+ * formatted again from scratch.
  */
 static void
 heap_zone_init(struct palloc_heap *heap, uint32_t zone_id)
@@ -258,14 +333,115 @@ heap_zone_init(struct palloc_heap *heap, uint32_t zone_id)
 	uint32_t size_idx = get_zone_size_idx(zone_id, heap->rt->max_zone,
 			heap->size);
 
+	z->header.magic = 0;
+	pmemops_persist(&heap->p_ops, &z->header.magic,
+		sizeof(z->header.magic));
+
 	heap_chunk_init(heap, &z->chunk_headers[0], CHUNK_TYPE_FREE, size_idx);
 
-	struct zone_header nhdr = {
-		.size_idx = size_idx,
-		.magic = ZONE_HEADER_MAGIC,
-	};
-	z->header = nhdr;  /* write the entire header (8 bytes) at once */
+	z->header.size_idx = size_idx;
+	z->header.format_id = heap->layout->header.zone_format_id;
+	memset(z->header.reserved, 0, sizeof(z->header.reserved));
 	pmemops_persist(&heap->p_ops, &z->header, sizeof(z->header));
+
+	z->header.magic = ZONE_HEADER_MAGIC;
+	pmemops_persist(&heap->p_ops, &z->header.magic,
+		sizeof(z->header.magic));
+}
+
+/*
+ * heap_zone_format -- (internal) formats the zone unless it already is
+ */
+static void
+heap_zone_format(struct palloc_heap *heap, uint32_t zone_id)
+{
+	util_mutex_lock(&heap->rt->zone_lock);
+
+	if (!heap_zone_is_formatted(heap->layout, zone_id))
+		heap_zone_init(heap, zone_id);
+
+	util_mutex_unlock(&heap->rt->zone_lock);
+}
+
+/*
+ * heap_formatter -- (internal) formats all of the remaining zones of the heap
+ */
+static void *
+heap_formatter(void *arg)
+{
+	struct palloc_heap *heap = arg;
+	struct heap_rt *h = heap->rt;
+
+	for (uint32_t zone_id = 0; zone_id < h->max_zone; ++zone_id) {
+		if (__sync_fetch_and_add(&h->formatter_stop, 0))
+			break;
+
+		heap_zone_format(heap, zone_id);
+	}
+
+	return NULL;
+}
+
+/*
+ * heap_formatter_stop -- (internal) waits for the background zone formatting
+ *	thread to finish, the zones that weren't reached are formatted on demand
+ */
+static void
+heap_formatter_stop(struct palloc_heap *heap)
+{
+	struct heap_rt *h = heap->rt;
+	if (!h->formatter_running)
+		return;
+
+	__sync_fetch_and_add(&h->formatter_stop, 1);
+
+	int ret = pthread_join(h->formatter, NULL);
+	if (ret != 0) {
+		errno = ret;
+		ERR("!pthread_join");
+	}
+
+	h->formatter_running = 0;
+}
+
+/*
+ * heap_formatter_start -- starts formatting the zones in the background,
+ *	if enabled
+ *
+ * The zones are formatted in order, so the thread doesn't interfere with the
+ * allocator growing into the next zone.
+ */
+void
+heap_formatter_start(struct palloc_heap *heap)
+{
+	struct heap_rt *h = heap->rt;
+	if (!Zone_preformat || h->formatter_running)
+		return;
+
+	h->formatter_stop = 0;
+
+	int ret = pthread_create(&h->formatter, NULL, heap_formatter, heap);
+	if (ret != 0) {
+		/* not fatal, the zones are still formatted on demand */
+		errno = ret;
+		ERR("!pthread_create");
+		return;
+	}
+
+	h->formatter_running = 1;
+}
+
+/*
+ * heap_params_boot -- reads the heap parameters from the environment
+ *
+ * Called by obj_init.
+ */
+void
+heap_params_boot(void)
+{
+	char *env = getenv("PMEMOBJ_ZONE_PREFORMAT");
+	if (env)
+		Zone_preformat = atoi(env);
 }
 
 /*
@@ -285,9 +461,12 @@ heap_init_run(struct palloc_heap *heap, struct bucket *b,
 			sizeof(run->block_size));
 
 	ASSERT(hdr->type == CHUNK_TYPE_FREE);
+	ASSERT(!(hdr->flags & CHUNK_FLAG_ALIGNED));
+
+	size_t bitmap_size = RUN_BITMAP_VALUES(b->unit_size) * sizeof(uint64_t);
 
 	/* set all the bits */
-	memset(run->bitmap, 0xFF, sizeof(run->bitmap));
+	memset(run->bitmap, 0xFF, bitmap_size);
 
 	unsigned nval = r->bitmap_nval;
 	ASSERT(nval > 0);
@@ -296,10 +475,14 @@ heap_init_run(struct palloc_heap *heap, struct bucket *b,
 	run->bitmap[nval - 1] = r->bitmap_lastval;
 	VALGRIND_REMOVE_FROM_TX(run, sizeof(*run));
 
-	pmemops_persist(&heap->p_ops, run->bitmap, sizeof(run->bitmap));
+	pmemops_persist(&heap->p_ops, run->bitmap, bitmap_size);
+
+	struct chunk_header nhdr = *hdr;
+	nhdr.type = CHUNK_TYPE_RUN;
+	nhdr.flags |= r->run_flags;
 
 	VALGRIND_ADD_TO_TX(hdr, sizeof(*hdr));
-	hdr->type = CHUNK_TYPE_RUN;
+	*hdr = nhdr; /* write the entire header (8 bytes) at once */
 	VALGRIND_REMOVE_FROM_TX(hdr, sizeof(*hdr));
 
 	pmemops_persist(&heap->p_ops, hdr, sizeof(*hdr));
@@ -354,10 +537,10 @@ heap_process_run_metadata(struct palloc_heap *heap, struct bucket *b,
 	ASSERTeq(b->type, BUCKET_RUN);
 	struct bucket_run *r = (struct bucket_run *)b;
 
-	ASSERT(RUN_NALLOCS(run->block_size) <= UINT16_MAX);
+	COMPILE_ERROR_ON(RUN_EXT_BITMAP_VALUES * BITS_PER_VALUE > UINT16_MAX);
 
-	uint16_t run_bits = (uint16_t)(RUNSIZE / run->block_size);
-	ASSERT(run_bits < (MAX_BITMAP_VALUES * BITS_PER_VALUE));
+	uint16_t run_bits = (uint16_t)r->bitmap_nallocs;
+	ASSERT(run_bits <= r->bitmap_nval * BITS_PER_VALUE);
 	uint16_t block_off = 0;
 	uint16_t block_size_idx = 0;
 
@@ -386,7 +569,7 @@ heap_process_run_metadata(struct palloc_heap *heap, struct bucket *b,
 			}
 
 			if ((block_off++) == run_bits) {
-				i = MAX_BITMAP_VALUES;
+				i = r->bitmap_nval;
 				break;
 			}
 		}
@@ -462,6 +645,8 @@ heap_reuse_run(struct palloc_heap *heap, struct bucket *b,
 	heap_set_run_bucket(run, b);
 	ASSERTeq(hdr->size_idx, 1);
 	ASSERTeq(b->unit_size, run->block_size);
+	ASSERTeq(hdr->flags & CHUNK_FLAG_ALIGNED,
+		((struct bucket_run *)b)->run_flags);
 
 	heap_process_run_metadata(heap, b, run, chunk_id, zone_id);
 
@@ -475,13 +660,26 @@ out:
 static int
 heap_run_is_empty(struct chunk_run *run)
 {
-	for (int i = 0; i < MAX_BITMAP_VALUES; ++i)
+	for (unsigned i = 0; i < RUN_BITMAP_VALUES(run->block_size); ++i)
 		if (run->bitmap[i] != UINT64_MAX)
 			return 0;
 
 	return 1;
 }
 
+/*
+ * heap_run_free_units -- (internal) counts the free units of the run
+ */
+static unsigned
+heap_run_free_units(struct chunk_run *run)
+{
+	unsigned nfree = 0;
+	for (unsigned i = 0; i < RUN_BITMAP_VALUES(run->block_size); ++i)
+		nfree += (unsigned)__builtin_popcountll(~run->bitmap[i]);
+
+	return nfree;
+}
+
 /*
  * heap_find_first_free_bucket_slot -- (internal) searches for the first
  *	available bucket slot
@@ -506,7 +704,7 @@ heap_find_first_free_bucket_slot(struct heap_rt *h)
  */
 static uint8_t
 heap_create_alloc_class_buckets(struct heap_rt *h,
-	size_t unit_size, unsigned unit_max)
+	size_t unit_size, unsigned unit_max, uint16_t run_flags)
 {
 	uint8_t slot = heap_find_first_free_bucket_slot(h);
 	if (slot == MAX_BUCKETS)
@@ -518,6 +716,9 @@ heap_create_alloc_class_buckets(struct heap_rt *h,
 	if (h->buckets[slot] == NULL)
 		goto error_bucket_new;
 
+	if (run_flags & CHUNK_FLAG_ALIGNED)
+		bucket_run_align(h->buckets[slot]);
+
 	int i;
 	for (i = 0; i < (int)h->ncaches; ++i) {
 		h->caches[i].buckets[slot] =
@@ -525,6 +726,9 @@ heap_create_alloc_class_buckets(struct heap_rt *h,
 				unit_size, unit_max);
 		if (h->caches[i].buckets[slot] == NULL)
 			goto error_cache_bucket_new;
+
+		if (run_flags & CHUNK_FLAG_ALIGNED)
+			bucket_run_align(h->caches[i].buckets[slot]);
 	}
 
 out:
@@ -543,14 +747,49 @@ error_bucket_new:
 	return MAX_BUCKETS;
 }
 
+/*
+ * heap_get_create_aligned_class -- (internal) retrieves or creates the
+ *	allocation class of the objects aligned to the given unit size
+ */
+static uint8_t
+heap_get_create_aligned_class(struct heap_rt *h, uint64_t unit_size)
+{
+	if (unit_size < (1ULL << ALIGNED_CLASS_MIN_SHIFT) ||
+		unit_size > (1ULL << ALIGNED_CLASS_MAX_SHIFT) ||
+		(unit_size & (unit_size - 1)) != 0) {
+		ERR("invalid unit size of an aligned run %ju", unit_size);
+		return MAX_BUCKETS;
+	}
+
+	int shift = __builtin_ctzll(unit_size);
+	if (h->aligned_bucket_map[shift] != MAX_BUCKETS)
+		return h->aligned_bucket_map[shift];
+
+	uint8_t bucket_idx = heap_create_alloc_class_buckets(h, unit_size,
+		RUN_UNIT_MAX, CHUNK_FLAG_ALIGNED);
+	if (bucket_idx == MAX_BUCKETS) {
+		ERR("Failed to allocate new bucket class");
+		return MAX_BUCKETS;
+	}
+
+	h->aligned_bucket_map[shift] = bucket_idx;
+
+	return bucket_idx;
+}
+
 /*
  * heap_get_create_bucket_idx_by_unit_size -- (internal) retrieves or creates
  *	the memory bucket index that points to buckets that are responsible
- *	for allocations with the given unit size.
+ *	for allocations with the given unit size, from the runs with the given
+ *	chunk header flags.
  */
 static uint8_t
-heap_get_create_bucket_idx_by_unit_size(struct heap_rt *h, uint64_t unit_size)
+heap_get_create_bucket_idx_by_unit_size(struct heap_rt *h, uint64_t unit_size,
+	uint16_t flags)
 {
+	if (flags & CHUNK_FLAG_ALIGNED)
+		return heap_get_create_aligned_class(h, unit_size);
+
 	uint8_t bucket_idx = SIZE_TO_BID(h, unit_size);
 	if (h->buckets[bucket_idx]->unit_size != unit_size) {
 		/*
@@ -561,7 +800,7 @@ heap_get_create_bucket_idx_by_unit_size(struct heap_rt *h, uint64_t unit_size)
 		 * initialization time.
 		 */
 		bucket_idx = heap_create_alloc_class_buckets(h, unit_size,
-			RUN_UNIT_MAX);
+			RUN_UNIT_MAX, 0);
 
 		if (bucket_idx == MAX_BUCKETS) {
 			ERR("Failed to allocate new bucket class");
@@ -588,8 +827,8 @@ heap_get_create_bucket_idx_by_unit_size(struct heap_rt *h, uint64_t unit_size)
  * heap_register_active_run -- (internal) inserts a run for eventual reuse
  */
 static void
-heap_register_active_run(struct heap_rt *h, struct chunk_run *run,
-	uint32_t chunk_id, uint32_t zone_id)
+heap_register_active_run(struct heap_rt *h, struct chunk_header *hdr,
+	struct chunk_run *run, uint32_t chunk_id, uint32_t zone_id)
 {
 	/* reset the volatile state of the run */
 	run->bucket_vptr = 0;
@@ -598,24 +837,26 @@ heap_register_active_run(struct heap_rt *h, struct chunk_run *run,
 	if (heap_run_is_empty(run))
 		return;
 
-	struct active_run *arun = Malloc(sizeof(*arun));
-	if (arun == NULL) {
-		ERR("Failed to register active run");
-		ASSERT(0);
-		return;
-	}
-	arun->chunk_id = chunk_id;
-	arun->zone_id = zone_id;
-
 	uint8_t bucket_idx = heap_get_create_bucket_idx_by_unit_size(h,
-		run->block_size);
+		run->block_size, hdr->flags);
 
 	if (bucket_idx == MAX_BUCKETS) {
 		ASSERT(0);
 		return;
 	}
 
-	SLIST_INSERT_HEAD(&h->active_runs[bucket_idx], arun, run);
+	uint64_t key = RUN_RANK_KEY(heap_run_free_units(run),
+		zone_id, chunk_id);
+
+	util_mutex_lock(&h->active_run_lock);
+	/* the run might have been registered already, that's fine */
+	int err = ctree_insert_unlocked(h->active_runs[bucket_idx], key, 0);
+	util_mutex_unlock(&h->active_run_lock);
+
+	if (err == ENOMEM) {
+		ERR("Failed to register active run");
+		ASSERT(0);
+	}
 }
 
 /*
@@ -636,8 +877,7 @@ heap_populate_buckets(struct palloc_heap *heap)
 	VALGRIND_ADD_TO_GLOBAL_TX_IGNORE(z, sizeof(z->header) +
 		sizeof(z->chunk_headers));
 
-	if (z->header.magic != ZONE_HEADER_MAGIC)
-		heap_zone_init(heap, zone_id);
+	heap_zone_format(heap, zone_id);
 
 	struct bucket *def_bucket = h->default_bucket;
 
@@ -651,7 +891,8 @@ heap_populate_buckets(struct palloc_heap *heap)
 		switch (hdr->type) {
 			case CHUNK_TYPE_RUN:
 				run = (struct chunk_run *)&z->chunks[i];
-				heap_register_active_run(h, run, i, zone_id);
+				heap_register_active_run(h, hdr, run, i,
+					zone_id);
 				break;
 			case CHUNK_TYPE_FREE:
 				m.chunk_id = i;
@@ -671,35 +912,240 @@ heap_populate_buckets(struct palloc_heap *heap)
 }
 
 /*
- * heap_get_active_run -- (internal) searches for an existing, unused, run
+ * heap_summary_nzones -- (internal) returns the number of initialized zones
+ *
+ * Zones are always initialized in order, so this is also the id of the first
+ * zone that was never used.
+ */
+static uint32_t
+heap_summary_nzones(struct palloc_heap *heap)
+{
+	unsigned max_zone = heap_max_zone(heap->size);
+	uint32_t nzones = 0;
+
+	while (nzones < max_zone &&
+		heap_zone_is_formatted(heap->layout, nzones))
+		nzones++;
+
+	return nzones;
+}
+
+/*
+ * heap_summary_write -- writes the free space summary of the heap
+ *
+ * The summary is stored in the data of the first free extent that is large
+ * enough to hold it. The chunk footers, which are normally recreated when
+ * a zone is processed, are persisted as well so that the zones don't have to
+ * be walked on the next boot.
+ *
+ * Returns the offset of the summary relative to the heap start, or zero if
+ * there's no free extent big enough for it.
+ */
+uint64_t
+heap_summary_write(struct palloc_heap *heap)
+{
+	heap_formatter_stop(heap);
+
+	uint32_t nzones = heap_summary_nzones(heap);
+	uint64_t nentries = 0;
+
+	for (uint32_t zone_id = 0; zone_id < nzones; ++zone_id) {
+		struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+
+		for (uint32_t i = 0; i < z->header.size_idx; ) {
+			struct chunk_header *hdr = &z->chunk_headers[i];
+			heap_chunk_write_footer(hdr, hdr->size_idx);
+
+			if (hdr->type == CHUNK_TYPE_FREE ||
+				hdr->type == CHUNK_TYPE_RUN)
+				nentries++;
+
+			i += hdr->size_idx;
+		}
+
+		VALGRIND_DO_MAKE_MEM_DEFINED(z->chunk_headers,
+			sizeof(struct chunk_header) * z->header.size_idx);
+		pmemops_flush(&heap->p_ops, z->chunk_headers,
+			sizeof(struct chunk_header) * z->header.size_idx);
+	}
+	pmemops_drain(&heap->p_ops);
+
+	size_t size = sizeof(struct heap_summary) +
+		nentries * sizeof(struct heap_summary_entry);
+
+	struct heap_summary *s = NULL;
+	for (uint32_t zone_id = 0; zone_id < nzones && s == NULL; ++zone_id) {
+		struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+
+		for (uint32_t i = 0; i < z->header.size_idx; ) {
+			struct chunk_header *hdr = &z->chunk_headers[i];
+			if (hdr->type == CHUNK_TYPE_FREE &&
+				(size_t)hdr->size_idx * CHUNKSIZE >= size) {
+				s = (struct heap_summary *)&z->chunks[i];
+				break;
+			}
+
+			i += hdr->size_idx;
+		}
+	}
+
+	if (s == NULL)
+		return 0;
+
+	VALGRIND_DO_MAKE_MEM_UNDEFINED(s, size);
+	VALGRIND_ADD_TO_TX(s, size);
+
+	s->nzones = nzones;
+	s->nentries = nentries;
+	s->unused = 0;
+
+	uint64_t n = 0;
+	for (uint32_t zone_id = 0; zone_id < nzones; ++zone_id) {
+		struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+
+		for (uint32_t i = 0; i < z->header.size_idx; ) {
+			struct chunk_header *hdr = &z->chunk_headers[i];
+			if (hdr->type == CHUNK_TYPE_FREE ||
+				hdr->type == CHUNK_TYPE_RUN) {
+				struct heap_summary_entry e = {zone_id, i,
+					hdr->size_idx, hdr->type};
+				s->entries[n++] = e;
+			}
+
+			i += hdr->size_idx;
+		}
+	}
+	ASSERTeq(n, nentries);
+
+	util_checksum(s, size, &s->checksum, 1);
+	VALGRIND_REMOVE_FROM_TX(s, size);
+
+	pmemops_persist(&heap->p_ops, s, size);
+
+	return (uint64_t)((uintptr_t)s - (uintptr_t)heap->layout);
+}
+
+/*
+ * heap_summary_verify -- (internal) checks whether the summary describes
+ *	the current state of the heap
  */
 static int
-heap_get_active_run(struct heap_rt *h, int bucket_idx,
-	struct memory_block *m)
+heap_summary_verify(struct palloc_heap *heap, struct heap_summary *s,
+	size_t size)
 {
-	util_mutex_lock(&h->active_run_lock);
+	if (!util_checksum(s, size, &s->checksum, 0))
+		return -1;
 
-	int ret = 0;
+	if (s->nzones != heap_summary_nzones(heap))
+		return -1;
+
+	for (uint64_t n = 0; n < s->nentries; ++n) {
+		struct heap_summary_entry *e = &s->entries[n];
+		if (e->zone_id >= s->nzones)
+			return -1;
+
+		struct zone *z = ZID_TO_ZONE(heap->layout, e->zone_id);
+		if (e->chunk_id >= z->header.size_idx)
+			return -1;
+
+		struct chunk_header *hdr = &z->chunk_headers[e->chunk_id];
+		if (hdr->type != e->type || hdr->size_idx != e->size_idx)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * heap_summary_load -- creates volatile state of the heap from the summary
+ *	written on the last clean close
+ *
+ * On failure the heap is left intact and its zones are processed on demand.
+ */
+int
+heap_summary_load(struct palloc_heap *heap, uint64_t off)
+{
+	struct heap_rt *h = heap->rt;
 
-	struct active_run *arun = SLIST_FIRST(&h->active_runs[bucket_idx]);
-	if (arun == NULL)
+	if (off == 0 || off > heap->size - sizeof(struct heap_summary))
+		return -1;
+
+	struct heap_summary *s =
+		(struct heap_summary *)((uintptr_t)heap->layout + off);
+	VALGRIND_DO_MAKE_MEM_DEFINED(s, sizeof(*s));
+
+	int ret = -1;
+	size_t size = sizeof(*s);
+	if (s->nentries > (heap->size - off - sizeof(*s)) /
+			sizeof(struct heap_summary_entry))
 		goto out;
 
-	SLIST_REMOVE_HEAD(&h->active_runs[bucket_idx], run);
+	size += s->nentries * sizeof(struct heap_summary_entry);
+	VALGRIND_DO_MAKE_MEM_DEFINED(s, size);
 
-	m->chunk_id = arun->chunk_id;
-	m->zone_id = arun->zone_id;
+	if (heap_summary_verify(heap, s, size) != 0)
+		goto out;
+
+	for (uint32_t zone_id = 0; zone_id < s->nzones; ++zone_id) {
+		struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+
+		/* ignore zone and chunk headers */
+		VALGRIND_ADD_TO_GLOBAL_TX_IGNORE(z, sizeof(z->header) +
+			sizeof(z->chunk_headers));
+	}
 
-	ret = 1;
+	for (uint64_t n = 0; n < s->nentries; ++n) {
+		struct heap_summary_entry *e = &s->entries[n];
+		struct zone *z = ZID_TO_ZONE(heap->layout, e->zone_id);
+
+		if (e->type == CHUNK_TYPE_RUN) {
+			struct chunk_run *run =
+				(struct chunk_run *)&z->chunks[e->chunk_id];
+			heap_register_active_run(h,
+				&z->chunk_headers[e->chunk_id], run,
+				e->chunk_id, e->zone_id);
+		} else {
+			struct memory_block m = {e->chunk_id, e->zone_id,
+				e->size_idx, 0};
+			CNT_OP(h->default_bucket, insert, heap, m);
+		}
+	}
 
-	Free(arun);
+	h->zones_exhausted = (unsigned)s->nzones;
+	ret = 0;
 
 out:
-	util_mutex_unlock(&h->active_run_lock);
+	/* the summary itself lives in free memory */
+	VALGRIND_DO_MAKE_MEM_UNDEFINED(s, size);
 
 	return ret;
 }
 
+/*
+ * heap_get_active_run -- (internal) searches for an existing, unused, run
+ *
+ * The run with the least free units is picked.
+ */
+static int
+heap_get_active_run(struct heap_rt *h, int bucket_idx,
+	struct memory_block *m)
+{
+	util_mutex_lock(&h->active_run_lock);
+
+	/* keys are never 0, the runs without free units aren't registered */
+	uint64_t key = ctree_remove_unlocked(h->active_runs[bucket_idx], 0, 0);
+
+	util_mutex_unlock(&h->active_run_lock);
+
+	if (key == 0)
+		return 0;
+
+	m->chunk_id = RUN_RANK_CHUNK_ID(key);
+	m->zone_id = RUN_RANK_ZONE_ID(key);
+
+	return 1;
+}
+
 /*
  * heap_get_default_bucket --
  *	(internal) returns the bucket with CHUNKSIZE unit size
@@ -805,11 +1251,11 @@ heap_get_run_bucket(struct chunk_run *run)
  * heap_assign_run_bucket -- (internal) finds and sets bucket for a run
  */
 static struct bucket *
-heap_assign_run_bucket(struct palloc_heap *heap, struct chunk_run *run,
-	uint32_t chunk_id, uint32_t zone_id)
+heap_assign_run_bucket(struct palloc_heap *heap, struct chunk_header *hdr,
+	struct chunk_run *run, uint32_t chunk_id, uint32_t zone_id)
 {
 	uint8_t bucket_idx = heap_get_create_bucket_idx_by_unit_size(heap->rt,
-		run->block_size);
+		run->block_size, hdr->flags);
 
 	/*
 	 * Due to lack of resources the volatile heap state can't be tracked
@@ -854,7 +1300,7 @@ heap_get_chunk_bucket(struct palloc_heap *heap, uint32_t chunk_id,
 		if (run->bucket_vptr != 0)
 			return heap_get_run_bucket(run);
 		else
-			return heap_assign_run_bucket(heap, run,
+			return heap_assign_run_bucket(heap, hdr, run,
 				chunk_id, zone_id);
 	} else {
 		return rt->default_bucket;
@@ -862,14 +1308,41 @@ heap_get_chunk_bucket(struct palloc_heap *heap, uint32_t chunk_id,
 }
 
 /*
- * heap_get_auxiliary_bucket -- returns bucket common for all threads
+ * heap_get_aligned_bucket -- returns the bucket of the allocation class in
+ *	which the objects of the given size are aligned to the given boundary,
+ *	or NULL if there's no such class
+ */
+struct bucket *
+heap_get_aligned_bucket(struct palloc_heap *heap, size_t alignment,
+	size_t size)
+{
+	struct heap_rt *rt = heap->rt;
+
+	if (alignment < (1ULL << ALIGNED_CLASS_MIN_SHIFT) ||
+		alignment > (1ULL << ALIGNED_CLASS_MAX_SHIFT))
+		return NULL;
+
+	uint8_t bucket_idx = rt->aligned_bucket_map[__builtin_ctzll(alignment)];
+	if (bucket_idx == MAX_BUCKETS)
+		return NULL;
+
+	struct bucket *b = heap_get_bucket_by_idx(rt, bucket_idx);
+	if (b->calc_units(b, size) > ((struct bucket_run *)b)->unit_max)
+		return NULL;
+
+	return b;
+}
+
+/*
+ * heap_get_auxiliary_bucket -- returns bucket common for all threads, of the
+ *	same allocation class as the given one
  */
 struct bucket *
-heap_get_auxiliary_bucket(struct palloc_heap *heap, size_t size)
+heap_get_auxiliary_bucket(struct palloc_heap *heap, struct bucket *b)
 {
-	ASSERT(size <= heap->rt->last_run_max_size);
+	ASSERTeq(b->type, BUCKET_RUN);
 
-	return heap->rt->buckets[SIZE_TO_BID(heap->rt, size)];
+	return heap->rt->buckets[b->id];
 }
 
 /*
@@ -989,7 +1462,7 @@ heap_find_or_create_alloc_class(struct palloc_heap *heap, size_t n)
 			return (uint8_t)i;
 	}
 
-	return heap_create_alloc_class_buckets(h, n, RUN_UNIT_MAX);
+	return heap_create_alloc_class_buckets(h, n, RUN_UNIT_MAX, 0);
 }
 
 /*
@@ -1040,10 +1513,17 @@ heap_buckets_init(struct palloc_heap *heap)
 {
 	struct heap_rt *h = heap->rt;
 
-	for (size_t i = 0; i < MAX_BUCKETS; ++i)
-		SLIST_INIT(&h->active_runs[i]);
+	for (size_t i = 0; i < MAX_BUCKETS; ++i) {
+		h->empty_runs[i].n = 0;
+		h->active_runs[i] = ctree_new();
+		if (h->active_runs[i] == NULL)
+			goto error_active_runs_new;
+	}
 
 	h->last_run_max_size = MAX_RUN_SIZE;
+	h->small_map_max_size = 0;
+	memset(h->aligned_bucket_map, MAX_BUCKETS,
+		sizeof(h->aligned_bucket_map));
 	h->bucket_map = Malloc((MAX_RUN_SIZE / ALLOC_BLOCK_SIZE) + 1);
 	if (h->bucket_map == NULL)
 		goto error_bucket_map_malloc;
@@ -1062,7 +1542,7 @@ heap_buckets_init(struct palloc_heap *heap)
 	 */
 	size_t size = 0;
 	uint8_t slot = heap_create_alloc_class_buckets(h,
-		MIN_RUN_SIZE, RUN_UNIT_MAX);
+		MIN_RUN_SIZE, RUN_UNIT_MAX, 0);
 	if (slot == MAX_BUCKETS)
 		goto error_bucket_create;
 
@@ -1123,6 +1603,54 @@ heap_buckets_init(struct palloc_heap *heap)
 		h->bucket_map[i] = bucket;
 	}
 
+	/*
+	 * With compact headers the smallest objects, along with their header,
+	 * fit in a single cache line, and the objects of up to 80 bytes in
+	 * blocks smaller than the smallest generated class. These classes are
+	 * created once all the other ones are in place, so that they are used
+	 * only for such objects.
+	 */
+	if (heap->header_type == HEADER_COMPACT) {
+		static const size_t small_classes[] = {
+			ALLOC_BLOCK_SIZE, 80, 96
+		};
+
+		for (size_t i = SMALL_CLASS_UNIT; i <= SMALL_CLASS_MAX_SIZE;
+				i += SMALL_CLASS_UNIT)
+			h->small_bucket_map[SIZE_TO_SMALL_UNITS(i)] =
+				h->bucket_map[SIZE_TO_ALLOC_BLOCKS(i)];
+
+		size_t min_size = SMALL_CLASS_UNIT;
+		for (size_t c = 0; c < ARRAY_SIZE(small_classes); ++c) {
+			slot = heap_create_alloc_class_buckets(h,
+				small_classes[c], RUN_UNIT_MAX, 0);
+			if (slot == MAX_BUCKETS)
+				goto error_bucket_create;
+
+			for (size_t i = min_size; i <= small_classes[c];
+					i += SMALL_CLASS_UNIT)
+				h->small_bucket_map[SIZE_TO_SMALL_UNITS(i)] =
+					slot;
+
+			min_size = small_classes[c] + SMALL_CLASS_UNIT;
+		}
+
+		h->small_map_max_size = SMALL_CLASS_MAX_SIZE;
+	}
+
+	/*
+	 * The aligned classes are separate from the other ones, even if their
+	 * unit size is the same, because the blocks of their runs are moved.
+	 */
+	if (heap->aligned_allocs) {
+		for (int shift = ALIGNED_CLASS_MIN_SHIFT;
+				shift <= ALIGNED_CLASS_MAX_SHIFT; ++shift) {
+			if (heap_get_create_aligned_class(h, 1ULL << shift)
+					== MAX_BUCKETS)
+				goto error_bucket_create;
+		}
+	}
+
 #ifdef DEBUG
 	/*
 	 * Verify that each bucket's unit size points back to the bucket by the
@@ -1130,7 +1658,8 @@ heap_buckets_init(struct palloc_heap *heap)
 	 * otherwise duplicate buckets will be created.
 	 */
 	for (size_t i = 0; i < MAX_BUCKETS; ++i) {
-		if (h->buckets[i] != NULL) {
+		if (h->buckets[i] != NULL &&
+			((struct bucket_run *)h->buckets[i])->run_flags == 0) {
 			struct bucket *b = h->buckets[i];
 			size_t b_id = SIZE_TO_BID(h, b->unit_size);
 			ASSERTeq(b_id, i);
@@ -1152,6 +1681,10 @@ error_default_bucket_new:
 	Free(h->bucket_map);
 
 error_bucket_map_malloc:
+error_active_runs_new:
+	for (size_t i = 0; i < MAX_BUCKETS && h->active_runs[i] != NULL; ++i)
+		ctree_delete(h->active_runs[i]);
+
 	return ENOMEM;
 }
 
@@ -1197,6 +1730,79 @@ heap_recycle_block(struct palloc_heap *heap, struct bucket *b,
 	m->size_idx = units;
 }
 
+/*
+ * heap_trim_chunk_front -- (internal) returns the given number of the first
+ *	chunks of the memory block back to the bucket
+ */
+static void
+heap_trim_chunk_front(struct palloc_heap *heap, struct bucket *b,
+		struct memory_block *m, uint32_t lead)
+{
+	ASSERT(lead < m->size_idx);
+
+	struct zone *z = ZID_TO_ZONE(heap->layout, m->zone_id);
+	struct chunk_header *hdr = &z->chunk_headers[m->chunk_id];
+	struct chunk_header *new_hdr = &z->chunk_headers[m->chunk_id + lead];
+
+	heap_chunk_init(heap, new_hdr, CHUNK_TYPE_FREE, m->size_idx - lead);
+	heap_chunk_init(heap, hdr, CHUNK_TYPE_FREE, lead);
+
+	struct memory_block f = {m->chunk_id, m->zone_id, lead, 0};
+	CNT_OP(b, insert, heap, f);
+
+	m->chunk_id += lead;
+	m->size_idx -= lead;
+}
+
+/*
+ * heap_get_aligned_block -- extracts a memory block of chunks in which the
+ *	data that follows the first data_off bytes of headers is aligned to the
+ *	given boundary
+ *
+ * The chunk in which the data starts is chosen so that it is moved by less
+ * than a single chunk, the chunks before and after the block are returned
+ * back to the bucket.
+ */
+int
+heap_get_aligned_block(struct palloc_heap *heap, struct bucket *b,
+	struct memory_block *m, size_t data_off, size_t size, size_t alignment)
+{
+	ASSERTeq(b->type, BUCKET_HUGE);
+
+	util_mutex_lock(&b->lock);
+
+	/* in the worst case the data starts in the last chunk of the pad */
+	size_t lead_max = (alignment - 1) / CHUNKSIZE;
+	m->size_idx = (uint32_t)(b->calc_units(b, size) + 1 + lead_max);
+
+	int ret = 0;
+
+	while (CNT_OP(b, get_rm_bestfit, m) != 0) {
+		if ((ret = heap_ensure_bucket_filled(heap, b)) != 0) {
+			goto out;
+		}
+	}
+
+	uint64_t off = PMALLOC_PTR_TO_OFF(heap,
+		heap_get_block_data(heap, *m)) + data_off;
+	uint64_t pad = (alignment - off % alignment) % alignment;
+
+	uint32_t lead = (uint32_t)(pad / CHUNKSIZE);
+	uint32_t units = b->calc_units(b, pad % CHUNKSIZE + size);
+	ASSERT(lead + units <= m->size_idx);
+
+	if (lead != 0)
+		heap_trim_chunk_front(heap, b, m, lead);
+
+	if (units != m->size_idx)
+		heap_recycle_block(heap, b, m, units);
+
+out:
+	util_mutex_unlock(&b->lock);
+
+	return ret;
+}
+
 /*
  * heap_get_bestfit_block --
  *	extracts a memory block of equal size index
@@ -1251,6 +1857,22 @@ out:
 	return 0;
 }
 
+/*
+ * heap_run_get_data -- (internal) returns pointer to the first block of a run
+ */
+static uint8_t *
+heap_run_get_data(struct palloc_heap *heap, struct chunk_header *hdr,
+	struct chunk_run *run)
+{
+	uint8_t *data = run->data + RUN_DATA_OFFSET(run->block_size);
+
+	if (hdr->flags & CHUNK_FLAG_ALIGNED)
+		data += RUN_ALIGNED_OFFSET(PMALLOC_PTR_TO_OFF(heap, data),
+			ALLOC_OFF(heap), run->block_size);
+
+	return data;
+}
+
 /*
  * heap_get_block_data -- returns pointer to the data of a block
  */
@@ -1267,7 +1889,8 @@ heap_get_block_data(struct palloc_heap *heap, struct memory_block m)
 	struct chunk_run *run = data;
 	ASSERT(run->block_size != 0);
 
-	return (char *)&run->data + (run->block_size * m.block_off);
+	return heap_run_get_data(heap, hdr, run) +
+		(run->block_size * m.block_off);
 }
 
 #ifdef DEBUG
@@ -1465,6 +2088,38 @@ heap_free_block(struct palloc_heap *heap, struct bucket *b,
 	return res;
 }
 
+/*
+ * heap_free_block_cancel -- returns the free neighbours which heap_free_block
+ *	coalesced with the memory block back to the bucket, once the operation
+ *	which was to free the block has failed
+ */
+void
+heap_free_block_cancel(struct palloc_heap *heap, struct bucket *b,
+	struct memory_block m, struct memory_block res)
+{
+	if (b == NULL)
+		return;
+
+	struct memory_block prev = res;
+	struct memory_block next = res;
+
+	if (b->type == BUCKET_RUN) {
+		prev.size_idx = (uint32_t)(m.block_off - res.block_off);
+		next.block_off = (uint16_t)(m.block_off + m.size_idx);
+		next.size_idx = res.block_off + res.size_idx - next.block_off;
+	} else {
+		prev.size_idx = m.chunk_id - res.chunk_id;
+		next.chunk_id = m.chunk_id + m.size_idx;
+		next.size_idx = res.chunk_id + res.size_idx - next.chunk_id;
+	}
+
+	if (prev.size_idx != 0)
+		CNT_OP(b, insert, heap, prev);
+
+	if (next.size_idx != 0)
+		CNT_OP(b, insert, heap, next);
+}
+
 /*
  * traverse_bucket_run -- (internal) traverses each memory block of a run
  */
@@ -1497,16 +2152,69 @@ traverse_bucket_run(struct bucket *b, struct memory_block m,
 }
 
 /*
- * heap_degrade_run_if_empty -- makes a chunk out of an empty run
+ * heap_run_is_unused -- (internal) checks whether none of the units of the run
+ *	are allocated
  */
-void
-heap_degrade_run_if_empty(struct palloc_heap *heap,
-		struct bucket *b, struct memory_block m)
+static int
+heap_run_is_unused(struct bucket_run *r, struct chunk_run *run)
+{
+	unsigned i;
+	unsigned nval = r->bitmap_nval;
+	for (i = 0; nval > 0 && i < nval - 1; ++i)
+		if (run->bitmap[i] != 0)
+			return 0;
+
+	return run->bitmap[i] == r->bitmap_lastval;
+}
+
+/*
+ * heap_keep_empty_run -- (internal) decides whether an empty run is left
+ *	in its bucket instead of being turned back into a chunk
+ *
+ * The kept runs stay reserved for their class, even once they are allocated
+ * from again, until the heap runs out of free chunks.
+ */
+static int
+heap_keep_empty_run(struct palloc_heap *heap, struct bucket *b,
+	struct memory_block m)
+{
+	struct heap_rt *h = heap->rt;
+	struct empty_runs *e = &h->empty_runs[b->id];
+	int keep = 0;
+
+	util_mutex_lock(&h->active_run_lock);
+
+	for (unsigned i = 0; i < e->n; ++i) {
+		if (e->runs[i].chunk_id == m.chunk_id &&
+			e->runs[i].zone_id == m.zone_id) {
+			keep = 1;
+			goto out;
+		}
+	}
+
+	if (e->n < MAX_EMPTY_RUNS) {
+		e->runs[e->n++] = m;
+		keep = 1;
+	}
+
+out:
+	util_mutex_unlock(&h->active_run_lock);
+
+	return keep;
+}
+
+/*
+ * heap_degrade_run -- (internal) makes a chunk out of an empty run, unless
+ *	it is kept for the future allocations of its class
+ *
+ * Returns 1 if the run was degraded.
+ */
+static int
+heap_degrade_run(struct palloc_heap *heap, struct bucket *b,
+	struct memory_block m, int keep)
 {
 	struct zone *z = ZID_TO_ZONE(heap->layout, m.zone_id);
 	struct chunk_header *hdr = &z->chunk_headers[m.chunk_id];
-	ASSERT(hdr->type == CHUNK_TYPE_RUN);
-
 	struct chunk_run *run = (struct chunk_run *)&z->chunks[m.chunk_id];
 
 	ASSERTeq(b->type, BUCKET_RUN);
@@ -1517,19 +2225,22 @@ heap_degrade_run_if_empty(struct palloc_heap *heap,
 	 * persistent value modification in the entire operation context.
 	 */
 	struct operation_context ctx;
-	operation_init(&ctx, heap->base, NULL, NULL);
+	operation_init(&ctx, heap->base, NULL, NULL, 0);
 	ctx.p_ops = &heap->p_ops;
 
+	int degraded = 0;
+
 	util_mutex_lock(&b->lock);
 	MEMBLOCK_OPS(RUN, &m)->lock(&m, heap);
 
-	unsigned i;
-	unsigned nval = r->bitmap_nval;
-	for (i = 0; nval > 0 && i < nval - 1; ++i)
-		if (run->bitmap[i] != 0)
-			goto out;
+	/* the run might have been degraded already, or given to other bucket */
+	if (hdr->type != CHUNK_TYPE_RUN || run->bucket_vptr != (uint64_t)b)
+		goto out;
+
+	if (!heap_run_is_unused(r, run))
+		goto out;
 
-	if (run->bitmap[i] != r->bitmap_lastval)
+	if (keep && heap_keep_empty_run(heap, b, m))
 		goto out;
 
 	if (traverse_bucket_run(b, m, b->c_ops->get_exact) != 0) {
@@ -1553,15 +2264,74 @@ heap_degrade_run_if_empty(struct palloc_heap *heap,
 	heap_chunk_init(heap, hdr, CHUNK_TYPE_FREE, m.size_idx);
 
 	struct memory_block fm = heap_free_block(heap, defb, m, &ctx);
-	operation_process(&ctx);
+	if (operation_process(&ctx) != 0) {
+		/* the chunk is free, but its neighbours remain separate */
+		heap_free_block_cancel(heap, defb, m, fm);
+		fm = m;
+	}
 
 	CNT_OP(defb, insert, heap, fm);
 
 	util_mutex_unlock(&defb->lock);
 
+	degraded = 1;
+
 out:
 	MEMBLOCK_OPS(RUN, &m)->unlock(&m, heap);
 	util_mutex_unlock(&b->lock);
+
+	return degraded;
+}
+
+/*
+ * heap_degrade_run_if_empty -- makes a chunk out of an empty run
+ *
+ * A few empty runs of each class are kept as they are, those are degraded
+ * only once the heap runs out of free chunks.
+ */
+void
+heap_degrade_run_if_empty(struct palloc_heap *heap,
+		struct bucket *b, struct memory_block m)
+{
+	heap_degrade_run(heap, b, m, 1);
+}
+
+/*
+ * heap_degrade_empty_runs -- makes chunks out of all of the empty runs kept
+ *	by the heap, returns the number of the degraded runs
+ */
+int
+heap_degrade_empty_runs(struct palloc_heap *heap)
+{
+	struct heap_rt *h = heap->rt;
+	struct empty_runs e;
+	int ndegraded = 0;
+
+	for (int c = 0; c < MAX_BUCKETS; ++c) {
+		util_mutex_lock(&h->active_run_lock);
+		e = h->empty_runs[c];
+		h->empty_runs[c].n = 0;
+		util_mutex_unlock(&h->active_run_lock);
+
+		for (unsigned i = 0; i < e.n; ++i) {
+			struct memory_block m = e.runs[i];
+			struct zone *z = ZID_TO_ZONE(heap->layout, m.zone_id);
+			struct chunk_run *run =
+				(struct chunk_run *)&z->chunks[m.chunk_id];
+
+			MEMBLOCK_OPS(RUN, &m)->lock(&m, heap);
+			struct bucket *b =
+				z->chunk_headers[m.chunk_id].type ==
+				CHUNK_TYPE_RUN ?
+				(struct bucket *)run->bucket_vptr : NULL;
+			MEMBLOCK_OPS(RUN, &m)->unlock(&m, heap);
+
+			if (b != NULL)
+				ndegraded += heap_degrade_run(heap, b, m, 0);
+		}
+	}
+
+	return ndegraded;
 }
 
 /*
@@ -1626,6 +2396,9 @@ heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 	h->zones_exhausted = 0;
 
 	util_mutex_init(&h->active_run_lock, NULL);
+	util_mutex_init(&h->zone_lock, NULL);
+	h->formatter_running = 0;
+	h->formatter_stop = 0;
 
 	pthread_mutexattr_t lock_attr;
 	if ((err = pthread_mutexattr_init(&lock_attr)) != 0)
@@ -1673,7 +2446,7 @@ error_heap_malloc:
  * heap_write_header -- (internal) creates a clean header
  */
 static void
-heap_write_header(struct heap_header *hdr, size_t size)
+heap_write_header(struct heap_header *hdr, size_t size, uint64_t format_id)
 {
 	struct heap_header newhdr = {
 		.signature = HEAP_SIGNATURE,
@@ -1682,6 +2455,7 @@ heap_write_header(struct heap_header *hdr, size_t size)
 		.size = size,
 		.chunksize = CHUNKSIZE,
 		.chunks_per_zone = MAX_CHUNK,
+		.zone_format_id = format_id,
 		.reserved = {0},
 		.checksum = 0
 	};
@@ -1709,9 +2483,7 @@ heap_vg_open(void *heap_start, uint64_t heap_size)
 		struct zone *z = ZID_TO_ZONE(layout, i);
 		uint32_t chunks;
 
-		VALGRIND_DO_MAKE_MEM_DEFINED(&z->header, sizeof(z->header));
-
-		if (z->header.magic != ZONE_HEADER_MAGIC)
+		if (!heap_zone_is_formatted(layout, i))
 			continue;
 
 		chunks = z->header.size_idx;
@@ -1759,24 +2531,23 @@ heap_init(void *heap_start, uint64_t heap_size, struct pmem_ops *p_ops)
 
 	VALGRIND_DO_MAKE_MEM_UNDEFINED(heap_start, heap_size);
 
-	struct heap_layout *layout = heap_start;
-	heap_write_header(&layout->header, heap_size);
-	pmemops_persist(p_ops, &layout->header, sizeof(struct heap_header));
+	/*
+	 * The zones aren't touched here, they are formatted when the heap
+	 * grows into them. The random format id makes the zone headers left
+	 * in this space by a previous pool invalid.
+	 */
+	uuid_t uuid;
+	if (util_uuid_generate(uuid) != 0)
+		return EINVAL;
 
-	unsigned zones = heap_max_zone(heap_size);
-	for (unsigned i = 0; i < zones; ++i) {
-		pmemops_memset_persist(p_ops,
-				&ZID_TO_ZONE(layout, i)->header,
-				0, sizeof(struct zone_header));
-		pmemops_memset_persist(p_ops,
-				&ZID_TO_ZONE(layout, i)->chunk_headers,
-				0, sizeof(struct chunk_header));
+	uint64_t format_id;
+	memcpy(&format_id, uuid, sizeof(format_id));
+	if (format_id == 0)
+		format_id = 1; /* zero is used by the eagerly formatted heaps */
 
-		/* only explicitly allocated chunks should be accessible */
-		VALGRIND_DO_MAKE_MEM_NOACCESS(
-			&ZID_TO_ZONE(layout, i)->chunk_headers,
-			sizeof(struct chunk_header));
-	}
+	struct heap_layout *layout = heap_start;
+	heap_write_header(&layout->header, heap_size, format_id);
+	pmemops_persist(p_ops, &layout->header, sizeof(struct heap_header));
 
 	return 0;
 }
@@ -1789,6 +2560,8 @@ heap_cleanup(struct palloc_heap *heap)
 {
 	struct heap_rt *rt = heap->rt;
 
+	heap_formatter_stop(heap);
+
 	bucket_delete(rt->default_bucket);
 
 	bucket_group_destroy(rt->buckets);
@@ -1804,14 +2577,10 @@ heap_cleanup(struct palloc_heap *heap)
 	Free(rt->caches);
 
 	util_mutex_destroy(&rt->active_run_lock);
+	util_mutex_destroy(&rt->zone_lock);
 
-	struct active_run *r;
-	for (int i = 0; i < MAX_BUCKETS; ++i) {
-		while ((r = SLIST_FIRST(&rt->active_runs[i])) != NULL) {
-			SLIST_REMOVE_HEAD(&rt->active_runs[i], run);
-			Free(r);
-		}
-	}
+	for (int i = 0; i < MAX_BUCKETS; ++i)
+		ctree_delete(rt->active_runs[i]);
 
 	VALGRIND_DO_DESTROY_MEMPOOL(heap->layout);
 
@@ -1882,9 +2651,9 @@ heap_verify_chunk_header(struct chunk_header *hdr)
  * heap_verify_zone -- (internal) verifies if the zone is consistent
  */
 static int
-heap_verify_zone(struct zone *zone)
+heap_verify_zone(struct zone *zone, uint64_t format_id)
 {
-	if (zone->header.magic == 0)
+	if (zone->header.magic == 0 || zone->header.format_id != format_id)
 		return 0; /* not initialized, and that is OK */
 
 	if (zone->header.magic != ZONE_HEADER_MAGIC) {
@@ -1935,16 +2704,14 @@ heap_check(void *heap_start, uint64_t heap_size)
 		return -1;
 
 	for (unsigned i = 0; i < heap_max_zone(layout->header.size); ++i) {
-		if (heap_verify_zone(ZID_TO_ZONE(layout, i)))
+		if (heap_verify_zone(ZID_TO_ZONE(layout, i),
+				layout->header.zone_format_id))
 			return -1;
 	}
 
 	return 0;
 }
 
-#define PMALLOC_PTR_TO_OFF(heap, ptr)\
-	((uintptr_t)(ptr) - (uintptr_t)(heap->base))
-
 /*
  * heap_check_remote -- verifies if the heap of a remote pool is consistent
  *                      and can be opened properly
@@ -1984,7 +2751,7 @@ heap_check_remote(void *heap_start, uint64_t heap_size, struct remote_ops *ops)
 			return -1;
 		}
 
-		if (heap_verify_zone(&zone_buff))
+		if (heap_verify_zone(&zone_buff, header.zone_format_id))
 			return -1;
 	}
 
@@ -1996,16 +2763,16 @@ heap_check_remote(void *heap_start, uint64_t heap_size, struct remote_ops *ops)
  */
 static int
 heap_run_foreach_object(struct palloc_heap *heap, object_callback cb,
-		void *arg, struct chunk_run *run)
+		void *arg, struct chunk_header *hdr, struct chunk_run *run)
 {
 	uint64_t bs = run->block_size;
 	uint64_t block_off;
 
-	uint64_t bitmap_nallocs = RUN_NALLOCS(bs);
-	uint64_t unused_bits = RUN_BITMAP_SIZE - bitmap_nallocs;
-	uint64_t unused_values = unused_bits / BITS_PER_VALUE;
-	uint64_t bitmap_nval = MAX_BITMAP_VALUES - unused_values;
-	unused_bits -= unused_values * BITS_PER_VALUE;
+	uint64_t bitmap_nallocs = hdr->flags & CHUNK_FLAG_ALIGNED ?
+		RUN_ALIGNED_NALLOCS(bs) : RUN_NALLOCS(bs);
+	uint64_t bitmap_nval =
+		(bitmap_nallocs + BITS_PER_VALUE - 1) / BITS_PER_VALUE;
+	uint8_t *data = heap_run_get_data(heap, hdr, run);
 
 	struct allocation_header *alloc;
 
@@ -2023,8 +2790,8 @@ heap_run_foreach_object(struct palloc_heap *heap, object_callback cb,
 
 			if (!BIT_IS_CLR(v, j)) {
 				alloc = (struct allocation_header *)
-					(run->data + (block_off + j) * bs);
-				j += (alloc->size / bs);
+					(data + (block_off + j) * bs);
+				j += (ALLOC_HDR_SIZE(alloc) / bs);
 				if (cb(PMALLOC_PTR_TO_OFF(heap, alloc), arg)
 						!= 0)
 					return 1;
@@ -2051,7 +2818,7 @@ heap_chunk_foreach_object(struct palloc_heap *heap, object_callback cb,
 		case CHUNK_TYPE_USED:
 			return cb(PMALLOC_PTR_TO_OFF(heap, chunk), arg);
 		case CHUNK_TYPE_RUN:
-			return heap_run_foreach_object(heap, cb, arg,
+			return heap_run_foreach_object(heap, cb, arg, hdr,
 				(struct chunk_run *)chunk);
 		default:
 			ASSERT(0);
@@ -2065,11 +2832,13 @@ heap_chunk_foreach_object(struct palloc_heap *heap, object_callback cb,
  */
 static int
 heap_zone_foreach_object(struct palloc_heap *heap, object_callback cb,
-	void *arg, struct zone *zone, struct memory_block start)
+	void *arg, uint32_t zone_id, struct memory_block start)
 {
-	if (zone->header.magic == 0)
+	if (!heap_zone_is_formatted(heap->layout, zone_id))
 		return 0;
 
+	struct zone *zone = ZID_TO_ZONE(heap->layout, zone_id);
+
 	uint32_t i;
 	for (i = start.chunk_id; i < zone->header.size_idx; ) {
 		if (heap_chunk_foreach_object(heap, cb, arg,
@@ -2091,9 +2860,60 @@ heap_foreach_object(struct palloc_heap *heap, object_callback cb, void *arg,
 {
 	struct heap_layout *layout = heap->layout;
 
-	for (unsigned i = start.zone_id;
+	for (uint32_t i = start.zone_id;
 		i < heap_max_zone(layout->header.size); ++i)
-		if (heap_zone_foreach_object(heap, cb, arg,
-				ZID_TO_ZONE(layout, i), start) != 0)
+		if (heap_zone_foreach_object(heap, cb, arg, i, start) != 0)
 			break;
 }
+
+/*
+ * heap_range_next -- moves the range to the following group of at most
+ *	nchunks chunks, returns 0 if the entire heap has already been covered
+ *
+ * The range must be zeroed before the first call. Chunks are never split
+ * between two ranges, so that each range can be walked independently.
+ */
+int
+heap_range_next(struct palloc_heap *heap, struct heap_range *r,
+	uint32_t nchunks)
+{
+	struct heap_layout *layout = heap->layout;
+	unsigned max_zone = heap_max_zone(layout->header.size);
+
+	for (; r->zone_id < max_zone; r->zone_id++, r->end = 0) {
+		struct zone *z = ZID_TO_ZONE(layout, r->zone_id);
+		if (!heap_zone_is_formatted(layout, r->zone_id) ||
+			r->end >= z->header.size_idx)
+			continue;
+
+		uint32_t i = r->chunk_id = r->end;
+		while (i < z->header.size_idx && i - r->chunk_id < nchunks)
+			i += z->chunk_headers[i].size_idx;
+
+		r->end = i;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * heap_range_foreach_object -- iterates through objects in the range
+ */
+int
+heap_range_foreach_object(struct palloc_heap *heap, object_callback cb,
+	void *arg, const struct heap_range *r)
+{
+	struct zone *z = ZID_TO_ZONE(heap->layout, r->zone_id);
+
+	for (uint32_t i = r->chunk_id; i < r->end; ) {
+		if (heap_chunk_foreach_object(heap, cb, arg,
+			&z->chunk_headers[i], &z->chunks[i]) != 0)
+			return 1;
+
+		i += z->chunk_headers[i].size_idx;
+	}
+
+	return 0;
+}
@@ -61,20 +61,32 @@
  */
 #define SIZE_TO_ALLOC_BLOCKS(_s) (1 + (((_s) - 1) / ALLOC_BLOCK_SIZE))
 
+/*
+ * Number of bytes between beginning of memory block and beginning of user data.
+ */
+#define ALLOC_OFF(heap) (sizeof(struct allocation_header) +\
+	((heap)->header_type == HEADER_COMPACT ? 0 : PALLOC_DATA_OFF))
+
+void heap_params_boot(void);
 int heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 		void *base, struct pmem_ops *p_ops);
+void heap_formatter_start(struct palloc_heap *heap);
 int heap_init(void *heap_start, uint64_t heap_size, struct pmem_ops *p_ops);
 void heap_vg_open(void *heap_start, uint64_t heap_size);
 void heap_cleanup(struct palloc_heap *heap);
 int heap_check(void *heap_start, uint64_t heap_size);
 int heap_check_remote(void *heap_start, uint64_t heap_size,
 		struct remote_ops *ops);
+uint64_t heap_summary_write(struct palloc_heap *heap);
+int heap_summary_load(struct palloc_heap *heap, uint64_t off);
 
 struct bucket *heap_get_best_bucket(struct palloc_heap *heap, size_t size);
 struct bucket *heap_get_chunk_bucket(struct palloc_heap *heap,
 		uint32_t chunk_id, uint32_t zone_id);
+struct bucket *heap_get_aligned_bucket(struct palloc_heap *heap,
+		size_t alignment, size_t size);
 struct bucket *heap_get_auxiliary_bucket(struct palloc_heap *heap,
-		size_t size);
+		struct bucket *b);
 void heap_drain_to_auxiliary(struct palloc_heap *heap, struct bucket *auxb,
 	uint32_t size_idx);
 void *heap_get_block_data(struct palloc_heap *heap, struct memory_block m);
@@ -88,16 +100,21 @@ void heap_chunk_write_footer(struct chunk_header *hdr, uint32_t size_idx);
 
 int heap_get_bestfit_block(struct palloc_heap *heap, struct bucket *b,
 	struct memory_block *m);
+int heap_get_aligned_block(struct palloc_heap *heap, struct bucket *b,
+	struct memory_block *m, size_t data_off, size_t size, size_t alignment);
 int heap_get_exact_block(struct palloc_heap *heap, struct bucket *b,
 	struct memory_block *m, uint32_t new_size_idx);
 void heap_degrade_run_if_empty(struct palloc_heap *heap, struct bucket *b,
 		struct memory_block m);
+int heap_degrade_empty_runs(struct palloc_heap *heap);
 
 pthread_mutex_t *heap_get_run_lock(struct palloc_heap *heap,
 		uint32_t chunk_id);
 
 struct memory_block heap_free_block(struct palloc_heap *heap, struct bucket *b,
 	struct memory_block m, struct operation_context *ctx);
+void heap_free_block_cancel(struct palloc_heap *heap, struct bucket *b,
+	struct memory_block m, struct memory_block res);
 
 /* foreach callback, terminates iteration if return value is non-zero */
 typedef int (*object_callback)(uint64_t off, void *arg);
@@ -105,6 +122,18 @@ typedef int (*object_callback)(uint64_t off, void *arg);
 void heap_foreach_object(struct palloc_heap *heap, object_callback cb,
 	void *arg, struct memory_block start);
 
+/* a group of consecutive chunks of a zone, one unit of a partitioned walk */
+struct heap_range {
+	uint32_t zone_id;
+	uint32_t chunk_id; /* first chunk of the range */
+	uint32_t end; /* chunk following the last one in the range */
+};
+
+int heap_range_next(struct palloc_heap *heap, struct heap_range *r,
+	uint32_t nchunks);
+int heap_range_foreach_object(struct palloc_heap *heap, object_callback cb,
+	void *arg, const struct heap_range *r);
+
 #ifdef DEBUG
 int heap_block_is_allocated(struct palloc_heap *heap, struct memory_block m);
 #endif /* DEBUG */
@@ -52,6 +52,9 @@
 #define ZONE_MIN_SIZE (sizeof(struct zone) + sizeof(struct chunk))
 #define ZONE_MAX_SIZE (sizeof(struct zone) + sizeof(struct chunk) * MAX_CHUNK)
 #define HEAP_MIN_SIZE (sizeof(struct heap_layout) + ZONE_MIN_SIZE)
+/* offset of the first chunk of the first zone from the start of the heap */
+#define HEAP_ZONE0_CHUNKS_OFFSET\
+	(sizeof(struct heap_header) + sizeof(struct zone))
 
 #define BITS_PER_VALUE 64U
 #define MAX_CACHELINE_ALIGNMENT 40 /* run alignment, 5 cachelines */
@@ -61,13 +64,48 @@
 #define RUNSIZE (CHUNKSIZE - RUN_METASIZE)
 #define MIN_RUN_SIZE 128
 
+/*
+ * The bitmap in the run metadata covers the whole run only for blocks of at
+ * least RUNSIZE / RUN_BITMAP_SIZE bytes. The bitmap of a run of smaller
+ * blocks, down to RUN_MIN_BLOCK_SIZE, continues over the beginning of the run
+ * data and the blocks of such a run start at the first cache line after it.
+ */
+#define RUN_MIN_BLOCK_SIZE 64
+#define RUN_EXT_BITMAP_VALUES\
+	(CHUNKSIZE / RUN_MIN_BLOCK_SIZE / BITS_PER_VALUE)
+#define RUN_HAS_EXT_BITMAP(_bs) (RUNSIZE / (_bs) > RUN_BITMAP_SIZE)
+
+/* number of values of the bitmap of a run of blocks of the given size */
+#define RUN_BITMAP_VALUES(_bs) (RUN_HAS_EXT_BITMAP(_bs) ?\
+	(CHUNKSIZE / (_bs) + BITS_PER_VALUE - 1) / BITS_PER_VALUE :\
+	MAX_BITMAP_VALUES)
+
+#define RUN_DATA_ALIGNMENT 64
+
+/*
+ * The first block of a run marked with CHUNK_FLAG_ALIGNED is moved forward,
+ * so that the object which follows the header of each of its blocks is
+ * aligned to the block size. The offset depends on the offset of the run data
+ * from the beginning of the pool, the size of the object headers and the
+ * block size, which has to be a power of two large enough for the whole run
+ * to be covered by the bitmap in the run metadata.
+ */
+#define RUN_ALIGNED_OFFSET(_data_off, _hdr_size, _bs)\
+	(((_bs) - ((_data_off) + (_hdr_size)) % (_bs)) % (_bs))
+
+/* offset of the first block of a run from its data */
+#define RUN_DATA_OFFSET(_bs) (RUN_HAS_EXT_BITMAP(_bs) ?\
+	((RUN_BITMAP_VALUES(_bs) - MAX_BITMAP_VALUES) * sizeof(uint64_t) +\
+	RUN_DATA_ALIGNMENT - 1) / RUN_DATA_ALIGNMENT * RUN_DATA_ALIGNMENT : 0)
+
 #define ZID_TO_ZONE(layoutp, zone_id)\
 	((struct zone *)((uintptr_t)&(((struct heap_layout *)(layoutp))->zone0)\
 					+ ZONE_MAX_SIZE * (zone_id)))
 
 enum chunk_flags {
 	CHUNK_FLAG_ZEROED	=	0x0001,
-	CHUNK_RUN_ACTIVE	=	0x0002
+	CHUNK_RUN_ACTIVE	=	0x0002,
+	CHUNK_FLAG_ALIGNED	=	0x0004	/* see RUN_ALIGNED_OFFSET */
 };
 
 enum chunk_type {
@@ -87,8 +125,14 @@ struct chunk {
 struct chunk_run {
 	uint64_t block_size;
 	uint64_t bucket_vptr; /* runtime information */
-	uint64_t bitmap[MAX_BITMAP_VALUES];
-	uint8_t data[RUNSIZE];
+	union {
+		/* only the values given by RUN_BITMAP_VALUES are used */
+		uint64_t bitmap[RUN_EXT_BITMAP_VALUES];
+		struct {
+			uint64_t bitmap_hdr[MAX_BITMAP_VALUES];
+			uint8_t data[RUNSIZE];
+		};
+	};
 };
 
 struct chunk_header {
@@ -100,7 +144,8 @@ struct chunk_header {
 struct zone_header {
 	uint32_t magic;
 	uint32_t size_idx;
-	uint8_t reserved[56];
+	uint64_t format_id; /* zone_format_id of the heap */
+	uint8_t reserved[48];
 };
 
 struct zone {
@@ -116,7 +161,8 @@ struct heap_header {
 	uint64_t size;
 	uint64_t chunksize;
 	uint64_t chunks_per_zone;
-	uint8_t reserved[960];
+	uint64_t zone_format_id; /* distinguishes the zones of this heap */
+	uint8_t reserved[952];
 	uint64_t checksum;
 };
 
@@ -131,4 +177,52 @@ struct allocation_header {
 	uint64_t size;
 };
 
+/*
+ * Header of an object in a heap with compact headers, it takes the place of
+ * both the allocation header and the out-of-band header of obj. The size is
+ * at the same offset as in the allocation header, but the chunk and zone of
+ * the memory block are calculated from the address of the header instead of
+ * being stored.
+ */
+struct allocation_header_compact {
+	uint64_t extra; /* type number of the object, set by obj */
+	uint64_t size;
+};
+
+/*
+ * The least significant bits of the allocation size hold the size of the
+ * memory block. The next ones hold the number of 16 byte units between the
+ * beginning of the memory block and the header of an object moved to a
+ * stricter alignment, the header is repeated there, right before the object.
+ * The most significant bit is left to the user of the allocator.
+ */
+#define ALLOC_HDR_PAD_SHIFT 40
+#define ALLOC_HDR_PAD_MASK ((1ULL << 23) - 1)
+#define ALLOC_HDR_PAD_UNIT 16
+#define ALLOC_HDR_FLAG_USER (1ULL << 63)
+#define ALLOC_HDR_SIZE(_a)\
+	((_a)->size & ((1ULL << ALLOC_HDR_PAD_SHIFT) - 1))
+#define ALLOC_HDR_PAD(_a)\
+	((((_a)->size >> ALLOC_HDR_PAD_SHIFT) & ALLOC_HDR_PAD_MASK) *\
+	ALLOC_HDR_PAD_UNIT)
+
+/*
+ * Free space summary written to a free extent of the heap on clean pool close,
+ * describes every free chunk and every run of the initialized zones.
+ */
+struct heap_summary_entry {
+	uint32_t zone_id;
+	uint32_t chunk_id;
+	uint32_t size_idx;
+	uint32_t type; /* CHUNK_TYPE_FREE or CHUNK_TYPE_RUN */
+};
+
+struct heap_summary {
+	uint64_t nzones; /* number of initialized zones */
+	uint64_t nentries;
+	uint64_t checksum; /* checksum of the header and all entries */
+	uint64_t unused;
+	struct heap_summary_entry entries[];
+};
+
 #endif
@@ -41,19 +41,36 @@
 #include <errno.h>
 #include <limits.h>
 #include <pthread.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include "libpmemobj.h"
 #include "cuckoo.h"
 #include "lane.h"
 #include "out.h"
 #include "obj.h"
+#include "util.h"
 #include "valgrind_internal.h"
 
+/*
+ * Number of pools which can have a direct per-thread lane info slot, lane info
+ * of any other pool is looked up in the per-thread hash table.
+ */
+#define LANE_INFO_SLOTS 64
+
 static pthread_key_t Lane_info_key;
 
 static __thread struct cuckoo *Lane_info_ht;
 static __thread struct lane_info *Lane_info_records;
 static __thread struct lane_info *Lane_info_cache;
+static __thread struct lane_info *Lane_info_slots[LANE_INFO_SLOTS];
+
+static uint64_t Lane_info_slots_used; /* bitmap of the assigned slots */
 
 struct section_operations *Section_ops[MAX_LANE_SECTION];
 
@@ -78,6 +95,7 @@ lane_info_destroy()
 	Lane_info_ht = NULL;
 	Lane_info_records = NULL;
 	Lane_info_cache = NULL;
+	memset(Lane_info_slots, 0, sizeof(Lane_info_slots));
 }
 
 /*
@@ -150,6 +168,10 @@ lane_info_cleanup(PMEMobjpool *pop)
 		if (Lane_info_cache == info)
 			Lane_info_cache = NULL;
 
+		unsigned slot = pop->lanes_desc.info_slot;
+		if (slot < LANE_INFO_SLOTS && Lane_info_slots[slot] == info)
+			Lane_info_slots[slot] = NULL;
+
 		if (Lane_info_records == info)
 			Lane_info_records = info->next;
 
@@ -158,20 +180,99 @@ lane_info_cleanup(PMEMobjpool *pop)
 }
 
 /*
- * lane_get_layout -- (internal) calculates the real pointer of the lane layout
+ * lane_info_slot_alloc -- (internal) assigns a free lane info slot to the pool
+ */
+static unsigned
+lane_info_slot_alloc(void)
+{
+	uint64_t used;
+	unsigned slot;
+
+	do {
+		used = Lane_info_slots_used;
+		if (used == UINT64_MAX)
+			return LANE_INFO_SLOTS; /* use the hash table */
+
+		slot = (unsigned)__builtin_ffsll((long long)~used) - 1;
+	} while (!__sync_bool_compare_and_swap(&Lane_info_slots_used,
+			used, used | (1ULL << slot)));
+
+	return slot;
+}
+
+/*
+ * lane_info_slot_free -- (internal) returns the lane info slot of the pool
+ */
+static void
+lane_info_slot_free(unsigned slot)
+{
+	if (slot < LANE_INFO_SLOTS)
+		__sync_fetch_and_and(&Lane_info_slots_used, ~(1ULL << slot));
+}
+
+/*
+ * lane_free_push -- (internal) puts the lane on the stack of free lanes,
+ *	unless it's already there
+ */
+static void
+lane_free_push(struct lane_descriptor *desc, unsigned idx)
+{
+	if (!__sync_bool_compare_and_swap(&desc->free_next[idx],
+			LANE_NOT_STACKED, 0))
+		return;
+
+	uint64_t head;
+	uint64_t nhead;
+	do {
+		head = desc->free_head;
+		desc->free_next[idx] = (unsigned)head;
+		nhead = (((head >> 32) + 1) << 32) | (idx + 1);
+	} while (!__sync_bool_compare_and_swap(&desc->free_head, head, nhead));
+}
+
+/*
+ * lane_free_pop -- (internal) takes the top lane from the stack of free lanes,
+ *	returns UINT_MAX if the stack is empty
  */
-static struct lane_layout *
-lane_get_layout(PMEMobjpool *pop, uint64_t lane_idx)
+static unsigned
+lane_free_pop(struct lane_descriptor *desc)
+{
+	uint64_t head;
+	uint64_t nhead;
+	unsigned idx;
+	do {
+		head = desc->free_head;
+		if ((unsigned)head == 0)
+			return UINT_MAX;
+
+		idx = (unsigned)head - 1;
+		/* the link may be stale, but then the counter won't match */
+		nhead = (((head >> 32) + 1) << 32) | desc->free_next[idx];
+	} while (!__sync_bool_compare_and_swap(&desc->free_head, head, nhead));
+
+	desc->free_next[idx] = LANE_NOT_STACKED;
+
+	return idx;
+}
+
+/*
+ * lane_get_section -- (internal) calculates the real pointer of the lane
+ *	section layout
+ */
+static struct lane_section_layout *
+lane_get_section(PMEMobjpool *pop, uint64_t lane_idx,
+	enum lane_section_type type)
 {
 	return (void *)((char *)pop + pop->lanes_offset +
-		sizeof(struct lane_layout) * lane_idx);
+		OBJ_LANE_SIZE(pop) * lane_idx +
+		OBJ_LANE_SECTION_LEN(pop) * type);
 }
 
 /*
  * lane_init -- (internal) initializes a single lane runtime variables
  */
 static int
-lane_init(PMEMobjpool *pop, struct lane *lane, struct lane_layout *layout)
+lane_init(PMEMobjpool *pop, struct lane *lane, uint64_t lane_idx)
 {
 	ASSERTne(lane, NULL);
 
@@ -179,7 +280,8 @@ lane_init(PMEMobjpool *pop, struct lane *lane, struct lane_layout *layout)
 	int oerrno;
 
 	for (i = 0; i < MAX_LANE_SECTION; ++i) {
-		lane->sections[i].layout = &layout->sections[i];
+		lane->sections[i].layout = lane_get_section(pop, lane_idx,
+			(enum lane_section_type)i);
 		errno = 0;
 		lane->sections[i].runtime = Section_ops[i]->construct_rt(pop);
 		if (lane->sections[i].runtime == NULL && errno) {
@@ -231,15 +333,32 @@ lane_boot(PMEMobjpool *pop)
 		goto error_locks_malloc;
 	}
 
+	pop->lanes_desc.free_next =
+		Malloc(sizeof(*pop->lanes_desc.free_next) * pop->nlanes);
+	if (pop->lanes_desc.free_next == NULL) {
+		ERR("!Malloc for free lanes stack");
+		goto error_free_next_malloc;
+	}
+
+	/* initially all of the lanes available at runtime are free */
+	pop->lanes_desc.free_head = 0;
+	for (unsigned l = 0; l < pop->nlanes; ++l)
+		pop->lanes_desc.free_next[l] = LANE_NOT_STACKED;
+	for (unsigned l = pop->lanes_desc.runtime_nlanes; l > 0; --l)
+		lane_free_push(&pop->lanes_desc, l - 1);
+
+	pop->lanes_desc.slow_acquirers = 0;
+	pop->lanes_desc.waiters = 0;
+	pop->lanes_desc.free_seq = 0;
+	pop->lanes_desc.info_slot = lane_info_slot_alloc();
+
 	/* add lanes to pmemcheck ignored list */
 	VALGRIND_ADD_TO_GLOBAL_TX_IGNORE((char *)pop + pop->lanes_offset,
-		(sizeof(struct lane_layout) * pop->nlanes));
+		OBJ_LANE_SIZE(pop) * pop->nlanes);
 
 	uint64_t i;
 	for (i = 0; i < pop->nlanes; ++i) {
-		struct lane_layout *layout = lane_get_layout(pop, i);
-
-		if ((err = lane_init(pop, &pop->lanes_desc.lane[i], layout))) {
+		if ((err = lane_init(pop, &pop->lanes_desc.lane[i], i))) {
 			ERR("!lane_init");
 			goto error_lane_init;
 		}
@@ -250,6 +369,10 @@ lane_boot(PMEMobjpool *pop)
 error_lane_init:
 	for (; i >= 1; --i)
 		lane_destroy(pop, &pop->lanes_desc.lane[i - 1]);
+	lane_info_slot_free(pop->lanes_desc.info_slot);
+	Free(pop->lanes_desc.free_next);
+	pop->lanes_desc.free_next = NULL;
+error_free_next_malloc:
 	Free(pop->lanes_desc.lane_locks);
 	pop->lanes_desc.lane_locks = NULL;
 error_locks_malloc:
@@ -272,8 +395,12 @@ lane_cleanup(PMEMobjpool *pop)
 	pop->lanes_desc.lane = NULL;
 	Free(pop->lanes_desc.lane_locks);
 	pop->lanes_desc.lane_locks = NULL;
+	Free(pop->lanes_desc.free_next);
+	pop->lanes_desc.free_next = NULL;
 
 	lane_info_cleanup(pop);
+	lane_info_slot_free(pop->lanes_desc.info_slot);
+	pop->lanes_desc.info_slot = LANE_INFO_SLOTS;
 }
 
 /*
@@ -285,13 +412,14 @@ lane_recover_and_section_boot(PMEMobjpool *pop)
 	int err = 0;
 	int i; /* section index */
 	uint64_t j; /* lane index */
-	struct lane_layout *layout;
+	struct lane_section_layout *layout;
+	unsigned len = (unsigned)OBJ_LANE_SECTION_LEN(pop);
 
 	for (i = 0; i < MAX_LANE_SECTION; ++i) {
 		for (j = 0; j < pop->nlanes; ++j) {
-			layout = lane_get_layout(pop, j);
-			err = Section_ops[i]->recover(pop, &layout->sections[i],
-				sizeof(layout->sections[i]));
+			layout = lane_get_section(pop, j,
+				(enum lane_section_type)i);
+			err = Section_ops[i]->recover(pop, layout, len);
 
 			if (err != 0) {
 				LOG(2, "section_ops->recover %d %ju %d",
@@ -309,6 +437,26 @@ lane_recover_and_section_boot(PMEMobjpool *pop)
 	return err;
 }
 
+/*
+ * lane_section_boot -- boots all lane sections without recovering the lanes
+ *
+ * Only valid for a pool that was cleanly closed, all of the lanes are idle.
+ */
+int
+lane_section_boot(PMEMobjpool *pop)
+{
+	int err = 0;
+
+	for (int i = 0; i < MAX_LANE_SECTION; ++i) {
+		if ((err = Section_ops[i]->boot(pop)) != 0) {
+			LOG(2, "section_ops->init %d %d", i, err);
+			return err;
+		}
+	}
+
+	return err;
+}
+
 /*
  * lane_check -- performs check of all lanes
  */
@@ -318,13 +466,14 @@ lane_check(PMEMobjpool *pop)
 	int err = 0;
 	int i; /* section index */
 	uint64_t j; /* lane index */
-	struct lane_layout *layout;
+	struct lane_section_layout *layout;
+	unsigned len = (unsigned)OBJ_LANE_SECTION_LEN(pop);
 
 	for (i = 0; i < MAX_LANE_SECTION; ++i) {
 		for (j = 0; j < pop->nlanes; ++j) {
-			layout = lane_get_layout(pop, j);
-			err = Section_ops[i]->check(pop, &layout->sections[i],
-					sizeof(layout->sections[i]));
+			layout = lane_get_section(pop, j,
+				(enum lane_section_type)i);
+			err = Section_ops[i]->check(pop, layout, len);
 
 			if (err) {
 				LOG(2, "section_ops->check %d %ju %d",
@@ -339,23 +488,97 @@ lane_check(PMEMobjpool *pop)
 }
 
 /*
- * get_lane -- (internal) get free lane index
+ * lane_wait -- (internal) sleeps until the futex word changes its value
+ */
+static void
+lane_wait(int *seq, int val)
+{
+#ifdef __linux__
+	syscall(SYS_futex, seq, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+#else
+	sched_yield();
+#endif
+}
+
+/*
+ * lane_wake -- (internal) wakes up one of the threads sleeping on the futex
+ *	word
+ */
+static void
+lane_wake(int *seq)
+{
+	__sync_fetch_and_add(seq, 1);
+#ifdef __linux__
+	syscall(SYS_futex, seq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#endif
+}
+
+/*
+ * get_free_lane -- (internal) tries to grab any free lane, first from the
+ *	stack of released lanes and then by scanning all of them
+ */
+static int
+get_free_lane(struct lane_descriptor *desc, uint64_t *index)
+{
+	uint64_t *locks = desc->lane_locks;
+	unsigned nlocks = desc->runtime_nlanes;
+
+	unsigned idx;
+	while ((idx = lane_free_pop(desc)) != UINT_MAX) {
+		if (idx < nlocks &&
+		    __sync_bool_compare_and_swap(&locks[idx], 0, 1)) {
+			*index = idx;
+			return 1;
+		}
+	}
+
+	uint64_t start = *index;
+	for (uint64_t i = 0; i < nlocks; ++i) {
+		idx = (unsigned)((start + i) % nlocks);
+		if (locks[idx] == 0 &&
+		    __sync_bool_compare_and_swap(&locks[idx], 0, 1)) {
+			*index = idx;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * get_lane -- (internal) get free lane index, the thread's previous lane is
+ *	preferred
  */
 static inline void
-get_lane(uint64_t *locks, uint64_t *index, uint64_t nlocks)
+get_lane(struct lane_descriptor *desc, uint64_t *index)
 {
-	while (1) {
-		do {
-			*index %= nlocks;
-			if (likely(__sync_bool_compare_and_swap(
-					&locks[*index], 0, 1)))
-				return;
+	*index %= desc->runtime_nlanes;
+	if (likely(__sync_bool_compare_and_swap(
+			&desc->lane_locks[*index], 0, 1)))
+		return;
+
+	__sync_fetch_and_add(&desc->slow_acquirers, 1);
+
+	while (!get_free_lane(desc, index)) {
+		/*
+		 * All lanes are taken. The waiter is registered before the
+		 * final check, so that a concurrent release either leaves
+		 * a free lane to be found or changes the futex word.
+		 */
+		int seq = desc->free_seq;
+		__sync_fetch_and_add(&desc->waiters, 1);
 
-			++(*index);
-		} while (*index < nlocks);
+		int found = get_free_lane(desc, index);
+		if (!found)
+			lane_wait(&desc->free_seq, seq);
 
-		sched_yield();
+		__sync_fetch_and_sub(&desc->waiters, 1);
+
+		if (found)
+			break;
 	}
+
+	__sync_fetch_and_sub(&desc->slow_acquirers, 1);
 }
 
 /*
@@ -365,7 +588,12 @@ get_lane(uint64_t *locks, uint64_t *index, uint64_t nlocks)
 static inline struct lane_info *
 get_lane_info_record(PMEMobjpool *pop)
 {
-	if (likely(Lane_info_cache != NULL &&
+	unsigned slot = pop->lanes_desc.info_slot;
+	if (likely(slot < LANE_INFO_SLOTS)) {
+		struct lane_info *info = Lane_info_slots[slot];
+		if (likely(info != NULL && info->pop_uuid_lo == pop->uuid_lo))
+			return info;
+	} else if (likely(Lane_info_cache != NULL &&
 			Lane_info_cache->pop_uuid_lo == pop->uuid_lo)) {
 		return Lane_info_cache;
 	}
@@ -397,12 +625,16 @@ get_lane_info_record(PMEMobjpool *pop)
 		}
 	}
 
-	Lane_info_cache = info;
+	if (slot < LANE_INFO_SLOTS)
+		Lane_info_slots[slot] = info;
+	else
+		Lane_info_cache = info;
+
 	return info;
 }
 
 /*
- * lane_hold -- grabs a per-thread lane in a round-robin fashion
+ * lane_hold -- grabs a per-thread lane, the previously used one if possible
  */
 unsigned
 lane_hold(PMEMobjpool *pop, struct lane_section **section,
@@ -429,11 +661,9 @@ lane_hold(PMEMobjpool *pop, struct lane_section **section,
 			&pop->lanes_desc.next_lane_idx, LANE_JUMP);
 	} /* handles wraparound */
 
-	uint64_t *llocks = pop->lanes_desc.lane_locks;
 	/* grab next free lane from lanes available at runtime */
 	if (!lane->nest_count++)
-		get_lane(llocks, &lane->lane_idx,
-			pop->lanes_desc.runtime_nlanes);
+		get_lane(&pop->lanes_desc, &lane->lane_idx);
 
 	if (section) {
 		ASSERT(type < MAX_LANE_SECTION);
@@ -463,10 +693,21 @@ lane_release(PMEMobjpool *pop)
 	if (unlikely(lane->nest_count == 0)) {
 		FATAL("lane_release");
 	} else if (--(lane->nest_count) == 0) {
+		struct lane_descriptor *desc = &pop->lanes_desc;
 		if (unlikely(!__sync_bool_compare_and_swap(
-				&pop->lanes_desc.lane_locks[lane->lane_idx],
+				&desc->lane_locks[lane->lane_idx],
 				1, 0))) {
 			FATAL("__sync_bool_compare_and_swap");
 		}
+
+		/*
+		 * The lane is going to be reused by this thread, unless some
+		 * other threads are out of their lanes.
+		 */
+		if (unlikely(desc->slow_acquirers != 0)) {
+			lane_free_push(desc, (unsigned)lane->lane_idx);
+			if (desc->waiters != 0)
+				lane_wake(&desc->free_seq);
+		}
 	}
 }
@@ -37,15 +37,25 @@
 #ifndef LIBPMEMOBJ_LANE_H
 #define LIBPMEMOBJ_LANE_H 1
 
+#include <limits.h>
 #include <stdint.h>
 
 #include "libpmemobj.h"
 #include "redo.h"
 
+/*
+ * Default and minimal length of a lane section. The length can be changed
+ * at pool creation time, but it must be a multiple of LANE_SECTION_ALIGN.
+ */
 #define LANE_SECTION_LEN 1024
+#define LANE_SECTION_LEN_MAX (64 * 1024)
+#define LANE_SECTION_ALIGN 64
+
+/* number of entries in the redo log of a list section of given length */
+#define LANE_REDO_NUM_ENTRIES(len) \
+	(((len) - 2 * sizeof(uint64_t)) / sizeof(struct redo_log))
 
-#define REDO_NUM_ENTRIES \
-	((LANE_SECTION_LEN - 2 * sizeof(uint64_t)) / sizeof(struct redo_log))
+#define REDO_NUM_ENTRIES LANE_REDO_NUM_ENTRIES(LANE_SECTION_LEN)
 
 /*
  * Distance between lanes used by threads required to prevent threads from
@@ -56,6 +66,8 @@
 
 #define RLANE_DEFAULT 0
 
+#define LANE_NOT_STACKED UINT_MAX
+
 enum lane_section_type {
 	LANE_SECTION_ALLOCATOR,
 	LANE_SECTION_LIST,
@@ -77,6 +89,10 @@ struct lane_section {
 	void *runtime;
 };
 
+/*
+ * Layout of a lane with sections of the default length, lanes of pools
+ * with longer sections are accessed through lane_get_layout.
+ */
 struct lane_layout {
 	struct lane_section_layout sections[MAX_LANE_SECTION];
 };
@@ -96,6 +112,22 @@ struct lane_descriptor {
 	unsigned next_lane_idx;
 	uint64_t *lane_locks;
 	struct lane *lane;
+
+	/*
+	 * Lock-free stack of lanes which were released while other threads
+	 * were looking for a free lane. The head contains the ABA counter in
+	 * the upper 32 bits and the index of the top lane + 1 in the lower
+	 * ones, free_next[i] is the index + 1 of the lane below lane i or
+	 * LANE_NOT_STACKED.
+	 */
+	uint64_t free_head;
+	unsigned *free_next;
+
+	unsigned slow_acquirers; /* threads whose own lane was busy */
+	unsigned waiters; /* threads sleeping until a lane is released */
+	int free_seq; /* futex word, bumped on release if there are waiters */
+
+	unsigned info_slot; /* index of the per-thread lane info slot */
 };
 
 typedef int (*section_layout_op)(PMEMobjpool *pop, void *data, unsigned length);
@@ -126,6 +158,7 @@ void lane_info_destroy(void);
 int lane_boot(PMEMobjpool *pop);
 void lane_cleanup(PMEMobjpool *pop);
 int lane_recover_and_section_boot(PMEMobjpool *pop);
+int lane_section_boot(PMEMobjpool *pop);
 int lane_check(PMEMobjpool *pop);
 
 unsigned lane_hold(PMEMobjpool *pop, struct lane_section **section,
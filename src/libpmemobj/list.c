@@ -42,6 +42,14 @@
 #define PREV_OFF (offsetof(struct list_entry, pe_prev) + offsetof(PMEMoid, off))
 #define NEXT_OFF (offsetof(struct list_entry, pe_next) + offsetof(PMEMoid, off))
 
+/*
+ * The maximum number of redo log entries used by a single element of a batch
+ * of inserts, removals or moves respectively.
+ */
+#define LIST_INSERT_MAX_ENTRIES	6
+#define LIST_REMOVE_MAX_ENTRIES	6
+#define LIST_MOVE_MAX_ENTRIES	10
+
 /*
  * list_args_common -- common arguments for operations on list
  *
@@ -98,6 +106,29 @@ struct list_args_remove {
 	struct list_entry *entry_ptr;
 };
 
+/*
+ * list_get_value -- (internal) returns the current value of the list field
+ *
+ * The stores which are already in the redo log but not processed yet take
+ * precedence over the value in the pool, this allows a batch of operations
+ * on the same list to share a single redo log.
+ */
+static uint64_t
+list_get_value(PMEMobjpool *pop, struct redo_log *redo, size_t redo_index,
+	const uint64_t *ptr)
+{
+	if (redo_index == 0)
+		return *ptr;
+
+	uint64_t off = OBJ_PTR_TO_OFF(pop, ptr);
+	for (size_t i = redo_index; i > 0; --i) {
+		if (redo_log_offset(&redo[i - 1]) == off)
+			return redo[i - 1].value;
+	}
+
+	return *ptr;
+}
+
 /*
  * list_mutexes_lock -- (internal) grab one or two locks in ascending
  * address order
@@ -160,19 +191,28 @@ list_mutexes_unlock(PMEMobjpool *pop,
  * If the input dest is OID_NULL and before is no set returns last element.
  */
 static inline PMEMoid
-list_get_dest(PMEMobjpool *pop, struct list_head *head, PMEMoid dest,
+list_get_dest(PMEMobjpool *pop, struct redo_log *redo, size_t redo_index,
+		struct list_head *head, PMEMoid dest,
 		ssize_t pe_offset, int before)
 {
 	if (dest.off)
 		return dest;
 
-	if (head->pe_first.off == 0 || !!before == POBJ_LIST_DEST_HEAD)
-		return head->pe_first;
+	uint64_t first = list_get_value(pop, redo, redo_index,
+			&head->pe_first.off);
+	if (first == 0 || !!before == POBJ_LIST_DEST_HEAD) {
+		dest.pool_uuid_lo = first ? pop->uuid_lo : 0;
+		dest.off = first;
+		return dest;
+	}
 
 	struct list_entry *first_ptr = (struct list_entry *)OBJ_OFF_TO_PTR(pop,
-			(uintptr_t)((ssize_t)head->pe_first.off + pe_offset));
+			(uintptr_t)((ssize_t)first + pe_offset));
 
-	return first_ptr->pe_prev;
+	dest.pool_uuid_lo = pop->uuid_lo;
+	dest.off = list_get_value(pop, redo, redo_index,
+			&first_ptr->pe_prev.off);
+	return dest;
 }
 
 /*
@@ -218,7 +258,8 @@ list_update_head(PMEMobjpool *pop,
 	redo_log_store(pop->redo, redo, redo_index + 0,
 			pe_first_off_off, first_offset);
 
-	if (head->pe_first.pool_uuid_lo == 0) {
+	if (list_get_value(pop, redo, redo_index,
+			&head->pe_first.pool_uuid_lo) == 0) {
 		uint64_t pe_first_uuid_off = OBJ_PTR_TO_OFF(pop,
 				&head->pe_first.pool_uuid_lo);
 
@@ -331,18 +372,23 @@ list_remove_single(PMEMobjpool *pop,
 {
 	LOG(15, NULL);
 
-	if (args->entry_ptr->pe_next.off == args->obj_doffset) {
+	uint64_t first_off = list_get_value(pop, redo, redo_index,
+			&args->head->pe_first.off);
+	uint64_t next_off = list_get_value(pop, redo, redo_index,
+			&args->entry_ptr->pe_next.off);
+	uint64_t prev_off = list_get_value(pop, redo, redo_index,
+			&args->entry_ptr->pe_prev.off);
+
+	if (next_off == args->obj_doffset) {
 		/* only one element on list */
-		ASSERTeq(args->head->pe_first.off, args->obj_doffset);
-		ASSERTeq(args->entry_ptr->pe_prev.off, args->obj_doffset);
+		ASSERTeq(first_off, args->obj_doffset);
+		ASSERTeq(prev_off, args->obj_doffset);
 
 		return list_update_head(pop, redo, redo_index, args->head, 0);
 	} else {
 		/* set next->prev = prev and prev->next = next */
-		uint64_t next_off = args->entry_ptr->pe_next.off;
 		uint64_t next_prev_off = next_off + PREV_OFF;
 		u64_add_offset(&next_prev_off, args->pe_offset);
-		uint64_t prev_off = args->entry_ptr->pe_prev.off;
 		uint64_t prev_next_off = prev_off + NEXT_OFF;
 		u64_add_offset(&prev_next_off, args->pe_offset);
 
@@ -352,7 +398,7 @@ list_remove_single(PMEMobjpool *pop,
 				prev_next_off, next_off);
 		redo_index += 2;
 
-		if (args->head->pe_first.off == args->obj_doffset) {
+		if (first_off == args->obj_doffset) {
 			/* removing element is the first one */
 			return list_update_head(pop, redo, redo_index,
 					args->head, next_off);
@@ -375,13 +421,13 @@ list_insert_before(PMEMobjpool *pop,
 
 	/* current->next = dest and current->prev = dest->prev */
 	*next_offset = args->dest.off;
-	*prev_offset = args->dest_entry_ptr->pe_prev.off;
+	*prev_offset = list_get_value(pop, redo, redo_index,
+			&args->dest_entry_ptr->pe_prev.off);
 
 	/* dest->prev = current and dest->prev->next = current */
 	uint64_t dest_prev_off = args->dest.off + PREV_OFF;
 	u64_add_offset(&dest_prev_off, args_common->pe_offset);
-	uint64_t dest_prev_next_off = args->dest_entry_ptr->pe_prev.off +
-					NEXT_OFF;
+	uint64_t dest_prev_next_off = *prev_offset + NEXT_OFF;
 	u64_add_offset(&dest_prev_next_off, args_common->pe_offset);
 
 	redo_log_store(pop->redo, redo, redo_index + 0,
@@ -404,14 +450,14 @@ list_insert_after(PMEMobjpool *pop,
 	LOG(15, NULL);
 
 	/* current->next = dest->next and current->prev = dest */
-	*next_offset = args->dest_entry_ptr->pe_next.off;
+	*next_offset = list_get_value(pop, redo, redo_index,
+			&args->dest_entry_ptr->pe_next.off);
 	*prev_offset = args->dest.off;
 
 	/* dest->next = current and dest->next->prev = current */
 	uint64_t dest_next_off = args->dest.off + NEXT_OFF;
 	u64_add_offset(&dest_next_off, args_common->pe_offset);
-	uint64_t dest_next_prev_off = args->dest_entry_ptr->pe_next.off +
-					PREV_OFF;
+	uint64_t dest_next_prev_off = *next_offset + PREV_OFF;
 	u64_add_offset(&dest_next_prev_off, args_common->pe_offset);
 
 	redo_log_store(pop->redo, redo, redo_index + 0,
@@ -432,9 +478,12 @@ list_insert_user(PMEMobjpool *pop,
 	uint64_t *next_offset, uint64_t *prev_offset)
 {
 	LOG(15, NULL);
+	uint64_t first_off = list_get_value(pop, redo, redo_index,
+			&args->head->pe_first.off);
+
 	if (args->dest.off == 0) {
 		/* inserting the first element on list */
-		ASSERTeq(args->head->pe_first.off, 0);
+		ASSERTeq(first_off, 0);
 
 		/* set loop on current element */
 		*next_offset = args_common->obj_doffset;
@@ -451,7 +500,7 @@ list_insert_user(PMEMobjpool *pop,
 				redo, redo_index, args, args_common,
 				next_offset, prev_offset);
 
-			if (args->dest.off == args->head->pe_first.off) {
+			if (args->dest.off == first_off) {
 				/* current element at first position */
 				redo_index = list_update_head(pop,
 					redo, redo_index, args->head,
@@ -505,7 +554,7 @@ list_insert_new(PMEMobjpool *pop,
 	ASSERTne(lane_section->layout, NULL);
 
 	/* increase allocation size by oob header size */
-	size += OBJ_OOB_SIZE;
+	size += OBJ_OOB_OFF(pop);
 	struct lane_list_layout *section =
 		(struct lane_list_layout *)lane_section->layout;
 	struct redo_log *redo = section->redo;
@@ -531,7 +580,7 @@ list_insert_new(PMEMobjpool *pop,
 
 	ASSERT((ssize_t)pe_offset >= 0);
 
-	dest = list_get_dest(pop, user_head, dest,
+	dest = list_get_dest(pop, redo, redo_index, user_head, dest,
 		(ssize_t)pe_offset, before);
 
 	struct list_entry *entry_ptr =
@@ -580,7 +629,8 @@ list_insert_new(PMEMobjpool *pop,
 	/* clear the obj_offset in lane section */
 	redo_log_store_last(pop->redo, redo, redo_index, sec_off_off, 0);
 
-	redo_log_process(pop->redo, redo, REDO_NUM_ENTRIES);
+	redo_log_process(pop->redo, redo,
+		LANE_REDO_NUM_ENTRIES(OBJ_LANE_SECTION_LEN(pop)));
 
 	ret = 0;
 
@@ -625,44 +675,35 @@ list_insert_new_user(PMEMobjpool *pop,
 }
 
 /*
- * list_insert -- insert object to a single list
- *
- * pop          - pmemobj handle
- * pe_offset    - offset to list entry on user list relative to user data
- * head         - list head
- * dest         - destination object ID
- * before       - before/after destination
- * oid          - target object ID
+ * list_redo_process -- (internal) processes the stores collected in the redo
+ *	log of the list section, returns the new index in the redo log
  */
-int
-list_insert(PMEMobjpool *pop,
-	ssize_t pe_offset, struct list_head *head,
-	PMEMoid dest, int before,
-	PMEMoid oid)
+static size_t
+list_redo_process(PMEMobjpool *pop, struct redo_log *redo, size_t redo_index)
 {
-	LOG(3, NULL);
-	ASSERTne(head, NULL);
-
-	int ret;
-
-	struct lane_section *lane_section;
-
-	lane_hold(pop, &lane_section, LANE_SECTION_LIST);
+	if (redo_index == 0)
+		return 0;
 
-	if ((ret = pmemobj_mutex_lock(pop, &head->lock))) {
-		LOG(2, "pmemobj_mutex_lock failed");
-		goto err;
-	}
+	redo_log_set_last(pop->redo, redo, redo_index - 1);
 
-	ASSERTne(lane_section, NULL);
-	ASSERTne(lane_section->layout, NULL);
+	redo_log_process(pop->redo, redo,
+		LANE_REDO_NUM_ENTRIES(OBJ_LANE_SECTION_LEN(pop)));
 
-	struct lane_list_layout *section =
-		(struct lane_list_layout *)lane_section->layout;
-	struct redo_log *redo = section->redo;
-	size_t redo_index = 0;
+	return 0;
+}
 
-	dest = list_get_dest(pop, head, dest, pe_offset, before);
+/*
+ * list_insert_one -- (internal) fill the redo log with the stores inserting
+ *	an object to a single list
+ */
+static size_t
+list_insert_one(PMEMobjpool *pop,
+	struct redo_log *redo, size_t redo_index,
+	ssize_t pe_offset, struct list_head *head,
+	PMEMoid dest, int before, PMEMoid oid)
+{
+	dest = list_get_dest(pop, redo, redo_index, head, dest,
+		pe_offset, before);
 
 	struct list_entry *entry_ptr =
 		(struct list_entry *)OBJ_OFF_TO_PTR(pop,
@@ -693,12 +734,68 @@ list_insert(PMEMobjpool *pop,
 			&args, &args_common, &next_offset, &prev_offset);
 
 	/* fill entry of existing element using redo log */
-	redo_index = list_fill_entry_redo_log(pop, redo, redo_index,
+	return list_fill_entry_redo_log(pop, redo, redo_index,
 			&args_common, next_offset, prev_offset, 1);
+}
 
-	redo_log_set_last(pop->redo, redo, redo_index - 1);
+/*
+ * list_insert_batch -- insert objects to a single list
+ *
+ * The first object is inserted at the destination and each of the following
+ * ones right after its predecessor, so the objects end up on the list in the
+ * order of the array. Each object is inserted atomically and as many of them
+ * as fit in the redo log of the lane are inserted in a single step.
+ *
+ * pop          - pmemobj handle
+ * pe_offset    - offset to list entry on user list relative to user data
+ * head         - list head
+ * dest         - destination object ID
+ * before       - before/after destination
+ * oids         - target object IDs
+ * noids        - number of target objects
+ */
+int
+list_insert_batch(PMEMobjpool *pop,
+	ssize_t pe_offset, struct list_head *head,
+	PMEMoid dest, int before,
+	const PMEMoid *oids, size_t noids)
+{
+	LOG(3, NULL);
+	ASSERTne(head, NULL);
+
+	int ret;
+
+	struct lane_section *lane_section;
 
-	redo_log_process(pop->redo, redo, REDO_NUM_ENTRIES);
+	lane_hold(pop, &lane_section, LANE_SECTION_LIST);
+
+	if ((ret = pmemobj_mutex_lock(pop, &head->lock))) {
+		LOG(2, "pmemobj_mutex_lock failed");
+		goto err;
+	}
+
+	ASSERTne(lane_section, NULL);
+	ASSERTne(lane_section->layout, NULL);
+
+	struct lane_list_layout *section =
+		(struct lane_list_layout *)lane_section->layout;
+	struct redo_log *redo = section->redo;
+	size_t redo_index = 0;
+	size_t nentries = LANE_REDO_NUM_ENTRIES(OBJ_LANE_SECTION_LEN(pop));
+
+	for (size_t i = 0; i < noids; ++i) {
+		if (redo_index + LIST_INSERT_MAX_ENTRIES > nentries)
+			redo_index = list_redo_process(pop, redo, redo_index);
+
+		redo_index = list_insert_one(pop, redo, redo_index,
+				pe_offset, head, dest, before, oids[i]);
+
+		/* the next object goes right after this one */
+		dest = oids[i];
+		before = POBJ_LIST_DEST_TAIL;
+	}
+
+	list_redo_process(pop, redo, redo_index);
 
 	pmemobj_mutex_unlock_nofail(pop, &head->lock);
 err:
@@ -707,6 +804,27 @@ err:
 	return ret;
 }
 
+/*
+ * list_insert -- insert object to a single list
+ *
+ * pop          - pmemobj handle
+ * pe_offset    - offset to list entry on user list relative to user data
+ * head         - list head
+ * dest         - destination object ID
+ * before       - before/after destination
+ * oid          - target object ID
+ */
+int
+list_insert(PMEMobjpool *pop,
+	ssize_t pe_offset, struct list_head *head,
+	PMEMoid dest, int before,
+	PMEMoid oid)
+{
+	LOG(3, NULL);
+
+	return list_insert_batch(pop, pe_offset, head, dest, before, &oid, 1);
+}
+
 /*
  * list_remove_free -- remove from two lists and free an object
  *
@@ -715,8 +833,11 @@ err:
  * pe_offset   - offset to list entry on user list relative to user data
  * user_head   - user list head, *must* be locked if not NULL
  * oidp        - pointer to target object ID
+ *
+ * If the object cannot be freed once it has been removed from the list,
+ * -1 is returned and errno is set, the object stays allocated.
  */
-static void
+static int
 list_remove_free(PMEMobjpool *pop, size_t pe_offset,
 	struct list_head *user_head, PMEMoid *oidp)
 {
@@ -769,15 +890,20 @@ list_remove_free(PMEMobjpool *pop, size_t pe_offset,
 	redo_log_store_last(pop->redo, redo, redo_index, sec_off_off,
 			obj_doffset);
 
-	redo_log_process(pop->redo, redo, REDO_NUM_ENTRIES);
+	redo_log_process(pop->redo, redo,
+		LANE_REDO_NUM_ENTRIES(OBJ_LANE_SECTION_LEN(pop)));
 
 	/*
 	 * Don't need to fill next and prev offsets of removing element
 	 * because the element is freed.
 	 */
-	pfree(pop, &section->obj_offset);
+	int ret = pfree(pop, &section->obj_offset);
+	if (ret)
+		ERR("!pfree");
 
 	lane_release(pop);
+
+	return ret;
 }
 
 /*
@@ -801,48 +927,57 @@ list_remove_free_user(PMEMobjpool *pop, size_t pe_offset,
 		return ret;
 	}
 
-	list_remove_free(pop, pe_offset, user_head, oidp);
+	ret = list_remove_free(pop, pe_offset, user_head, oidp);
 
 	pmemobj_mutex_unlock_nofail(pop, &user_head->lock);
 
-	return 0;
+	return ret;
 }
 
 /*
- * list_remove -- remove object from list
+ * list_remove_free_batch -- remove objects from a list and free them
  *
- * pop          - pmemobj handle
- * pe_offset    - offset to list entry on user list relative to user data
- * head         - list head
- * oid          - target object ID
+ * Each object is removed and freed in a separate fail-safe step, but all of
+ * them under a single acquisition of the list lock. The function stops at
+ * the first object which cannot be freed.
+ *
+ * pop         - pmemobj pool handle
+ * pe_offset   - offset to list entry on user list relative to user data
+ * user_head   - user list head
+ * oids        - target object IDs
+ * noids       - number of target objects
  */
 int
-list_remove(PMEMobjpool *pop,
-	ssize_t pe_offset, struct list_head *head,
-	PMEMoid oid)
+list_remove_free_batch(PMEMobjpool *pop, size_t pe_offset,
+	struct list_head *user_head, const PMEMoid *oids, size_t noids)
 {
 	LOG(3, NULL);
-	ASSERTne(head, NULL);
 
 	int ret;
-
-	struct lane_section *lane_section;
-
-	lane_hold(pop, &lane_section, LANE_SECTION_LIST);
-
-	ASSERTne(lane_section, NULL);
-	ASSERTne(lane_section->layout, NULL);
-
-	if ((ret = pmemobj_mutex_lock(pop, &head->lock))) {
+	if ((ret = pmemobj_mutex_lock(pop, &user_head->lock))) {
 		LOG(2, "pmemobj_mutex_lock failed");
-		goto err;
+		return ret;
 	}
 
-	struct lane_list_layout *section =
-		(struct lane_list_layout *)lane_section->layout;
-	struct redo_log *redo = section->redo;
-	size_t redo_index = 0;
+	for (size_t i = 0; i < noids && ret == 0; ++i) {
+		PMEMoid oid = oids[i];
+		ret = list_remove_free(pop, pe_offset, user_head, &oid);
+	}
+
+	pmemobj_mutex_unlock_nofail(pop, &user_head->lock);
 
+	return ret;
+}
+
+/*
+ * list_remove_one -- (internal) fill the redo log with the stores removing
+ *	an object from a list
+ */
+static size_t
+list_remove_one(PMEMobjpool *pop,
+	struct redo_log *redo, size_t redo_index,
+	ssize_t pe_offset, struct list_head *head, PMEMoid oid)
+{
 	struct list_entry *entry_ptr =
 		(struct list_entry *)OBJ_OFF_TO_PTR(pop,
 				oid.off + (size_t)pe_offset);
@@ -864,41 +999,29 @@ list_remove(PMEMobjpool *pop,
 	redo_index = list_remove_single(pop, redo, redo_index, &args);
 
 	/* clear next and prev offsets in removing element using redo log */
-	redo_index = list_fill_entry_redo_log(pop, redo, redo_index,
+	return list_fill_entry_redo_log(pop, redo, redo_index,
 			&args_common, 0, 0, 0);
-
-	redo_log_set_last(pop->redo, redo, redo_index - 1);
-
-	redo_log_process(pop->redo, redo, REDO_NUM_ENTRIES);
-
-	pmemobj_mutex_unlock_nofail(pop, &head->lock);
-err:
-	lane_release(pop);
-
-	return ret;
 }
 
 /*
- * list_move -- move object between two lists
+ * list_remove_batch -- remove objects from a list
  *
- * pop           - pmemobj handle
- * pe_offset_old - offset to old list entry relative to user data
- * head_old      - old list head
- * pe_offset_new - offset to new list entry relative to user data
- * head_new      - new list head
- * dest          - destination object ID
- * before        - before/after destination
- * oid           - target object ID
+ * Each object is removed atomically and as many of them as fit in the redo
+ * log of the lane are removed in a single step.
+ *
+ * pop          - pmemobj handle
+ * pe_offset    - offset to list entry on user list relative to user data
+ * head         - list head
+ * oids         - target object IDs
+ * noids        - number of target objects
  */
 int
-list_move(PMEMobjpool *pop,
-	size_t pe_offset_old, struct list_head *head_old,
-	size_t pe_offset_new, struct list_head *head_new,
-	PMEMoid dest, int before, PMEMoid oid)
+list_remove_batch(PMEMobjpool *pop,
+	ssize_t pe_offset, struct list_head *head,
+	const PMEMoid *oids, size_t noids)
 {
 	LOG(3, NULL);
-	ASSERTne(head_old, NULL);
-	ASSERTne(head_new, NULL);
+	ASSERTne(head, NULL);
 
 	int ret;
 
@@ -909,13 +1032,8 @@ list_move(PMEMobjpool *pop,
 	ASSERTne(lane_section, NULL);
 	ASSERTne(lane_section->layout, NULL);
 
-	/*
-	 * Grab locks in specified order to avoid dead-locks.
-	 *
-	 * XXX performance improvement: initialize oob locks at pool opening
-	 */
-	if ((ret = list_mutexes_lock(pop, head_new, head_old))) {
-		LOG(2, "list_mutexes_lock failed");
+	if ((ret = pmemobj_mutex_lock(pop, &head->lock))) {
+		LOG(2, "pmemobj_mutex_lock failed");
 		goto err;
 	}
 
@@ -923,8 +1041,55 @@ list_move(PMEMobjpool *pop,
 		(struct lane_list_layout *)lane_section->layout;
 	struct redo_log *redo = section->redo;
 	size_t redo_index = 0;
+	size_t nentries = LANE_REDO_NUM_ENTRIES(OBJ_LANE_SECTION_LEN(pop));
+
+	for (size_t i = 0; i < noids; ++i) {
+		if (redo_index + LIST_REMOVE_MAX_ENTRIES > nentries)
+			redo_index = list_redo_process(pop, redo, redo_index);
+
+		redo_index = list_remove_one(pop, redo, redo_index,
+				pe_offset, head, oids[i]);
+	}
+
+	list_redo_process(pop, redo, redo_index);
 
-	dest = list_get_dest(pop, head_new, dest,
+	pmemobj_mutex_unlock_nofail(pop, &head->lock);
+err:
+	lane_release(pop);
+
+	return ret;
+}
+
+/*
+ * list_remove -- remove object from list
+ *
+ * pop          - pmemobj handle
+ * pe_offset    - offset to list entry on user list relative to user data
+ * head         - list head
+ * oid          - target object ID
+ */
+int
+list_remove(PMEMobjpool *pop,
+	ssize_t pe_offset, struct list_head *head,
+	PMEMoid oid)
+{
+	LOG(3, NULL);
+
+	return list_remove_batch(pop, pe_offset, head, &oid, 1);
+}
+
+/*
+ * list_move_one -- (internal) fill the redo log with the stores moving an
+ *	object between two lists
+ */
+static size_t
+list_move_one(PMEMobjpool *pop,
+	struct redo_log *redo, size_t redo_index,
+	size_t pe_offset_old, struct list_head *head_old,
+	size_t pe_offset_new, struct list_head *head_new,
+	PMEMoid dest, int before, PMEMoid oid)
+{
+	dest = list_get_dest(pop, redo, redo_index, head_new, dest,
 		(ssize_t)pe_offset_new, before);
 
 	struct list_entry *entry_ptr_old =
@@ -943,26 +1108,30 @@ list_move(PMEMobjpool *pop,
 		/* moving within the same list */
 
 		if (dest.off == oid.off)
-			goto unlock;
+			return redo_index;
 
-		if (before && dest_entry_ptr->pe_prev.off == oid.off) {
-			if (head_old->pe_first.off != dest.off)
-				goto unlock;
+		uint64_t first_off = list_get_value(pop, redo, redo_index,
+				&head_old->pe_first.off);
 
-			redo_index = list_update_head(pop, redo, redo_index,
-					head_old, oid.off);
+		if (before && list_get_value(pop, redo, redo_index,
+				&dest_entry_ptr->pe_prev.off) == oid.off) {
+			if (first_off != dest.off)
+				return redo_index;
 
-			goto redo_last;
+			return list_update_head(pop, redo, redo_index,
+					head_old, oid.off);
 		}
 
-		if (!before && dest_entry_ptr->pe_next.off == oid.off) {
-			if (head_old->pe_first.off != oid.off)
-				goto unlock;
+		if (!before && list_get_value(pop, redo, redo_index,
+				&dest_entry_ptr->pe_next.off) == oid.off) {
+			if (first_off != oid.off)
+				return redo_index;
 
-			redo_index = list_update_head(pop, redo, redo_index,
-					head_old, entry_ptr_old->pe_next.off);
+			uint64_t next_off = list_get_value(pop, redo,
+				redo_index, &entry_ptr_old->pe_next.off);
 
-			goto redo_last;
+			return list_update_head(pop, redo, redo_index,
+					head_old, next_off);
 		}
 	}
 
@@ -1002,15 +1171,79 @@ list_move(PMEMobjpool *pop,
 	int set_uuid = pe_offset_new != pe_offset_old ? 1 : 0;
 
 	/* fill next and prev offsets of moving element using redo log */
-	redo_index = list_fill_entry_redo_log(pop, redo, redo_index,
+	return list_fill_entry_redo_log(pop, redo, redo_index,
 			&args_common, next_offset, prev_offset, set_uuid);
+}
 
-redo_last:
-	redo_log_set_last(pop->redo, redo, redo_index - 1);
+/*
+ * list_move_batch -- move objects between two lists
+ *
+ * The first object is moved to the destination and each of the following
+ * ones right after its predecessor, so the objects end up on the new list in
+ * the order of the array. Each object is moved atomically and as many of them
+ * as fit in the redo log of the lane are moved in a single step.
+ *
+ * pop           - pmemobj handle
+ * pe_offset_old - offset to old list entry relative to user data
+ * head_old      - old list head
+ * pe_offset_new - offset to new list entry relative to user data
+ * head_new      - new list head
+ * dest          - destination object ID
+ * before        - before/after destination
+ * oids          - target object IDs
+ * noids         - number of target objects
+ */
+int
+list_move_batch(PMEMobjpool *pop,
+	size_t pe_offset_old, struct list_head *head_old,
+	size_t pe_offset_new, struct list_head *head_new,
+	PMEMoid dest, int before, const PMEMoid *oids, size_t noids)
+{
+	LOG(3, NULL);
+	ASSERTne(head_old, NULL);
+	ASSERTne(head_new, NULL);
+
+	int ret;
+
+	struct lane_section *lane_section;
+
+	lane_hold(pop, &lane_section, LANE_SECTION_LIST);
+
+	ASSERTne(lane_section, NULL);
+	ASSERTne(lane_section->layout, NULL);
+
+	/*
+	 * Grab locks in specified order to avoid dead-locks.
+	 *
+	 * XXX performance improvement: initialize oob locks at pool opening
+	 */
+	if ((ret = list_mutexes_lock(pop, head_new, head_old))) {
+		LOG(2, "list_mutexes_lock failed");
+		goto err;
+	}
+
+	struct lane_list_layout *section =
+		(struct lane_list_layout *)lane_section->layout;
+	struct redo_log *redo = section->redo;
+	size_t redo_index = 0;
+	size_t nentries = LANE_REDO_NUM_ENTRIES(OBJ_LANE_SECTION_LEN(pop));
+
+	for (size_t i = 0; i < noids; ++i) {
+		if (redo_index + LIST_MOVE_MAX_ENTRIES > nentries)
+			redo_index = list_redo_process(pop, redo, redo_index);
+
+		redo_index = list_move_one(pop, redo, redo_index,
+				pe_offset_old, head_old,
+				pe_offset_new, head_new,
+				dest, before, oids[i]);
 
-	redo_log_process(pop->redo, redo, REDO_NUM_ENTRIES);
+		/* the next object goes right after this one */
+		dest = oids[i];
+		before = POBJ_LIST_DEST_TAIL;
+	}
+
+	list_redo_process(pop, redo, redo_index);
 
-unlock:
 	list_mutexes_unlock(pop, head_new, head_old);
 err:
 	lane_release(pop);
@@ -1018,6 +1251,30 @@ err:
 	return ret;
 }
 
+/*
+ * list_move -- move object between two lists
+ *
+ * pop           - pmemobj handle
+ * pe_offset_old - offset to old list entry relative to user data
+ * head_old      - old list head
+ * pe_offset_new - offset to new list entry relative to user data
+ * head_new      - new list head
+ * dest          - destination object ID
+ * before        - before/after destination
+ * oid           - target object ID
+ */
+int
+list_move(PMEMobjpool *pop,
+	size_t pe_offset_old, struct list_head *head_old,
+	size_t pe_offset_new, struct list_head *head_new,
+	PMEMoid dest, int before, PMEMoid oid)
+{
+	LOG(3, NULL);
+
+	return list_move_batch(pop, pe_offset_old, head_old,
+			pe_offset_new, head_new, dest, before, &oid, 1);
+}
+
 /*
  * lane_list_recovery -- (internal) recover the list section of the lane
  */
@@ -1029,11 +1286,13 @@ lane_list_recovery(PMEMobjpool *pop, void *data, unsigned length)
 	struct lane_list_layout *section = data;
 	ASSERT(sizeof(*section) <= length);
 
-	redo_log_recover(pop->redo, section->redo, REDO_NUM_ENTRIES);
+	redo_log_recover(pop->redo, section->redo,
+		LANE_REDO_NUM_ENTRIES(length));
 
 	if (section->obj_offset) {
 		/* alloc or free recovery */
-		pfree(pop, &section->obj_offset);
+		if (pfree(pop, &section->obj_offset) != 0)
+			return errno;
 	}
 
 	return 0;
@@ -1051,7 +1310,7 @@ lane_list_check(PMEMobjpool *pop, void *data, unsigned length)
 
 	int ret = 0;
 	if ((ret = redo_log_check(pop->redo,
-			section->redo, REDO_NUM_ENTRIES)) != 0) {
+			section->redo, LANE_REDO_NUM_ENTRIES(length))) != 0) {
 		ERR("list lane: redo log check failed");
 
 		return ret;
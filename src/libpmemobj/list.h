@@ -75,19 +75,36 @@ int list_insert(PMEMobjpool *pop,
 	ssize_t pe_offset, struct list_head *head, PMEMoid dest, int before,
 	PMEMoid oid);
 
+int list_insert_batch(PMEMobjpool *pop,
+	ssize_t pe_offset, struct list_head *head, PMEMoid dest, int before,
+	const PMEMoid *oids, size_t noids);
+
 int list_remove_free_user(PMEMobjpool *pop,
 	size_t pe_offset, struct list_head *user_head,
 	PMEMoid *oidp);
 
+int list_remove_free_batch(PMEMobjpool *pop,
+	size_t pe_offset, struct list_head *user_head,
+	const PMEMoid *oids, size_t noids);
+
 int list_remove(PMEMobjpool *pop,
 	ssize_t pe_offset, struct list_head *head,
 	PMEMoid oid);
 
+int list_remove_batch(PMEMobjpool *pop,
+	ssize_t pe_offset, struct list_head *head,
+	const PMEMoid *oids, size_t noids);
+
 int list_move(PMEMobjpool *pop,
 	size_t pe_offset_old, struct list_head *head_old,
 	size_t pe_offset_new, struct list_head *head_new,
 	PMEMoid dest, int before, PMEMoid oid);
 
+int list_move_batch(PMEMobjpool *pop,
+	size_t pe_offset_old, struct list_head *head_old,
+	size_t pe_offset_new, struct list_head *head_new,
+	PMEMoid dest, int before, const PMEMoid *oids, size_t noids);
+
 void list_move_oob(PMEMobjpool *pop,
 	struct list_head *head_old, struct list_head *head_new,
 	PMEMoid oid);
@@ -41,29 +41,104 @@
  * a bit by completely omitting that whole machinery.
  *
  * The modifications are not visible until the context is processed.
+ *
+ * The number of entries is not limited - the context starts out with a small
+ * embedded array of entries which is replaced by a heap allocated one once
+ * the operation grows past it. Operations with more persistent entries than
+ * the provided redo log can hold are stored in the pool-wide extension redo
+ * log instead, so that they are still processed in a single fail-safe step.
+ *
+ * An operation which cannot be stored, either because the entries could not
+ * be allocated or because they do not fit in any of the redo logs, fails as
+ * a whole when it is processed and none of its modifications take effect.
  */
 
+#include <errno.h>
+#include <string.h>
+
 #include "memops.h"
 #include "out.h"
+#include "util.h"
 #include "valgrind_internal.h"
 
+/*
+ * operation_entries_init -- (internal) points the context at the embedded
+ *	arrays of entries
+ */
+static void
+operation_entries_init(struct operation_context *ctx)
+{
+	for (int i = 0; i < MAX_OPERATION_ENTRY_TYPE; ++i) {
+		ctx->nentries[i] = 0;
+		ctx->capacity[i] = OPERATION_EMBEDDED_ENTRIES;
+		ctx->entries[i] = ctx->embedded[i];
+	}
+	ctx->error = 0;
+}
+
+/*
+ * operation_entries_fini -- (internal) frees the arrays of entries and resets
+ *	the context, so that it can be reused
+ */
+static void
+operation_entries_fini(struct operation_context *ctx)
+{
+	for (int i = 0; i < MAX_OPERATION_ENTRY_TYPE; ++i) {
+		if (ctx->entries[i] != ctx->embedded[i])
+			Free(ctx->entries[i]);
+	}
+
+	operation_entries_init(ctx);
+}
+
 /*
  * operation_init -- initializes a new palloc operation
  */
 void
 operation_init(struct operation_context *ctx, const void *base,
-	const struct redo_ctx *redo_ctx, struct redo_log *redo)
+	const struct redo_ctx *redo_ctx, struct redo_log *redo,
+	size_t redo_nentries)
 {
 	ctx->base = base;
 	ctx->redo_ctx = redo_ctx;
 	ctx->redo = redo;
+	ctx->redo_nentries = redo_nentries;
 	if (redo_ctx)
 		ctx->p_ops = redo_get_pmem_ops(redo_ctx);
 	else
 		ctx->p_ops = NULL;
 
-	ctx->nentries[ENTRY_PERSISTENT] = 0;
-	ctx->nentries[ENTRY_TRANSIENT] = 0;
+	operation_entries_init(ctx);
+}
+
+/*
+ * operation_grow -- (internal) doubles the capacity of the entries array
+ */
+static int
+operation_grow(struct operation_context *ctx, enum operation_entry_type en_type)
+{
+	size_t capacity = ctx->capacity[en_type] * 2;
+	struct operation_entry *entries;
+
+	if (ctx->entries[en_type] == ctx->embedded[en_type]) {
+		entries = Malloc(capacity * sizeof(*entries));
+		if (entries != NULL)
+			memcpy(entries, ctx->embedded[en_type],
+				sizeof(ctx->embedded[en_type]));
+	} else {
+		entries = Realloc(ctx->entries[en_type],
+			capacity * sizeof(*entries));
+	}
+
+	if (entries == NULL) {
+		ERR("!cannot grow operation context");
+		return -1;
+	}
+
+	ctx->entries[en_type] = entries;
+	ctx->capacity[en_type] = capacity;
+
+	return 0;
 }
 
 /*
@@ -91,14 +166,14 @@ operation_perform(uint64_t *field, uint64_t value,
  * operation_add_typed_entry -- adds new entry to the current operation, if the
  *	same ptr address already exists and the operation type is set,
  *	the new value is not added and the function has no effect.
+ *
+ * If the entry cannot be added, the error is reported once the operation is
+ * processed.
  */
 void operation_add_typed_entry(struct operation_context *ctx,
 	void *ptr, uint64_t value,
 	enum operation_type type, enum operation_entry_type en_type)
 {
-	ASSERT(ctx->nentries[ENTRY_PERSISTENT] <= MAX_PERSITENT_ENTRIES);
-	ASSERT(ctx->nentries[ENTRY_TRANSIENT] <= MAX_TRANSIENT_ENTRIES);
-
 	/*
 	 * New entry to be added to the operations, all operations eventually
 	 * come down to a set operation regardless.
@@ -122,6 +197,15 @@ void operation_add_typed_entry(struct operation_context *ctx,
 		operation_perform(&en.value, value, type);
 	}
 
+	if (ctx->error != 0)
+		return;
+
+	if (ctx->nentries[en_type] == ctx->capacity[en_type] &&
+	    operation_grow(ctx, en_type) != 0) {
+		ctx->error = ENOMEM;
+		return;
+	}
+
 	ctx->entries[en_type][ctx->nentries[en_type]] = en;
 
 	ctx->nentries[en_type]++;
@@ -162,22 +246,27 @@ operation_add_entries(struct operation_context *ctx,
  * operation_process_persistent_redo -- (internal) process using redo
  */
 static void
-operation_process_persistent_redo(struct operation_context *ctx)
+operation_process_persistent_redo(struct operation_context *ctx,
+	struct redo_log *log)
 {
 	struct operation_entry *e;
 	const struct redo_ctx *redo = ctx->redo_ctx;
+	size_t nentries = ctx->nentries[ENTRY_PERSISTENT];
 
 	size_t i;
-	for (i = 0; i < ctx->nentries[ENTRY_PERSISTENT]; ++i) {
+	for (i = 0; i < nentries; ++i) {
 		e = &ctx->entries[ENTRY_PERSISTENT][i];
 
-		redo_log_store(redo, ctx->redo, i,
+		redo_log_store(redo, log, i,
 				(uintptr_t)e->ptr - (uintptr_t)ctx->base,
 				e->value);
 	}
 
-	redo_log_set_last(redo, ctx->redo, i - 1);
-	redo_log_process(redo, ctx->redo, i);
+	redo_log_set_last(redo, log, i - 1);
+	redo_log_process(redo, log, i);
+
+	if (log != ctx->redo)
+		redo_log_ext_release(redo);
 }
 
 /*
@@ -187,11 +276,36 @@ operation_process_persistent_redo(struct operation_context *ctx)
  * This is because the transient entries that reside on persistent memory might
  * require write to a location that is currently occupied by a valid persistent
  * state but becomes a transient state after operation is processed.
+ *
+ * Returns 0 on success. Otherwise none of the modifications are performed,
+ * -1 is returned and errno is set to ENOMEM if the entries could not be
+ * allocated or to EINVAL if they do not fit in the redo logs. The context is
+ * reset in either case.
  */
-void
+int
 operation_process(struct operation_context *ctx)
 {
 	struct operation_entry *e;
+	struct redo_log *log = ctx->redo;
+	size_t nentries = ctx->nentries[ENTRY_PERSISTENT];
+
+	if (ctx->error != 0) {
+		int oerrno = ctx->error;
+		operation_entries_fini(ctx);
+		errno = oerrno;
+		return -1;
+	}
+
+	if (nentries > 1 && nentries > ctx->redo_nentries) {
+		log = redo_log_ext_hold(ctx->redo_ctx, nentries);
+		if (log == NULL) {
+			ERR("operation of %zu entries does not fit in "
+				"the redo log", nentries);
+			operation_entries_fini(ctx);
+			errno = EINVAL;
+			return -1;
+		}
+	}
 
 	/*
 	 * If there's exactly one persistent entry there's no need to involve
@@ -209,7 +323,7 @@ operation_process(struct operation_context *ctx)
 
 		VALGRIND_REMOVE_FROM_TX(e->ptr, sizeof(uint64_t));
 	} else if (ctx->nentries[ENTRY_PERSISTENT] != 0) {
-		operation_process_persistent_redo(ctx);
+		operation_process_persistent_redo(ctx, log);
 	}
 
 	for (size_t i = 0; i < ctx->nentries[ENTRY_TRANSIENT]; ++i) {
@@ -222,4 +336,8 @@ operation_process(struct operation_context *ctx)
 		 */
 		VALGRIND_SET_CLEAN(e->ptr, sizeof(e->value));
 	}
+
+	operation_entries_fini(ctx);
+
+	return 0;
 }
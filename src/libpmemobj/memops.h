@@ -57,8 +57,8 @@ struct operation_entry {
 	enum operation_type type;
 };
 
-#define MAX_TRANSIENT_ENTRIES 10
-#define MAX_PERSITENT_ENTRIES 10
+/* number of entries of each type that fit in the context without allocation */
+#define OPERATION_EMBEDDED_ENTRIES 10
 
 enum operation_entry_type {
 	ENTRY_PERSISTENT,
@@ -75,15 +75,21 @@ struct operation_context {
 
 	const struct redo_ctx *redo_ctx;
 	struct redo_log *redo;
+	size_t redo_nentries; /* capacity of the redo log */
 	const struct pmem_ops *p_ops;
 
 	size_t nentries[MAX_OPERATION_ENTRY_TYPE];
+	size_t capacity[MAX_OPERATION_ENTRY_TYPE];
+	struct operation_entry *entries[MAX_OPERATION_ENTRY_TYPE];
+	int error; /* errno of an entry which could not be added, or 0 */
+
 	struct operation_entry
-		entries[MAX_OPERATION_ENTRY_TYPE][MAX_PERSITENT_ENTRIES];
+		embedded[MAX_OPERATION_ENTRY_TYPE][OPERATION_EMBEDDED_ENTRIES];
 };
 
 void operation_init(struct operation_context *ctx, const void *base,
-	const struct redo_ctx *redo_ctx, struct redo_log *redo);
+	const struct redo_ctx *redo_ctx, struct redo_log *redo,
+	size_t redo_nentries);
 void operation_add_entry(struct operation_context *ctx,
 	void *ptr, uint64_t value, enum operation_type type);
 void operation_add_typed_entry(struct operation_context *ctx,
@@ -91,6 +97,6 @@ void operation_add_typed_entry(struct operation_context *ctx,
 	enum operation_type type, enum operation_entry_type en_type);
 void operation_add_entries(struct operation_context *ctx,
 	struct operation_entry *entries, size_t nentries);
-void operation_process(struct operation_context *ctx);
+int operation_process(struct operation_context *ctx);
 
 #endif
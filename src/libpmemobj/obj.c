@@ -33,6 +33,7 @@
 /*
  * obj.c -- transactional object store implementation
  */
+#include <endian.h>
 #include <limits.h>
 
 #include "libpmem.h"
@@ -43,8 +44,11 @@
 #include "obj.h"
 
 #include "pmemops.h"
+#include "replicator.h"
 #include "set.h"
 #include "sync.h"
+#include "tx.h"
+#include "type_index.h"
 #include "valgrind_internal.h"
 
 static struct cuckoo *pools_ht; /* hash table used for searching by UUID */
@@ -58,6 +62,15 @@ __thread struct _pobj_pcache _pobj_cached_pool;
 
 #else /* _WIN32 */
 
+#define _POBJ_POOL_TABLE_SIZE 64
+
+struct _pobj_pool_slot {
+	uint64_t uuid_lo;
+	PMEMobjpool *pop;
+};
+
+extern struct _pobj_pool_slot _pobj_pools[_POBJ_POOL_TABLE_SIZE];
+
 /*
  * XXX - this is a temporary implementation
  *
@@ -87,7 +100,16 @@ _Cached_pool_key_alloc(void)
 void *
 pmemobj_direct(PMEMoid oid)
 {
-	if (oid.off == 0 || oid.pool_uuid_lo == 0)
+	if (oid.off == 0)
+		return NULL;
+
+	struct _pobj_pool_slot *slot =
+		&_pobj_pools[oid.pool_uuid_lo % _POBJ_POOL_TABLE_SIZE];
+
+	if (slot->uuid_lo == oid.pool_uuid_lo)
+		return (void *)((uintptr_t)slot->pop + oid.off);
+
+	if (oid.pool_uuid_lo == 0)
 		return NULL;
 
 	struct _pobj_pcache *pcache = pthread_getspecific(Cached_pool_key);
@@ -115,6 +137,57 @@ pmemobj_direct(PMEMoid oid)
 
 #endif /* _WIN32 */
 
+struct _pobj_pool_slot _pobj_pools[_POBJ_POOL_TABLE_SIZE];
+
+/* uuid_lo value of a not used pool table slot, it indexes the next slot */
+#define OBJ_POOL_SLOT_EMPTY(idx) ((uint64_t)(idx) + 1)
+
+/*
+ * obj_pool_table_init -- (internal) marks all slots of the pool table as empty
+ */
+static void
+obj_pool_table_init(void)
+{
+	for (unsigned i = 0; i < _POBJ_POOL_TABLE_SIZE; ++i) {
+		_pobj_pools[i].pop = NULL;
+		_pobj_pools[i].uuid_lo = OBJ_POOL_SLOT_EMPTY(i);
+	}
+}
+
+/*
+ * obj_pool_table_insert -- (internal) publishes the pool in the pool table,
+ *	if its slot is already taken the pool is looked up the slow way
+ */
+static void
+obj_pool_table_insert(PMEMobjpool *pop)
+{
+	struct _pobj_pool_slot *slot =
+		&_pobj_pools[pop->uuid_lo % _POBJ_POOL_TABLE_SIZE];
+
+	/* the barrier makes the handle visible before the uuid guarding it */
+	if (!__sync_bool_compare_and_swap(&slot->pop, NULL, pop))
+		return;
+
+	slot->uuid_lo = pop->uuid_lo;
+}
+
+/*
+ * obj_pool_table_remove -- (internal) removes the pool from the pool table
+ */
+static void
+obj_pool_table_remove(PMEMobjpool *pop)
+{
+	unsigned idx = (unsigned)(pop->uuid_lo % _POBJ_POOL_TABLE_SIZE);
+	struct _pobj_pool_slot *slot = &_pobj_pools[idx];
+
+	if (slot->pop != pop)
+		return;
+
+	slot->uuid_lo = OBJ_POOL_SLOT_EMPTY(idx);
+	__sync_synchronize();
+	slot->pop = NULL;
+}
+
 /*
  * User may decide to map all pools with MAP_PRIVATE flag using
  * PMEMOBJ_COW environment variable.
@@ -144,6 +217,8 @@ obj_init(void)
 	pthread_once(&Cached_pool_key_once, _Cached_pool_key_alloc);
 #endif
 
+	obj_pool_table_init();
+
 	pools_ht = cuckoo_new();
 	if (pools_ht == NULL)
 		FATAL("!cuckoo_new");
@@ -153,6 +228,8 @@ obj_init(void)
 		FATAL("!ctree_new");
 
 	lane_info_boot();
+	tx_params_boot();
+	palloc_params_boot();
 
 	util_remote_init();
 }
@@ -170,6 +247,7 @@ obj_fini(void)
 	cuckoo_delete(pools_ht);
 	ctree_delete(pools_tree);
 	lane_info_destroy();
+	tx_params_destroy();
 	util_remote_fini();
 }
 
@@ -336,13 +414,19 @@ obj_rep_memcpy_persist(void *ctx, void *dest, const void *src,
 	if (pop->has_remote_replicas)
 		lane = lane_hold(pop, NULL, LANE_ID);
 
+	uint64_t ticket = 0;
+	if (pop->replicator)
+		ticket = replicator_memcpy_persist(pop->replicator, dest, src,
+			len);
+
 	void *ret = pop->memcpy_persist_local(dest, src, len);
 
 	PMEMobjpool *rep = pop->replica;
 	while (rep) {
 		void *rdest = (char *)rep + (uintptr_t)dest - (uintptr_t)pop;
 		if (rep->rpp == NULL) {
-			rep->memcpy_persist_local(rdest, src, len);
+			if (pop->replicator == NULL)
+				rep->memcpy_persist_local(rdest, src, len);
 		} else {
 			if (rep->persist_remote(rep, rdest, len, lane) == NULL)
 				obj_handle_remote_persist_error(pop);
@@ -350,6 +434,9 @@ obj_rep_memcpy_persist(void *ctx, void *dest, const void *src,
 		rep = rep->replica;
 	}
 
+	if (pop->replicator)
+		replicator_wait(pop->replicator, ticket);
+
 	if (pop->has_remote_replicas)
 		lane_release(pop);
 
@@ -370,13 +457,19 @@ obj_rep_memset_persist(void *ctx, void *dest, int c, size_t len)
 	if (pop->has_remote_replicas)
 		lane = lane_hold(pop, NULL, LANE_ID);
 
+	uint64_t ticket = 0;
+	if (pop->replicator)
+		ticket = replicator_memset_persist(pop->replicator, dest, c,
+			len);
+
 	void *ret = pop->memset_persist_local(dest, c, len);
 
 	PMEMobjpool *rep = pop->replica;
 	while (rep) {
 		void *rdest = (char *)rep + (uintptr_t)dest - (uintptr_t)pop;
 		if (rep->rpp == NULL) {
-			rep->memset_persist_local(rdest, c, len);
+			if (pop->replicator == NULL)
+				rep->memset_persist_local(rdest, c, len);
 		} else {
 			if (rep->persist_remote(rep, rdest, len, lane) == NULL)
 				obj_handle_remote_persist_error(pop);
@@ -384,6 +477,9 @@ obj_rep_memset_persist(void *ctx, void *dest, int c, size_t len)
 		rep = rep->replica;
 	}
 
+	if (pop->replicator)
+		replicator_wait(pop->replicator, ticket);
+
 	if (pop->has_remote_replicas)
 		lane_release(pop);
 
@@ -404,13 +500,19 @@ obj_rep_persist(void *ctx, const void *addr, size_t len)
 	if (pop->has_remote_replicas)
 		lane = lane_hold(pop, NULL, LANE_ID);
 
+	uint64_t ticket = 0;
+	if (pop->replicator)
+		ticket = replicator_memcpy_persist(pop->replicator, addr, addr,
+			len);
+
 	pop->persist_local(addr, len);
 
 	PMEMobjpool *rep = pop->replica;
 	while (rep) {
 		void *raddr = (char *)rep + (uintptr_t)addr - (uintptr_t)pop;
 		if (rep->rpp == NULL) {
-			rep->memcpy_persist_local(raddr, addr, len);
+			if (pop->replicator == NULL)
+				rep->memcpy_persist_local(raddr, addr, len);
 		} else {
 			if (rep->persist_remote(rep, raddr, len, lane) == NULL)
 				obj_handle_remote_persist_error(pop);
@@ -418,12 +520,17 @@ obj_rep_persist(void *ctx, const void *addr, size_t len)
 		rep = rep->replica;
 	}
 
+	if (pop->replicator)
+		replicator_wait(pop->replicator, ticket);
+
 	if (pop->has_remote_replicas)
 		lane_release(pop);
 }
 
 /*
  * obj_rep_flush -- (internal) flush with replication
+ *
+ * The local replicas are not waited for until the drain.
  */
 static void
 obj_rep_flush(void *ctx, const void *addr, size_t len)
@@ -436,14 +543,19 @@ obj_rep_flush(void *ctx, const void *addr, size_t len)
 	if (pop->has_remote_replicas)
 		lane = lane_hold(pop, NULL, LANE_ID);
 
+	if (pop->replicator)
+		replicator_flush(pop->replicator, addr, len);
+
 	pop->flush_local(addr, len);
 
 	PMEMobjpool *rep = pop->replica;
 	while (rep) {
 		void *raddr = (char *)rep + (uintptr_t)addr - (uintptr_t)pop;
 		if (rep->rpp == NULL) {
-			memcpy(raddr, addr, len);
-			rep->flush_local(raddr, len);
+			if (pop->replicator == NULL) {
+				memcpy(raddr, addr, len);
+				rep->flush_local(raddr, len);
+			}
 		} else {
 			if (rep->persist_remote(rep, raddr, len, lane) == NULL)
 				obj_handle_remote_persist_error(pop);
@@ -466,6 +578,11 @@ obj_rep_drain(void *ctx)
 
 	pop->drain_local();
 
+	if (pop->replicator) {
+		replicator_drain(pop->replicator);
+		return;
+	}
+
 	PMEMobjpool *rep = pop->replica;
 	while (rep) {
 		if (rep->rpp == NULL)
@@ -474,6 +591,46 @@ obj_rep_drain(void *ctx)
 	}
 }
 
+/*
+ * obj_replicator_start -- (internal) starts the threads which update the local
+ *	replicas in parallel, the replicas are updated by the calling thread
+ *	one after another if that is not possible
+ */
+static void
+obj_replicator_start(PMEMobjpool *pop)
+{
+	LOG(3, "pop %p", pop);
+
+	ASSERTeq(pop->replicator, NULL);
+
+	for (PMEMobjpool *rep = pop->replica; rep != NULL; rep = rep->replica) {
+		if (rep->rpp != NULL)
+			continue;
+
+		pop->replicator = replicator_new(pop);
+		if (pop->replicator == NULL)
+			LOG(2, "!replicator_new");
+
+		return;
+	}
+}
+
+/*
+ * obj_replicator_stop -- (internal) completes all of the pending updates of
+ *	the local replicas and stops the replication threads
+ */
+static void
+obj_replicator_stop(PMEMobjpool *pop)
+{
+	LOG(3, "pop %p", pop);
+
+	if (pop->replicator == NULL)
+		return;
+
+	replicator_delete(pop->replicator);
+	pop->replicator = NULL;
+}
+
 #ifdef USE_VG_MEMCHECK
 /*
  * Arbitrary value. When there's more undefined regions than MAX_UNDEFS, it's
@@ -602,19 +759,123 @@ pmemobj_vg_boot(struct pmemobjpool *pop)
 
 #endif
 
+/*
+ * obj_ext_redo -- (internal) returns the extension redo log of the pool
+ */
+static inline struct redo_log *
+obj_ext_redo(PMEMobjpool *pop)
+{
+	return (struct redo_log *)((uintptr_t)pop + pop->ext_redo_offset);
+}
+
+/*
+ * obj_lanes_len -- (internal) returns the length of the lanes region,
+ *	including the extension redo log which directly follows the lanes
+ */
+static inline size_t
+obj_lanes_len(PMEMobjpool *pop)
+{
+	return pop->nlanes * OBJ_LANE_SIZE(pop) +
+		pop->ext_redo_nentries * sizeof(struct redo_log);
+}
+
+/*
+ * obj_clean_shutdown -- (internal) checks whether the pool was cleanly closed
+ *	by the previous run
+ *
+ * Must be called before the run_id is incremented.
+ */
+static int
+obj_clean_shutdown(PMEMobjpool *pop)
+{
+	return pop->clean_run_id != 0 && pop->clean_run_id == pop->run_id;
+}
+
+/*
+ * obj_lanes_idle -- (internal) checks whether there's no operation in progress
+ *	that would have to be recovered
+ */
+static int
+obj_lanes_idle(PMEMobjpool *pop)
+{
+	for (unsigned i = 0; i < pop->lanes_desc.runtime_nlanes; ++i)
+		if (pop->lanes_desc.lane_locks[i] != 0)
+			return 0;
+
+	return pop->ext_redo_nentries == 0 ||
+		redo_log_nflags(obj_ext_redo(pop), pop->ext_redo_nentries) == 0;
+}
+
+/*
+ * obj_clean_shutdown_mark -- (internal) stores the free space summary of the
+ *	heap and marks the pool as cleanly closed
+ *
+ * Incrementing the run_id on the next open invalidates the marker, so a crash
+ * of that run is always followed by a full recovery.
+ */
+static void
+obj_clean_shutdown_mark(PMEMobjpool *pop)
+{
+	if (!obj_lanes_idle(pop)) {
+		LOG(3, "pop %p operation in progress, recovery required", pop);
+		return;
+	}
+
+	pop->heap_summary_offset = palloc_summary_write(&pop->heap);
+	pmemops_persist(&pop->p_ops, &pop->heap_summary_offset,
+		sizeof(pop->heap_summary_offset));
+
+	pop->clean_run_id = pop->run_id;
+	pmemops_persist(&pop->p_ops, &pop->clean_run_id,
+		sizeof(pop->clean_run_id));
+}
+
+/*
+ * pmemobj_boot_clean -- (internal) boots a cleanly closed pmemobj pool
+ *
+ * None of the lanes can hold an unfinished operation, so the recovery is
+ * skipped and the volatile heap state is created from the persisted summary.
+ */
+static int
+pmemobj_boot_clean(PMEMobjpool *pop)
+{
+	if ((errno = lane_section_boot(pop)) != 0) {
+		ERR("!lane_section_boot");
+		return errno;
+	}
+
+	if (palloc_summary_load(&pop->heap, pop->heap_summary_offset) != 0)
+		LOG(3, "heap summary unavailable, zones processed on demand");
+
+	return 0;
+}
+
 /*
  * pmemobj_boot -- (internal) boots the pmemobj pool
  */
 static int
-pmemobj_boot(PMEMobjpool *pop)
+pmemobj_boot(PMEMobjpool *pop, int clean)
 {
-	LOG(3, "pop %p", pop);
+	LOG(3, "pop %p clean %d", pop, clean);
 
 	if ((errno = lane_boot(pop)) != 0) {
 		ERR("!lane_boot");
 		return errno;
 	}
 
+	if (clean)
+		return pmemobj_boot_clean(pop);
+
+	/*
+	 * The extension redo log is recovered before any of the lane
+	 * sections, the heap must not be booted before all of the pending
+	 * allocator operations are finished.
+	 */
+	if (pop->ext_redo_nentries != 0) {
+		redo_log_recover(pop->redo, obj_ext_redo(pop),
+			pop->ext_redo_nentries);
+	}
+
 	if ((errno = lane_recover_and_section_boot(pop)) != 0) {
 		ERR("!lane_recover_and_section_boot");
 		return errno;
@@ -627,9 +888,13 @@ pmemobj_boot(PMEMobjpool *pop)
  * pmemobj_descr_create -- (internal) create obj pool descriptor
  */
 static int
-pmemobj_descr_create(PMEMobjpool *pop, const char *layout, size_t poolsize)
+pmemobj_descr_create(PMEMobjpool *pop, const char *layout, size_t poolsize,
+	unsigned nlanes, size_t lane_section_len, size_t ext_redo_entries,
+	unsigned flags)
 {
-	LOG(3, "pop %p layout %s poolsize %zu", pop, layout, poolsize);
+	LOG(3, "pop %p layout %s poolsize %zu nlanes %u lane_section_len %zu "
+		"ext_redo_entries %zu flags 0x%x", pop, layout, poolsize,
+		nlanes, lane_section_len, ext_redo_entries, flags);
 
 	ASSERTeq(poolsize % Pagesize, 0);
 
@@ -645,22 +910,47 @@ pmemobj_descr_create(PMEMobjpool *pop, const char *layout, size_t poolsize)
 
 	/* initialize run_id, it will be incremented later */
 	pop->run_id = 0;
-	pmemops_persist(p_ops, &pop->run_id, sizeof(pop->run_id));
+	pop->clean_run_id = 0;
+	pop->heap_summary_offset = 0;
+	pmemops_persist(p_ops, &pop->run_id, sizeof(pop->run_id) +
+		sizeof(pop->clean_run_id) + sizeof(pop->heap_summary_offset));
 
 	pop->lanes_offset = OBJ_LANES_OFFSET;
-	pop->nlanes = OBJ_NLANES;
+	pop->nlanes = nlanes;
+	pop->lane_section_len = lane_section_len;
 	pop->root_offset = 0;
 
-	/* zero all lanes */
-	void *lanes_layout = (void *)((uintptr_t)pop + pop->lanes_offset);
-	pmemops_memset_persist(p_ops, lanes_layout, 0,
-				pop->nlanes * sizeof(struct lane_layout));
+	if (ext_redo_entries != 0) {
+		pop->ext_redo_offset = pop->lanes_offset +
+			pop->nlanes * OBJ_LANE_SIZE(pop);
+		pop->ext_redo_nentries = ext_redo_entries;
+	}
 
-	pop->heap_offset = pop->lanes_offset +
-		pop->nlanes * sizeof(struct lane_layout);
+	pop->heap_offset = pop->lanes_offset + obj_lanes_len(pop);
 	pop->heap_offset = (pop->heap_offset + Pagesize - 1) & ~(Pagesize - 1);
+	if (flags & POBJ_POOL_HUGE_ALIGNED) {
+		/*
+		 * The pool is mapped at a huge page aligned address, so the
+		 * heap is moved forward until its first chunk is aligned too.
+		 * The heap header and the zone header end up unaligned.
+		 */
+		uint64_t chunks = pop->heap_offset + HEAP_ZONE0_CHUNKS_OFFSET;
+		chunks = (chunks + OBJ_HUGE_PAGE_SIZE - 1) &
+			~(OBJ_HUGE_PAGE_SIZE - 1);
+		pop->heap_offset = chunks - HEAP_ZONE0_CHUNKS_OFFSET;
+	}
+	if (pop->heap_offset >= poolsize) {
+		ERR("pool too small for %u lanes of %zu bytes", nlanes,
+			(size_t)OBJ_LANE_SIZE(pop));
+		errno = EINVAL;
+		return -1;
+	}
 	pop->heap_size = poolsize - pop->heap_offset;
 
+	/* zero all lanes and the extension redo log */
+	void *lanes_layout = (void *)((uintptr_t)pop + pop->lanes_offset);
+	pmemops_memset_persist(p_ops, lanes_layout, 0, obj_lanes_len(pop));
+
 	/* initialize heap prior to storing the checksum */
 	errno = palloc_init((char *)pop + pop->heap_offset, pop->heap_size,
 			p_ops);
@@ -731,14 +1021,33 @@ pmemobj_descr_check(PMEMobjpool *pop, const char *layout, size_t poolsize)
 		return -1;
 	}
 
-	if (pop->heap_offset % Pagesize ||
-	    pop->heap_size % Pagesize) {
+	/* in huge aligned pools it's the first chunk that is aligned */
+	uint64_t aligned_off = pop->heap_offset;
+	uint64_t align = Pagesize;
+	if (le32toh(pop->hdr.incompat_features) & OBJ_INCOMPAT_HUGE_ALIGNED) {
+		aligned_off += HEAP_ZONE0_CHUNKS_OFFSET;
+		align = OBJ_HUGE_PAGE_SIZE;
+	}
+
+	if (aligned_off % align ||
+	    (pop->heap_offset + pop->heap_size) % Pagesize) {
 		ERR("unaligned heap: off %ju, size %zu",
 			pop->heap_offset, pop->heap_size);
 		errno = EINVAL;
 		return -1;
 	}
 
+	if (pop->ext_redo_nentries != 0 &&
+	    (pop->ext_redo_nentries > OBJ_EXT_REDO_NENTRIES_MAX ||
+	    pop->ext_redo_offset != pop->lanes_offset +
+			pop->nlanes * OBJ_LANE_SIZE(pop) ||
+	    pop->lanes_offset + obj_lanes_len(pop) > pop->heap_offset)) {
+		ERR("invalid extension redo log: off %ju, entries %ju",
+			pop->ext_redo_offset, pop->ext_redo_nentries);
+		errno = EINVAL;
+		return -1;
+	}
+
 	return 0;
 }
 
@@ -885,10 +1194,39 @@ pmemobj_replica_init(PMEMobjpool *rep, struct pool_set *set, unsigned repidx,
 	if (ret)
 		return ret;
 
-	rep->redo = redo_log_config_new(rep->addr, &rep->p_ops,
-			redo_log_check_offset, rep, REDO_NUM_ENTRIES);
-	if (!rep->redo)
-		return -1;
+	return 0;
+}
+
+/*
+ * pmemobj_replicas_redo_init -- (internal) creates redo log contexts of all
+ *	replicas, must be called once the pool descriptor is valid
+ */
+static int
+pmemobj_replicas_redo_init(PMEMobjpool *pop)
+{
+	size_t len = OBJ_LANE_SECTION_LEN(pop);
+	size_t list_entries = LANE_REDO_NUM_ENTRIES(len);
+	size_t alloc_entries = ALLOC_REDO_NUM_ENTRIES(len);
+	size_t nentries = list_entries > alloc_entries ?
+		list_entries : alloc_entries;
+	if (pop->ext_redo_nentries > nentries)
+		nentries = pop->ext_redo_nentries;
+
+	for (PMEMobjpool *rep = pop; rep != NULL; rep = rep->replica) {
+		rep->redo = redo_log_config_new(rep->addr, &rep->p_ops,
+				redo_log_check_offset, rep,
+				(unsigned)nentries);
+		if (!rep->redo)
+			return -1;
+
+		if (pop->replica != NULL)
+			redo_log_config_set_replicated(rep->redo);
+
+		if (pop->ext_redo_nentries != 0 &&
+		    redo_log_config_set_ext(rep->redo, obj_ext_redo(rep),
+				pop->ext_redo_nentries) != 0)
+			return -1;
+	}
 
 	return 0;
 }
@@ -897,9 +1235,10 @@ pmemobj_replica_init(PMEMobjpool *rep, struct pool_set *set, unsigned repidx,
  * pmemobj_runtime_init -- (internal) initialize runtime part of the pool header
  */
 static int
-pmemobj_runtime_init(PMEMobjpool *pop, int rdonly, int boot, unsigned nlanes)
+pmemobj_runtime_init(PMEMobjpool *pop, int rdonly, int boot, int clean,
+	unsigned nlanes)
 {
-	LOG(3, "pop %p rdonly %d boot %d", pop, rdonly, boot);
+	LOG(3, "pop %p rdonly %d boot %d clean %d", pop, rdonly, boot, clean);
 	struct pmem_ops *p_ops = &pop->p_ops;
 
 	/* run_id is made unique by incrementing the previous value */
@@ -917,12 +1256,32 @@ pmemobj_runtime_init(PMEMobjpool *pop, int rdonly, int boot, unsigned nlanes)
 
 	pop->uuid_lo = pmemobj_get_uuid_lo(pop);
 
-	pop->lanes_desc.runtime_nlanes = nlanes;
+	/* the runtime number of lanes cannot exceed the pool's one */
+	pop->lanes_desc.runtime_nlanes = nlanes < pop->nlanes ?
+		nlanes : (unsigned)pop->nlanes;
+
+	pop->tx_stats = NULL;
+	pop->tx_stats_enabled = 0;
+	pop->tx_max_cached_range = MAX_CACHED_RANGE_SIZE;
+	pop->tx_range_cache_slots = (le32toh(pop->hdr.incompat_features) &
+		OBJ_INCOMPAT_RANGE_CACHE_SLOTS) != 0;
+	pop->lock_max_spin = SYNC_MAX_SPIN_DEFAULT;
+	pop->lock_stats = NULL;
+	pop->lock_stats_enabled = 0;
+	pop->type_index = NULL;
+
+	/* the headers of the objects are known only from the pool header */
+	pop->heap.header_type = (le32toh(pop->hdr.incompat_features) &
+		OBJ_INCOMPAT_COMPACT_HEADERS) ? HEADER_COMPACT : HEADER_LEGACY;
+	pop->heap.aligned_allocs = (le32toh(pop->hdr.incompat_features) &
+		OBJ_INCOMPAT_ALIGNED_ALLOCS) != 0;
 
 	if (boot) {
-		if ((errno = pmemobj_boot(pop)) != 0)
+		if ((errno = pmemobj_boot(pop, clean)) != 0)
 			return -1;
 
+		palloc_format_start(&pop->heap);
+
 #ifdef USE_VG_MEMCHECK
 		if (On_valgrind) {
 			/* mark unused part of the pool as not accessible */
@@ -942,6 +1301,8 @@ pmemobj_runtime_init(PMEMobjpool *pop, int rdonly, int boot, unsigned nlanes)
 			ERR("!ctree_insert");
 			return -1;
 		}
+
+		obj_pool_table_insert(pop);
 	}
 
 	/*
@@ -973,14 +1334,15 @@ pmemobj_cleanup_remote(PMEMobjpool *pop)
 }
 
 /*
- * pmemobj_create -- create a transactional memory pool (set)
+ * pmemobj_create_attr -- create a transactional memory pool (set) with
+ *	non-default parameters
  */
 PMEMobjpool *
-pmemobj_create(const char *path, const char *layout, size_t poolsize,
-		mode_t mode)
+pmemobj_create_attr(const char *path, const char *layout, size_t poolsize,
+		mode_t mode, const struct pobj_pool_attr *attr)
 {
-	LOG(3, "path %s layout %s poolsize %zu mode %o",
-			path, layout, poolsize, mode);
+	LOG(3, "path %s layout %s poolsize %zu mode %o attr %p",
+			path, layout, poolsize, mode, attr);
 
 	PMEMobjpool *pop;
 	struct pool_set *set;
@@ -992,17 +1354,77 @@ pmemobj_create(const char *path, const char *layout, size_t poolsize,
 		return NULL;
 	}
 
+	unsigned nlanes = OBJ_NLANES;
+	size_t lane_section_len = LANE_SECTION_LEN;
+	size_t ext_redo_entries = 0;
+	unsigned flags = 0;
+	uint32_t incompat = OBJ_FORMAT_INCOMPAT;
+
+	if (attr != NULL) {
+		if (attr->nlanes != 0)
+			nlanes = attr->nlanes;
+		if (attr->lane_section_size != 0)
+			lane_section_len = attr->lane_section_size;
+		ext_redo_entries = attr->ext_redo_entries;
+		flags = attr->flags;
+	}
+
+	if ((flags & ~(POBJ_POOL_COMPACT_HEADERS |
+			POBJ_POOL_HUGE_ALIGNED)) != 0) {
+		ERR("invalid pool flags 0x%x", flags);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (nlanes > OBJ_NLANES_MAX) {
+		ERR("invalid number of lanes %u", nlanes);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (lane_section_len < LANE_SECTION_LEN ||
+	    lane_section_len > LANE_SECTION_LEN_MAX ||
+	    lane_section_len % LANE_SECTION_ALIGN != 0) {
+		ERR("invalid lane section size %zu", lane_section_len);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (ext_redo_entries > OBJ_EXT_REDO_NENTRIES_MAX) {
+		ERR("invalid number of extension redo log entries %zu",
+			ext_redo_entries);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	/* older versions of the library must not open such a pool */
+	if (nlanes != OBJ_NLANES || lane_section_len != LANE_SECTION_LEN)
+		incompat |= OBJ_INCOMPAT_LANES;
+	if (ext_redo_entries != 0)
+		incompat |= OBJ_INCOMPAT_EXT_REDO;
+	if (flags & POBJ_POOL_COMPACT_HEADERS)
+		incompat |= OBJ_INCOMPAT_COMPACT_HEADERS;
+	if (flags & POBJ_POOL_HUGE_ALIGNED)
+		incompat |= OBJ_INCOMPAT_HUGE_ALIGNED;
+
+	/* the size of the allocation headers includes the alignment padding */
+	incompat |= OBJ_INCOMPAT_ALIGNED_ALLOCS;
+	/* the range caches may contain snapshots spanning several slots */
+	incompat |= OBJ_INCOMPAT_RANGE_CACHE_SLOTS;
+	/* the zones not yet reached by the heap are left unformatted */
+	incompat |= OBJ_INCOMPAT_LAZY_ZONES;
+
 	/*
 	 * A number of lanes available at runtime equals the lowest value
 	 * from all reported by remote replicas hosts. In the single host mode
 	 * the runtime number of lanes is equal to the total number of lanes
 	 * available in the pool.
 	 */
-	unsigned runtime_nlanes = OBJ_NLANES;
+	unsigned runtime_nlanes = nlanes;
 
 	if (util_pool_create(&set, path, poolsize, PMEMOBJ_MIN_POOL,
 			OBJ_HDR_SIG, OBJ_FORMAT_MAJOR,
-			OBJ_FORMAT_COMPAT, OBJ_FORMAT_INCOMPAT,
+			OBJ_FORMAT_COMPAT, incompat,
 			OBJ_FORMAT_RO_COMPAT, &runtime_nlanes) != 0) {
 		LOG(2, "cannot create pool or pool set");
 		return NULL;
@@ -1040,14 +1462,22 @@ pmemobj_create(const char *path, const char *layout, size_t poolsize,
 
 	pop->set = set;
 
+	obj_replicator_start(pop);
+
 	/* create pool descriptor */
-	if (pmemobj_descr_create(pop, layout, set->poolsize) != 0) {
+	if (pmemobj_descr_create(pop, layout, set->poolsize, nlanes,
+			lane_section_len, ext_redo_entries, flags) != 0) {
 		LOG(2, "creation of pool descriptor failed");
 		goto err;
 	}
 
+	if (pmemobj_replicas_redo_init(pop) != 0) {
+		ERR("!redo_log_config_new");
+		goto err;
+	}
+
 	/* initialize runtime parts - lanes, obj stores, ... */
-	if (pmemobj_runtime_init(pop, 0, 1 /* boot */,
+	if (pmemobj_runtime_init(pop, 0, 1 /* boot */, 0 /* clean */,
 					runtime_nlanes) != 0) {
 		ERR("pool initialization failed");
 		goto err;
@@ -1063,6 +1493,7 @@ pmemobj_create(const char *path, const char *layout, size_t poolsize,
 err:
 	LOG(4, "error clean up");
 	int oerrno = errno;
+	obj_replicator_stop(pop);
 	if (set->remote)
 		pmemobj_cleanup_remote(pop);
 	util_poolset_close(set, 1);
@@ -1070,6 +1501,16 @@ err:
 	return NULL;
 }
 
+/*
+ * pmemobj_create -- create a transactional memory pool (set)
+ */
+PMEMobjpool *
+pmemobj_create(const char *path, const char *layout, size_t poolsize,
+		mode_t mode)
+{
+	return pmemobj_create_attr(path, layout, poolsize, mode, NULL);
+}
+
 /*
  * pmemobj_check_basic_local -- (internal) basic pool consistency check
  *                              of a local replica
@@ -1088,6 +1529,13 @@ pmemobj_check_basic_local(PMEMobjpool *pop)
 		consistent = 0;
 	}
 
+	if (pop->ext_redo_nentries != 0 &&
+	    (errno = redo_log_check(pop->redo, obj_ext_redo(pop),
+			pop->ext_redo_nentries)) != 0) {
+		LOG(2, "!redo_log_check");
+		consistent = 0;
+	}
+
 	if ((errno = lane_check(pop)) != 0) {
 		LOG(2, "!lane_check");
 		consistent = 0;
@@ -1205,7 +1653,7 @@ pmemobj_open_common(const char *path, const char *layout, int cow, int boot)
 
 	if (util_pool_open(&set, path, cow, PMEMOBJ_MIN_POOL,
 			OBJ_HDR_SIG, OBJ_FORMAT_MAJOR,
-			OBJ_FORMAT_COMPAT, OBJ_FORMAT_INCOMPAT,
+			OBJ_FORMAT_COMPAT, OBJ_FORMAT_INCOMPAT_SUPPORTED,
 			OBJ_FORMAT_RO_COMPAT, &runtime_nlanes) != 0) {
 		LOG(2, "cannot open pool or pool set");
 		return NULL;
@@ -1257,7 +1705,20 @@ pmemobj_open_common(const char *path, const char *layout, int cow, int boot)
 
 	pop->set = set;
 
-	if (boot) {
+	obj_replicator_start(pop);
+
+	if (pmemobj_replicas_redo_init(pop) != 0) {
+		ERR("!redo_log_config_new");
+		goto err;
+	}
+
+	/*
+	 * There's nothing to recover in a pool that was cleanly closed, only
+	 * the other replicas are verified.
+	 */
+	int clean = boot && obj_clean_shutdown(pop);
+
+	if (boot && !clean) {
 		/* check consistency of 'master' replica */
 		if (pmemobj_check_basic(pop) == 0) {
 			goto err;
@@ -1272,7 +1733,7 @@ pmemobj_open_common(const char *path, const char *layout, int cow, int boot)
 	 */
 	if (set->nreplicas > 1) {
 		PMEMobjpool *rep;
-		for (unsigned r = 0; r < set->nreplicas; r++) {
+		for (unsigned r = clean ? 1 : 0; r < set->nreplicas; r++) {
 			rep = set->replica[r]->part[0].addr;
 			if (pmemobj_check_basic(rep) == 0) {
 				ERR("inconsistent replica #%u", r);
@@ -1280,9 +1741,9 @@ pmemobj_open_common(const char *path, const char *layout, int cow, int boot)
 			}
 		}
 
-		/* copy lanes */
+		/* copy lanes along with the extension redo log */
 		void *src = (void *)((uintptr_t)pop + pop->lanes_offset);
-		size_t len = pop->nlanes * sizeof(struct lane_layout);
+		size_t len = obj_lanes_len(pop);
 
 		for (unsigned r = 1; r < set->nreplicas; r++) {
 			rep = set->replica[r]->part[0].addr;
@@ -1309,7 +1770,7 @@ pmemobj_open_common(const char *path, const char *layout, int cow, int boot)
 #endif
 
 	/* initialize runtime parts - lanes, obj stores, ... */
-	if (pmemobj_runtime_init(pop, 0, boot, runtime_nlanes) != 0) {
+	if (pmemobj_runtime_init(pop, 0, boot, clean, runtime_nlanes) != 0) {
 		ERR("pool initialization failed");
 		goto err;
 	}
@@ -1326,6 +1787,8 @@ pmemobj_open_common(const char *path, const char *layout, int cow, int boot)
 err:
 	LOG(4, "error clean up");
 	int oerrno = errno;
+	if (pop != NULL)
+		obj_replicator_stop(pop);
 	if (set->remote)
 		pmemobj_cleanup_remote(pop);
 	util_poolset_close(set, 0);
@@ -1382,6 +1845,14 @@ obj_pool_cleanup(PMEMobjpool *pop)
 
 	lane_cleanup(pop);
 
+	Free(pop->tx_stats);
+	pop->tx_stats = NULL;
+
+	sync_stats_cleanup(pop);
+	type_index_cleanup(pop);
+
+	obj_replicator_stop(pop);
+
 	/* unmap all the replicas */
 	obj_replicas_cleanup(pop->set);
 	util_poolset_close(pop->set, 0);
@@ -1395,6 +1866,8 @@ pmemobj_close(PMEMobjpool *pop)
 {
 	LOG(3, "pop %p", pop);
 
+	obj_pool_table_remove(pop);
+
 	_pobj_cache_invalidate++;
 
 	if (cuckoo_remove(pools_ht, pop->uuid_lo) != pop) {
@@ -1424,6 +1897,10 @@ pmemobj_close(PMEMobjpool *pop)
 
 #endif /* _WIN32 */
 
+	tx_post_commit_deferred_all(pop);
+
+	obj_clean_shutdown_mark(pop);
+
 	obj_pool_cleanup(pop);
 }
 
@@ -1448,7 +1925,7 @@ pmemobj_check(const char *path, const char *layout)
 	if (pop->replica == NULL)
 		consistent = pmemobj_check_basic(pop);
 
-	if (consistent && (errno = pmemobj_boot(pop)) != 0) {
+	if (consistent && (errno = pmemobj_boot(pop, 0)) != 0) {
 		LOG(3, "!pmemobj_boot");
 		consistent = 0;
 	}
@@ -1456,6 +1933,8 @@ pmemobj_check(const char *path, const char *layout)
 	if (consistent) {
 		obj_pool_cleanup(pop);
 	} else {
+		obj_replicator_stop(pop);
+
 		/* unmap all the replicas */
 		obj_replicas_cleanup(pop->set);
 		util_poolset_close(pop->set, 0);
@@ -1475,6 +1954,12 @@ pmemobj_pool_by_oid(PMEMoid oid)
 {
 	LOG(3, "oid.off 0x%016jx", oid.off);
 
+	struct _pobj_pool_slot *slot =
+		&_pobj_pools[oid.pool_uuid_lo % _POBJ_POOL_TABLE_SIZE];
+
+	if (slot->uuid_lo == oid.pool_uuid_lo)
+		return slot->pop;
+
 	return cuckoo_get(pools_ht, oid.pool_uuid_lo);
 }
 
@@ -1501,6 +1986,22 @@ pmemobj_pool_by_ptr(const void *addr)
 	return (PMEMobjpool *)key;
 }
 
+/*
+ * pmemobj_oid -- returns the object handle of the address
+ */
+PMEMoid
+pmemobj_oid(const void *addr)
+{
+	LOG(3, "addr %p", addr);
+
+	PMEMobjpool *pop = pmemobj_pool_by_ptr(addr);
+	if (pop == NULL)
+		return OID_NULL;
+
+	PMEMoid oid = {pop->uuid_lo, (uintptr_t)addr - (uintptr_t)pop};
+	return oid;
+}
+
 /* arguments for constructor_alloc_bytype */
 struct carg_bytype {
 	type_num_t user_type;
@@ -1522,13 +2023,9 @@ constructor_alloc_bytype(void *ctx, void *ptr, size_t usable_size, void *arg)
 	ASSERTne(ptr, NULL);
 	ASSERTne(arg, NULL);
 
-	struct oob_header *pobj = OOB_HEADER_FROM_PTR(ptr);
 	struct carg_bytype *carg = arg;
 
-	pobj->undo_entry_offset = 0;
-	pobj->type_num = carg->user_type;
-	pobj->size = 0;
-	memset(pobj->unused, 0, sizeof(pobj->unused));
+	obj_hdr_init(pop, ptr, 0, carg->user_type);
 
 	if (carg->zero_init)
 		pmemops_memset_persist(p_ops, ptr, 0, usable_size);
@@ -1545,7 +2042,7 @@ constructor_alloc_bytype(void *ctx, void *ptr, size_t usable_size, void *arg)
  */
 static int
 obj_alloc_construct(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
-	type_num_t type_num, int zero_init,
+	size_t alignment, type_num_t type_num, int zero_init,
 	pmemobj_constr constructor,
 	void *arg)
 {
@@ -1565,14 +2062,16 @@ obj_alloc_construct(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 	struct redo_log *redo = pmalloc_redo_hold(pop);
 
 	struct operation_context ctx;
-	operation_init(&ctx, pop, pop->redo, redo);
+	operation_init(&ctx, pop, pop->redo, redo,
+		pmalloc_redo_nentries(pop));
 
 	if (oidp)
 		operation_add_entry(&ctx, &oidp->pool_uuid_lo, pop->uuid_lo,
 				OPERATION_SET);
 
 	int ret = pmalloc_operation(&pop->heap, 0,
-			oidp != NULL ? &oidp->off : NULL, size + OBJ_OOB_SIZE,
+			oidp != NULL ? &oidp->off : NULL,
+			size + OBJ_OOB_OFF(pop), alignment,
 			constructor_alloc_bytype, &carg, &ctx);
 
 	pmalloc_redo_release(pop);
@@ -1600,7 +2099,45 @@ pmemobj_alloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 		return -1;
 	}
 
-	return obj_alloc_construct(pop, oidp, size, type_num,
+	return obj_alloc_construct(pop, oidp, size, 0, type_num,
+			0, constructor, arg);
+}
+
+/*
+ * pmemobj_alloc_aligned -- allocates a new object aligned to the given
+ *	boundary
+ */
+int
+pmemobj_alloc_aligned(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
+	size_t alignment, uint64_t type_num, pmemobj_constr constructor,
+	void *arg)
+{
+	LOG(3, "pop %p oidp %p size %zu alignment %zu type_num %llx "
+		"constructor %p arg %p", pop, oidp, size, alignment,
+		(unsigned long long)type_num, constructor, arg);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (size == 0) {
+		ERR("allocation with size 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!OBJ_ALIGNMENT_IS_VALID(alignment)) {
+		ERR("invalid alignment %zu", alignment);
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!OBJ_ALIGNMENT_IS_SUPPORTED(pop, alignment)) {
+		ERR("alignment %zu not supported by the pool", alignment);
+		errno = ENOTSUP;
+		return -1;
+	}
+
+	return obj_alloc_construct(pop, oidp, size, alignment, type_num,
 			0, constructor, arg);
 }
 
@@ -1634,7 +2171,7 @@ pmemobj_zalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 		return -1;
 	}
 
-	return obj_alloc_construct(pop, oidp, size, type_num,
+	return obj_alloc_construct(pop, oidp, size, 0, type_num,
 					1, NULL, NULL);
 }
 
@@ -1649,11 +2186,12 @@ obj_free(PMEMobjpool *pop, PMEMoid *oidp)
 	struct redo_log *redo = pmalloc_redo_hold(pop);
 
 	struct operation_context ctx;
-	operation_init(&ctx, pop, pop->redo, redo);
+	operation_init(&ctx, pop, pop->redo, redo,
+		pmalloc_redo_nentries(pop));
 
 	operation_add_entry(&ctx, &oidp->pool_uuid_lo, 0, OPERATION_SET);
 
-	pmalloc_operation(&pop->heap, oidp->off, &oidp->off, 0, NULL, NULL,
+	pmalloc_operation(&pop->heap, oidp->off, &oidp->off, 0, 0, NULL, NULL,
 			&ctx);
 
 	pmalloc_redo_release(pop);
@@ -1673,13 +2211,10 @@ constructor_realloc(void *ctx, void *ptr, size_t usable_size, void *arg)
 	ASSERTne(arg, NULL);
 
 	struct carg_realloc *carg = arg;
-	struct oob_header *pobj = OOB_HEADER_FROM_PTR(ptr);
 
-	if (ptr != carg->ptr) {
-		pobj->undo_entry_offset = 0;
-		pobj->type_num = carg->user_type;
-		pobj->size = 0;
-	}
+	/* the allocator rewrites compact headers, even of a resized object */
+	if (ptr != carg->ptr || pop->heap.header_type == HEADER_COMPACT)
+		obj_hdr_init(pop, ptr, 0, carg->user_type);
 
 	if (!carg->zero_init)
 		return 0;
@@ -1708,7 +2243,7 @@ obj_realloc_common(PMEMobjpool *pop,
 		if (size == 0)
 			return 0;
 
-		return obj_alloc_construct(pop, oidp, size, type_num,
+		return obj_alloc_construct(pop, oidp, size, 0, type_num,
 				zero_init, NULL, NULL);
 	}
 
@@ -1724,8 +2259,8 @@ obj_realloc_common(PMEMobjpool *pop,
 		return 0;
 	}
 
-	struct oob_header *pobj = OOB_HEADER_FROM_OID(pop, *oidp);
-	type_num_t user_type_old = pobj->type_num;
+	uint64_t *type_nump = obj_hdr_type_num(pop, oidp->off);
+	type_num_t user_type_old = *type_nump;
 
 	struct carg_realloc carg;
 	carg.ptr = OBJ_OFF_TO_PTR(pop, oidp->off);
@@ -1739,19 +2274,21 @@ obj_realloc_common(PMEMobjpool *pop,
 	struct redo_log *redo = pmalloc_redo_hold(pop);
 
 	struct operation_context ctx;
-	operation_init(&ctx, pop, pop->redo, redo);
+	operation_init(&ctx, pop, pop->redo, redo,
+		pmalloc_redo_nentries(pop));
 
 	int ret;
 	if (type_num == user_type_old) {
 		ret = pmalloc_operation(&pop->heap, oidp->off, &oidp->off,
-			size + OBJ_OOB_SIZE,
+			size + OBJ_OOB_OFF(pop), 0,
 			constructor_realloc, &carg, &ctx);
 	} else {
-		operation_add_entry(&ctx, &pobj->type_num, type_num,
+		operation_add_entry(&ctx, type_nump, type_num,
 				OPERATION_SET);
 
 		ret = pmalloc_operation(&pop->heap, oidp->off, &oidp->off,
-			size + OBJ_OOB_SIZE, constructor_realloc, &carg, &ctx);
+			size + OBJ_OOB_OFF(pop), 0, constructor_realloc, &carg,
+			&ctx);
 	}
 	pmalloc_redo_release(pop);
 
@@ -1772,22 +2309,19 @@ constructor_zrealloc_root(void *ctx, void *ptr, size_t usable_size, void *arg)
 
 	struct carg_realloc *carg = arg;
 
-	VALGRIND_ADD_TO_TX(OOB_HEADER_FROM_PTR(ptr),
-		usable_size + OBJ_OOB_SIZE);
-
-	struct oob_header *pobj = OOB_HEADER_FROM_PTR(ptr);
+	VALGRIND_ADD_TO_TX((char *)ptr - OBJ_OOB_OFF(pop),
+		usable_size + OBJ_OOB_OFF(pop));
 
 	constructor_realloc(pop, ptr, usable_size, arg);
-	if (ptr != carg->ptr) {
-		pobj->size = carg->new_size | OBJ_INTERNAL_OBJECT_MASK;
-	}
+	if (ptr != carg->ptr || pop->heap.header_type == HEADER_COMPACT)
+		obj_hdr_init(pop, ptr, 1, carg->new_size);
 
 	int ret = 0;
 	if (carg->constructor)
 		ret = carg->constructor(pop, ptr, carg->arg);
 
-	VALGRIND_REMOVE_FROM_TX(OOB_HEADER_FROM_PTR(ptr),
-		carg->new_size + OBJ_OOB_SIZE);
+	VALGRIND_REMOVE_FROM_TX((char *)ptr - OBJ_OOB_OFF(pop),
+		carg->new_size + OBJ_OOB_OFF(pop));
 
 	return ret;
 }
@@ -1876,7 +2410,7 @@ pmemobj_strdup(PMEMobjpool *pop, PMEMoid *oidp, const char *s,
 	carg.size = (strlen(s) + 1) * sizeof(char);
 	carg.s = s;
 
-	return obj_alloc_construct(pop, oidp, carg.size,
+	return obj_alloc_construct(pop, oidp, carg.size, 0,
 		(type_num_t)type_num, 0, constructor_strdup, &carg);
 }
 
@@ -1920,7 +2454,190 @@ pmemobj_alloc_usable_size(PMEMoid oid)
 	ASSERTne(pop, NULL);
 	ASSERT(OBJ_OID_IS_VALID(pop, oid));
 
-	return (palloc_usable_size(&pop->heap, oid.off) - OBJ_OOB_SIZE);
+	return (palloc_usable_size(&pop->heap, oid.off) - OBJ_OOB_OFF(pop));
+}
+
+/*
+ * constructor_region -- (internal) constructor for pmemobj_region_create
+ */
+static int
+constructor_region(PMEMobjpool *pop, void *ptr, void *arg)
+{
+	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
+
+	ASSERTne(ptr, NULL);
+	ASSERTne(arg, NULL);
+
+	struct obj_region *r = ptr;
+
+	r->capacity = *(size_t *)arg;
+	r->used = 0;
+	memset(r->unused, 0, sizeof(r->unused));
+
+	pmemops_persist(&pop->p_ops, r, sizeof(*r));
+
+	return 0;
+}
+
+/*
+ * pmemobj_region_create -- allocates a new region
+ */
+int
+pmemobj_region_create(PMEMobjpool *pop, PMEMoid *regionp, size_t size,
+	uint64_t type_num)
+{
+	LOG(3, "pop %p regionp %p size %zu type_num %llx",
+		pop, regionp, size, (unsigned long long)type_num);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (size == 0) {
+		ERR("region with size 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (size > PMEMOBJ_MAX_ALLOC_SIZE - sizeof(struct obj_region)) {
+		ERR("requested size too large");
+		errno = ENOMEM;
+		return -1;
+	}
+
+	return obj_alloc_construct(pop, regionp,
+		size + sizeof(struct obj_region), 0, (type_num_t)type_num, 0,
+		constructor_region, &size);
+}
+
+/*
+ * obj_region_alloc -- (internal) allocates an object from the region
+ *
+ * The object is constructed in the unused space of the region first, and
+ * becomes allocated once the new number of used bytes is persistent. If
+ * interrupted, the space is reclaimed together with the region.
+ */
+static int
+obj_region_alloc(PMEMoid region, PMEMoid *oidp, size_t size, int zero_init,
+	pmemobj_constr constructor, void *arg)
+{
+	if (size == 0) {
+		ERR("allocation with size 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMobjpool *pop = pmemobj_pool_by_oid(region);
+
+	ASSERTne(pop, NULL);
+	ASSERT(OBJ_OID_IS_VALID(pop, region));
+
+	struct obj_region *r = OBJ_OFF_TO_PTR(pop, region.off);
+	uint64_t avail = r->capacity - r->used;
+
+	if (size > avail || OBJ_REGION_ALLOC_SIZE(size) > avail) {
+		ERR("region exhausted");
+		errno = ENOMEM;
+		return -1;
+	}
+
+	uint64_t off = region.off + sizeof(*r) + r->used;
+	void *ptr = OBJ_OFF_TO_PTR(pop, off);
+
+	if (zero_init)
+		pmemops_memset_persist(&pop->p_ops, ptr, 0, size);
+
+	if (constructor != NULL && constructor(pop, ptr, arg) != 0) {
+		ERR("constructor failed");
+		errno = ECANCELED;
+		return -1;
+	}
+
+	r->used += OBJ_REGION_ALLOC_SIZE(size);
+	pmemops_persist(&pop->p_ops, &r->used, sizeof(r->used));
+
+	if (oidp == NULL)
+		return 0;
+
+	/*
+	 * The handle is not updated atomically, but the uuid of the pool
+	 * is written first, so an interrupted update can only leave behind
+	 * the previous offset.
+	 */
+	oidp->pool_uuid_lo = pop->uuid_lo;
+	if (OBJ_PTR_FROM_POOL(pop, oidp))
+		pmemops_persist(&pop->p_ops, &oidp->pool_uuid_lo,
+			sizeof(oidp->pool_uuid_lo));
+
+	oidp->off = off;
+	if (OBJ_PTR_FROM_POOL(pop, oidp))
+		pmemops_persist(&pop->p_ops, &oidp->off, sizeof(oidp->off));
+
+	return 0;
+}
+
+/*
+ * pmemobj_region_alloc -- allocates a new object from the region
+ */
+int
+pmemobj_region_alloc(PMEMoid region, PMEMoid *oidp, size_t size,
+	pmemobj_constr constructor, void *arg)
+{
+	LOG(3, "region.off 0x%016jx oidp %p size %zu constructor %p arg %p",
+		region.off, oidp, size, constructor, arg);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	return obj_region_alloc(region, oidp, size, 0, constructor, arg);
+}
+
+/*
+ * pmemobj_region_zalloc -- allocates a new zeroed object from the region
+ */
+int
+pmemobj_region_zalloc(PMEMoid region, PMEMoid *oidp, size_t size)
+{
+	LOG(3, "region.off 0x%016jx oidp %p size %zu", region.off, oidp, size);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	return obj_region_alloc(region, oidp, size, 1, NULL, NULL);
+}
+
+/*
+ * pmemobj_region_reset -- frees all of the objects allocated from the region
+ */
+void
+pmemobj_region_reset(PMEMoid region)
+{
+	LOG(3, "region.off 0x%016jx", region.off);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	PMEMobjpool *pop = pmemobj_pool_by_oid(region);
+
+	ASSERTne(pop, NULL);
+	ASSERT(OBJ_OID_IS_VALID(pop, region));
+
+	struct obj_region *r = OBJ_OFF_TO_PTR(pop, region.off);
+
+	r->used = 0;
+	pmemops_persist(&pop->p_ops, &r->used, sizeof(r->used));
+}
+
+/*
+ * pmemobj_region_free -- frees the region with all of its objects
+ */
+void
+pmemobj_region_free(PMEMoid *regionp)
+{
+	ASSERTne(regionp, NULL);
+
+	LOG(3, "region.off 0x%016jx", regionp->off);
+
+	pmemobj_free(regionp);
 }
 
 /*
@@ -1989,10 +2706,15 @@ pmemobj_type_num(PMEMoid oid)
 
 	ASSERT(!OID_IS_NULL(oid));
 
-	void *ptr = pmemobj_direct(oid);
+	PMEMobjpool *pop = pmemobj_pool_by_oid(oid);
+
+	ASSERTne(pop, NULL);
+
+	/* a compact header of the root object holds its size instead */
+	if (oid.off == pop->root_offset)
+		return POBJ_ROOT_TYPE_NUM;
 
-	struct oob_header *oobh = OOB_HEADER_FROM_PTR(ptr);
-	return oobh->type_num;
+	return *obj_hdr_type_num(pop, oid.off);
 }
 
 /* arguments for constructor_alloc_root */
@@ -2017,26 +2739,20 @@ constructor_alloc_root(void *ctx, void *ptr, size_t usable_size, void *arg)
 
 	int ret = 0;
 
-	struct oob_header *ro = OOB_HEADER_FROM_PTR(ptr);
 	struct carg_root *carg = arg;
+	void *hdr = (char *)ptr - OBJ_OOB_OFF(pop);
 
 	/* temporarily add atomic root allocation to pmemcheck transaction */
-	VALGRIND_ADD_TO_TX(ro, OBJ_OOB_SIZE + usable_size);
+	VALGRIND_ADD_TO_TX(hdr, OBJ_OOB_OFF(pop) + usable_size);
 
 	if (carg->constructor)
 		ret = carg->constructor(pop, ptr, carg->arg);
 	else
 		pmemops_memset_persist(p_ops, ptr, 0, usable_size);
 
-	ro->undo_entry_offset = 0;
-	ro->type_num = POBJ_ROOT_TYPE_NUM;
-	ro->size = carg->size | OBJ_INTERNAL_OBJECT_MASK;
+	obj_hdr_init(pop, ptr, 1, carg->size);
 
-	VALGRIND_REMOVE_FROM_TX(ro, OBJ_OOB_SIZE + usable_size);
-
-	pmemops_persist(p_ops, &ro->size,
-		/* there's no padding between these, so we can add sizes */
-		sizeof(ro->size) + sizeof(ro->type_num));
+	VALGRIND_REMOVE_FROM_TX(hdr, OBJ_OOB_OFF(pop) + usable_size);
 
 	return ret;
 }
@@ -2057,7 +2773,7 @@ obj_alloc_root(PMEMobjpool *pop, size_t size,
 	carg.arg = arg;
 
 	return pmalloc_construct(pop, &pop->root_offset,
-		size + OBJ_OOB_SIZE, constructor_alloc_root, &carg);
+		size + OBJ_OOB_OFF(pop), constructor_alloc_root, &carg);
 }
 
 /*
@@ -2083,10 +2799,11 @@ obj_realloc_root(PMEMobjpool *pop, size_t size,
 	struct redo_log *redo = pmalloc_redo_hold(pop);
 
 	struct operation_context ctx;
-	operation_init(&ctx, pop, pop->redo, redo);
+	operation_init(&ctx, pop, pop->redo, redo,
+		pmalloc_redo_nentries(pop));
 
 	int ret = pmalloc_operation(&pop->heap, pop->root_offset,
-			&pop->root_offset, size + OBJ_OOB_SIZE,
+			&pop->root_offset, size + OBJ_OOB_OFF(pop), 0,
 			constructor_zrealloc_root, &carg, &ctx);
 
 	pmalloc_redo_release(pop);
@@ -2102,11 +2819,9 @@ pmemobj_root_size(PMEMobjpool *pop)
 {
 	LOG(3, "pop %p", pop);
 
-	if (pop->root_offset) {
-		struct oob_header *ro =
-			OOB_HEADER_FROM_OFF(pop, pop->root_offset);
-		return ro->size & ~OBJ_INTERNAL_OBJECT_MASK;
-	} else
+	if (pop->root_offset)
+		return obj_hdr_internal_value(pop, pop->root_offset);
+	else
 		return 0;
 }
 
@@ -2171,11 +2886,10 @@ pmemobj_first(PMEMobjpool *pop)
 
 	uint64_t off = palloc_first(&pop->heap);
 	if (off != 0) {
-		ret.off = off + OBJ_OOB_SIZE;
+		ret.off = off + OBJ_OOB_OFF(pop);
 		ret.pool_uuid_lo = pop->uuid_lo;
 
-		struct oob_header *oobh = OOB_HEADER_FROM_OFF(pop, ret.off);
-		if (oobh->size & OBJ_INTERNAL_OBJECT_MASK) {
+		if (obj_hdr_is_internal(pop, ret.off)) {
 			return pmemobj_next(ret);
 		}
 	}
@@ -2202,11 +2916,10 @@ pmemobj_next(PMEMoid oid)
 	PMEMoid ret = {0, 0};
 	uint64_t off = palloc_next(&pop->heap, oid.off);
 	if (off != 0) {
-		ret.off = off + OBJ_OOB_SIZE;
+		ret.off = off + OBJ_OOB_OFF(pop);
 		ret.pool_uuid_lo = pop->uuid_lo;
 
-		struct oob_header *oobh = OOB_HEADER_FROM_OFF(pop, ret.off);
-		if (oobh->size & OBJ_INTERNAL_OBJECT_MASK) {
+		if (obj_hdr_is_internal(pop, ret.off)) {
 			return pmemobj_next(ret);
 		}
 	}
@@ -2214,6 +2927,156 @@ pmemobj_next(PMEMoid oid)
 	return ret;
 }
 
+/*
+ * pmemobj_first_type -- returns the first object of the specified type
+ */
+PMEMoid
+pmemobj_first_type(PMEMobjpool *pop, uint64_t type_num)
+{
+	LOG(3, "pop %p type_num %lu", pop, type_num);
+
+	PMEMoid ret = {0, 0};
+
+	uint64_t off;
+	if (type_index_first(pop, type_num, &off) != 0) {
+		/* no index, fall back to the heap walk */
+		ret = pmemobj_first(pop);
+		while (ret.off != 0 && pmemobj_type_num(ret) != type_num)
+			ret = pmemobj_next(ret);
+
+		return ret;
+	}
+
+	if (off != 0) {
+		ret.off = off;
+		ret.pool_uuid_lo = pop->uuid_lo;
+	}
+
+	return ret;
+}
+
+/*
+ * pmemobj_next_type -- returns the next object of the same type
+ */
+PMEMoid
+pmemobj_next_type(PMEMoid oid)
+{
+	LOG(3, "oid.off 0x%016jx", oid.off);
+
+	if (oid.off == 0)
+		return OID_NULL;
+
+	PMEMobjpool *pop = pmemobj_pool_by_oid(oid);
+
+	ASSERTne(pop, NULL);
+	ASSERT(OBJ_OID_IS_VALID(pop, oid));
+
+	uint64_t type_num = pmemobj_type_num(oid);
+	PMEMoid ret = {0, 0};
+
+	uint64_t off;
+	if (type_index_next(pop, type_num, oid.off, &off) != 0) {
+		/* no index, fall back to the heap walk */
+		ret = pmemobj_next(oid);
+		while (ret.off != 0 && pmemobj_type_num(ret) != type_num)
+			ret = pmemobj_next(ret);
+
+		return ret;
+	}
+
+	if (off != 0) {
+		ret.off = off;
+		ret.pool_uuid_lo = pop->uuid_lo;
+	}
+
+	return ret;
+}
+
+/*
+ * pmemobj_type_count -- returns the number of objects of the specified type
+ */
+size_t
+pmemobj_type_count(PMEMobjpool *pop, uint64_t type_num)
+{
+	LOG(3, "pop %p type_num %lu", pop, type_num);
+
+	size_t count;
+	if (type_index_count(pop, type_num, &count) == 0)
+		return count;
+
+	/* no index, fall back to the heap walk */
+	count = 0;
+	for (PMEMoid oid = pmemobj_first(pop); oid.off != 0;
+			oid = pmemobj_next(oid)) {
+		if (pmemobj_type_num(oid) == type_num)
+			count++;
+	}
+
+	return count;
+}
+
+/* arguments for obj_foreach_cb */
+struct obj_foreach_arg {
+	PMEMobjpool *pop;
+	int filter; /* visit only the objects of type_num */
+	uint64_t type_num;
+	pmemobj_foreach_cb cb;
+	void *arg;
+};
+
+/*
+ * obj_foreach_cb -- (internal) calls the user callback for an object found
+ *	by the parallel heap walk
+ */
+static int
+obj_foreach_cb(uint64_t off, void *arg)
+{
+	struct obj_foreach_arg *farg = arg;
+
+	PMEMobjpool *pop = farg->pop;
+	PMEMoid oid = {pop->uuid_lo, off + OBJ_OOB_OFF(pop)};
+
+	if (obj_hdr_is_internal(pop, oid.off))
+		return 0;
+
+	if (farg->filter && *obj_hdr_type_num(pop, oid.off) != farg->type_num)
+		return 0;
+
+	return farg->cb(oid, farg->arg);
+}
+
+/*
+ * pmemobj_foreach_parallel -- calls the callback for every object in the
+ *	pool from multiple threads
+ */
+int
+pmemobj_foreach_parallel(PMEMobjpool *pop, unsigned nthreads,
+	pmemobj_foreach_cb cb, void *arg)
+{
+	LOG(3, "pop %p nthreads %u", pop, nthreads);
+
+	struct obj_foreach_arg farg = {pop, 0, 0, cb, arg};
+
+	return palloc_foreach_parallel(&pop->heap, nthreads,
+			obj_foreach_cb, &farg);
+}
+
+/*
+ * pmemobj_foreach_type_parallel -- calls the callback for every object of
+ *	the type in the pool from multiple threads
+ */
+int
+pmemobj_foreach_type_parallel(PMEMobjpool *pop, uint64_t type_num,
+	unsigned nthreads, pmemobj_foreach_cb cb, void *arg)
+{
+	LOG(3, "pop %p type_num %lu nthreads %u", pop, type_num, nthreads);
+
+	struct obj_foreach_arg farg = {pop, 1, type_num, cb, arg};
+
+	return palloc_foreach_parallel(&pop->heap, nthreads,
+			obj_foreach_cb, &farg);
+}
+
 /*
  * pmemobj_list_insert -- adds object to a list
  */
@@ -2342,6 +3205,100 @@ pmemobj_list_move(PMEMobjpool *pop, size_t pe_old_offset, void *head_old,
 				dest, before, oid);
 }
 
+/*
+ * pmemobj_list_insert_batch -- adds existing objects to a list
+ */
+int
+pmemobj_list_insert_batch(PMEMobjpool *pop, size_t pe_offset, void *head,
+		PMEMoid dest, int before, const PMEMoid *oids, size_t noids)
+{
+	LOG(3, "pop %p pe_offset %zu head %p dest.off 0x%016jx before %d"
+	    " oids %p noids %zu",
+	    pop, pe_offset, head, dest.off, before, oids, noids);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+	ASSERT(OBJ_OID_IS_VALID(pop, dest));
+
+	if (pe_offset >= pop->size) {
+		ERR("pe_offset (%lu) too big", pe_offset);
+		return EINVAL;
+	}
+
+	if (noids == 0)
+		return 0;
+
+	return list_insert_batch(pop, (ssize_t)pe_offset, head, dest, before,
+			oids, noids);
+}
+
+/*
+ * pmemobj_list_remove_batch -- removes objects from a list
+ */
+int
+pmemobj_list_remove_batch(PMEMobjpool *pop, size_t pe_offset, void *head,
+		const PMEMoid *oids, size_t noids, int free)
+{
+	LOG(3, "pop %p pe_offset %zu head %p oids %p noids %zu free %d",
+	    pop, pe_offset, head, oids, noids, free);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (pe_offset >= pop->size) {
+		ERR("pe_offset (%lu) too big", pe_offset);
+		return EINVAL;
+	}
+
+	if (noids == 0)
+		return 0;
+
+	if (free) {
+		return list_remove_free_batch(pop, pe_offset, head,
+				oids, noids);
+	} else {
+		return list_remove_batch(pop, (ssize_t)pe_offset, head,
+				oids, noids);
+	}
+}
+
+/*
+ * pmemobj_list_move_batch -- moves objects between lists
+ */
+int
+pmemobj_list_move_batch(PMEMobjpool *pop, size_t pe_old_offset,
+		void *head_old, size_t pe_new_offset, void *head_new,
+		PMEMoid dest, int before, const PMEMoid *oids, size_t noids)
+{
+	LOG(3, "pop %p pe_old_offset %zu pe_new_offset %zu"
+	    " head_old %p head_new %p dest.off 0x%016jx"
+	    " before %d oids %p noids %zu",
+	    pop, pe_old_offset, pe_new_offset,
+	    head_old, head_new, dest.off, before, oids, noids);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	ASSERT(OBJ_OID_IS_VALID(pop, dest));
+
+	if (pe_old_offset >= pop->size) {
+		ERR("pe_old_offset (%lu) too big", pe_old_offset);
+		return EINVAL;
+	}
+
+	if (pe_new_offset >= pop->size) {
+		ERR("pe_new_offset (%lu) too big", pe_new_offset);
+		return EINVAL;
+	}
+
+	if (noids == 0)
+		return 0;
+
+	return list_move_batch(pop, pe_old_offset, head_old,
+				pe_new_offset, head_new,
+				dest, before, oids, noids);
+}
+
 /*
  * _pobj_debug_notice -- logs notice message if used inside a transaction
  */
@@ -39,7 +39,9 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
+#include "heap_layout.h"
 #include "lane.h"
 #include "pool_hdr.h"
 #include "pmalloc.h"
@@ -56,15 +58,57 @@
 #define OBJ_FORMAT_INCOMPAT 0x0000
 #define OBJ_FORMAT_RO_COMPAT 0x0000
 
+/* pool uses a non-default number of lanes or length of lane sections */
+#define OBJ_INCOMPAT_LANES 0x0001
+
+/* pool has an extension redo log for operations which do not fit in a lane */
+#define OBJ_INCOMPAT_EXT_REDO 0x0002
+
+/* objects of the pool have a single compact header, without the oob header */
+#define OBJ_INCOMPAT_COMPACT_HEADERS 0x0004
+
+/* heap of the pool is placed so that the chunks are huge page aligned */
+#define OBJ_INCOMPAT_HUGE_ALIGNED 0x0008
+
+/* objects can be moved forward within their blocks to a stricter alignment */
+#define OBJ_INCOMPAT_ALIGNED_ALLOCS 0x0010
+
+/* snapshots in the tx range cache can span several consecutive slots */
+#define OBJ_INCOMPAT_RANGE_CACHE_SLOTS 0x0020
+
+/* zones of the heap are formatted on demand, see zone_format_id */
+#define OBJ_INCOMPAT_LAZY_ZONES 0x0040
+
+/* incompat features supported by this version of the library */
+#define OBJ_FORMAT_INCOMPAT_SUPPORTED\
+	(OBJ_FORMAT_INCOMPAT | OBJ_INCOMPAT_LANES | OBJ_INCOMPAT_EXT_REDO |\
+	OBJ_INCOMPAT_COMPACT_HEADERS | OBJ_INCOMPAT_HUGE_ALIGNED |\
+	OBJ_INCOMPAT_ALIGNED_ALLOCS | OBJ_INCOMPAT_RANGE_CACHE_SLOTS |\
+	OBJ_INCOMPAT_LAZY_ZONES)
+
 /* size of the persistent part of PMEMOBJ pool descriptor (2kB) */
 #define OBJ_DSC_P_SIZE		2048
 /* size of unused part of the persistent part of PMEMOBJ pool descriptor */
-#define OBJ_DSC_P_UNUSED	(OBJ_DSC_P_SIZE - PMEMOBJ_MAX_LAYOUT - 40)
+#define OBJ_DSC_P_UNUSED	(OBJ_DSC_P_SIZE - PMEMOBJ_MAX_LAYOUT - 64)
 
 #define OBJ_LANES_OFFSET	8192	/* lanes offset (8kB) */
-#define OBJ_NLANES		1024	/* number of lanes */
+#define OBJ_HUGE_PAGE_SIZE	((uint64_t)2 << 20) /* heap alignment (2MB) */
+#define OBJ_NLANES		1024	/* default number of lanes */
+#define OBJ_NLANES_MAX		65536	/* maximum number of lanes */
+
+/* maximum number of entries in the extension redo log */
+#define OBJ_EXT_REDO_NENTRIES_MAX	(1 << 20)
+
+/* pools created before the length was stored use the default one */
+#define OBJ_LANE_SECTION_LEN(pop)\
+	((pop)->lane_section_len ? (pop)->lane_section_len : LANE_SECTION_LEN)
+#define OBJ_LANE_SIZE(pop)\
+	(OBJ_LANE_SECTION_LEN(pop) * MAX_LANE_SECTION)
 
 #define OBJ_OOB_SIZE		(sizeof(struct oob_header))
+/* number of bytes the allocator reserves before an object of the pool */
+#define OBJ_OOB_OFF(pop)\
+	((pop)->heap.header_type == HEADER_COMPACT ? 0 : OBJ_OOB_SIZE)
 #define OBJ_OFF_TO_PTR(pop, off) ((void *)((uintptr_t)(pop) + (off)))
 #define OBJ_PTR_TO_OFF(pop, ptr) ((uintptr_t)(ptr) - (uintptr_t)(pop))
 #define OBJ_OID_IS_NULL(oid)	((oid).off == 0)
@@ -75,7 +119,7 @@
 #define OBJ_OFF_FROM_LANES(pop, off)\
 	((off) >= (pop)->lanes_offset &&\
 	(off) < (pop)->lanes_offset +\
-	(pop)->nlanes * sizeof(struct lane_layout))
+	(pop)->nlanes * OBJ_LANE_SIZE(pop))
 
 #define OBJ_PTR_FROM_POOL(pop, ptr)\
 	((uintptr_t)(ptr) >= (uintptr_t)(pop) &&\
@@ -89,21 +133,29 @@
 #define OBJ_PTR_IS_VALID(pop, ptr)\
 	OBJ_OFF_IS_VALID(pop, OBJ_PTR_TO_OFF(pop, ptr))
 
+#define OBJ_ALIGNMENT_IS_VALID(a)\
+	((a) != 0 && ((a) & ((a) - 1)) == 0 && (a) <= PMEMOBJ_MAX_ALIGNMENT)
+
+/* pools created by older versions only have cache line aligned objects */
+#define OBJ_ALIGNMENT_IS_SUPPORTED(pop, a)\
+	((pop)->heap.aligned_allocs || (a) <= _POBJ_CL_ALIGNMENT)
+
 #define OOB_HEADER_FROM_OFF(pop, off)\
 	((struct oob_header *)((uintptr_t)(pop) + (off) - OBJ_OOB_SIZE))
 
 #define OOB_HEADER_FROM_OID(pop, oid)\
 	((struct oob_header *)((uintptr_t)(pop) + (oid).off - OBJ_OOB_SIZE))
 
-#define OBJ_OID_IS_IN_UNDO_LOG(pop, oid)\
-	(OOB_HEADER_FROM_OID(pop, oid)->undo_entry_offset != 0)
-
 #define OOB_HEADER_FROM_PTR(ptr)\
 	((struct oob_header *)((uintptr_t)(ptr) - OBJ_OOB_SIZE))
 
 #define OOB_OFFSET_OF(oid, field)\
 	((oid).off - OBJ_OOB_SIZE + offsetof(struct oob_header, field))
 
+#define COMPACT_HEADER_FROM_OFF(pop, off)\
+	((struct allocation_header_compact *)((uintptr_t)(pop) + (off) -\
+	sizeof(struct allocation_header_compact)))
+
 typedef void (*persist_local_fn)(const void *, size_t);
 typedef void (*flush_local_fn)(const void *, size_t);
 typedef void (*drain_local_fn)(void);
@@ -117,6 +169,8 @@ extern unsigned long long Pagesize;
 
 typedef uint64_t type_num_t;
 
+struct tx_stats;
+
 struct pmemobjpool {
 	struct pool_hdr hdr;	/* memory pool header */
 
@@ -126,6 +180,9 @@ struct pmemobjpool {
 	uint64_t nlanes;
 	uint64_t heap_offset;
 	uint64_t heap_size;
+	uint64_t lane_section_len;
+	uint64_t ext_redo_offset;	/* extension redo log, 0 if none */
+	uint64_t ext_redo_nentries;
 	unsigned char unused[OBJ_DSC_P_UNUSED]; /* must be zero */
 	uint64_t checksum;	/* checksum of above fields */
 
@@ -134,6 +191,10 @@ struct pmemobjpool {
 	/* unique runID for this program run - persistent but not checksummed */
 	uint64_t run_id;
 
+	/* clean shutdown marker - persistent but not checksummed */
+	uint64_t clean_run_id;	/* run_id of the last clean close */
+	uint64_t heap_summary_offset;	/* free space summary, 0 if none */
+
 	/* some run-time state, allocated out of memory pool... */
 	void *addr;		/* mapped region */
 	size_t size;		/* size of mapped region */
@@ -169,15 +230,30 @@ struct pmemobjpool {
 
 	persist_remote_fn persist_remote; /* remote persist function */
 
+	struct tx_stats *tx_stats;	/* per-lane transaction statistics */
+	int tx_stats_enabled;
+	unsigned tx_max_cached_range;	/* largest range in tx range cache */
+	int tx_range_cache_slots; /* snapshots may span several cache slots */
+
+	unsigned lock_max_spin;	/* attempts to take a lock before sleeping */
+	int lock_stats_enabled;
+	struct sync_stats *lock_stats; /* lock contention statistics */
+
+	struct type_index *type_index; /* objects by type, built on demand */
+
+	/* for 'master' replica: threads which update the local replicas */
+	struct replicator *replicator;
+
 	/* padding to align size of this structure to page boundary */
 	/* sizeof(unused2) == 8192 - offsetof(struct pmemobjpool, unused2) */
-	char unused2[1606];
+	char unused2[1494];
 };
 
 /*
  * Stored in the 'size' field of oobh header, determines whether the object
  * is internal or not. Internal objects are skipped in pmemobj iteration
- * functions.
+ * functions. With compact headers the flag of the allocator's user in the
+ * allocation size is used instead.
  */
 #define OBJ_INTERNAL_OBJECT_MASK ((1ULL) << 63)
 
@@ -196,6 +272,21 @@ struct oob_header {
 	uint64_t type_num;
 };
 
+/*
+ * Header of a region, the objects allocated from the region follow it.
+ * The region is a regular object, which is freed as a whole.
+ */
+struct obj_region {
+	uint64_t capacity; /* number of bytes available for the objects */
+	uint64_t used; /* number of bytes already handed out */
+	uint8_t unused[48];
+};
+
+/* alignment of the objects allocated from a region */
+#define OBJ_REGION_ALIGN	16
+#define OBJ_REGION_ALLOC_SIZE(s)\
+	(((s) + OBJ_REGION_ALIGN - 1) & ~((size_t)OBJ_REGION_ALIGN - 1))
+
 enum internal_type {
 	TYPE_NONE,
 	TYPE_ALLOCATED,
@@ -222,6 +313,81 @@ pmemobj_get_uuid_lo(PMEMobjpool *pop)
 	return uuid_lo;
 }
 
+/*
+ * obj_hdr_type_num -- (internal) returns the location of the type number of
+ *	the object at the given offset
+ */
+static inline uint64_t *
+obj_hdr_type_num(PMEMobjpool *pop, uint64_t off)
+{
+	if (pop->heap.header_type == HEADER_COMPACT)
+		return &COMPACT_HEADER_FROM_OFF(pop, off)->extra;
+
+	return &OOB_HEADER_FROM_OFF(pop, off)->type_num;
+}
+
+/*
+ * obj_hdr_is_internal -- (internal) checks whether the object is an internal
+ *	one, which is hidden from the user
+ */
+static inline int
+obj_hdr_is_internal(PMEMobjpool *pop, uint64_t off)
+{
+	if (pop->heap.header_type == HEADER_COMPACT)
+		return (COMPACT_HEADER_FROM_OFF(pop, off)->size &
+			ALLOC_HDR_FLAG_USER) != 0;
+
+	return (OOB_HEADER_FROM_OFF(pop, off)->size &
+		OBJ_INTERNAL_OBJECT_MASK) != 0;
+}
+
+/*
+ * obj_hdr_init -- (internal) initializes the header of a new object, must be
+ *	called from the constructor of the allocation
+ *
+ * The value of an internal object is stored in place of its type number, or
+ * of the unused size of the oob header, and can be read back with
+ * obj_hdr_internal_value. The header is persisted by the allocator.
+ */
+static inline void
+obj_hdr_init(PMEMobjpool *pop, void *ptr, int internal, uint64_t value)
+{
+	uint64_t off = OBJ_PTR_TO_OFF(pop, ptr);
+
+	if (pop->heap.header_type == HEADER_COMPACT) {
+		struct allocation_header_compact *hdr =
+			COMPACT_HEADER_FROM_OFF(pop, off);
+		hdr->extra = value;
+		if (internal)
+			hdr->size |= ALLOC_HDR_FLAG_USER;
+		return;
+	}
+
+	struct oob_header *oobh = OOB_HEADER_FROM_OFF(pop, off);
+	oobh->undo_entry_offset = 0;
+	if (internal) {
+		oobh->type_num = 0;
+		oobh->size = value | OBJ_INTERNAL_OBJECT_MASK;
+	} else {
+		oobh->type_num = value;
+		oobh->size = 0;
+	}
+	memset(oobh->unused, 0, sizeof(oobh->unused));
+}
+
+/*
+ * obj_hdr_internal_value -- (internal) returns the value stored in the header
+ *	of an internal object
+ */
+static inline uint64_t
+obj_hdr_internal_value(PMEMobjpool *pop, uint64_t off)
+{
+	if (pop->heap.header_type == HEADER_COMPACT)
+		return COMPACT_HEADER_FROM_OFF(pop, off)->extra;
+
+	return OOB_HEADER_FROM_OFF(pop, off)->size & ~OBJ_INTERNAL_OBJECT_MASK;
+}
+
 /*
  * OBJ_OID_IS_VALID -- (internal) checks if 'oid' is valid
  */
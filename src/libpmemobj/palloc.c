@@ -38,19 +38,27 @@
  * in a reasonable time and with an acceptable common-case fragmentation.
  */
 
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
 #include "heap_layout.h"
 #include "heap.h"
 #include "out.h"
 #include "palloc.h"
+#include "sys_util.h"
+#include "util.h"
 #include "valgrind_internal.h"
 
 /*
- * Number of bytes between beginning of memory block and beginning of user data.
+ * Alignment of user data of the objects which are not moved to a stricter one.
  */
-#define ALLOC_OFF (PALLOC_DATA_OFF + sizeof(struct allocation_header))
+#define ALLOC_HDR_ALIGNMENT(heap)\
+	((heap)->header_type == HEADER_COMPACT ?\
+	sizeof(struct allocation_header) : _POBJ_CL_ALIGNMENT)
 
 #define USABLE_SIZE(_a)\
-((_a)->size - sizeof(struct allocation_header))
+(ALLOC_HDR_SIZE(_a) - ALLOC_HDR_PAD(_a) - sizeof(struct allocation_header))
 
 #define MEMORY_BLOCK_IS_EMPTY(_m)\
 ((_m).size_idx == 0)
@@ -60,19 +68,24 @@
 	((uintptr_t)(ptr) - (uintptr_t)(heap->base))
 
 #define ALLOC_GET_HEADER(_heap, _off) (struct allocation_header *)\
-((char *)PMALLOC_OFF_TO_PTR((_heap), (_off)) - ALLOC_OFF)
+((char *)PMALLOC_OFF_TO_PTR((_heap), (_off)) - ALLOC_OFF(_heap))
 
 /*
  * alloc_write_header -- (internal) creates allocation header
  */
 static void
 alloc_write_header(struct palloc_heap *heap, struct allocation_header *alloc,
-	struct memory_block m, uint64_t size)
+	struct memory_block m, uint64_t size, uint64_t pad)
 {
 	VALGRIND_ADD_TO_TX(alloc, sizeof(*alloc));
-	alloc->chunk_id = m.chunk_id;
-	alloc->size = size;
-	alloc->zone_id = m.zone_id;
+	if (heap->header_type == HEADER_COMPACT) {
+		((struct allocation_header_compact *)alloc)->extra = 0;
+	} else {
+		alloc->chunk_id = m.chunk_id;
+		alloc->zone_id = m.zone_id;
+	}
+	alloc->size = size |
+		((pad / ALLOC_HDR_PAD_UNIT) << ALLOC_HDR_PAD_SHIFT);
 	VALGRIND_REMOVE_FROM_TX(alloc, sizeof(*alloc));
 }
 
@@ -83,21 +96,63 @@ static struct memory_block
 get_mblock_from_alloc(struct palloc_heap *heap,
 		struct allocation_header *alloc)
 {
-	struct memory_block m = {
-		alloc->chunk_id,
-		alloc->zone_id,
-		0,
-		0
-	};
+	/* the header of an aligned object is not at the start of the block */
+	void *block_data = (char *)alloc - ALLOC_HDR_PAD(alloc);
+
+	struct memory_block m = {0, 0, 0, 0};
+	if (heap->header_type == HEADER_COMPACT) {
+		/* the location of the block is not stored in the header */
+		uintptr_t zoff = (uintptr_t)block_data -
+			(uintptr_t)&heap->layout->zone0;
+		m.zone_id = (uint32_t)(zoff / ZONE_MAX_SIZE);
+
+		struct zone *z = ZID_TO_ZONE(heap->layout, m.zone_id);
+		m.chunk_id = (uint32_t)(((uintptr_t)block_data -
+			(uintptr_t)&z->chunks[0]) / CHUNKSIZE);
+	} else {
+		m.chunk_id = alloc->chunk_id;
+		m.zone_id = alloc->zone_id;
+	}
 
 	uint64_t unit_size = MEMBLOCK_OPS(AUTO, &m)->
 			block_size(&m, heap->layout);
-	m.block_off = MEMBLOCK_OPS(AUTO, &m)->block_offset(&m, heap, alloc);
-	m.size_idx = CALC_SIZE_IDX(unit_size, alloc->size);
+
+	m.block_off = MEMBLOCK_OPS(AUTO, &m)->block_offset(&m, heap,
+			block_data);
+	m.size_idx = CALC_SIZE_IDX(unit_size, ALLOC_HDR_SIZE(alloc));
 
 	return m;
 }
 
+/*
+ * alloc_block_to_off -- (internal) translates the offset of a memory block
+ *	to the offset of the object stored in it, as returned by palloc_first
+ */
+static uint64_t
+alloc_block_to_off(struct palloc_heap *heap, uint64_t block_off)
+{
+	struct allocation_header *alloc =
+		PMALLOC_OFF_TO_PTR(heap, block_off);
+
+	return block_off + ALLOC_HDR_PAD(alloc) +
+		sizeof(struct allocation_header);
+}
+
+/*
+ * alloc_pad -- (internal) returns the number of bytes the object of the block
+ *	has to be moved by to be aligned to the requested boundary
+ */
+static uint64_t
+alloc_pad(struct palloc_heap *heap, void *userdatap, size_t alignment)
+{
+	if (alignment <= ALLOC_HDR_ALIGNMENT(heap))
+		return 0;
+
+	uint64_t off = PMALLOC_PTR_TO_OFF(heap, userdatap);
+
+	return (alignment - off % alignment) % alignment;
+}
+
 /*
  * alloc_reserve_block -- (internal) reserves a memory block in volatile state
  *
@@ -119,14 +174,42 @@ get_mblock_from_alloc(struct palloc_heap *heap,
  * memory from other caches if that's required to satisfy the current caller
  * needs.
  *
+ * The empty runs kept by the heap are the last resort, those are turned back
+ * into chunks and the reservation is retried.
+ *
  * Once this method completes no further locking is required on the transient
  * part of the heap during the allocation process.
  */
 static int
 alloc_reserve_block(struct palloc_heap *heap, struct memory_block *m,
-		size_t sizeh)
+		size_t sizeh, size_t alignment)
 {
-	struct bucket *b = heap_get_best_bucket(heap, sizeh);
+	struct bucket *b = NULL;
+	int err;
+
+	/*
+	 * An object with a stricter alignment than the one of the memory
+	 * blocks is allocated from the class in which the blocks themselves
+	 * are aligned, if there's one, or is moved forward within a larger
+	 * block.
+	 */
+	size_t sizea = sizeh;
+	if (alignment > ALLOC_HDR_ALIGNMENT(heap)) {
+		ASSERT(heap->aligned_allocs);
+		b = heap_get_aligned_bucket(heap, alignment, sizeh);
+		if (b == NULL)
+			sizea += alignment - ALLOC_HDR_ALIGNMENT(heap);
+	}
+
+	if (b == NULL)
+		b = heap_get_best_bucket(heap, sizea);
+
+	if (b->type == BUCKET_HUGE && sizea != sizeh) {
+		/* the object is moved by less than a chunk */
+		err = heap_get_aligned_block(heap, b, m, ALLOC_OFF(heap),
+			sizeh, alignment);
+		goto out;
+	}
 
 	/*
 	 * The caller provided size in bytes, but buckets operate in
@@ -135,19 +218,19 @@ alloc_reserve_block(struct palloc_heap *heap, struct memory_block *m,
 	 * For example, to allocate 500 bytes from a bucket that provides 256
 	 * byte blocks two memory 'units' are required.
 	 */
-	m->size_idx = b->calc_units(b, sizeh);
+	m->size_idx = b->calc_units(b, sizea);
 
-	int err = heap_get_bestfit_block(heap, b, m);
+	err = heap_get_bestfit_block(heap, b, m);
 
 	if (err == ENOMEM && b->type == BUCKET_HUGE)
-		return ENOMEM; /* there's only one huge bucket */
+		goto out; /* there's only one huge bucket */
 
 	if (err == ENOMEM) {
 		/*
 		 * There's no more available memory in the common heap and in
 		 * this lane cache, fallback to the auxiliary (shared) bucket.
 		 */
-		b = heap_get_auxiliary_bucket(heap, sizeh);
+		b = heap_get_auxiliary_bucket(heap, b);
 		err = heap_get_bestfit_block(heap, b, m);
 	}
 
@@ -160,12 +243,17 @@ alloc_reserve_block(struct palloc_heap *heap, struct memory_block *m,
 		err = heap_get_bestfit_block(heap, b, m);
 	}
 
-	if (err == ENOMEM) {
-		/* we are completely out of memory */
-		return ENOMEM;
+out:
+	if (err == ENOMEM && heap_degrade_empty_runs(heap) != 0) {
+		/*
+		 * The empty runs kept by the allocation classes were turned
+		 * back into chunks, there might be enough memory now.
+		 */
+		return alloc_reserve_block(heap, m, sizeh, alignment);
 	}
 
-	return 0;
+	/* ENOMEM means that we are completely out of memory */
+	return err;
 }
 
 /*
@@ -181,31 +269,39 @@ alloc_reserve_block(struct palloc_heap *heap, struct memory_block *m,
  */
 static int
 alloc_prep_block(struct palloc_heap *heap, struct memory_block m,
-	palloc_constr constructor, void *arg, uint64_t *offset_value)
+	size_t alignment, palloc_constr constructor, void *arg,
+	uint64_t *offset_value)
 {
 	void *block_data = heap_get_block_data(heap, m);
-	void *userdatap = (char *)block_data + ALLOC_OFF;
+	void *userdatap = (char *)block_data + ALLOC_OFF(heap);
 
 	uint64_t unit_size = MEMBLOCK_OPS(AUTO, &m)->
 			block_size(&m, heap->layout);
 
 	uint64_t real_size = unit_size * m.size_idx;
 
-	ASSERT((uint64_t)block_data % _POBJ_CL_ALIGNMENT == 0);
-	ASSERT((uint64_t)userdatap % _POBJ_CL_ALIGNMENT == 0);
+	ASSERT((uint64_t)block_data % ALLOC_HDR_ALIGNMENT(heap) == 0);
+	ASSERT((uint64_t)userdatap % ALLOC_HDR_ALIGNMENT(heap) == 0);
+
+	uint64_t pad = alloc_pad(heap, userdatap, alignment);
+	ASSERT(pad + ALLOC_OFF(heap) < real_size);
+	userdatap = (char *)userdatap + pad;
 
 	/* mark everything (including headers) as accessible */
 	VALGRIND_DO_MAKE_MEM_UNDEFINED(block_data, real_size);
 	/* mark space as allocated */
 	VALGRIND_DO_MEMPOOL_ALLOC(heap->layout, userdatap,
-			real_size - ALLOC_OFF);
+			real_size - ALLOC_OFF(heap) - pad);
 
-	alloc_write_header(heap, block_data, m, real_size);
+	alloc_write_header(heap, block_data, m, real_size, pad);
+	if (pad != 0)
+		alloc_write_header(heap, (struct allocation_header *)
+			((char *)block_data + pad), m, real_size, pad);
 
 	int ret;
 	if (constructor != NULL &&
 		(ret = constructor(heap->base, userdatap,
-			real_size - ALLOC_OFF, arg)) != 0) {
+			real_size - ALLOC_OFF(heap) - pad, arg)) != 0) {
 
 		/*
 		 * If canceled, revert the block back to the free state in vg
@@ -214,20 +310,25 @@ alloc_prep_block(struct palloc_heap *heap, struct memory_block m,
 		 * in a separate call.
 		 */
 		VALGRIND_DO_MEMPOOL_FREE(heap->layout, userdatap);
-		VALGRIND_DO_MAKE_MEM_NOACCESS(block_data, ALLOC_OFF);
+		VALGRIND_DO_MAKE_MEM_NOACCESS(block_data,
+			ALLOC_OFF(heap) + pad);
 
 		/*
 		 * During this method there are several stores to pmem that are
 		 * not immediately flushed and in case of a cancelation those
 		 * stores are no longer relevant anyway.
 		 */
-		VALGRIND_SET_CLEAN(block_data, ALLOC_OFF);
+		VALGRIND_SET_CLEAN(block_data, ALLOC_OFF(heap) + pad);
 
 		return ret;
 	}
 
-	/* flushes both the alloc and oob headers */
-	pmemops_persist(&heap->p_ops, block_data, ALLOC_OFF);
+	/* flushes both the alloc and oob headers, and the block header */
+	if (pad != 0)
+		pmemops_flush(&heap->p_ops, block_data,
+			sizeof(struct allocation_header));
+	pmemops_persist(&heap->p_ops, (char *)block_data + pad,
+		ALLOC_OFF(heap));
 
 	/*
 	 * To avoid determining the user data pointer twice this method is also
@@ -240,6 +341,27 @@ alloc_prep_block(struct palloc_heap *heap, struct memory_block m,
 	return 0;
 }
 
+/*
+ * alloc_cancel_block -- (internal) returns a reserved memory block, which
+ *	did not become allocated, back to its bucket
+ */
+static void
+alloc_cancel_block(struct palloc_heap *heap, struct memory_block m)
+{
+	struct bucket *b = heap_get_chunk_bucket(heap, m.chunk_id, m.zone_id);
+	ASSERTne(b, NULL);
+
+	/*
+	 * Omitting the context in this method results in coalescing of blocks
+	 * without affecting the persistent heap state.
+	 */
+	m = heap_free_block(heap, b, m, NULL);
+	CNT_OP(b, insert, heap, m);
+
+	if (b->type == BUCKET_RUN)
+		heap_degrade_run_if_empty(heap, b, m);
+}
+
 /*
  * palloc_operation -- persistent memory operation. Takes a NULL pointer
  *	or an existing memory block and modifies it to occupy, at least, 'size'
@@ -274,7 +396,7 @@ alloc_prep_block(struct palloc_heap *heap, struct memory_block m,
  */
 int
 palloc_operation(struct palloc_heap *heap,
-	uint64_t off, uint64_t *dest_off, size_t size,
+	uint64_t off, uint64_t *dest_off, size_t size, size_t alignment,
 	palloc_constr constructor, void *arg,
 	struct operation_context *ctx)
 {
@@ -306,9 +428,9 @@ palloc_operation(struct palloc_heap *heap,
 		 * necessary volatile heap modifications won't be performed for
 		 * this memory block.
 		 */
-		b = heap_get_chunk_bucket(heap, alloc->chunk_id,
-				alloc->zone_id);
 		existing_block = get_mblock_from_alloc(heap, alloc);
+		b = heap_get_chunk_bucket(heap, existing_block.chunk_id,
+				existing_block.zone_id);
 	}
 
 	/* if allocation or reallocation, reserve new memory */
@@ -317,7 +439,8 @@ palloc_operation(struct palloc_heap *heap,
 		if (alloc != NULL && alloc->size == sizeh)
 			return 0;
 
-		errno = alloc_reserve_block(heap, &new_block, sizeh);
+		errno = alloc_reserve_block(heap, &new_block, sizeh,
+			alignment);
 		if (errno != 0)
 			return -1;
 	}
@@ -370,28 +493,13 @@ palloc_operation(struct palloc_heap *heap,
 		}
 #endif /* DEBUG */
 
-		if (alloc_prep_block(heap, new_block, constructor,
+		if (alloc_prep_block(heap, new_block, alignment, constructor,
 				arg, &offset_value) != 0) {
 			/*
 			 * Constructor returned non-zero value which means
 			 * the memory block reservation has to be rolled back.
 			 */
-			struct bucket *new_bucket = heap_get_chunk_bucket(heap,
-				new_block.chunk_id, new_block.zone_id);
-			ASSERTne(new_bucket, NULL);
-
-			/*
-			 * Omitting the context in this method results in
-			 * coalescing of blocks without affecting the persistent
-			 * heap state.
-			 */
-			new_block = heap_free_block(heap, new_bucket,
-					new_block, NULL);
-			CNT_OP(new_bucket, insert, heap, new_block);
-
-			if (new_bucket->type == BUCKET_RUN)
-				heap_degrade_run_if_empty(heap,
-					new_bucket, new_block);
+			alloc_cancel_block(heap, new_block);
 
 			errno = ECANCELED;
 			return -1;
@@ -419,16 +527,16 @@ palloc_operation(struct palloc_heap *heap,
 	/* not in-place realloc */
 	if (!MEMORY_BLOCK_IS_EMPTY(existing_block) &&
 		!MEMORY_BLOCK_IS_EMPTY(new_block)) {
-		size_t old_size = alloc->size;
+		size_t old_size = ALLOC_HDR_SIZE(alloc) - ALLOC_HDR_PAD(alloc);
 		size_t to_cpy = old_size > sizeh ? sizeh : old_size;
 		VALGRIND_ADD_TO_TX(PMALLOC_OFF_TO_PTR(heap, offset_value),
-			to_cpy - ALLOC_OFF);
+			to_cpy - ALLOC_OFF(heap));
 		pmemops_memcpy_persist(&heap->p_ops,
 			PMALLOC_OFF_TO_PTR(heap, offset_value),
 			PMALLOC_OFF_TO_PTR(heap, off),
-			to_cpy - ALLOC_OFF);
+			to_cpy - ALLOC_OFF(heap));
 		VALGRIND_REMOVE_FROM_TX(PMALLOC_OFF_TO_PTR(heap, offset_value),
-			to_cpy - ALLOC_OFF);
+			to_cpy - ALLOC_OFF(heap));
 	}
 
 	/*
@@ -440,7 +548,31 @@ palloc_operation(struct palloc_heap *heap,
 	if (dest_off != NULL)
 		operation_add_entry(ctx, dest_off, offset_value, OPERATION_SET);
 
-	operation_process(ctx);
+	if (operation_process(ctx) != 0) {
+		/*
+		 * None of the persistent modifications took place, the
+		 * transient state of the heap is brought back in line with it.
+		 */
+		int oerrno = errno;
+
+		if (!MEMORY_BLOCK_IS_EMPTY(existing_block)) {
+			MEMBLOCK_OPS(AUTO, &existing_block)->
+				unlock(&existing_block, heap);
+			heap_free_block_cancel(heap, b, existing_block,
+				reclaimed_block);
+		}
+
+		if (!MEMORY_BLOCK_IS_EMPTY(new_block)) {
+			MEMBLOCK_OPS(AUTO, &new_block)->unlock(&new_block,
+				heap);
+			VALGRIND_DO_MEMPOOL_FREE(heap->layout,
+				PMALLOC_OFF_TO_PTR(heap, offset_value));
+			alloc_cancel_block(heap, new_block);
+		}
+
+		errno = oerrno;
+		return -1;
+	}
 
 	/*
 	 * After the operation succeeded, the persistent state is all in order
@@ -459,8 +591,7 @@ palloc_operation(struct palloc_heap *heap,
 				unlock(&existing_block, heap);
 
 		VALGRIND_DO_MEMPOOL_FREE(heap->layout,
-			(char *)heap_get_block_data(heap, existing_block)
-			+ ALLOC_OFF);
+			PMALLOC_OFF_TO_PTR(heap, off));
 
 		/* we might have been operating on inactive run */
 		if (b != NULL) {
@@ -482,11 +613,10 @@ palloc_operation(struct palloc_heap *heap,
 			/*
 			 * Degrading of a run means turning it back into a chunk
 			 * in case it's no longer needed.
-			 * It might be tempting to defer this operation until
-			 * such time that the chunk is actually needed, but
-			 * right now the decision is to keep the persistent heap
-			 * state as clean as possible - and that means not
-			 * leaving unused data around.
+			 * A few empty runs of each class are kept as they are,
+			 * so that a burst of allocations and frees doesn't
+			 * create and degrade the same run repeatedly, those are
+			 * degraded once the chunk is actually needed.
 			 */
 			if (b->type == BUCKET_RUN)
 				heap_degrade_run_if_empty(heap, b,
@@ -543,7 +673,7 @@ palloc_first(struct palloc_heap *heap)
 	if (off_search == UINT64_MAX)
 		return 0;
 
-	return off_search + sizeof(struct allocation_header);
+	return alloc_block_to_off(heap, off_search);
 }
 
 /*
@@ -555,16 +685,159 @@ palloc_next(struct palloc_heap *heap, uint64_t off)
 	struct allocation_header *alloc = ALLOC_GET_HEADER(heap, off);
 	struct memory_block m = get_mblock_from_alloc(heap, alloc);
 
-	uint64_t off_search = off - ALLOC_OFF;
+	uint64_t block_off = off - ALLOC_OFF(heap) - ALLOC_HDR_PAD(alloc);
+	uint64_t off_search = block_off;
 
 	heap_foreach_object(heap, pmalloc_search_cb, &off_search, m);
 
-	if (off_search == (off - ALLOC_OFF) ||
+	if (off_search == block_off ||
 		off_search == 0 ||
 		off_search == UINT64_MAX)
 		return 0;
 
-	return off_search + sizeof(struct allocation_header);
+	return alloc_block_to_off(heap, off_search);
+}
+
+/* arguments for palloc_foreach_object_cb */
+struct palloc_foreach_arg {
+	struct palloc_heap *heap;
+	palloc_foreach_cb cb;
+	void *arg;
+};
+
+/*
+ * palloc_foreach_object_cb -- (internal) foreach callback, translates the
+ *	object offset to the one returned by palloc_first
+ */
+static int
+palloc_foreach_object_cb(uint64_t off, void *arg)
+{
+	struct palloc_foreach_arg *farg = arg;
+
+	return farg->cb(alloc_block_to_off(farg->heap, off), farg->arg);
+}
+
+/*
+ * palloc_foreach -- calls cb for every object in the heap in one walk, stops
+ *	if the callback returns non-zero. The offsets are the same as the ones
+ *	returned by palloc_first and palloc_next.
+ */
+void
+palloc_foreach(struct palloc_heap *heap, palloc_foreach_cb cb, void *arg)
+{
+	struct palloc_foreach_arg farg = {heap, cb, arg};
+	struct memory_block m = {0, 0, 0, 0};
+
+	heap_foreach_object(heap, palloc_foreach_object_cb, &farg, m);
+}
+
+/* number of chunks handed out to a thread of the parallel walk at once */
+#define PALLOC_WALK_CHUNKS 64
+
+/* state shared by the threads of palloc_foreach_parallel */
+struct palloc_walk {
+	struct palloc_heap *heap;
+	palloc_foreach_cb cb;
+	void *arg;
+
+	pthread_mutex_t lock; /* protects the next range */
+	struct heap_range next;
+
+	int ret; /* first non-zero value returned by the callback */
+};
+
+/*
+ * palloc_walk_cb -- (internal) foreach callback of the parallel walk
+ */
+static int
+palloc_walk_cb(uint64_t off, void *arg)
+{
+	struct palloc_walk *walk = arg;
+
+	if (walk->ret != 0)
+		return 1;
+
+	int ret = walk->cb(alloc_block_to_off(walk->heap, off), walk->arg);
+	if (ret != 0) {
+		__sync_bool_compare_and_swap(&walk->ret, 0, ret);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * palloc_walk_worker -- (internal) walks through ranges of the heap until
+ *	there are none left or the callback requests to stop
+ */
+static void *
+palloc_walk_worker(void *arg)
+{
+	struct palloc_walk *walk = arg;
+	struct heap_range r;
+
+	for (;;) {
+		util_mutex_lock(&walk->lock);
+		int more = heap_range_next(walk->heap, &walk->next,
+				PALLOC_WALK_CHUNKS);
+		r = walk->next;
+		util_mutex_unlock(&walk->lock);
+
+		if (!more || walk->ret != 0)
+			break;
+
+		heap_range_foreach_object(walk->heap, palloc_walk_cb, walk, &r);
+	}
+
+	return NULL;
+}
+
+/*
+ * palloc_foreach_parallel -- calls cb for every object in the heap from
+ *	nthreads threads, including the calling one
+ *
+ * The heap is split into groups of chunks which are handed out to the
+ * threads one at a time, so that the work is balanced even if the objects
+ * are unevenly distributed. If not all threads can be created the walk is
+ * finished by the ones which were. Returns 0 or the first non-zero value
+ * returned by the callback, which stops the walk.
+ */
+int
+palloc_foreach_parallel(struct palloc_heap *heap, unsigned nthreads,
+	palloc_foreach_cb cb, void *arg)
+{
+	struct palloc_walk walk;
+	walk.heap = heap;
+	walk.cb = cb;
+	walk.arg = arg;
+	walk.ret = 0;
+	memset(&walk.next, 0, sizeof(walk.next));
+	util_mutex_init(&walk.lock, NULL);
+
+	pthread_t *threads = NULL;
+	unsigned nstarted = 0;
+	if (nthreads > 1 &&
+	    (threads = Malloc(sizeof(*threads) * (nthreads - 1))) == NULL)
+		LOG(2, "!Malloc, walking the heap in a single thread");
+
+	for (; threads != NULL && nstarted < nthreads - 1; ++nstarted) {
+		errno = pthread_create(&threads[nstarted], NULL,
+				palloc_walk_worker, &walk);
+		if (errno != 0) {
+			LOG(2, "!pthread_create, %u threads started", nstarted);
+			break;
+		}
+	}
+
+	palloc_walk_worker(&walk);
+
+	for (unsigned i = 0; i < nstarted; ++i)
+		pthread_join(threads[i], NULL);
+
+	Free(threads);
+	util_mutex_destroy(&walk.lock);
+
+	return walk.ret;
 }
 
 /*
@@ -577,6 +850,24 @@ palloc_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 	return heap_boot(heap, heap_start, heap_size, base, p_ops);
 }
 
+/*
+ * palloc_params_boot -- reads the heap parameters from the environment
+ */
+void
+palloc_params_boot(void)
+{
+	heap_params_boot();
+}
+
+/*
+ * palloc_format_start -- starts the background formatting of the heap zones
+ */
+void
+palloc_format_start(struct palloc_heap *heap)
+{
+	heap_formatter_start(heap);
+}
+
 /*
  * palloc_init -- initializes palloc heap
  */
@@ -623,6 +914,24 @@ palloc_heap_cleanup(struct palloc_heap *heap)
 	heap_cleanup(heap);
 }
 
+/*
+ * palloc_summary_write -- stores the free space summary of the heap
+ */
+uint64_t
+palloc_summary_write(struct palloc_heap *heap)
+{
+	return heap_summary_write(heap);
+}
+
+/*
+ * palloc_summary_load -- creates volatile heap state from the summary
+ */
+int
+palloc_summary_load(struct palloc_heap *heap, uint64_t off)
+{
+	return heap_summary_load(heap, off);
+}
+
 #ifdef USE_VG_MEMCHECK
 /*
  * palloc_vg_register_object -- registers object in Valgrind
@@ -631,7 +940,7 @@ void
 palloc_vg_register_object(struct palloc_heap *heap, PMEMoid oid, size_t size)
 {
 	void *addr = pmemobj_direct(oid);
-	size_t headers = sizeof(struct allocation_header) + PALLOC_DATA_OFF;
+	size_t headers = ALLOC_OFF(heap);
 
 	VALGRIND_DO_MEMPOOL_ALLOC(heap->layout, addr, size);
 	VALGRIND_DO_MAKE_MEM_DEFINED((char *)addr - headers, size + headers);
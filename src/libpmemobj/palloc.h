@@ -44,10 +44,21 @@
 #include "redo.h"
 
 /*
- * Number of bytes between end of allocation header and beginning of user data.
+ * Number of bytes between end of allocation header and beginning of user data
+ * in heaps with legacy headers.
  */
 #define PALLOC_DATA_OFF 48
 
+/* formats of the object headers, fixed when the heap is created */
+enum palloc_header_type {
+	/* allocation header followed by PALLOC_DATA_OFF bytes */
+	HEADER_LEGACY,
+	/* 16 byte header, user data right after it */
+	HEADER_COMPACT,
+
+	MAX_HEADER_TYPES
+};
+
 struct palloc_heap {
 	struct pmem_ops p_ops;
 	struct heap_layout *layout;
@@ -55,22 +66,33 @@ struct palloc_heap {
 	uint64_t size;
 
 	void *base;
+
+	/* must be set before the heap is booted */
+	enum palloc_header_type header_type;
+	int aligned_allocs; /* objects can be moved to a stricter alignment */
 };
 
 typedef int (*palloc_constr)(void *base, void *ptr,
 		size_t usable_size, void *arg);
 
 int palloc_operation(struct palloc_heap *heap, uint64_t off, uint64_t *dest_off,
-	size_t size, palloc_constr constructor, void *arg,
+	size_t size, size_t alignment, palloc_constr constructor, void *arg,
 	struct operation_context *ctx);
 
 uint64_t palloc_first(struct palloc_heap *heap);
 uint64_t palloc_next(struct palloc_heap *heap, uint64_t off);
 
+typedef int (*palloc_foreach_cb)(uint64_t off, void *arg);
+void palloc_foreach(struct palloc_heap *heap, palloc_foreach_cb cb, void *arg);
+int palloc_foreach_parallel(struct palloc_heap *heap, unsigned nthreads,
+	palloc_foreach_cb cb, void *arg);
+
 size_t palloc_usable_size(struct palloc_heap *heap, uint64_t off);
 
+void palloc_params_boot(void);
 int palloc_boot(struct palloc_heap *heap, void *heap_start,
 		uint64_t heap_size, void *base, struct pmem_ops *p_ops);
+void palloc_format_start(struct palloc_heap *heap);
 
 int palloc_init(void *heap_start, uint64_t heap_size, struct pmem_ops *p_ops);
 void *palloc_heap_end(struct palloc_heap *h);
@@ -78,6 +100,8 @@ int palloc_heap_check(void *heap_start, uint64_t heap_size);
 int palloc_heap_check_remote(void *heap_start, uint64_t heap_size,
 		struct remote_ops *ops);
 void palloc_heap_cleanup(struct palloc_heap *heap);
+uint64_t palloc_summary_write(struct palloc_heap *heap);
+int palloc_summary_load(struct palloc_heap *heap, uint64_t off);
 
 void palloc_vg_register_object(struct palloc_heap *heap, PMEMoid oid,
 		size_t size);
@@ -45,6 +45,7 @@
 #include "out.h"
 #include "palloc.h"
 #include "pmalloc.h"
+#include "type_index.h"
 #include "valgrind_internal.h"
 
 /*
@@ -61,6 +62,16 @@ pmalloc_redo_hold(PMEMobjpool *pop)
 	return sec->redo;
 }
 
+/*
+ * pmalloc_redo_nentries -- returns the number of entries in the redo log of
+ *	the allocator lane section
+ */
+size_t
+pmalloc_redo_nentries(PMEMobjpool *pop)
+{
+	return ALLOC_REDO_NUM_ENTRIES(OBJ_LANE_SECTION_LEN(pop));
+}
+
 /*
  * pmalloc_redo_release -- releases allocator lane section
  */
@@ -77,22 +88,50 @@ pmalloc_redo_release(PMEMobjpool *pop)
  */
 int
 pmalloc_operation(struct palloc_heap *heap, uint64_t off, uint64_t *dest_off,
-	size_t size, palloc_constr constructor, void *arg,
+	size_t size, size_t alignment, palloc_constr constructor, void *arg,
 	struct operation_context *ctx)
 {
-#ifdef USE_VG_MEMCHECK
-	uint64_t tmp;
-	if (size && On_valgrind && dest_off == NULL)
-		dest_off = &tmp;
-#endif
+	PMEMobjpool *pop = heap->base;
+
+	/*
+	 * The offset of a new object is needed to record it in the type
+	 * index, even if the caller is not interested in it.
+	 */
+	uint64_t new_off;
+	if (size && dest_off == NULL)
+		dest_off = &new_off;
+
+	/*
+	 * The old object is removed from the type index before it is freed,
+	 * while its header is still valid, so that a concurrent allocation
+	 * which reuses its memory cannot be recorded first and then forgotten.
+	 */
+	struct type_index *idx = pop->type_index;
+	uint64_t gen = 0;
+	if (idx != NULL && off != 0)
+		gen = type_index_remove(idx, pop, off);
+
+	int ret = palloc_operation(heap, off, dest_off, size, alignment,
+			constructor, arg, ctx);
+
+	/* the index might have been created while the operation was running */
+	if ((idx = pop->type_index) != NULL) {
+		if (ret != 0) {
+			if (off != 0)
+				type_index_insert(idx, pop, off);
+		} else {
+			if (off != 0)
+				type_index_validate(idx, gen);
+			if (size != 0)
+				type_index_insert(idx, pop, *dest_off);
+		}
+	}
 
-	int ret = palloc_operation(heap, off, dest_off, size, constructor, arg,
-			ctx);
 	if (ret)
 		return ret;
 
 #ifdef USE_VG_MEMCHECK
-	if (size && On_valgrind) {
+	if (size && On_valgrind && heap->header_type == HEADER_LEGACY) {
 		struct oob_header *pobj =
 			OOB_HEADER_FROM_PTR((char *)heap->base + *dest_off);
 
@@ -122,9 +161,11 @@ pmalloc(PMEMobjpool *pop, uint64_t *off, size_t size)
 	struct redo_log *redo = pmalloc_redo_hold(pop);
 
 	struct operation_context ctx;
-	operation_init(&ctx, pop, pop->redo, redo);
+	operation_init(&ctx, pop, pop->redo, redo,
+		pmalloc_redo_nentries(pop));
 
-	int ret = pmalloc_operation(&pop->heap, 0, off, size, NULL, NULL, &ctx);
+	int ret = pmalloc_operation(&pop->heap, 0, off, size, 0, NULL, NULL,
+			&ctx);
 
 	pmalloc_redo_release(pop);
 
@@ -146,10 +187,11 @@ pmalloc_construct(PMEMobjpool *pop, uint64_t *off, size_t size,
 	struct redo_log *redo = pmalloc_redo_hold(pop);
 	struct operation_context ctx;
 
-	operation_init(&ctx, pop, pop->redo, redo);
+	operation_init(&ctx, pop, pop->redo, redo,
+		pmalloc_redo_nentries(pop));
 
-	int ret = pmalloc_operation(&pop->heap, 0, off, size, constructor, arg,
-			&ctx);
+	int ret = pmalloc_operation(&pop->heap, 0, off, size, 0, constructor,
+			arg, &ctx);
 
 	pmalloc_redo_release(pop);
 
@@ -169,9 +211,11 @@ prealloc(PMEMobjpool *pop, uint64_t *off, size_t size)
 	struct redo_log *redo = pmalloc_redo_hold(pop);
 	struct operation_context ctx;
 
-	operation_init(&ctx, pop, pop->redo, redo);
+	operation_init(&ctx, pop, pop->redo, redo,
+		pmalloc_redo_nentries(pop));
 
-	int ret = pmalloc_operation(&pop->heap, *off, off, size, NULL, 0, &ctx);
+	int ret = pmalloc_operation(&pop->heap, *off, off, size, 0, NULL, 0,
+			&ctx);
 
 	pmalloc_redo_release(pop);
 
@@ -193,9 +237,10 @@ prealloc_construct(PMEMobjpool *pop, uint64_t *off, size_t size,
 	struct redo_log *redo = pmalloc_redo_hold(pop);
 	struct operation_context ctx;
 
-	operation_init(&ctx, pop, pop->redo, redo);
+	operation_init(&ctx, pop, pop->redo, redo,
+		pmalloc_redo_nentries(pop));
 
-	int ret = pmalloc_operation(&pop->heap, *off, off, size, constructor,
+	int ret = pmalloc_operation(&pop->heap, *off, off, size, 0, constructor,
 			arg, &ctx);
 
 	pmalloc_redo_release(pop);
@@ -208,20 +253,24 @@ prealloc_construct(PMEMobjpool *pop, uint64_t *off, size_t size,
  *
  * A zero value is written persistently into the off variable.
  *
- * If successful function returns zero. Otherwise an error number is returned.
+ * If successful function returns zero. Otherwise, -1 is returned, errno is
+ * set and the block remains allocated.
  */
-void
+int
 pfree(PMEMobjpool *pop, uint64_t *off)
 {
 	struct redo_log *redo = pmalloc_redo_hold(pop);
 	struct operation_context ctx;
 
-	operation_init(&ctx, pop, pop->redo, redo);
+	operation_init(&ctx, pop, pop->redo, redo,
+		pmalloc_redo_nentries(pop));
 
-	int ret = pmalloc_operation(&pop->heap, *off, off, 0, NULL, NULL, &ctx);
-	ASSERTeq(ret, 0);
+	int ret = pmalloc_operation(&pop->heap, *off, off, 0, 0, NULL, NULL,
+			&ctx);
 
 	pmalloc_redo_release(pop);
+
+	return ret;
 }
 
 /*
@@ -251,7 +300,7 @@ pmalloc_recovery(PMEMobjpool *pop, void *data, unsigned length)
 	struct lane_alloc_layout *sec = data;
 	ASSERT(sizeof(*sec) <= length);
 
-	redo_log_recover(pop->redo, sec->redo, ALLOC_REDO_LOG_SIZE);
+	redo_log_recover(pop->redo, sec->redo, ALLOC_REDO_NUM_ENTRIES(length));
 
 	return 0;
 }
@@ -266,7 +315,8 @@ pmalloc_check(PMEMobjpool *pop, void *data, unsigned length)
 
 	struct lane_alloc_layout *sec = data;
 
-	int ret = redo_log_check(pop->redo, sec->redo, ALLOC_REDO_LOG_SIZE);
+	int ret = redo_log_check(pop->redo, sec->redo,
+		ALLOC_REDO_NUM_ENTRIES(length));
 	if (ret != 0)
 		ERR("allocator lane: redo log check failed");
 
@@ -50,12 +50,19 @@
  * location and the second for applying the chunk metadata modifications.
  */
 #define ALLOC_REDO_LOG_SIZE 10
+
+/*
+ * The number of redo log entries in the allocator section of given length.
+ * Sections longer than the default one are used in their entirety.
+ */
+#define ALLOC_REDO_NUM_ENTRIES(len) ((len) > LANE_SECTION_LEN ?\
+	(len) / sizeof(struct redo_log) : ALLOC_REDO_LOG_SIZE)
 struct lane_alloc_layout {
 	struct redo_log redo[ALLOC_REDO_LOG_SIZE];
 };
 
 int pmalloc_operation(struct palloc_heap *heap,
-	uint64_t off, uint64_t *dest_off, size_t size,
+	uint64_t off, uint64_t *dest_off, size_t size, size_t alignment,
 	palloc_constr constructor, void *arg,
 	struct operation_context *ctx);
 
@@ -67,9 +74,10 @@ int prealloc(PMEMobjpool *pop, uint64_t *off, size_t size);
 int prealloc_construct(PMEMobjpool *pop, uint64_t *off, size_t size,
 	palloc_constr constructor, void *arg);
 
-void pfree(PMEMobjpool *pop, uint64_t *off);
+int pfree(PMEMobjpool *pop, uint64_t *off);
 
 struct redo_log *pmalloc_redo_hold(PMEMobjpool *pop);
+size_t pmalloc_redo_nentries(PMEMobjpool *pop);
 void pmalloc_redo_release(PMEMobjpool *pop);
 
 #endif
@@ -104,10 +104,12 @@ pvector_new(PMEMobjpool *pop, struct pvector *vec)
 		 * the push_back or pop_back methods. Either way there's really
 		 * no point in keeping the array.
 		 */
-		if (nvalues == 0 && last_array != 0 /* 0 array is embedded*/)
-			pfree(pop, &vec->arrays[last_array]);
-		else
+		if (nvalues == 0 && last_array != 0 /* 0 array is embedded*/) {
+			int ret = pfree(pop, &vec->arrays[last_array]);
+			ASSERTeq(ret, 0); /* fits in the redo log of the lane */
+		} else {
 			ctx->nvalues += nvalues;
+		}
 	}
 
 	return ctx;
@@ -262,8 +264,10 @@ pvector_pop_back(struct pvector_context *ctx, entry_op_callback cb)
 	if (cb)
 		cb(ctx->pop, &arrp[s.pos]);
 
-	if (s.pos == 0 && s.idx != 0 /* the array 0 is embedded */)
-		pfree(ctx->pop, &ctx->vec->arrays[s.idx]);
+	if (s.pos == 0 && s.idx != 0 /* the array 0 is embedded */) {
+		int ret = pfree(ctx->pop, &ctx->vec->arrays[s.idx]);
+		ASSERTeq(ret, 0); /* fits in the redo log of the lane */
+	}
 
 	ctx->nvalues--;
 
@@ -36,6 +36,7 @@
 
 #include "redo.h"
 #include "out.h"
+#include "sys_util.h"
 #include "util.h"
 #include "valgrind_internal.h"
 
@@ -45,6 +46,16 @@
 #define REDO_FINISH_FLAG	((uint64_t)1<<0)
 #define REDO_FLAG_MASK		(~REDO_FINISH_FLAG)
 
+#define REDO_CACHELINE_SIZE	64
+#define REDO_CACHELINE(addr)\
+	((uintptr_t)(addr) & ~((uintptr_t)REDO_CACHELINE_SIZE - 1))
+
+/*
+ * Number of preceding entries searched for an already flushed cache line,
+ * limits the cost of processing the large extension redo logs.
+ */
+#define REDO_FLUSH_LOOKBACK	16
+
 struct redo_ctx {
 	void *base;
 
@@ -54,6 +65,17 @@ struct redo_ctx {
 	void *check_offset_ctx;
 
 	unsigned redo_num_entries;
+
+	/*
+	 * flush every entry separately, the flush function also copies
+	 * the flushed range to the replicas
+	 */
+	int replicated;
+
+	/* extension redo log shared by all threads, NULL if there's none */
+	struct redo_log *ext;
+	size_t ext_nentries;
+	pthread_mutex_t *ext_lock;
 };
 
 /*
@@ -77,6 +99,10 @@ redo_log_config_new(void *base,
 	cfg->check_offset = check_offset;
 	cfg->check_offset_ctx = check_offset_ctx;
 	cfg->redo_num_entries = redo_num_entries;
+	cfg->replicated = 0;
+	cfg->ext = NULL;
+	cfg->ext_nentries = 0;
+	cfg->ext_lock = NULL;
 
 	return cfg;
 }
@@ -87,9 +113,77 @@ redo_log_config_new(void *base,
 void
 redo_log_config_delete(struct redo_ctx *ctx)
 {
+	if (ctx->ext_lock != NULL) {
+		util_mutex_destroy(ctx->ext_lock);
+		Free(ctx->ext_lock);
+	}
+
 	Free(ctx);
 }
 
+/*
+ * redo_log_config_set_replicated -- marks the context of a pool with replicas
+ *
+ * A flush of such a pool copies exactly the flushed range to the replicas,
+ * so the entries which share a cache line cannot be flushed just once.
+ */
+void
+redo_log_config_set_replicated(struct redo_ctx *ctx)
+{
+	ctx->replicated = 1;
+}
+
+/*
+ * redo_log_config_set_ext -- attaches the extension redo log to the context
+ *
+ * The extension redo log is used by the operations which do not fit in the
+ * redo log of a lane. The context must have been created with at least
+ * 'nentries' redo entries.
+ */
+int
+redo_log_config_set_ext(struct redo_ctx *ctx, struct redo_log *ext,
+		size_t nentries)
+{
+	ASSERT(nentries <= ctx->redo_num_entries);
+	ASSERTeq(ctx->ext_lock, NULL);
+
+	ctx->ext_lock = Malloc(sizeof(*ctx->ext_lock));
+	if (ctx->ext_lock == NULL) {
+		ERR("!Malloc");
+		return -1;
+	}
+
+	util_mutex_init(ctx->ext_lock, NULL);
+	ctx->ext = ext;
+	ctx->ext_nentries = nentries;
+
+	return 0;
+}
+
+/*
+ * redo_log_ext_hold -- acquires the extension redo log, returns NULL if there
+ *	is none or if it cannot hold 'nentries' entries
+ */
+struct redo_log *
+redo_log_ext_hold(const struct redo_ctx *ctx, size_t nentries)
+{
+	if (ctx->ext == NULL || nentries > ctx->ext_nentries)
+		return NULL;
+
+	util_mutex_lock(ctx->ext_lock);
+
+	return ctx->ext;
+}
+
+/*
+ * redo_log_ext_release -- releases the extension redo log
+ */
+void
+redo_log_ext_release(const struct redo_ctx *ctx)
+{
+	util_mutex_unlock(ctx->ext_lock);
+}
+
 /*
  * redo_log_nflags -- (internal) get number of finish flags set
  */
@@ -171,8 +265,24 @@ redo_log_set_last(const struct redo_ctx *ctx, struct redo_log *redo,
 	pmemops_persist(p_ops, &redo[index].offset, sizeof(redo[index].offset));
 }
 
+/*
+ * redo_log_entry_ptr -- (internal) returns pointer to the target of an entry
+ */
+static inline uint64_t *
+redo_log_entry_ptr(const struct redo_ctx *ctx, const struct redo_log *redo)
+{
+	return (uint64_t *)((uintptr_t)ctx->base +
+		(redo->offset & REDO_FLAG_MASK));
+}
+
 /*
  * redo_log_process -- (internal) process redo log entries
+ *
+ * All of the targets are written first and then the modified cache lines are
+ * flushed, skipping the ones already flushed for one of the nearby entries,
+ * so that the whole log costs a single drain before the finish flag is
+ * cleared. A pool with replicas flushes every entry, since its flushes also
+ * copy the entries to the replicas.
  */
 void
 redo_log_process(const struct redo_ctx *ctx, struct redo_log *redo,
@@ -185,29 +295,46 @@ redo_log_process(const struct redo_ctx *ctx, struct redo_log *redo,
 #endif
 	const struct pmem_ops *p_ops = &ctx->p_ops;
 
+	struct redo_log *last = redo;
 	uint64_t *val;
-	while ((redo->offset & REDO_FINISH_FLAG) == 0) {
-		val = (uint64_t *)((uintptr_t)ctx->base + redo->offset);
+	for (;;) {
+		val = redo_log_entry_ptr(ctx, last);
 		VALGRIND_ADD_TO_TX(val, sizeof(*val));
-		*val = redo->value;
+		*val = last->value;
 		VALGRIND_REMOVE_FROM_TX(val, sizeof(*val));
 
-		pmemops_flush(p_ops, val, sizeof(uint64_t));
+		if (last->offset & REDO_FINISH_FLAG)
+			break;
 
-		redo++;
+		last++;
 	}
 
-	uint64_t offset = redo->offset & REDO_FLAG_MASK;
-	val = (uint64_t *)((uintptr_t)ctx->base + offset);
-	VALGRIND_ADD_TO_TX(val, sizeof(*val));
-	*val = redo->value;
-	VALGRIND_REMOVE_FROM_TX(val, sizeof(*val));
+	for (struct redo_log *e = redo; e <= last; ++e) {
+		val = redo_log_entry_ptr(ctx, e);
+
+		if (ctx->replicated) {
+			pmemops_flush(p_ops, val, sizeof(uint64_t));
+			continue;
+		}
+
+		/* skip cache lines flushed for one of the prior entries */
+		uintptr_t line = REDO_CACHELINE(val);
+		struct redo_log *prev = redo;
+		if ((size_t)(e - redo) > REDO_FLUSH_LOOKBACK)
+			prev = e - REDO_FLUSH_LOOKBACK;
+		while (prev != e &&
+			REDO_CACHELINE(redo_log_entry_ptr(ctx, prev)) != line)
+			prev++;
+
+		if (prev == e)
+			pmemops_flush(p_ops, val, sizeof(uint64_t));
+	}
 
-	pmemops_persist(p_ops, val, sizeof(uint64_t));
+	pmemops_drain(p_ops);
 
-	redo->offset = 0;
+	last->offset = 0;
 
-	pmemops_persist(p_ops, &redo->offset, sizeof(redo->offset));
+	pmemops_persist(p_ops, &last->offset, sizeof(last->offset));
 }
 
 /*
@@ -61,6 +61,13 @@ struct redo_ctx *redo_log_config_new(void *base,
 		unsigned redo_num_entries);
 
 void redo_log_config_delete(struct redo_ctx *ctx);
+void redo_log_config_set_replicated(struct redo_ctx *ctx);
+
+int redo_log_config_set_ext(struct redo_ctx *ctx, struct redo_log *ext,
+		size_t nentries);
+struct redo_log *redo_log_ext_hold(const struct redo_ctx *ctx,
+		size_t nentries);
+void redo_log_ext_release(const struct redo_ctx *ctx);
 
 void redo_log_store(const struct redo_ctx *ctx, struct redo_log *redo,
 		size_t index, uint64_t offset, uint64_t value);
@@ -0,0 +1,560 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * replicator.c -- parallel replication to the local replicas
+ *
+ * Every local replica other than the master one has a worker thread which
+ * applies the updates of the master replica to it. The updates are passed
+ * through a bounded lock-free queue of the worker, so that the threads of the
+ * application which write to the pool do not contend on a lock. Each queue
+ * receives the same updates in the same order, hence the order in which the
+ * updates become persistent is the same in all of the replicas.
+ *
+ * Each update is assigned a ticket, which is the number of updates queued for
+ * the worker up to and including that update. The worker publishes the number
+ * of updates it has made persistent and the submitting thread waits until
+ * all of the workers have reached its ticket. Flushed updates are not waited
+ * for until the next drain, which waits for all of the updates queued so far.
+ *
+ * Flush instructions are only guaranteed to be complete after a fence issued
+ * by the same thread, so the workers drain their own flushes before the
+ * updates are reported as persistent. A worker does so when its queue becomes
+ * empty or after a fixed number of flushes, whichever comes first.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "obj.h"
+#include "out.h"
+#include "replicator.h"
+#include "sys_util.h"
+#include "util.h"
+#include "valgrind_internal.h"
+
+#define REPLICATOR_QUEUE_LEN 1024 /* has to be a power of two */
+#define REPLICATOR_MAX_SPIN 1024 /* pause iterations before backing off */
+#define REPLICATOR_MAX_FLUSHES 64 /* flushes completed by a single drain */
+#define REPLICATOR_CL_SIZE ((size_t)_POBJ_CL_ALIGNMENT)
+
+enum replicator_op {
+	REPLICATOR_MEMCPY_PERSIST,
+	REPLICATOR_MEMSET_PERSIST,
+	REPLICATOR_MEMCPY_FLUSH,
+
+	MAX_REPLICATOR_OP
+};
+
+struct replicator_job {
+	enum replicator_op op;
+	int c; /* value of the memset */
+	uint64_t off; /* offset of the destination from the pool start */
+	const void *src;
+	size_t len;
+};
+
+/*
+ * A slot of the queue, the sequence number equals the position of the slot
+ * in the queue when the slot is free, the position incremented by one once
+ * the job is published and the position of the slot in the next lap once
+ * the worker has taken the job.
+ */
+struct replicator_slot {
+	volatile uint64_t seq;
+	struct replicator_job job;
+};
+
+struct replicator_worker {
+	/* written by the submitting threads */
+	uint64_t tail; /* number of tickets handed out */
+	uint8_t unused1[56];
+
+	/* written by the worker */
+	volatile uint64_t done; /* number of persistent updates */
+	volatile int sleeping;
+	int stop;
+	uint8_t unused2[48];
+
+	struct pmemobjpool *rep;
+	pthread_t thread;
+	pthread_mutex_t lock; /* protects sleeping and stop */
+	pthread_cond_t work; /* signaled when a sleeping worker has a job */
+
+	struct replicator_slot slots[REPLICATOR_QUEUE_LEN];
+};
+
+/* the workers are cache line aligned, so their hot fields don't share lines */
+#define REPLICATOR_WORKER_SIZE\
+	roundup(sizeof(struct replicator_worker), REPLICATOR_CL_SIZE)
+
+struct replicator {
+	uintptr_t base; /* address of the master replica */
+	unsigned nworkers;
+	char *workers; /* array of REPLICATOR_WORKER_SIZE elements */
+};
+
+/*
+ * replicator_worker_get -- (internal) returns the worker with the given index
+ */
+static inline struct replicator_worker *
+replicator_worker_get(struct replicator *r, unsigned i)
+{
+	return (struct replicator_worker *)
+		(r->workers + i * REPLICATOR_WORKER_SIZE);
+}
+
+/*
+ * replicator_backoff -- (internal) spins for a while and then yields
+ */
+static void
+replicator_backoff(unsigned *spins)
+{
+	if (*spins < REPLICATOR_MAX_SPIN) {
+		(*spins)++;
+		util_cpu_relax();
+	} else {
+		sched_yield();
+	}
+}
+
+/*
+ * replicator_publish -- (internal) reports the updates up to the given ticket
+ *	as persistent in the replica of the worker
+ */
+static void
+replicator_publish(struct replicator_worker *w, uint64_t done)
+{
+	/* the updates must be complete before they are reported */
+	__sync_synchronize();
+	VALGRIND_ANNOTATE_HAPPENS_BEFORE(&w->done);
+	w->done = done;
+}
+
+/*
+ * replicator_sleep -- (internal) waits for a job at the given position
+ *
+ * Returns non-zero if the worker was stopped and the queue is empty.
+ */
+static int
+replicator_sleep(struct replicator_worker *w, uint64_t head)
+{
+	struct replicator_slot *slot =
+		&w->slots[head % REPLICATOR_QUEUE_LEN];
+	int stop;
+
+	util_mutex_lock(&w->lock);
+	w->sleeping = 1;
+
+	/* pairs with the barrier between publishing a job and the wakeup */
+	__sync_synchronize();
+
+	while (slot->seq != head + 1 && !w->stop)
+		pthread_cond_wait(&w->work, &w->lock);
+
+	w->sleeping = 0;
+	stop = slot->seq != head + 1;
+	util_mutex_unlock(&w->lock);
+
+	return stop;
+}
+
+/*
+ * replicator_run -- (internal) applies a single update to the replica
+ *
+ * Returns non-zero if the update is only flushed and not yet persistent.
+ */
+static int
+replicator_run(struct pmemobjpool *rep, const struct replicator_job *job)
+{
+	void *dest = (char *)rep + job->off;
+
+	switch (job->op) {
+	case REPLICATOR_MEMCPY_PERSIST:
+		rep->memcpy_persist_local(dest, job->src, job->len);
+		return 0;
+	case REPLICATOR_MEMSET_PERSIST:
+		rep->memset_persist_local(dest, job->c, job->len);
+		return 0;
+	case REPLICATOR_MEMCPY_FLUSH:
+		memcpy(dest, job->src, job->len);
+		rep->flush_local(dest, job->len);
+		return 1;
+	default:
+		FATAL("unknown replicator operation %d", job->op);
+	}
+}
+
+/*
+ * replicator_worker_main -- (internal) worker thread main loop
+ */
+static void *
+replicator_worker_main(void *arg)
+{
+	struct replicator_worker *w = arg;
+	struct pmemobjpool *rep = w->rep;
+	uint64_t head = 0;
+	unsigned flushed = 0; /* number of flushed updates not yet drained */
+	unsigned spins = 0;
+
+	for (;;) {
+		struct replicator_slot *slot =
+			&w->slots[head % REPLICATOR_QUEUE_LEN];
+
+		if (slot->seq != head + 1) {
+			/* the queue is empty, complete the flushed updates */
+			if (flushed) {
+				rep->drain_local();
+				replicator_publish(w, head);
+				flushed = 0;
+			}
+
+			if (spins < REPLICATOR_MAX_SPIN) {
+				replicator_backoff(&spins);
+			} else {
+				if (replicator_sleep(w, head))
+					break;
+				spins = 0;
+			}
+
+			continue;
+		}
+		spins = 0;
+
+		/* the job must not be read before its sequence number */
+		__sync_synchronize();
+		VALGRIND_ANNOTATE_HAPPENS_AFTER(slot);
+
+		struct replicator_job job = slot->job;
+
+		/* the slot can be reused as soon as the job is copied */
+		__sync_synchronize();
+		slot->seq = head + REPLICATOR_QUEUE_LEN;
+		head++;
+
+		if (replicator_run(rep, &job)) {
+			/*
+			 * The flushes are completed in batches, so that the
+			 * threads waiting for them don't depend on the queue
+			 * ever becoming empty.
+			 */
+			if (++flushed == REPLICATOR_MAX_FLUSHES) {
+				rep->drain_local();
+				replicator_publish(w, head);
+				flushed = 0;
+			}
+		} else {
+			/*
+			 * The drain which completes a persist also completes
+			 * all of the preceding flushes of this thread.
+			 */
+			replicator_publish(w, head);
+			flushed = 0;
+		}
+	}
+
+	ASSERTeq(flushed, 0);
+
+	return NULL;
+}
+
+/*
+ * replicator_stop -- (internal) stops and joins the first nworkers workers
+ *
+ * All of the queued updates are applied before the workers exit.
+ */
+static void
+replicator_stop(struct replicator *r, unsigned nworkers)
+{
+	for (unsigned i = 0; i < nworkers; ++i) {
+		struct replicator_worker *w = replicator_worker_get(r, i);
+
+		util_mutex_lock(&w->lock);
+		w->stop = 1;
+		pthread_cond_signal(&w->work);
+		util_mutex_unlock(&w->lock);
+	}
+
+	for (unsigned i = 0; i < nworkers; ++i) {
+		struct replicator_worker *w = replicator_worker_get(r, i);
+
+		pthread_join(w->thread, NULL);
+		ASSERTeq(w->done, w->tail);
+
+		pthread_cond_destroy(&w->work);
+		util_mutex_destroy(&w->lock);
+	}
+}
+
+/*
+ * replicator_new -- creates a worker thread for each of the local replicas
+ *	of the pool other than the master one
+ */
+struct replicator *
+replicator_new(struct pmemobjpool *pop)
+{
+	LOG(3, "pop %p", pop);
+
+	unsigned nworkers = 0;
+	for (PMEMobjpool *rep = pop->replica; rep != NULL; rep = rep->replica) {
+		if (rep->rpp == NULL)
+			nworkers++;
+	}
+
+	ASSERTne(nworkers, 0);
+
+	struct replicator *r = Malloc(sizeof(*r) + REPLICATOR_CL_SIZE - 1 +
+		nworkers * REPLICATOR_WORKER_SIZE);
+	if (r == NULL) {
+		ERR("!Malloc");
+		return NULL;
+	}
+
+	int ret;
+	r->base = (uintptr_t)pop;
+	r->workers = (char *)roundup((uintptr_t)(r + 1), REPLICATOR_CL_SIZE);
+	r->nworkers = 0;
+	for (PMEMobjpool *rep = pop->replica; rep != NULL; rep = rep->replica) {
+		if (rep->rpp != NULL)
+			continue;
+
+		struct replicator_worker *w =
+			replicator_worker_get(r, r->nworkers);
+		w->tail = 0;
+		w->done = 0;
+		w->sleeping = 0;
+		w->stop = 0;
+		w->rep = rep;
+		for (uint64_t i = 0; i < REPLICATOR_QUEUE_LEN; ++i)
+			w->slots[i].seq = i;
+
+		util_mutex_init(&w->lock, NULL);
+		pthread_cond_init(&w->work, NULL);
+
+		ret = pthread_create(&w->thread, NULL, replicator_worker_main,
+			w);
+		if (ret != 0) {
+			pthread_cond_destroy(&w->work);
+			util_mutex_destroy(&w->lock);
+			errno = ret;
+			ERR("!pthread_create");
+			goto error_thread_create;
+		}
+
+		r->nworkers++;
+	}
+
+	return r;
+
+error_thread_create:
+	replicator_stop(r, r->nworkers);
+	Free(r);
+	errno = ret;
+	return NULL;
+}
+
+/*
+ * replicator_delete -- applies all of the queued updates, stops the workers
+ *	and frees the replicator
+ */
+void
+replicator_delete(struct replicator *r)
+{
+	LOG(3, "r %p", r);
+
+	replicator_stop(r, r->nworkers);
+	Free(r);
+}
+
+/*
+ * replicator_push -- (internal) queues the update for all of the workers
+ *
+ * Returns the ticket of the update.
+ */
+static uint64_t
+replicator_push(struct replicator *r, const struct replicator_job *job)
+{
+	uint64_t ticket = 0;
+
+	for (unsigned i = 0; i < r->nworkers; ++i) {
+		struct replicator_worker *w = replicator_worker_get(r, i);
+
+		uint64_t pos = __sync_fetch_and_add(&w->tail, 1);
+		struct replicator_slot *slot =
+			&w->slots[pos % REPLICATOR_QUEUE_LEN];
+
+		/* the queue is full, the worker has to free the slot first */
+		unsigned spins = 0;
+		while (slot->seq != pos)
+			replicator_backoff(&spins);
+
+		__sync_synchronize();
+		slot->job = *job;
+
+		/* the job and the data must be visible before the job */
+		__sync_synchronize();
+		VALGRIND_ANNOTATE_HAPPENS_BEFORE(slot);
+		slot->seq = pos + 1;
+
+		/* pairs with the barrier in replicator_sleep */
+		__sync_synchronize();
+		if (w->sleeping) {
+			util_mutex_lock(&w->lock);
+			pthread_cond_signal(&w->work);
+			util_mutex_unlock(&w->lock);
+		}
+
+		/*
+		 * All of the workers receive the same number of updates, so
+		 * waiting for the highest of the positions is enough.
+		 */
+		if (pos + 1 > ticket)
+			ticket = pos + 1;
+	}
+
+	return ticket;
+}
+
+/*
+ * replicator_memcpy_persist -- queues a copy of the source buffer to the
+ *	address of all of the replicas which corresponds to the destination
+ *	address of the master replica
+ *
+ * The source buffer must not change until the update is waited for.
+ */
+uint64_t
+replicator_memcpy_persist(struct replicator *r, const void *dest,
+	const void *src, size_t len)
+{
+	LOG(15, "r %p dest %p src %p len %zu", r, dest, src, len);
+
+	struct replicator_job job = {
+		.op = REPLICATOR_MEMCPY_PERSIST,
+		.c = 0,
+		.off = (uintptr_t)dest - r->base,
+		.src = src,
+		.len = len,
+	};
+
+	return replicator_push(r, &job);
+}
+
+/*
+ * replicator_memset_persist -- queues a memset of the address of all of the
+ *	replicas which corresponds to the destination address of the master
+ *	replica
+ */
+uint64_t
+replicator_memset_persist(struct replicator *r, const void *dest, int c,
+	size_t len)
+{
+	LOG(15, "r %p dest %p c 0x%02x len %zu", r, dest, c, len);
+
+	struct replicator_job job = {
+		.op = REPLICATOR_MEMSET_PERSIST,
+		.c = c,
+		.off = (uintptr_t)dest - r->base,
+		.src = NULL,
+		.len = len,
+	};
+
+	return replicator_push(r, &job);
+}
+
+/*
+ * replicator_flush -- queues a copy of the range of the master replica to all
+ *	of the replicas, which does not have to be persistent until the next
+ *	replicator_drain
+ *
+ * The range is read by the workers asynchronously, so its contents in
+ * the replicas may already include later modifications.
+ */
+uint64_t
+replicator_flush(struct replicator *r, const void *addr, size_t len)
+{
+	LOG(15, "r %p addr %p len %zu", r, addr, len);
+
+	struct replicator_job job = {
+		.op = REPLICATOR_MEMCPY_FLUSH,
+		.c = 0,
+		.off = (uintptr_t)addr - r->base,
+		.src = addr,
+		.len = len,
+	};
+
+	return replicator_push(r, &job);
+}
+
+/*
+ * replicator_wait -- waits until the update with the given ticket, and all
+ *	of the updates queued before it, are persistent in all of the replicas
+ */
+void
+replicator_wait(struct replicator *r, uint64_t ticket)
+{
+	LOG(15, "r %p ticket %ju", r, ticket);
+
+	for (unsigned i = 0; i < r->nworkers; ++i) {
+		struct replicator_worker *w = replicator_worker_get(r, i);
+
+		unsigned spins = 0;
+		while (w->done < ticket)
+			replicator_backoff(&spins);
+
+		VALGRIND_ANNOTATE_HAPPENS_AFTER(&w->done);
+	}
+
+	/* nothing which follows may be reordered with the updates */
+	__sync_synchronize();
+}
+
+/*
+ * replicator_drain -- waits until all of the updates queued so far are
+ *	persistent in all of the replicas
+ */
+void
+replicator_drain(struct replicator *r)
+{
+	LOG(15, "r %p", r);
+
+	uint64_t ticket = 0;
+	for (unsigned i = 0; i < r->nworkers; ++i) {
+		struct replicator_worker *w = replicator_worker_get(r, i);
+		uint64_t tail = *(volatile uint64_t *)&w->tail;
+		if (tail > ticket)
+			ticket = tail;
+	}
+
+	replicator_wait(r, ticket);
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * replicator.h -- internal definitions for parallel replication to the local
+ *	replicas
+ */
+
+#ifndef LIBPMEMOBJ_REPLICATOR_H
+#define LIBPMEMOBJ_REPLICATOR_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct pmemobjpool;
+struct replicator;
+
+struct replicator *replicator_new(struct pmemobjpool *pop);
+void replicator_delete(struct replicator *r);
+
+uint64_t replicator_memcpy_persist(struct replicator *r, const void *dest,
+	const void *src, size_t len);
+uint64_t replicator_memset_persist(struct replicator *r, const void *dest,
+	int c, size_t len);
+uint64_t replicator_flush(struct replicator *r, const void *addr, size_t len);
+
+void replicator_wait(struct replicator *r, uint64_t ticket);
+void replicator_drain(struct replicator *r);
+
+#endif
@@ -38,8 +38,17 @@
 #include "out.h"
 #include "sync.h"
 #include "sys_util.h"
+#include "util.h"
 #include "valgrind_internal.h"
 
+/* the upper limit of the number of pause instructions between two attempts */
+#define SYNC_BACKOFF_MAX 32
+
+typedef int (*sync_trylock_fn)(void *lock);
+typedef int (*sync_lock_fn)(void *lock);
+typedef int (*sync_timedlock_fn)(void *lock,
+	const struct timespec *abs_timeout);
+
 #define GET_MUTEX(pop, mutexp)\
 get_lock((pop)->run_id,\
 	&(mutexp)->pmemmutex.runid,\
@@ -62,6 +71,27 @@ get_lock((pop)->run_id,\
 	(void *)pthread_cond_init,\
 	sizeof((condp)->pmemcond.cond))
 
+#define GET_SEQLOCK(pop, seqlockp)\
+get_lock((pop)->run_id,\
+	&(seqlockp)->pmemseqlock.runid,\
+	&(seqlockp)->pmemseqlock.seq,\
+	seqlock_init,\
+	sizeof((seqlockp)->pmemseqlock.seq))
+
+/*
+ * seqlock_init -- (internal) initialize the sequence counter of a seqlock
+ *
+ * A writer which did not finish before the previous run of the pool ended
+ * leaves the counter odd, so it has to be reset along with the run_id.
+ */
+static int
+seqlock_init(void *lock, void *arg)
+{
+	*(uint64_t *)lock = 0;
+
+	return 0;
+}
+
 /*
  * _get_lock -- (internal) atomically initialize and return a lock
  */
@@ -114,6 +144,310 @@ get_lock(uint64_t pop_runid, volatile uint64_t *runid, void *lock,
 	return _get_lock(pop_runid, runid, lock, init_lock, size);
 }
 
+/*
+ * sync_stats_slot -- (internal) returns the slot of the hash table with
+ *	contention statistics which holds the key, if insert is set a free slot
+ *	is claimed for a key which is not in the table yet
+ *
+ * The table is never resized and its slots are never released before the
+ * pool is closed, so both lookups and inserts are lock-free.
+ */
+static struct pobj_lock_stats *
+sync_stats_slot(struct sync_stats *table, uint64_t key, int insert)
+{
+	/* locks are cache line aligned, the low bits of the offset are 0 */
+	uint64_t h = (key >> 6) * 0x9E3779B97F4A7C15ULL;
+
+	for (unsigned i = 0; i < SYNC_STATS_SLOTS; ++i) {
+		struct sync_stats_entry *e =
+			&table->entries[(h + i) % SYNC_STATS_SLOTS];
+
+		uint64_t cur = e->key;
+		if (cur == 0) {
+			if (!insert)
+				return NULL;
+
+			if (!__sync_bool_compare_and_swap(&e->key, 0, key)) {
+				cur = e->key;
+				if (cur != key)
+					continue;
+			}
+
+			return &e->stats;
+		}
+
+		if (cur == key)
+			return &e->stats;
+	}
+
+	return NULL;
+}
+
+/*
+ * sync_stats_get -- (internal) returns contention statistics of the lock,
+ *	creates them on first use
+ */
+static struct pobj_lock_stats *
+sync_stats_get(PMEMobjpool *pop, void *lockp)
+{
+	struct sync_stats *table = pop->lock_stats;
+	if (table == NULL)
+		return NULL;
+
+	uint64_t key = (uint64_t)((uintptr_t)lockp - (uintptr_t)pop);
+
+	return sync_stats_slot(table, key, 1);
+}
+
+/*
+ * sync_stats_read -- (internal) copies contention statistics of the lock
+ */
+static void
+sync_stats_read(PMEMobjpool *pop, void *lockp, struct pobj_lock_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	if (pop->lock_stats == NULL)
+		return;
+
+	uint64_t key = (uint64_t)((uintptr_t)lockp - (uintptr_t)pop);
+	struct pobj_lock_stats *s = sync_stats_slot(pop->lock_stats, key, 0);
+	if (s != NULL)
+		*stats = *s;
+}
+
+/*
+ * sync_mutex_trylock -- (internal) wraps pthread_mutex_trylock
+ */
+static int
+sync_mutex_trylock(void *lock)
+{
+	return pthread_mutex_trylock(lock);
+}
+
+/*
+ * sync_mutex_lock -- (internal) wraps pthread_mutex_lock
+ */
+static int
+sync_mutex_lock(void *lock)
+{
+	return pthread_mutex_lock(lock);
+}
+
+/*
+ * sync_mutex_timedlock -- (internal) wraps pthread_mutex_timedlock
+ */
+static int
+sync_mutex_timedlock(void *lock, const struct timespec *abs_timeout)
+{
+	return pthread_mutex_timedlock(lock, abs_timeout);
+}
+
+/*
+ * sync_rwlock_tryrdlock -- (internal) wraps pthread_rwlock_tryrdlock
+ */
+static int
+sync_rwlock_tryrdlock(void *lock)
+{
+	return pthread_rwlock_tryrdlock(lock);
+}
+
+/*
+ * sync_rwlock_rdlock -- (internal) wraps pthread_rwlock_rdlock
+ */
+static int
+sync_rwlock_rdlock(void *lock)
+{
+	return pthread_rwlock_rdlock(lock);
+}
+
+/*
+ * sync_rwlock_timedrdlock -- (internal) wraps pthread_rwlock_timedrdlock
+ */
+static int
+sync_rwlock_timedrdlock(void *lock, const struct timespec *abs_timeout)
+{
+	return pthread_rwlock_timedrdlock(lock, abs_timeout);
+}
+
+/*
+ * sync_rwlock_trywrlock -- (internal) wraps pthread_rwlock_trywrlock
+ */
+static int
+sync_rwlock_trywrlock(void *lock)
+{
+	return pthread_rwlock_trywrlock(lock);
+}
+
+/*
+ * sync_rwlock_wrlock -- (internal) wraps pthread_rwlock_wrlock
+ */
+static int
+sync_rwlock_wrlock(void *lock)
+{
+	return pthread_rwlock_wrlock(lock);
+}
+
+/*
+ * sync_rwlock_timedwrlock -- (internal) wraps pthread_rwlock_timedwrlock
+ */
+static int
+sync_rwlock_timedwrlock(void *lock, const struct timespec *abs_timeout)
+{
+	return pthread_rwlock_timedwrlock(lock, abs_timeout);
+}
+
+/*
+ * sync_spin -- (internal) tries to take a contended lock for a bounded number
+ *	of attempts, with an exponential backoff between them
+ */
+static int
+sync_spin(unsigned max_spin, sync_trylock_fn trylock, void *lock)
+{
+	unsigned backoff = 1;
+
+	for (unsigned i = 0; i < max_spin; ++i) {
+		for (unsigned j = 0; j < backoff; ++j)
+			util_cpu_relax();
+
+		if (trylock(lock) == 0)
+			return 0;
+
+		if (backoff < SYNC_BACKOFF_MAX)
+			backoff <<= 1;
+	}
+
+	return EBUSY;
+}
+
+/*
+ * sync_lock -- (internal) takes the lock, spinning briefly before the thread
+ *	is put to sleep if the lock is contended
+ *
+ * If abs_timeout is not NULL, the timedlock function is used to sleep.
+ */
+static int
+sync_lock(PMEMobjpool *pop, void *lockp, void *lock,
+	sync_trylock_fn trylock, sync_lock_fn lockfn,
+	sync_timedlock_fn timedlockfn, const struct timespec *abs_timeout)
+{
+	unsigned max_spin = pop->lock_max_spin;
+	struct pobj_lock_stats *stats = pop->lock_stats_enabled ?
+		sync_stats_get(pop, lockp) : NULL;
+	int ret;
+
+	if (max_spin == 0 && stats == NULL)
+		goto park;
+
+	if ((ret = trylock(lock)) != EBUSY)
+		goto out;
+
+	if (stats)
+		__sync_fetch_and_add(&stats->contended, 1);
+
+	if (sync_spin(max_spin, trylock, lock) == 0) {
+		if (stats)
+			__sync_fetch_and_add(&stats->spun, 1);
+		ret = 0;
+		goto out;
+	}
+
+	if (stats)
+		__sync_fetch_and_add(&stats->parked, 1);
+
+park:
+	ret = abs_timeout ? timedlockfn(lock, abs_timeout) : lockfn(lock);
+
+out:
+	if (ret == 0 && stats)
+		__sync_fetch_and_add(&stats->acquired, 1);
+
+	return ret;
+}
+
+/*
+ * sync_stats_cleanup -- frees contention statistics of all locks in the pool
+ */
+void
+sync_stats_cleanup(PMEMobjpool *pop)
+{
+	Free(pop->lock_stats);
+	pop->lock_stats = NULL;
+}
+
+/*
+ * pmemobj_lock_set_max_spin -- sets the number of attempts to take
+ *	a contended lock before going to sleep
+ */
+int
+pmemobj_lock_set_max_spin(PMEMobjpool *pop, unsigned spins)
+{
+	LOG(3, "pop %p spins %u", pop, spins);
+
+	if (spins > SYNC_MAX_SPIN) {
+		ERR("spin count %u too large, max %u", spins, SYNC_MAX_SPIN);
+		return EINVAL;
+	}
+
+	pop->lock_max_spin = spins;
+
+	return 0;
+}
+
+/*
+ * pmemobj_lock_stats_enable -- enables or disables lock contention statistics
+ */
+int
+pmemobj_lock_stats_enable(PMEMobjpool *pop, int enable)
+{
+	LOG(3, "pop %p enable %d", pop, enable);
+
+	if (enable && pop->lock_stats == NULL) {
+		struct sync_stats *table = Zalloc(sizeof(*table));
+		if (table == NULL) {
+			ERR("!Zalloc");
+			return ENOMEM;
+		}
+
+		if (!__sync_bool_compare_and_swap(&pop->lock_stats, NULL,
+				table))
+			Free(table);
+	}
+
+	pop->lock_stats_enabled = enable != 0;
+
+	return 0;
+}
+
+/*
+ * pmemobj_mutex_stats -- returns contention statistics of a pmem resident mutex
+ */
+int
+pmemobj_mutex_stats(PMEMobjpool *pop, PMEMmutex *mutexp,
+		struct pobj_lock_stats *stats)
+{
+	LOG(3, "pop %p mutex %p stats %p", pop, mutexp, stats);
+
+	sync_stats_read(pop, mutexp, stats);
+
+	return 0;
+}
+
+/*
+ * pmemobj_rwlock_stats -- returns contention statistics of a pmem resident
+ *	rwlock
+ */
+int
+pmemobj_rwlock_stats(PMEMobjpool *pop, PMEMrwlock *rwlockp,
+		struct pobj_lock_stats *stats)
+{
+	LOG(3, "pop %p rwlock %p stats %p", pop, rwlockp, stats);
+
+	sync_stats_read(pop, rwlockp, stats);
+
+	return 0;
+}
+
 /*
  * pmemobj_mutex_zero -- zero-initialize a pmem resident mutex
  *
@@ -146,7 +480,8 @@ pmemobj_mutex_lock(PMEMobjpool *pop, PMEMmutex *mutexp)
 	if (mutex == NULL)
 		return EINVAL;
 
-	return pthread_mutex_lock(mutex);
+	return sync_lock(pop, mutexp, mutex,
+		sync_mutex_trylock, sync_mutex_lock, NULL, NULL);
 }
 
 /*
@@ -195,7 +530,8 @@ pmemobj_mutex_timedlock(PMEMobjpool *pop, PMEMmutex *__restrict mutexp,
 	if (mutex == NULL)
 		return EINVAL;
 
-	return pthread_mutex_timedlock(mutex, abs_timeout);
+	return sync_lock(pop, mutexp, mutex,
+		sync_mutex_trylock, NULL, sync_mutex_timedlock, abs_timeout);
 }
 
 /*
@@ -266,7 +602,8 @@ pmemobj_rwlock_rdlock(PMEMobjpool *pop, PMEMrwlock *rwlockp)
 	if (rwlock == NULL)
 		return EINVAL;
 
-	return pthread_rwlock_rdlock(rwlock);
+	return sync_lock(pop, rwlockp, rwlock,
+		sync_rwlock_tryrdlock, sync_rwlock_rdlock, NULL, NULL);
 }
 
 /*
@@ -285,7 +622,8 @@ pmemobj_rwlock_wrlock(PMEMobjpool *pop, PMEMrwlock *rwlockp)
 	if (rwlock == NULL)
 		return EINVAL;
 
-	return pthread_rwlock_wrlock(rwlock);
+	return sync_lock(pop, rwlockp, rwlock,
+		sync_rwlock_trywrlock, sync_rwlock_wrlock, NULL, NULL);
 }
 
 /*
@@ -306,7 +644,9 @@ pmemobj_rwlock_timedrdlock(PMEMobjpool *pop, PMEMrwlock *__restrict rwlockp,
 	if (rwlock == NULL)
 		return EINVAL;
 
-	return pthread_rwlock_timedrdlock(rwlock, abs_timeout);
+	return sync_lock(pop, rwlockp, rwlock,
+		sync_rwlock_tryrdlock, NULL,
+		sync_rwlock_timedrdlock, abs_timeout);
 }
 
 /*
@@ -327,7 +667,9 @@ pmemobj_rwlock_timedwrlock(PMEMobjpool *pop, PMEMrwlock *__restrict rwlockp,
 	if (rwlock == NULL)
 		return EINVAL;
 
-	return pthread_rwlock_timedwrlock(rwlock, abs_timeout);
+	return sync_lock(pop, rwlockp, rwlock,
+		sync_rwlock_trywrlock, NULL,
+		sync_rwlock_timedwrlock, abs_timeout);
 }
 
 /*
@@ -484,3 +826,157 @@ pmemobj_cond_wait(PMEMobjpool *pop, PMEMcond *condp,
 
 	return pthread_cond_wait(cond, mutex);
 }
+
+/*
+ * pmemobj_seqlock_zero -- zero-initialize a pmem resident seqlock
+ *
+ * This function is not MT safe.
+ */
+void
+pmemobj_seqlock_zero(PMEMobjpool *pop, PMEMseqlock *seqlockp)
+{
+	LOG(3, "pop %p seqlock %p", pop, seqlockp);
+
+	PMEMseqlock_internal *seqlockip = (PMEMseqlock_internal *)seqlockp;
+	seqlockip->pmemseqlock.runid = 0;
+	pmemops_persist(&pop->p_ops, &seqlockip->pmemseqlock.runid,
+			sizeof(seqlockip->pmemseqlock.runid));
+}
+
+/*
+ * sync_seqlock_backoff -- (internal) waits before the next attempt to access
+ *	a seqlock, the exponential backoff turns into yielding at its limit
+ */
+static void
+sync_seqlock_backoff(unsigned *backoff)
+{
+	if (*backoff < SYNC_BACKOFF_MAX) {
+		for (unsigned i = 0; i < *backoff; ++i)
+			util_cpu_relax();
+		*backoff <<= 1;
+	} else {
+		sched_yield();
+	}
+}
+
+/*
+ * pmemobj_seqlock_read_begin -- start a read-side critical section of a pmem
+ *	resident seqlock
+ *
+ * Waits until there is no active writer, spinning with an exponential backoff
+ * and then yielding the processor, and returns the sequence number which
+ * has to be passed to pmemobj_seqlock_read_retry. Does not write to the lock,
+ * unless it has to be initialized in the current run of the pool.
+ */
+uint64_t
+pmemobj_seqlock_read_begin(PMEMobjpool *pop, PMEMseqlock *seqlockp)
+{
+	LOG(15, "pop %p seqlock %p", pop, seqlockp);
+
+	PMEMseqlock_internal *seqlockip = (PMEMseqlock_internal *)seqlockp;
+	volatile uint64_t *seq = GET_SEQLOCK(pop, seqlockip);
+	/* initialization of a seqlock cannot fail */
+	ASSERTne(seq, NULL);
+
+	/* a writer can hold the lock for a whole transaction, don't burn cpu */
+	unsigned backoff = 1;
+	uint64_t ret;
+	while ((ret = *seq) & 1)
+		sync_seqlock_backoff(&backoff);
+
+	/* the protected data must not be read before the sequence number */
+	__sync_synchronize();
+
+	return ret;
+}
+
+/*
+ * pmemobj_seqlock_read_retry -- end a read-side critical section of a pmem
+ *	resident seqlock
+ *
+ * Returns non-zero if a writer has modified the protected data since
+ * the corresponding pmemobj_seqlock_read_begin call, in which case the data
+ * read in between is inconsistent and the read has to be repeated.
+ */
+int
+pmemobj_seqlock_read_retry(PMEMobjpool *pop, PMEMseqlock *seqlockp,
+		uint64_t seq)
+{
+	LOG(15, "pop %p seqlock %p seq %ju", pop, seqlockp, seq);
+
+	PMEMseqlock_internal *seqlockip = (PMEMseqlock_internal *)seqlockp;
+
+	/* the protected data must be read before the sequence number */
+	__sync_synchronize();
+
+	return *(volatile uint64_t *)&seqlockip->pmemseqlock.seq != seq;
+}
+
+/*
+ * pmemobj_seqlock_write_trylock -- trylock a pmem resident seqlock for writing
+ */
+int
+pmemobj_seqlock_write_trylock(PMEMobjpool *pop, PMEMseqlock *seqlockp)
+{
+	LOG(3, "pop %p seqlock %p", pop, seqlockp);
+
+	PMEMseqlock_internal *seqlockip = (PMEMseqlock_internal *)seqlockp;
+	volatile uint64_t *seq = GET_SEQLOCK(pop, seqlockip);
+	if (seq == NULL)
+		return EINVAL;
+
+	uint64_t cur = *seq;
+	if ((cur & 1) || !__sync_bool_compare_and_swap(seq, cur, cur + 1))
+		return EBUSY;
+
+	return 0;
+}
+
+/*
+ * pmemobj_seqlock_write_lock -- lock a pmem resident seqlock for writing
+ *
+ * Writers spin with an exponential backoff and yield the processor once
+ * the backoff reaches its limit.
+ */
+int
+pmemobj_seqlock_write_lock(PMEMobjpool *pop, PMEMseqlock *seqlockp)
+{
+	LOG(3, "pop %p seqlock %p", pop, seqlockp);
+
+	PMEMseqlock_internal *seqlockip = (PMEMseqlock_internal *)seqlockp;
+	volatile uint64_t *seq = GET_SEQLOCK(pop, seqlockip);
+	if (seq == NULL)
+		return EINVAL;
+
+	unsigned backoff = 1;
+	for (;;) {
+		uint64_t cur = *seq;
+		if (!(cur & 1) &&
+			__sync_bool_compare_and_swap(seq, cur, cur + 1))
+			return 0;
+
+		sync_seqlock_backoff(&backoff);
+	}
+}
+
+/*
+ * pmemobj_seqlock_write_unlock -- unlock a pmem resident seqlock locked for
+ *	writing
+ */
+int
+pmemobj_seqlock_write_unlock(PMEMobjpool *pop, PMEMseqlock *seqlockp)
+{
+	LOG(3, "pop %p seqlock %p", pop, seqlockp);
+
+	PMEMseqlock_internal *seqlockip = (PMEMseqlock_internal *)seqlockp;
+	volatile uint64_t *seq = GET_SEQLOCK(pop, seqlockip);
+	if (seq == NULL)
+		return EINVAL;
+
+	if (!(*seq & 1))
+		return EPERM;
+
+	__sync_fetch_and_add(seq, 1);
+
+	return 0;
+}
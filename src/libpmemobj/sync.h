@@ -71,6 +71,14 @@ typedef union padded_pmemcond {
 	} pmemcond;
 } PMEMcond_internal;
 
+typedef union padded_pmemseqlock {
+	char padding[_POBJ_CL_ALIGNMENT];
+	struct {
+		uint64_t runid;
+		uint64_t seq;	/* odd while a writer holds the lock */
+	} pmemseqlock;
+} PMEMseqlock_internal;
+
 /*
  * pmemobj_mutex_lock_nofail -- pmemobj_mutex_lock variant that never
  * fails from caller perspective. If pmemobj_mutex_lock failed, this function
@@ -103,4 +111,24 @@ pmemobj_mutex_unlock_nofail(PMEMobjpool *pop, PMEMmutex *mutexp)
 
 int pmemobj_mutex_assert_locked(PMEMobjpool *pop, PMEMmutex *mutexp);
 
+/* default number of attempts to take a contended lock before sleeping */
+#define SYNC_MAX_SPIN_DEFAULT 10
+#define SYNC_MAX_SPIN 10000
+
+/* number of locks for which contention statistics can be collected */
+#define SYNC_STATS_SLOTS 4096
+
+/*
+ * open addressed hash table of lock contention statistics, keyed by
+ * the offset of the lock in the pool
+ */
+struct sync_stats {
+	struct sync_stats_entry {
+		uint64_t key;
+		struct pobj_lock_stats stats;
+	} entries[SYNC_STATS_SLOTS];
+};
+
+void sync_stats_cleanup(PMEMobjpool *pop);
+
 #endif
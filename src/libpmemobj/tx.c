@@ -34,12 +34,16 @@
  * tx.c -- transactions implementation
  */
 
+#include <stdlib.h>
 #include <sys/queue.h>
+#include <time.h>
 
 #include "ctree.h"
+#include "flusher.h"
 #include "obj.h"
 #include "out.h"
 #include "pmalloc.h"
+#include "sys_util.h"
 #include "tx.h"
 #include "valgrind_internal.h"
 
@@ -49,14 +53,6 @@
  */
 #define TX_SKIP_ENTRY_VALUE UINT64_MAX
 
-/* Safely modify a single variable during a transaction */
-#define SET_TX_VAR(_pop, _var, _nval)\
-do {\
-	VALGRIND_ADD_TO_TX(&(_var), sizeof(_var));\
-	(_var) = (_nval);\
-	VALGRIND_REMOVE_FROM_TX(&(_var), sizeof(_var));\
-} while (0)
-
 struct tx_data {
 	SLIST_ENTRY(tx_data) tx_entry;
 	jmp_buf env;
@@ -72,6 +68,7 @@ struct tx_lock_data {
 	union {
 		PMEMmutex *mutex;
 		PMEMrwlock *rwlock;
+		PMEMseqlock *seqlock;
 	} lock;
 	enum pobj_tx_lock lock_type;
 	SLIST_ENTRY(tx_lock_data) tx_lock;
@@ -81,18 +78,39 @@ struct tx_undo_runtime {
 	struct pvector_context *ctx[MAX_UNDO_TYPES];
 };
 
+/*
+ * tx_stats -- transaction statistics of a single lane
+ *
+ * A lane is held by at most one thread at a time, which means that
+ * the counters can be updated without any synchronization. They are summed
+ * up across all of the lanes only when queried.
+ */
+struct tx_stats {
+	struct pobj_tx_stats total;
+
+	/* counters of the currently running outermost transaction */
+	uint64_t snapshot_bytes;
+	uint64_t add_ranges;
+	uint64_t allocs;
+	uint64_t frees;
+};
+
 struct lane_tx_runtime {
 	PMEMobjpool *pop;
 	struct ctree *ranges;
+	struct ctree *persisted; /* ranges already written with NT stores */
+	struct ctree *allocs; /* objects allocated by the tx, to undo entries */
+	struct ctree *region_allocs; /* objects allocated from regions */
 	unsigned cache_slot;
 	struct tx_undo_runtime undo;
+	struct tx_stats *stats; /* NULL if statistics are disabled */
+	int post_commit_pending; /* post commit phase has been deferred */
 	SLIST_HEAD(txd, tx_data) tx_entries;
 	SLIST_HEAD(txl, tx_lock_data) tx_locks;
 };
 
 struct tx_alloc_args {
 	type_num_t type_num;
-	uint64_t entry_offset;
 };
 
 struct tx_alloc_copy_args {
@@ -106,8 +124,17 @@ struct tx_add_range_args {
 	PMEMobjpool *pop;
 	uint64_t offset;
 	uint64_t size;
+	int persisted; /* range is going to be written and persisted */
 };
 
+/*
+ * TX_STATS_ADD -- (internal) increments a counter of the current transaction
+ */
+#define TX_STATS_ADD(_lane, _field, _val) do {\
+	if ((_lane)->stats != NULL)\
+		(_lane)->stats->_field += (_val);\
+} while (0)
+
 /*
  * tx_clr_flag -- flags for clearing undo log list
  */
@@ -117,6 +144,26 @@ enum tx_clr_flag {
 	TX_CLR_FLAG_VG_TX_REMOVE = 1 << 2, /* remove from valgrind tx */
 };
 
+/* default minimal size of a range flushed by the helper threads */
+#define TX_FLUSH_THRESHOLD_DEFAULT (4 * 1024 * 1024)
+
+/*
+ * Parallel commit flush parameters, set by the PMEMOBJ_TX_FLUSH_THREADS and
+ * PMEMOBJ_TX_FLUSH_THRESHOLD environment variables. The helper threads are
+ * shared by all of the pools and started on first use.
+ */
+static unsigned Tx_flush_threads;
+static size_t Tx_flush_threshold = TX_FLUSH_THRESHOLD_DEFAULT;
+static struct flusher *Tx_flusher;
+static pthread_mutex_t Tx_flusher_lock;
+
+/*
+ * If set by the PMEMOBJ_TX_DEFERRED_POST_COMMIT environment variable,
+ * the post commit phase of a transaction is performed when its lane is used
+ * by the next transaction instead of before pmemobj_tx_commit returns.
+ */
+static int Tx_deferred_post_commit;
+
 /*
  * pmemobj_tx_abort_err -- (internal) pmemobj_tx_abort variant that returns
  * error code
@@ -158,27 +205,21 @@ static int
 constructor_tx_alloc(void *ctx, void *ptr, size_t usable_size, void *arg)
 {
 	LOG(3, NULL);
+	PMEMobjpool *pop = ctx;
 
 	ASSERTne(ptr, NULL);
 	ASSERTne(arg, NULL);
 
 	struct tx_alloc_args *args = arg;
 
-	struct oob_header *oobh = OOB_HEADER_FROM_PTR(ptr);
-
 	/* temporarily add the OOB header */
-	VALGRIND_ADD_TO_TX(oobh, OBJ_OOB_SIZE);
+	VALGRIND_ADD_TO_TX((char *)ptr - OBJ_OOB_OFF(pop), OBJ_OOB_OFF(pop));
 
-	/*
-	 * no need to flush and persist because this
-	 * will be done in pre-commit phase
-	 */
-	oobh->type_num = args->type_num;
-	oobh->size = 0;
-	oobh->undo_entry_offset = args->entry_offset;
-	memset(oobh->unused, 0, sizeof(oobh->unused));
+	/* the header is persisted by the allocator */
+	obj_hdr_init(pop, ptr, 0, args->type_num);
 
-	VALGRIND_REMOVE_FROM_TX(oobh, OBJ_OOB_SIZE);
+	VALGRIND_REMOVE_FROM_TX((char *)ptr - OBJ_OOB_OFF(pop),
+		OBJ_OOB_OFF(pop));
 
 	/* do not report changes to the new object */
 	VALGRIND_ADD_TO_TX(ptr, usable_size);
@@ -264,13 +305,13 @@ constructor_tx_add_range(void *ctx, void *ptr, size_t usable_size, void *arg)
 	struct tx_range *range = ptr;
 	const struct pmem_ops *p_ops = &pop->p_ops;
 
-	struct oob_header *oobh = OOB_HEADER_FROM_PTR(ptr);
+	void *hdr = (char *)ptr - OBJ_OOB_OFF(pop);
 	/* temporarily add the object copy to the transaction */
-	VALGRIND_ADD_TO_TX(oobh,
+	VALGRIND_ADD_TO_TX(hdr,
 				sizeof(struct tx_range) + args->size
-				+ OBJ_OOB_SIZE);
+				+ OBJ_OOB_OFF(pop));
 
-	oobh->size = OBJ_INTERNAL_OBJECT_MASK;
+	obj_hdr_init(pop, ptr, 1, 0);
 
 	range->offset = args->offset;
 	range->size = args->size;
@@ -282,9 +323,9 @@ constructor_tx_add_range(void *ctx, void *ptr, size_t usable_size, void *arg)
 	/* memcpy data and persist */
 	pmemops_memcpy_persist(p_ops, range->data, src, args->size);
 
-	VALGRIND_REMOVE_FROM_TX(oobh,
+	VALGRIND_REMOVE_FROM_TX(hdr,
 				sizeof(struct tx_range) + args->size
-				+ OBJ_OOB_SIZE);
+				+ OBJ_OOB_OFF(pop));
 
 	/* do not report changes to the original object */
 	VALGRIND_ADD_TO_TX(src, args->size);
@@ -320,7 +361,9 @@ tx_clear_vec_entry(PMEMobjpool *pop, uint64_t *entry)
 static void
 tx_free_vec_entry(PMEMobjpool *pop, uint64_t *entry)
 {
-	pfree(pop, entry);
+	/* a free of a single block always fits in the redo log of the lane */
+	int ret = pfree(pop, entry);
+	ASSERTeq(ret, 0);
 }
 
 /*
@@ -339,10 +382,10 @@ tx_clear_undo_log_vg(PMEMobjpool *pop, uint64_t off, enum tx_clr_flag flags)
 	 * modifications after abort are not reported.
 	 */
 	if (flags & TX_CLR_FLAG_VG_CLEAN) {
-		struct oob_header *oobh = OOB_HEADER_FROM_OFF(pop, off);
+		void *hdr = (char *)pop + off - OBJ_OOB_OFF(pop);
 		size_t size = palloc_usable_size(&pop->heap, off);
 
-		VALGRIND_SET_CLEAN(oobh, size);
+		VALGRIND_SET_CLEAN(hdr, size);
 	}
 
 	if (flags & TX_CLR_FLAG_VG_TX_REMOVE) {
@@ -352,7 +395,7 @@ tx_clear_undo_log_vg(PMEMobjpool *pop, uint64_t off, enum tx_clr_flag flags)
 		 * is not yet available. Use pmalloc version.
 		 */
 		size_t size = palloc_usable_size(&pop->heap, off) -
-				OBJ_OOB_SIZE;
+				OBJ_OOB_OFF(pop);
 		VALGRIND_REMOVE_FROM_TX(OBJ_OFF_TO_PTR(pop, off), size);
 	}
 #endif
@@ -535,7 +578,8 @@ tx_restore_range(PMEMobjpool *pop, struct tx_range *range)
  */
 static void
 tx_foreach_set(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt,
-	void (*cb)(PMEMobjpool *pop, struct tx_range *range))
+	void (*cb)(PMEMobjpool *pop, struct tx_range *range, void *arg),
+	void *arg)
 {
 	LOG(3, NULL);
 
@@ -544,7 +588,7 @@ tx_foreach_set(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt,
 	struct pvector_context *ctx = tx_rt->ctx[UNDO_SET];
 	for (off = pvector_first(ctx); off != 0; off = pvector_next(ctx)) {
 		range = OBJ_OFF_TO_PTR(pop, off);
-		cb(pop, range);
+		cb(pop, range, arg);
 	}
 
 	struct tx_range_cache *cache;
@@ -552,12 +596,16 @@ tx_foreach_set(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt,
 	for (off = pvector_first(ctx); off != 0; off = pvector_next(ctx)) {
 		cache = OBJ_OFF_TO_PTR(pop, off);
 
-		for (int i = 0; i < MAX_CACHED_RANGES; ++i) {
+		size_t i = 0;
+		while (i < MAX_CACHED_RANGES) {
 			range = (struct tx_range *)&cache->range[i];
 			if (range->offset == 0 || range->size == 0)
 				break;
 
-			cb(pop, range);
+			cb(pop, range, arg);
+
+			/* larger ranges occupy more than one slot */
+			i += TX_RANGE_CACHE_SLOTS(range->size);
 		}
 	}
 }
@@ -566,7 +614,8 @@ tx_foreach_set(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt,
  * tx_abort_restore_range -- (internal) restores content of the memory range
  */
 static void
-tx_abort_restore_range(PMEMobjpool *pop, struct tx_range *range)
+tx_abort_restore_range(PMEMobjpool *pop, struct tx_range *range,
+	void *arg)
 {
 	tx_restore_range(pop, range);
 	VALGRIND_REMOVE_FROM_TX(OBJ_OFF_TO_PTR(pop, range->offset),
@@ -577,7 +626,8 @@ tx_abort_restore_range(PMEMobjpool *pop, struct tx_range *range)
  * tx_abort_recover_range -- (internal) restores content while skipping locks
  */
 static void
-tx_abort_recover_range(PMEMobjpool *pop, struct tx_range *range)
+tx_abort_recover_range(PMEMobjpool *pop, struct tx_range *range,
+	void *arg)
 {
 	void *ptr = OBJ_OFF_TO_PTR(pop, range->offset);
 	pmemops_memcpy_persist(&pop->p_ops, ptr, range->data, range->size);
@@ -592,9 +642,9 @@ tx_abort_set(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt, int recovery)
 	LOG(3, NULL);
 
 	if (recovery)
-		tx_foreach_set(pop, tx_rt, tx_abort_recover_range);
+		tx_foreach_set(pop, tx_rt, tx_abort_recover_range, NULL);
 	else
-		tx_foreach_set(pop, tx_rt, tx_abort_restore_range);
+		tx_foreach_set(pop, tx_rt, tx_abort_restore_range, NULL);
 
 	tx_clear_undo_log(pop, tx_rt->ctx[UNDO_SET_CACHE],
 		TX_CLR_FLAG_FREE | TX_CLR_FLAG_VG_CLEAN);
@@ -602,12 +652,62 @@ tx_abort_set(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt, int recovery)
 		TX_CLR_FLAG_FREE | TX_CLR_FLAG_VG_CLEAN);
 }
 
+/*
+ * tx_get_flusher -- (internal) returns the helper threads for parallel flush
+ * or NULL if it should not be used for the pool
+ */
+static struct flusher *
+tx_get_flusher(PMEMobjpool *pop)
+{
+	/*
+	 * Flushing to remote replicas requires holding a lane, which would
+	 * deadlock the helper threads if all of the lanes are in use.
+	 */
+	if (Tx_flush_threads == 0 || pop->has_remote_replicas)
+		return NULL;
+
+	struct flusher *f = Tx_flusher;
+	if (f != NULL)
+		return f;
+
+	util_mutex_lock(&Tx_flusher_lock);
+	if (Tx_flusher == NULL && Tx_flush_threads != 0) {
+		f = flusher_new(Tx_flush_threads);
+		if (f == NULL) {
+			LOG(2, "parallel flush disabled");
+			Tx_flush_threads = 0;
+		} else {
+			__sync_synchronize();
+			Tx_flusher = f;
+		}
+	}
+	f = Tx_flusher;
+	util_mutex_unlock(&Tx_flusher_lock);
+
+	return f;
+}
+
+/*
+ * tx_flush -- (internal) flushes the memory range, large ranges are handed
+ * over to the helper threads if the request is provided
+ */
+static void
+tx_flush(PMEMobjpool *pop, struct flusher_req *req, const void *addr,
+	size_t len)
+{
+	if (req != NULL && len >= Tx_flush_threshold)
+		flusher_flush(Tx_flusher, req, &pop->p_ops, addr, len);
+	else
+		pmemops_flush(&pop->p_ops, addr, len);
+}
+
 /*
  * tx_pre_commit_alloc -- (internal) do pre-commit operations for
  * allocated objects
  */
 static void
-tx_pre_commit_alloc(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt)
+tx_pre_commit_alloc(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt,
+	struct flusher_req *req)
 {
 	LOG(3, NULL);
 
@@ -620,17 +720,32 @@ tx_pre_commit_alloc(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt)
 		if (offset == TX_SKIP_ENTRY_VALUE)
 			continue;
 
-		struct oob_header *oobh = OOB_HEADER_FROM_OFF(pop, offset);
-		SET_TX_VAR(pop, oobh->undo_entry_offset, 0);
-
-		/*
-		 * Flush the entire object with the exception of the unused part
-		 * of the OOB header. This code is very reliant on the object
-		 * header layout so be careful when modifying.
-		 */
+		/* the header has already been persisted by the allocator */
 		size_t size = palloc_usable_size(&pop->heap, offset) -
-			sizeof(oobh->unused);
-		pmemops_flush(&pop->p_ops, &oobh->undo_entry_offset, size);
+			OBJ_OOB_OFF(pop);
+		tx_flush(pop, req, OBJ_OFF_TO_PTR(pop, offset), size);
+	}
+}
+
+/*
+ * tx_pre_commit_region -- (internal) do pre-commit operations for objects
+ *	allocated from the regions
+ */
+static void
+tx_pre_commit_region(PMEMobjpool *pop, struct lane_tx_runtime *lane,
+	struct flusher_req *req)
+{
+	LOG(3, NULL);
+
+	if (lane->region_allocs == NULL)
+		return;
+
+	uint64_t off = UINT64_MAX;
+	uint64_t size;
+	while ((size = ctree_find_le_unlocked(lane->region_allocs, &off))
+			!= 0) {
+		tx_flush(pop, req, OBJ_OFF_TO_PTR(pop, off), size);
+		off--;
 	}
 }
 
@@ -638,10 +753,21 @@ tx_pre_commit_alloc(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt)
  * tx_pre_commit_range_persist -- (internal) flushes memory range to persistence
  */
 static void
-tx_pre_commit_range_persist(PMEMobjpool *pop, struct tx_range *range)
+tx_pre_commit_range_persist(PMEMobjpool *pop, struct tx_range *range,
+	void *arg)
 {
+	struct lane_tx_runtime *lane = tx.section->runtime;
+
+	/* skip ranges written by pmemobj_tx_memcpy/memset */
+	if (lane->persisted != NULL) {
+		uint64_t key = range->offset;
+		uint64_t size = ctree_find_le_unlocked(lane->persisted, &key);
+		if (key == range->offset && size == range->size)
+			return;
+	}
+
 	void *ptr = OBJ_OFF_TO_PTR(pop, range->offset);
-	pmemops_flush(&pop->p_ops, ptr, range->size);
+	tx_flush(pop, arg, ptr, range->size);
 }
 
 /*
@@ -649,11 +775,12 @@ tx_pre_commit_range_persist(PMEMobjpool *pop, struct tx_range *range)
  * set operations
  */
 static void
-tx_pre_commit_set(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt)
+tx_pre_commit_set(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt,
+	struct flusher_req *req)
 {
 	LOG(3, NULL);
 
-	tx_foreach_set(pop, tx_rt, tx_pre_commit_range_persist);
+	tx_foreach_set(pop, tx_rt, tx_pre_commit_range_persist, req);
 }
 
 /*
@@ -688,7 +815,8 @@ tx_post_commit_free(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt)
  * transaction tracked by pmemcheck
  */
 static void
-tx_post_commit_range_vg_tx_remove(PMEMobjpool *pop, struct tx_range *range)
+tx_post_commit_range_vg_tx_remove(PMEMobjpool *pop, struct tx_range *range,
+	void *arg)
 {
 	VALGRIND_REMOVE_FROM_TX(OBJ_OFF_TO_PTR(pop, range->offset),
 			range->size);
@@ -701,13 +829,14 @@ tx_post_commit_range_vg_tx_remove(PMEMobjpool *pop, struct tx_range *range)
  */
 static void
 tx_post_commit_set(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt,
-		int recovery)
+		unsigned cache_slot, int recovery)
 {
 	LOG(3, NULL);
 
 #ifdef USE_VG_PMEMCHECK
 	if (On_valgrind)
-		tx_foreach_set(pop, tx_rt, tx_post_commit_range_vg_tx_remove);
+		tx_foreach_set(pop, tx_rt, tx_post_commit_range_vg_tx_remove,
+			NULL);
 #endif
 
 	struct pvector_context *cache_undo = tx_rt->ctx[UNDO_SET_CACHE];
@@ -728,8 +857,7 @@ tx_post_commit_set(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt,
 		if (zero_all) {
 			sz = sizeof(*cache);
 		} else {
-			struct lane_tx_runtime *r = tx.section->runtime;
-			sz = sizeof(cache->range[0]) * r->cache_slot;
+			sz = sizeof(cache->range[0]) * cache_slot;
 		}
 
 		VALGRIND_ADD_TO_TX(cache, sz);
@@ -755,8 +883,20 @@ tx_pre_commit(PMEMobjpool *pop, struct tx_undo_runtime *tx_rt)
 
 	ASSERTne(tx.section->runtime, NULL);
 
-	tx_pre_commit_set(pop, tx_rt);
-	tx_pre_commit_alloc(pop, tx_rt);
+	struct flusher_req req;
+	struct flusher_req *reqp = NULL;
+	struct flusher *f = tx_get_flusher(pop);
+	if (f != NULL) {
+		flusher_req_init(&req);
+		reqp = &req;
+	}
+
+	tx_pre_commit_set(pop, tx_rt, reqp);
+	tx_pre_commit_alloc(pop, tx_rt, reqp);
+	tx_pre_commit_region(pop, tx.section->runtime, reqp);
+
+	if (f != NULL)
+		flusher_wait(f, &req);
 }
 
 /*
@@ -800,12 +940,17 @@ tx_destroy_undo_runtime(struct tx_undo_runtime *tx)
 
 /*
  * tx_post_commit -- (internal) do post commit operations
+ *
+ * The lane runtime is NULL during recovery.
  */
 static void
-tx_post_commit(PMEMobjpool *pop, struct lane_tx_layout *layout, int recovery)
+tx_post_commit(PMEMobjpool *pop, struct lane_tx_layout *layout,
+	struct lane_tx_runtime *lane)
 {
 	LOG(3, NULL);
 
+	int recovery = lane == NULL;
+	unsigned cache_slot = 0;
 	struct tx_undo_runtime *tx_rt;
 	struct tx_undo_runtime new_rt = { .ctx = {NULL, } };
 	if (recovery) {
@@ -814,11 +959,11 @@ tx_post_commit(PMEMobjpool *pop, struct lane_tx_layout *layout, int recovery)
 
 		tx_rt = &new_rt;
 	} else {
-		struct lane_tx_runtime *lane = tx.section->runtime;
 		tx_rt = &lane->undo;
+		cache_slot = lane->cache_slot;
 	}
 
-	tx_post_commit_set(pop, tx_rt, recovery);
+	tx_post_commit_set(pop, tx_rt, cache_slot, recovery);
 	tx_post_commit_alloc(pop, tx_rt);
 	tx_post_commit_free(pop, tx_rt);
 
@@ -826,6 +971,35 @@ tx_post_commit(PMEMobjpool *pop, struct lane_tx_layout *layout, int recovery)
 		tx_destroy_undo_runtime(tx_rt);
 }
 
+/*
+ * tx_post_commit_deferred -- (internal) finishes the post commit phase of
+ * the last transaction committed in the lane, if it has been deferred
+ *
+ * Until this is done, the lane stays in the committed state, so a crash in
+ * the meantime is handled by the regular recovery of committed transactions.
+ * This only clears the undo logs and the range cache, the objects freed by
+ * the transaction have already been released during commit.
+ */
+static void
+tx_post_commit_deferred(PMEMobjpool *pop, struct lane_section *section)
+{
+	struct lane_tx_runtime *lane = section->runtime;
+	if (!lane->post_commit_pending)
+		return;
+
+	LOG(4, "lane %p", section);
+
+	struct lane_tx_layout *layout =
+		(struct lane_tx_layout *)section->layout;
+	ASSERTeq(layout->state, TX_STATE_COMMITTED);
+
+	tx_post_commit(pop, layout, lane);
+	tx_set_state(pop, layout, TX_STATE_NONE);
+
+	lane->post_commit_pending = 0;
+	lane->cache_slot = 0;
+}
+
 #ifdef USE_VG_MEMCHECK
 /*
  * tx_abort_register_valgrind -- tells Valgrind about objects from specified
@@ -844,7 +1018,8 @@ tx_abort_register_valgrind(PMEMobjpool *pop, struct pvector_context *ctx)
 		 * because pool has not been registered yet.
 		 */
 		void *p = (char *)pop + off;
-		size_t sz = palloc_usable_size(&pop->heap, off) - OBJ_OOB_SIZE;
+		size_t sz = palloc_usable_size(&pop->heap, off) -
+			OBJ_OOB_OFF(pop);
 
 		VALGRIND_DO_MEMPOOL_ALLOC(pop->heap.layout, p, sz);
 		VALGRIND_DO_MAKE_MEM_DEFINED(p, sz);
@@ -920,6 +1095,11 @@ add_to_tx_and_lock(struct lane_tx_runtime *lane, enum pobj_tx_lock type,
 			retval = pmemobj_rwlock_wrlock(lane->pop,
 				txl->lock.rwlock);
 			break;
+		case TX_LOCK_SEQLOCK:
+			txl->lock.seqlock = lock;
+			retval = pmemobj_seqlock_write_lock(lane->pop,
+				txl->lock.seqlock);
+			break;
 		default:
 			ERR("Unrecognized lock type");
 			ASSERT(0);
@@ -952,6 +1132,10 @@ release_and_free_tx_locks(struct lane_tx_runtime *lane)
 				pmemobj_rwlock_unlock(lane->pop,
 					tx_lock->lock.rwlock);
 				break;
+			case TX_LOCK_SEQLOCK:
+				pmemobj_seqlock_write_unlock(lane->pop,
+					tx_lock->lock.seqlock);
+				break;
 			default:
 				ERR("Unrecognized lock type");
 				ASSERT(0);
@@ -961,11 +1145,114 @@ release_and_free_tx_locks(struct lane_tx_runtime *lane)
 	}
 }
 
+/*
+ * tx_stats_now -- (internal) returns monotonic time in nanoseconds
+ */
+static inline uint64_t
+tx_stats_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * tx_stats_hist_add -- (internal) adds a sample to the log2 histogram
+ */
+static inline void
+tx_stats_hist_add(uint64_t *hist, uint64_t val)
+{
+	/* __builtin_clzll is undefined for 0 */
+	unsigned b = val == 0 ? 0 : 64 - (unsigned)__builtin_clzll(val);
+	if (b >= PMEMOBJ_TX_STATS_HIST_BUCKETS)
+		b = PMEMOBJ_TX_STATS_HIST_BUCKETS - 1;
+
+	hist[b]++;
+}
+
+/*
+ * tx_stats_begin -- (internal) attaches the lane statistics to the outermost
+ *	transaction
+ */
+static void
+tx_stats_begin(PMEMobjpool *pop, struct lane_tx_runtime *lane, unsigned idx)
+{
+	if (!pop->tx_stats_enabled) {
+		lane->stats = NULL;
+		return;
+	}
+
+	struct tx_stats *stats = &pop->tx_stats[idx];
+	stats->snapshot_bytes = 0;
+	stats->add_ranges = 0;
+	stats->allocs = 0;
+	stats->frees = 0;
+
+	lane->stats = stats;
+}
+
+/*
+ * tx_stats_end -- (internal) folds the counters of the finished outermost
+ *	transaction into the lane statistics
+ */
+static void
+tx_stats_end(struct tx_stats *stats)
+{
+	struct pobj_tx_stats *t = &stats->total;
+
+	t->snapshot_bytes += stats->snapshot_bytes;
+	t->add_ranges += stats->add_ranges;
+	t->allocs += stats->allocs;
+	t->frees += stats->frees;
+
+	tx_stats_hist_add(t->hist[TX_STATS_HIST_SNAPSHOT_BYTES],
+			stats->snapshot_bytes);
+	tx_stats_hist_add(t->hist[TX_STATS_HIST_ADD_RANGES],
+			stats->add_ranges);
+	tx_stats_hist_add(t->hist[TX_STATS_HIST_ALLOCS], stats->allocs);
+	tx_stats_hist_add(t->hist[TX_STATS_HIST_FREES], stats->frees);
+}
+
+/*
+ * tx_alloc_track -- (internal) remembers the undo log entry of an object
+ *	allocated by the transaction
+ *
+ * The objects do not have a place for the entry in their headers, it is
+ * known only for the duration of the transaction.
+ */
+static int
+tx_alloc_track(struct lane_tx_runtime *lane, uint64_t off,
+	uint64_t *entry_offset)
+{
+	if (lane->allocs == NULL && (lane->allocs = ctree_new()) == NULL)
+		return -1;
+
+	return ctree_insert_unlocked(lane->allocs, off, (uint64_t)entry_offset);
+}
+
+/*
+ * tx_alloc_entry -- (internal) returns the undo log entry of an object
+ *	allocated by the transaction, NULL for any other object
+ */
+static uint64_t *
+tx_alloc_entry(struct lane_tx_runtime *lane, uint64_t off)
+{
+	if (lane->allocs == NULL)
+		return NULL;
+
+	uint64_t key = off;
+	uint64_t entry = ctree_find_le_unlocked(lane->allocs, &key);
+
+	return key == off ? (uint64_t *)entry : NULL;
+}
+
 /*
  * tx_alloc_common -- (internal) common function for alloc and zalloc
  */
 static PMEMoid
-tx_alloc_common(size_t size, type_num_t type_num, palloc_constr constructor)
+tx_alloc_common(size_t size, size_t alignment, type_num_t type_num,
+	palloc_constr constructor)
 {
 	LOG(3, NULL);
 
@@ -985,22 +1272,33 @@ tx_alloc_common(size_t size, type_num_t type_num, palloc_constr constructor)
 
 	struct tx_alloc_args args = {
 		.type_num = type_num,
-		.entry_offset = (uint64_t)entry_offset,
 	};
 
 	/* allocate object to undo log */
 	PMEMoid retoid = OID_NULL;
+	PMEMobjpool *pop = lane->pop;
 
-	pmalloc_construct(lane->pop, entry_offset,
-		size + OBJ_OOB_SIZE, constructor, &args);
+	struct redo_log *redo = pmalloc_redo_hold(pop);
+
+	struct operation_context ctx;
+	operation_init(&ctx, pop, pop->redo, redo,
+		pmalloc_redo_nentries(pop));
+
+	pmalloc_operation(&pop->heap, 0, entry_offset, size + OBJ_OOB_OFF(pop),
+		alignment, constructor, &args, &ctx);
+
+	pmalloc_redo_release(pop);
 
 	retoid.off = *entry_offset;
 	retoid.pool_uuid_lo = lane->pop->uuid_lo;
 
 	if (OBJ_OID_IS_NULL(retoid) ||
-		ctree_insert_unlocked(lane->ranges, retoid.off, size) != 0)
+		ctree_insert_unlocked(lane->ranges, retoid.off, size) != 0 ||
+		tx_alloc_track(lane, retoid.off, entry_offset) != 0)
 		goto err_oom;
 
+	TX_STATS_ADD(lane, allocs, 1);
+
 	return retoid;
 
 err_oom:
@@ -1036,7 +1334,6 @@ tx_alloc_copy_common(size_t size, type_num_t type_num, const void *ptr,
 	struct tx_alloc_copy_args args = {
 		.super = {
 			.type_num = type_num,
-			.entry_offset = (uint64_t)entry_offset,
 		},
 		.size = size,
 		.ptr = ptr,
@@ -1046,15 +1343,18 @@ tx_alloc_copy_common(size_t size, type_num_t type_num, const void *ptr,
 	/* allocate object to undo log */
 	PMEMoid retoid;
 	int ret = pmalloc_construct(lane->pop, entry_offset,
-		size + OBJ_OOB_SIZE, constructor, &args);
+		size + OBJ_OOB_OFF(lane->pop), constructor, &args);
 
 	retoid.off = *entry_offset;
 	retoid.pool_uuid_lo = lane->pop->uuid_lo;
 
 	if (ret || OBJ_OID_IS_NULL(retoid) ||
-		ctree_insert_unlocked(lane->ranges, retoid.off, size) != 0)
+		ctree_insert_unlocked(lane->ranges, retoid.off, size) != 0 ||
+		tx_alloc_track(lane, retoid.off, entry_offset) != 0)
 		goto err_oom;
 
+	TX_STATS_ADD(lane, allocs, 1);
+
 	return retoid;
 
 err_oom:
@@ -1084,7 +1384,7 @@ tx_realloc_common(PMEMoid oid, size_t size, uint64_t type_num,
 
 	/* if oid is NULL just alloc */
 	if (OBJ_OID_IS_NULL(oid))
-		return tx_alloc_common(size, (type_num_t)type_num,
+		return tx_alloc_common(size, 0, (type_num_t)type_num,
 				constructor_alloc);
 
 	ASSERT(OBJ_OID_IS_VALID(lane->pop, oid));
@@ -1102,7 +1402,7 @@ tx_realloc_common(PMEMoid oid, size_t size, uint64_t type_num,
 	/* oid is not NULL and size is not 0 so do realloc by alloc and free */
 	void *ptr = OBJ_OFF_TO_PTR(lane->pop, oid.off);
 	size_t old_size = palloc_usable_size(&lane->pop->heap,
-			oid.off) - OBJ_OOB_SIZE;
+			oid.off) - OBJ_OOB_OFF(lane->pop);
 
 	size_t copy_size = old_size < size ? old_size : size;
 
@@ -1141,12 +1441,18 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 	} else if (tx.stage == TX_STAGE_NONE) {
 		VALGRIND_START_TX;
 
-		lane_hold(pop, &tx.section, LANE_SECTION_TRANSACTION);
+		unsigned idx = lane_hold(pop, &tx.section,
+				LANE_SECTION_TRANSACTION);
 
 		lane = tx.section->runtime;
+		tx_post_commit_deferred(pop, tx.section);
+		tx_stats_begin(pop, lane, idx);
 		SLIST_INIT(&lane->tx_entries);
 		SLIST_INIT(&lane->tx_locks);
 		lane->ranges = ctree_new();
+		lane->persisted = NULL;
+		lane->allocs = NULL;
+		lane->region_allocs = NULL;
 		lane->cache_slot = 0;
 
 		struct lane_tx_layout *layout =
@@ -1257,6 +1563,11 @@ pmemobj_tx_abort(int errnum)
 
 		/* process the undo log */
 		tx_abort(lane->pop, layout, 0 /* abort */);
+
+		if (lane->stats != NULL) {
+			lane->stats->total.aborts++;
+			tx_stats_end(lane->stats);
+		}
 	}
 
 	tx.last_errnum = errnum;
@@ -1300,6 +1611,12 @@ pmemobj_tx_commit()
 		struct lane_tx_layout *layout =
 			(struct lane_tx_layout *)tx.section->layout;
 		PMEMobjpool *pop = lane->pop;
+		struct tx_stats *stats = lane->stats;
+		uint64_t t_begin = 0;
+		uint64_t t_committed = 0;
+
+		if (stats != NULL)
+			t_begin = tx_stats_now();
 
 		/* pre-commit phase */
 		tx_pre_commit(pop, &lane->undo);
@@ -1309,16 +1626,63 @@ pmemobj_tx_commit()
 		/* set transaction state as committed */
 		tx_set_state(pop, layout, TX_STATE_COMMITTED);
 
-		/* post commit phase */
-		tx_post_commit(pop, layout, 0 /* not recovery */);
+		if (stats != NULL)
+			t_committed = tx_stats_now();
+
+		if (Tx_deferred_post_commit) {
+			/*
+			 * Objects freed by the transaction must not be visible
+			 * after commit, the rest of the post commit phase is
+			 * finished by the next transaction in the lane.
+			 */
+			tx_post_commit_free(pop, &lane->undo);
+			lane->post_commit_pending = 1;
+		} else {
+			/* post commit phase */
+			tx_post_commit(pop, layout, lane);
 
-		/* clear transaction state */
-		tx_set_state(pop, layout, TX_STATE_NONE);
+			/* clear transaction state */
+			tx_set_state(pop, layout, TX_STATE_NONE);
+		}
+
+		if (stats != NULL) {
+			uint64_t t_end = tx_stats_now();
+			struct pobj_tx_stats *t = &stats->total;
+
+			t->commits++;
+			t->pre_commit_ns += t_committed - t_begin;
+			t->post_commit_ns += t_end - t_committed;
+			t->commit_ns += t_end - t_begin;
+			tx_stats_hist_add(t->hist[TX_STATS_HIST_COMMIT_NS],
+					t_end - t_begin);
+			tx_stats_end(stats);
+		}
 	}
 
 	tx.stage = TX_STAGE_ONCOMMIT;
 }
 
+/*
+ * tx_end_clear_lane -- (internal) resets the range cache of the lane after
+ * the outermost transaction has finished
+ */
+static void
+tx_end_clear_lane(struct lane_tx_layout *layout, struct lane_tx_runtime *lane)
+{
+	lane->cache_slot = 0;
+
+	/* the transaction state and undo log should be clear */
+	ASSERTeq(layout->state, TX_STATE_NONE);
+	if (layout->state != TX_STATE_NONE)
+		LOG(2, "invalid transaction state");
+
+	ASSERTeq(pvector_nvalues(lane->undo.ctx[UNDO_ALLOC]), 0);
+	ASSERTeq(pvector_nvalues(lane->undo.ctx[UNDO_SET]), 0);
+	ASSERTeq(pvector_nvalues(lane->undo.ctx[UNDO_FREE]), 0);
+	ASSERT(pvector_nvalues(lane->undo.ctx[UNDO_FREE]) == 0 ||
+		pvector_nvalues(lane->undo.ctx[UNDO_FREE]) == 1);
+}
+
 /*
  * pmemobj_tx_end -- ends current transaction
  */
@@ -1348,18 +1712,25 @@ pmemobj_tx_end()
 
 		/* cleanup cache */
 		ctree_delete(lane->ranges);
-		lane->cache_slot = 0;
-
-		/* the transaction state and undo log should be clear */
-		ASSERTeq(layout->state, TX_STATE_NONE);
-		if (layout->state != TX_STATE_NONE)
-			LOG(2, "invalid transaction state");
+		if (lane->persisted != NULL) {
+			ctree_delete(lane->persisted);
+			lane->persisted = NULL;
+		}
+		if (lane->allocs != NULL) {
+			ctree_delete(lane->allocs);
+			lane->allocs = NULL;
+		}
+		if (lane->region_allocs != NULL) {
+			ctree_delete(lane->region_allocs);
+			lane->region_allocs = NULL;
+		}
 
-		ASSERTeq(pvector_nvalues(lane->undo.ctx[UNDO_ALLOC]), 0);
-		ASSERTeq(pvector_nvalues(lane->undo.ctx[UNDO_SET]), 0);
-		ASSERTeq(pvector_nvalues(lane->undo.ctx[UNDO_FREE]), 0);
-		ASSERT(pvector_nvalues(lane->undo.ctx[UNDO_FREE]) == 0 ||
-			pvector_nvalues(lane->undo.ctx[UNDO_FREE]) == 1);
+		/*
+		 * A deferred post commit phase clears the undo log and
+		 * the range cache at the beginning of the next transaction.
+		 */
+		if (!lane->post_commit_pending)
+			tx_end_clear_lane(layout, lane);
 
 		tx.stage = TX_STAGE_NONE;
 		release_and_free_tx_locks(lane);
@@ -1422,7 +1793,8 @@ pmemobj_tx_add_large(struct tx_add_range_args *args)
 
 	/* insert snapshot to undo log */
 	int ret = pmalloc_construct(args->pop, entry,
-			args->size + sizeof(struct tx_range) + OBJ_OOB_SIZE,
+			args->size + sizeof(struct tx_range) +
+			OBJ_OOB_OFF(args->pop),
 			constructor_tx_add_range, args);
 
 	if (ret != 0) {
@@ -1444,18 +1816,18 @@ constructor_tx_range_cache(void *ctx, void *ptr, size_t usable_size, void *arg)
 
 	ASSERTne(ptr, NULL);
 
-	struct oob_header *oobh = OOB_HEADER_FROM_PTR(ptr);
+	void *hdr = (char *)ptr - OBJ_OOB_OFF(pop);
 	/* temporarily add the object copy to the transaction */
-	VALGRIND_ADD_TO_TX(oobh,
-		OBJ_OOB_SIZE + sizeof(struct tx_range_cache));
+	VALGRIND_ADD_TO_TX(hdr,
+		OBJ_OOB_OFF(pop) + sizeof(struct tx_range_cache));
 
-	oobh->size = OBJ_INTERNAL_OBJECT_MASK;
-	pmemops_flush(p_ops, &oobh->size, sizeof(oobh->size));
+	/* the header is persisted by the allocator */
+	obj_hdr_init(pop, ptr, 1, 0);
 
 	pmemops_memset_persist(p_ops, ptr, 0, sizeof(struct tx_range_cache));
 
-	VALGRIND_REMOVE_FROM_TX(oobh,
-		OBJ_OOB_SIZE + sizeof(struct tx_range_cache));
+	VALGRIND_REMOVE_FROM_TX(hdr,
+		OBJ_OOB_OFF(pop) + sizeof(struct tx_range_cache));
 
 	return 0;
 }
@@ -1464,17 +1836,20 @@ constructor_tx_range_cache(void *ctx, void *ptr, size_t usable_size, void *arg)
  * pmemobj_tx_get_range_cache -- (internal) returns first available cache
  */
 static struct tx_range_cache *
-pmemobj_tx_get_range_cache(PMEMobjpool *pop, struct pvector_context *undo)
+pmemobj_tx_get_range_cache(PMEMobjpool *pop, struct pvector_context *undo,
+	unsigned nslots)
 {
 	uint64_t last_cache = pvector_last(undo);
+	struct lane_tx_runtime *runtime = tx.section->runtime;
 
 	struct tx_range_cache *cache = NULL;
 	/* get the last element from the caches list */
 	if (last_cache != 0)
 		cache = OBJ_OFF_TO_PTR(pop, last_cache);
 
-	/* verify if the cache exists and has at least one free slot */
-	if (cache == NULL || cache->range[MAX_CACHED_RANGES - 1].offset != 0) {
+	/* verify if the cache exists and has enough free slots */
+	if (cache == NULL ||
+		runtime->cache_slot + nslots > MAX_CACHED_RANGES) {
 		/* no existing cache, allocate a new one */
 		uint64_t *entry = pvector_push_back(undo);
 		if (entry == NULL) {
@@ -1482,7 +1857,7 @@ pmemobj_tx_get_range_cache(PMEMobjpool *pop, struct pvector_context *undo)
 			return NULL;
 		}
 		int err = pmalloc_construct(pop, entry,
-			sizeof(struct tx_range_cache) + OBJ_OOB_SIZE,
+			sizeof(struct tx_range_cache) + OBJ_OOB_OFF(pop),
 			constructor_tx_range_cache, NULL);
 
 		if (err != 0) {
@@ -1493,7 +1868,6 @@ pmemobj_tx_get_range_cache(PMEMobjpool *pop, struct pvector_context *undo)
 		cache = OBJ_OFF_TO_PTR(pop, *entry);
 
 		/* since the cache is new, we start the count from 0 */
-		struct lane_tx_runtime *runtime = tx.section->runtime;
 		runtime->cache_slot = 0;
 	}
 
@@ -1512,20 +1886,25 @@ pmemobj_tx_add_small(struct tx_add_range_args *args)
 	struct pvector_context *undo = runtime->undo.ctx[UNDO_SET_CACHE];
 	const struct pmem_ops *p_ops = &pop->p_ops;
 
-	struct tx_range_cache *cache = pmemobj_tx_get_range_cache(pop, undo);
+	unsigned nslots = (unsigned)TX_RANGE_CACHE_SLOTS(args->size);
+	ASSERT(nslots <= MAX_CACHED_RANGES);
+
+	struct tx_range_cache *cache = pmemobj_tx_get_range_cache(pop, undo,
+		nslots);
 	if (cache == NULL) {
 		ERR("Failed to create range cache");
 		return 1;
 	}
 
-	unsigned n = runtime->cache_slot++; /* first free cache slot */
+	unsigned n = runtime->cache_slot; /* first free cache slot */
+	runtime->cache_slot += nslots;
 
-	ASSERT(n != MAX_CACHED_RANGES);
+	ASSERT(runtime->cache_slot <= MAX_CACHED_RANGES);
 
 	/* those structures are binary compatible */
 	struct tx_range *range = (struct tx_range *)&cache->range[n];
-	VALGRIND_ADD_TO_TX(range,
-		sizeof(struct tx_range) + MAX_CACHED_RANGE_SIZE);
+	size_t range_size = nslots * TX_RANGE_CACHE_SLOT_SIZE;
+	VALGRIND_ADD_TO_TX(range, range_size);
 
 	/* this isn't transactional so we have to keep the order */
 	void *src = OBJ_OFF_TO_PTR(pop, args->offset);
@@ -1539,12 +1918,28 @@ pmemobj_tx_add_small(struct tx_add_range_args *args)
 	pmemops_persist(p_ops, range,
 		sizeof(range->offset) + sizeof(range->size));
 
-	VALGRIND_REMOVE_FROM_TX(range,
-		sizeof(struct tx_range) + MAX_CACHED_RANGE_SIZE);
+	VALGRIND_REMOVE_FROM_TX(range, range_size);
 
 	return 0;
 }
 
+/*
+ * tx_persisted_remove -- (internal) forgets about all of the persisted ranges
+ *	which overlap with the given one
+ */
+static void
+tx_persisted_remove(struct ctree *persisted, uint64_t offset, uint64_t size)
+{
+	while (!ctree_is_empty_unlocked(persisted)) {
+		uint64_t key = offset + size - 1;
+		uint64_t rsize = ctree_find_le_unlocked(persisted, &key);
+		if (rsize == 0 || key + rsize <= offset)
+			break;
+
+		ctree_remove_unlocked(persisted, key, 1);
+	}
+}
+
 /*
  * pmemobj_tx_add_common -- (internal) common code for adding persistent memory
  *				into the transaction
@@ -1568,6 +1963,14 @@ pmemobj_tx_add_common(struct tx_add_range_args *args)
 
 	struct lane_tx_runtime *runtime = tx.section->runtime;
 
+	/*
+	 * The range is about to be modified with regular stores, so it has
+	 * to be flushed on commit, even if it was written and persisted before.
+	 */
+	if (!args->persisted && runtime->persisted != NULL && args->size != 0)
+		tx_persisted_remove(runtime->persisted, args->offset,
+			args->size);
+
 	/* starting from the end, search for all overlapping ranges */
 	uint64_t spoint = args->offset + args->size - 1; /* start point */
 	uint64_t apoint = 0; /* add point */
@@ -1610,7 +2013,7 @@ pmemobj_tx_add_common(struct tx_add_range_args *args)
 		 * Depending on the size of the block, either allocate an
 		 * entire new object or use cache.
 		 */
-		ret = nargs.size > MAX_CACHED_RANGE_SIZE ?
+		ret = nargs.size > args->pop->tx_max_cached_range ?
 			pmemobj_tx_add_large(&nargs) :
 			pmemobj_tx_add_small(&nargs);
 
@@ -1625,6 +2028,16 @@ pmemobj_tx_add_common(struct tx_add_range_args *args)
 
 			break;
 		}
+
+		/*
+		 * Failing to mark the range only results in an additional
+		 * flush on commit.
+		 */
+		if (args->persisted)
+			ctree_insert_unlocked(runtime->persisted, nargs.offset,
+				nargs.size);
+
+		TX_STATS_ADD(runtime, snapshot_bytes, nargs.size);
 	}
 
 	if (ret != 0) {
@@ -1662,6 +2075,8 @@ pmemobj_tx_add_range_direct(const void *ptr, size_t size)
 		.size = size
 	};
 
+	TX_STATS_ADD(lane, add_ranges, 1);
+
 	return pmemobj_tx_add_common(&args);
 }
 
@@ -1691,17 +2106,96 @@ pmemobj_tx_add_range(PMEMoid oid, uint64_t hoff, size_t size)
 		.size = size
 	};
 
+	TX_STATS_ADD(lane, add_ranges, 1);
+
 	/*
 	 * If internal type is in undo log it means
 	 * the object was allocated within this transaction
 	 * and there is no need to create a snapshot.
 	 */
-	if (!OBJ_OID_IS_IN_UNDO_LOG(lane->pop, oid))
+	if (tx_alloc_entry(lane, oid.off) == NULL)
 		return pmemobj_tx_add_common(&args);
 
 	return 0;
 }
 
+/*
+ * tx_add_persisted -- (internal) adds persistent memory range which is going
+ *	to be written and persisted by the caller into the transaction
+ */
+static int
+tx_add_persisted(void *dest, size_t num)
+{
+	ASSERT_IN_TX();
+	ASSERT_TX_STAGE_WORK();
+
+	struct lane_tx_runtime *lane =
+		(struct lane_tx_runtime *)tx.section->runtime;
+
+	if ((char *)dest < (char *)lane->pop ||
+			(char *)dest >= (char *)lane->pop + lane->pop->size) {
+		ERR("object outside of pool");
+		return pmemobj_tx_abort_err(EINVAL);
+	}
+
+	if (lane->persisted == NULL) {
+		lane->persisted = ctree_new();
+		if (lane->persisted == NULL) {
+			ERR("!ctree_new");
+			return pmemobj_tx_abort_err(ENOMEM);
+		}
+	}
+
+	struct tx_add_range_args args = {
+		.pop = lane->pop,
+		.offset = (uint64_t)((char *)dest - (char *)lane->pop),
+		.size = num,
+		.persisted = 1
+	};
+
+	TX_STATS_ADD(lane, add_ranges, 1);
+
+	return pmemobj_tx_add_common(&args);
+}
+
+/*
+ * pmemobj_tx_memcpy -- transactionally copies memory to a persistent memory
+ *	range using non-temporal stores
+ */
+int
+pmemobj_tx_memcpy(void *dest, const void *src, size_t num)
+{
+	LOG(3, "dest %p src %p num %zu", dest, src, num);
+
+	int ret = tx_add_persisted(dest, num);
+	if (ret != 0)
+		return ret;
+
+	struct lane_tx_runtime *lane = tx.section->runtime;
+	pmemops_memcpy_persist(&lane->pop->p_ops, dest, src, num);
+
+	return 0;
+}
+
+/*
+ * pmemobj_tx_memset -- transactionally fills a persistent memory range
+ *	using non-temporal stores
+ */
+int
+pmemobj_tx_memset(void *dest, int c, size_t num)
+{
+	LOG(3, "dest %p c %d num %zu", dest, c, num);
+
+	int ret = tx_add_persisted(dest, num);
+	if (ret != 0)
+		return ret;
+
+	struct lane_tx_runtime *lane = tx.section->runtime;
+	pmemops_memset_persist(&lane->pop->p_ops, dest, c, num);
+
+	return 0;
+}
+
 /*
  * pmemobj_tx_alloc -- allocates a new object
  */
@@ -1718,7 +2212,7 @@ pmemobj_tx_alloc(size_t size, uint64_t type_num)
 		return pmemobj_tx_abort_null(EINVAL);
 	}
 
-	return tx_alloc_common(size, (type_num_t)type_num,
+	return tx_alloc_common(size, 0, (type_num_t)type_num,
 			constructor_tx_alloc);
 }
 
@@ -1738,7 +2232,71 @@ pmemobj_tx_zalloc(size_t size, uint64_t type_num)
 		return pmemobj_tx_abort_null(EINVAL);
 	}
 
-	return tx_alloc_common(size, (type_num_t)type_num,
+	return tx_alloc_common(size, 0, (type_num_t)type_num,
+			constructor_tx_zalloc);
+}
+
+/*
+ * pmemobj_tx_alloc_aligned -- allocates a new object aligned to the given
+ *	boundary
+ */
+PMEMoid
+pmemobj_tx_alloc_aligned(size_t size, size_t alignment, uint64_t type_num)
+{
+	LOG(3, NULL);
+
+	ASSERT_IN_TX();
+	ASSERT_TX_STAGE_WORK();
+
+	if (size == 0) {
+		ERR("allocation with size 0");
+		return pmemobj_tx_abort_null(EINVAL);
+	}
+
+	if (!OBJ_ALIGNMENT_IS_VALID(alignment)) {
+		ERR("invalid alignment %zu", alignment);
+		return pmemobj_tx_abort_null(EINVAL);
+	}
+
+	struct lane_tx_runtime *lane = tx.section->runtime;
+	if (!OBJ_ALIGNMENT_IS_SUPPORTED(lane->pop, alignment)) {
+		ERR("alignment %zu not supported by the pool", alignment);
+		return pmemobj_tx_abort_null(ENOTSUP);
+	}
+
+	return tx_alloc_common(size, alignment, (type_num_t)type_num,
+			constructor_tx_alloc);
+}
+
+/*
+ * pmemobj_tx_zalloc_aligned -- allocates a new zeroed object aligned to the
+ *	given boundary
+ */
+PMEMoid
+pmemobj_tx_zalloc_aligned(size_t size, size_t alignment, uint64_t type_num)
+{
+	LOG(3, NULL);
+
+	ASSERT_IN_TX();
+	ASSERT_TX_STAGE_WORK();
+
+	if (size == 0) {
+		ERR("allocation with size 0");
+		return pmemobj_tx_abort_null(EINVAL);
+	}
+
+	if (!OBJ_ALIGNMENT_IS_VALID(alignment)) {
+		ERR("invalid alignment %zu", alignment);
+		return pmemobj_tx_abort_null(EINVAL);
+	}
+
+	struct lane_tx_runtime *lane = tx.section->runtime;
+	if (!OBJ_ALIGNMENT_IS_SUPPORTED(lane->pop, alignment)) {
+		ERR("alignment %zu not supported by the pool", alignment);
+		return pmemobj_tx_abort_null(ENOTSUP);
+	}
+
+	return tx_alloc_common(size, alignment, (type_num_t)type_num,
 			constructor_tx_zalloc);
 }
 
@@ -1792,7 +2350,7 @@ pmemobj_tx_strdup(const char *s, uint64_t type_num)
 	size_t len = strlen(s);
 
 	if (len == 0)
-		return tx_alloc_common(sizeof(char), (type_num_t)type_num,
+		return tx_alloc_common(sizeof(char), 0, (type_num_t)type_num,
 				constructor_tx_zalloc);
 
 	size_t size = (len + 1) * sizeof(char);
@@ -1825,7 +2383,10 @@ pmemobj_tx_free(PMEMoid oid)
 	}
 	ASSERT(OBJ_OID_IS_VALID(pop, oid));
 
-	if (!OBJ_OID_IS_IN_UNDO_LOG(pop, oid)) {
+	TX_STATS_ADD(lane, frees, 1);
+
+	uint64_t *entry_offset = tx_alloc_entry(lane, oid.off);
+	if (entry_offset == NULL) {
 		/* the object is in object store */
 		uint64_t *entry = pvector_push_back(lane->undo.ctx[UNDO_FREE]);
 		if (entry == NULL) {
@@ -1835,23 +2396,24 @@ pmemobj_tx_free(PMEMoid oid)
 		*entry = oid.off;
 		pmemops_persist(&pop->p_ops, entry, sizeof(*entry));
 	} else {
-
-		struct oob_header *oobh = OOB_HEADER_FROM_OID(pop, oid);
 #ifdef USE_VG_PMEMCHECK
 		if (On_valgrind) {
+			void *hdr = (char *)pop + oid.off - OBJ_OOB_OFF(pop);
 			size_t size = palloc_usable_size(&pop->heap, oid.off);
-			VALGRIND_SET_CLEAN(oobh, size);
-			VALGRIND_REMOVE_FROM_TX(oobh, size);
+			VALGRIND_SET_CLEAN(hdr, size);
+			VALGRIND_REMOVE_FROM_TX(hdr, size);
 		}
 #endif
 
 		if (ctree_remove_unlocked(lane->ranges, oid.off, 1) != oid.off)
 			FATAL("TX undo state mismatch");
+		ctree_remove_unlocked(lane->allocs, oid.off, 1);
 
 		struct redo_log *redo = pmalloc_redo_hold(pop);
 
 		struct operation_context ctx;
-		operation_init(&ctx, pop, pop->redo, redo);
+		operation_init(&ctx, pop, pop->redo, redo,
+			pmalloc_redo_nentries(pop));
 
 		/*
 		 * The object has been allocated within the same transaction.
@@ -1859,12 +2421,11 @@ pmemobj_tx_free(PMEMoid oid)
 		 * the removed entry with a special value which is skipped
 		 * during processing.
 		 */
-		uint64_t *entry_offset = (uint64_t *)oobh->undo_entry_offset;
 		operation_add_entry(&ctx, entry_offset, TX_SKIP_ENTRY_VALUE,
 				OPERATION_SET);
 
 		pmalloc_operation(&pop->heap, *entry_offset,
-			entry_offset, 0, NULL, NULL, &ctx);
+			entry_offset, 0, 0, NULL, NULL, &ctx);
 
 		pmalloc_redo_release(pop);
 	}
@@ -1872,6 +2433,332 @@ pmemobj_tx_free(PMEMoid oid)
 	return 0;
 }
 
+/*
+ * pmemobj_tx_region_create -- allocates a new region
+ */
+PMEMoid
+pmemobj_tx_region_create(size_t size, uint64_t type_num)
+{
+	LOG(3, NULL);
+
+	ASSERT_IN_TX();
+	ASSERT_TX_STAGE_WORK();
+
+	if (size == 0) {
+		ERR("region with size 0");
+		return pmemobj_tx_abort_null(EINVAL);
+	}
+
+	if (size > PMEMOBJ_MAX_ALLOC_SIZE - sizeof(struct obj_region)) {
+		ERR("requested size too large");
+		return pmemobj_tx_abort_null(ENOMEM);
+	}
+
+	PMEMoid region = tx_alloc_common(size + sizeof(struct obj_region), 0,
+			(type_num_t)type_num, constructor_tx_alloc);
+	if (OBJ_OID_IS_NULL(region))
+		return region;
+
+	struct lane_tx_runtime *lane =
+		(struct lane_tx_runtime *)tx.section->runtime;
+
+	/* the new object is flushed on commit */
+	struct obj_region *r = OBJ_OFF_TO_PTR(lane->pop, region.off);
+	r->capacity = size;
+	r->used = 0;
+	memset(r->unused, 0, sizeof(r->unused));
+
+	return region;
+}
+
+/*
+ * tx_region_alloc_common -- (internal) common function for region alloc and
+ *	zalloc
+ */
+static PMEMoid
+tx_region_alloc_common(PMEMoid region, size_t size, int zero_init)
+{
+	LOG(3, NULL);
+
+	if (size == 0) {
+		ERR("allocation with size 0");
+		return pmemobj_tx_abort_null(EINVAL);
+	}
+
+	struct lane_tx_runtime *lane =
+		(struct lane_tx_runtime *)tx.section->runtime;
+	PMEMobjpool *pop = lane->pop;
+
+	if (pop->uuid_lo != region.pool_uuid_lo) {
+		ERR("invalid pool uuid");
+		return pmemobj_tx_abort_null(EINVAL);
+	}
+	ASSERT(OBJ_OID_IS_VALID(pop, region));
+
+	struct obj_region *r = OBJ_OFF_TO_PTR(pop, region.off);
+	uint64_t avail = r->capacity - r->used;
+
+	if (size > avail || OBJ_REGION_ALLOC_SIZE(size) > avail) {
+		ERR("region exhausted");
+		return pmemobj_tx_abort_null(ENOMEM);
+	}
+
+	/* the abort restores the number of used bytes */
+	struct tx_add_range_args args = {
+		.pop = pop,
+		.offset = OBJ_PTR_TO_OFF(pop, &r->used),
+		.size = sizeof(r->used),
+	};
+
+	if (pmemobj_tx_add_common(&args) != 0)
+		return OID_NULL;
+
+	PMEMoid retoid;
+	retoid.off = region.off + sizeof(*r) + r->used;
+	retoid.pool_uuid_lo = pop->uuid_lo;
+
+	size_t asize = OBJ_REGION_ALLOC_SIZE(size);
+
+	/*
+	 * Like the objects allocated by the transaction, the new object
+	 * does not have to be snapshotted, it is flushed on commit instead.
+	 * A region allocated by this transaction is flushed as a whole.
+	 */
+	if (tx_alloc_entry(lane, region.off) == NULL) {
+		if (lane->region_allocs == NULL) {
+			lane->region_allocs = ctree_new();
+			if (lane->region_allocs == NULL) {
+				ERR("!ctree_new");
+				return pmemobj_tx_abort_null(ENOMEM);
+			}
+		}
+
+		if (ctree_insert_unlocked(lane->region_allocs, retoid.off,
+				asize) != 0 ||
+		    ctree_insert_unlocked(lane->ranges, retoid.off,
+				asize) != 0) {
+			ERR("out of memory");
+			return pmemobj_tx_abort_null(ENOMEM);
+		}
+	}
+
+	r->used += asize;
+
+	if (zero_init)
+		memset(OBJ_OFF_TO_PTR(pop, retoid.off), 0, size);
+
+	TX_STATS_ADD(lane, allocs, 1);
+
+	return retoid;
+}
+
+/*
+ * pmemobj_tx_region_alloc -- allocates a new object from the region
+ */
+PMEMoid
+pmemobj_tx_region_alloc(PMEMoid region, size_t size)
+{
+	LOG(3, NULL);
+
+	ASSERT_IN_TX();
+	ASSERT_TX_STAGE_WORK();
+
+	return tx_region_alloc_common(region, size, 0);
+}
+
+/*
+ * pmemobj_tx_region_zalloc -- allocates a new zeroed object from the region
+ */
+PMEMoid
+pmemobj_tx_region_zalloc(PMEMoid region, size_t size)
+{
+	LOG(3, NULL);
+
+	ASSERT_IN_TX();
+	ASSERT_TX_STAGE_WORK();
+
+	return tx_region_alloc_common(region, size, 1);
+}
+
+/*
+ * pmemobj_tx_region_free -- frees the region with all of its objects
+ */
+int
+pmemobj_tx_region_free(PMEMoid region)
+{
+	LOG(3, NULL);
+
+	return pmemobj_tx_free(region);
+}
+
+/*
+ * pmemobj_tx_stats_enable -- enables or disables transaction statistics
+ */
+int
+pmemobj_tx_stats_enable(PMEMobjpool *pop, int enable)
+{
+	LOG(3, "pop %p enable %d", pop, enable);
+
+	if (enable && pop->tx_stats == NULL) {
+		struct tx_stats *stats = Zalloc(sizeof(*stats) * pop->nlanes);
+		if (stats == NULL) {
+			ERR("!Zalloc");
+			return ENOMEM;
+		}
+
+		if (!__sync_bool_compare_and_swap(&pop->tx_stats, NULL, stats))
+			Free(stats);
+	}
+
+	pop->tx_stats_enabled = enable != 0;
+
+	return 0;
+}
+
+/*
+ * pmemobj_tx_stats -- sums up transaction statistics of all lanes
+ */
+int
+pmemobj_tx_stats(PMEMobjpool *pop, struct pobj_tx_stats *stats)
+{
+	LOG(3, "pop %p stats %p", pop, stats);
+
+	memset(stats, 0, sizeof(*stats));
+
+	if (pop->tx_stats == NULL)
+		return 0;
+
+	for (uint64_t i = 0; i < pop->nlanes; ++i) {
+		struct pobj_tx_stats *t = &pop->tx_stats[i].total;
+
+		stats->commits += t->commits;
+		stats->aborts += t->aborts;
+		stats->add_ranges += t->add_ranges;
+		stats->snapshot_bytes += t->snapshot_bytes;
+		stats->allocs += t->allocs;
+		stats->frees += t->frees;
+		stats->pre_commit_ns += t->pre_commit_ns;
+		stats->post_commit_ns += t->post_commit_ns;
+		stats->commit_ns += t->commit_ns;
+
+		for (int h = 0; h < MAX_TX_STATS_HIST; ++h)
+			for (int b = 0; b < PMEMOBJ_TX_STATS_HIST_BUCKETS; ++b)
+				stats->hist[h][b] += t->hist[h][b];
+	}
+
+	return 0;
+}
+
+/*
+ * pmemobj_tx_stats_reset -- zeroes transaction statistics
+ */
+void
+pmemobj_tx_stats_reset(PMEMobjpool *pop)
+{
+	LOG(3, "pop %p", pop);
+
+	if (pop->tx_stats == NULL)
+		return;
+
+	for (uint64_t i = 0; i < pop->nlanes; ++i)
+		memset(&pop->tx_stats[i].total, 0,
+			sizeof(pop->tx_stats[i].total));
+}
+
+/*
+ * pmemobj_tx_set_max_cached_range -- sets the size of the largest snapshot
+ * stored in the range cache
+ */
+int
+pmemobj_tx_set_max_cached_range(PMEMobjpool *pop, size_t size)
+{
+	LOG(3, "pop %p size %zu", pop, size);
+
+	if (size > TX_MAX_CACHED_RANGE_LIMIT) {
+		ERR("cached range size %zu larger than %zu", size,
+			TX_MAX_CACHED_RANGE_LIMIT);
+		return EINVAL;
+	}
+
+	/* older versions of the library read one snapshot per slot */
+	if (size > MAX_CACHED_RANGE_SIZE && !pop->tx_range_cache_slots) {
+		ERR("cached range size %zu not supported by the pool", size);
+		return ENOTSUP;
+	}
+
+	pop->tx_max_cached_range = (unsigned)size;
+
+	return 0;
+}
+
+/*
+ * tx_params_boot -- reads the transaction parameters from the environment
+ *
+ * Called by obj_init.
+ */
+void
+tx_params_boot(void)
+{
+	util_mutex_init(&Tx_flusher_lock, NULL);
+
+	char *env = getenv("PMEMOBJ_TX_FLUSH_THREADS");
+	if (env) {
+		int nthreads = atoi(env);
+		if (nthreads < 0)
+			LOG(2, "invalid PMEMOBJ_TX_FLUSH_THREADS value %s",
+				env);
+		else
+			Tx_flush_threads = (unsigned)nthreads;
+	}
+
+	env = getenv("PMEMOBJ_TX_FLUSH_THRESHOLD");
+	if (env) {
+		size_t threshold;
+		if (util_parse_size(env, &threshold) != 0 || threshold == 0)
+			LOG(2, "invalid PMEMOBJ_TX_FLUSH_THRESHOLD value %s",
+				env);
+		else
+			Tx_flush_threshold = threshold;
+	}
+
+	env = getenv("PMEMOBJ_TX_DEFERRED_POST_COMMIT");
+	if (env)
+		Tx_deferred_post_commit = atoi(env);
+}
+
+/*
+ * tx_params_destroy -- stops the parallel commit flush helper threads
+ *
+ * Called by obj_fini.
+ */
+void
+tx_params_destroy(void)
+{
+	if (Tx_flusher != NULL) {
+		flusher_delete(Tx_flusher);
+		Tx_flusher = NULL;
+	}
+
+	util_mutex_destroy(&Tx_flusher_lock);
+}
+
+/*
+ * tx_post_commit_deferred_all -- finishes all of the deferred post commit
+ * phases in the pool
+ *
+ * Called by pmemobj_close, before the heap is destroyed.
+ */
+void
+tx_post_commit_deferred_all(PMEMobjpool *pop)
+{
+	LOG(3, "pop %p", pop);
+
+	for (uint64_t i = 0; i < pop->nlanes; ++i)
+		tx_post_commit_deferred(pop,
+			&pop->lanes_desc.lane[i].sections[
+				LANE_SECTION_TRANSACTION]);
+}
+
 /*
  * lane_transaction_construct_rt -- construct runtime part of transaction
  * section
@@ -1914,7 +2801,7 @@ lane_transaction_recovery(PMEMobjpool *pop, void *data, unsigned length)
 		 * process the undo log, do the post commit phase
 		 * and clear the transaction state.
 		 */
-		tx_post_commit(pop, layout, 1 /* recovery */);
+		tx_post_commit(pop, layout, NULL /* recovery */);
 		tx_set_state(pop, layout, TX_STATE_NONE);
 	} else {
 		/* process undo log and restore all operations */
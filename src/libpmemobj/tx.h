@@ -44,6 +44,9 @@
  * To make sure that the range cache does not needlessly waste memory in the
  * allocator, the values set here must very closely match allocation class
  * sizes. A good value to aim for is multiples of 1024 bytes.
+ *
+ * Ranges larger than MAX_CACHED_RANGE_SIZE occupy several consecutive slots
+ * of the cache, with the data of the range overlaying the following slots.
  */
 #define MAX_CACHED_RANGE_SIZE 32
 #define MAX_CACHED_RANGES 169
@@ -67,6 +70,19 @@ struct tx_range_cache {
 	} range[MAX_CACHED_RANGES];
 };
 
+/* size of a single slot of the range cache */
+#define TX_RANGE_CACHE_SLOT_SIZE\
+	(sizeof(struct tx_range) + MAX_CACHED_RANGE_SIZE)
+
+/* number of consecutive cache slots occupied by a range of the given size */
+#define TX_RANGE_CACHE_SLOTS(size)\
+	((sizeof(struct tx_range) + (size) + TX_RANGE_CACHE_SLOT_SIZE - 1) /\
+	TX_RANGE_CACHE_SLOT_SIZE)
+
+/* the largest range that fits in the range cache */
+#define TX_MAX_CACHED_RANGE_LIMIT\
+	(MAX_CACHED_RANGES * TX_RANGE_CACHE_SLOT_SIZE - sizeof(struct tx_range))
+
 enum undo_types {
 	UNDO_ALLOC,
 	UNDO_FREE,
@@ -81,4 +97,10 @@ struct lane_tx_layout {
 	struct pvector undo_log[MAX_UNDO_TYPES];
 };
 
+struct pmemobjpool;
+
+void tx_params_boot(void);
+void tx_params_destroy(void);
+void tx_post_commit_deferred_all(struct pmemobjpool *pop);
+
 #endif
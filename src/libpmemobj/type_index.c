@@ -0,0 +1,469 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * type_index.c -- volatile index of objects by type number
+ *
+ * The index is built with a single heap walk the first time the pool is
+ * queried by type and from then on it is kept up to date by the allocator,
+ * which reports every object it creates, frees or retypes. This makes
+ * type-filtered iteration and per-type object counts proportional to the
+ * number of objects of the requested type instead of the size of the heap.
+ *
+ * Each type has a crit-bit tree of the offsets of its objects, with a lock of
+ * its own, so that the allocations of objects of different types update the
+ * index in parallel. The keys are inverted so that the less-or-equal search
+ * finds the next object in the pool order. The type of an object is always
+ * read from its header, the allocator reports a removal before the object is
+ * freed.
+ *
+ * The lock of the index is shared by all of the updates and queries and is
+ * taken exclusively only to add a new type or to rebuild the index. If the
+ * index ever fails to record a change, for lack of memory, or it might have
+ * recorded an object which is freed at the same time, it is marked as stale
+ * and rebuilt from scratch on the next query.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "ctree.h"
+#include "obj.h"
+#include "out.h"
+#include "palloc.h"
+#include "sys_util.h"
+#include "type_index.h"
+#include "util.h"
+
+/* inverted key under which an object is stored in the tree of its type */
+#define TYPE_INDEX_KEY(off) (UINT64_MAX - (off))
+
+struct type_entry {
+	pthread_mutex_t lock; /* protects count and objs */
+	uint64_t type_num;
+	size_t count; /* number of objects of this type */
+	struct ctree *objs; /* inverted offsets of the objects of this type */
+};
+
+struct type_index {
+	pthread_rwlock_t lock; /* exclusive for new types and rebuilds */
+	volatile int stale; /* a change was not recorded, must be rebuilt */
+	uint64_t gen; /* number of rebuilds, see type_index_validate */
+	struct ctree *types; /* type number -> struct type_entry */
+};
+
+/*
+ * type_index_lookup -- (internal) returns the entry of the type, NULL if there
+ *	is none
+ */
+static struct type_entry *
+type_index_lookup(struct type_index *idx, uint64_t type_num)
+{
+	uint64_t found = type_num;
+	uint64_t value = ctree_find_le_unlocked(idx->types, &found);
+
+	return found == type_num ? (struct type_entry *)value : NULL;
+}
+
+/*
+ * type_index_trees_free -- (internal) frees all of the entries of the index
+ */
+static void
+type_index_trees_free(struct type_index *idx)
+{
+	if (idx->types == NULL)
+		return;
+
+	while (!ctree_is_empty_unlocked(idx->types)) {
+		uint64_t key = UINT64_MAX;
+		struct type_entry *e = (struct type_entry *)
+			ctree_find_le_unlocked(idx->types, &key);
+		ctree_remove_unlocked(idx->types, key, 1);
+
+		ctree_delete(e->objs);
+		util_mutex_destroy(&e->lock);
+		Free(e);
+	}
+
+	ctree_delete(idx->types);
+	idx->types = NULL;
+}
+
+/*
+ * type_index_entry -- (internal) returns the entry of the type, creates it
+ *	if it does not exist yet, must be called with the index locked
+ *	exclusively
+ */
+static struct type_entry *
+type_index_entry(struct type_index *idx, uint64_t type_num)
+{
+	struct type_entry *e = type_index_lookup(idx, type_num);
+	if (e != NULL)
+		return e;
+
+	if ((e = Zalloc(sizeof(*e))) == NULL)
+		return NULL;
+
+	e->type_num = type_num;
+	if ((e->objs = ctree_new()) == NULL)
+		goto error_objs;
+
+	if (ctree_insert_unlocked(idx->types, type_num, (uint64_t)e) != 0)
+		goto error_insert;
+
+	util_mutex_init(&e->lock, NULL);
+
+	return e;
+
+error_insert:
+	ctree_delete(e->objs);
+error_objs:
+	Free(e);
+	return NULL;
+}
+
+/*
+ * type_index_add -- (internal) records the object in the entry of its type,
+ *	must be called with the entry locked
+ */
+static int
+type_index_add(struct type_entry *e, uint64_t off)
+{
+	int ret = ctree_insert_unlocked(e->objs, TYPE_INDEX_KEY(off), off);
+	if (ret == EEXIST)
+		return 0; /* already found by the heap walk */
+	if (ret != 0)
+		return ret;
+
+	e->count++;
+
+	return 0;
+}
+
+/*
+ * type_index_del -- (internal) removes the object from the entry of its type,
+ *	must be called with the entry locked
+ */
+static void
+type_index_del(struct type_entry *e, uint64_t off)
+{
+	if (ctree_remove_unlocked(e->objs, TYPE_INDEX_KEY(off), 1) != 0)
+		e->count--;
+}
+
+/* arguments for type_index_build_cb */
+struct type_index_build_arg {
+	PMEMobjpool *pop;
+	struct type_index *idx;
+	int ret;
+};
+
+/*
+ * type_index_build_cb -- (internal) adds a single object found in the heap
+ *	to the index
+ */
+static int
+type_index_build_cb(uint64_t off, void *arg)
+{
+	struct type_index_build_arg *barg = arg;
+
+	uint64_t obj_off = off + OBJ_OOB_OFF(barg->pop);
+	if (obj_hdr_is_internal(barg->pop, obj_off))
+		return 0;
+
+	struct type_entry *e = type_index_entry(barg->idx,
+		*obj_hdr_type_num(barg->pop, obj_off));
+	barg->ret = e != NULL ? type_index_add(e, obj_off) : ENOMEM;
+
+	return barg->ret != 0;
+}
+
+/*
+ * type_index_rebuild -- (internal) discards the content of the index and
+ *	fills it again with one walk over the heap, must be called with the
+ *	index locked exclusively
+ */
+static int
+type_index_rebuild(struct type_index *idx, PMEMobjpool *pop)
+{
+	type_index_trees_free(idx);
+
+	/* the updates which began before the walk have to validate the index */
+	idx->gen++;
+	idx->stale = 0;
+
+	if ((idx->types = ctree_new()) == NULL) {
+		ERR("!ctree_new");
+		goto error;
+	}
+
+	struct type_index_build_arg barg = {pop, idx, 0};
+	palloc_foreach(&pop->heap, type_index_build_cb, &barg);
+	if (barg.ret != 0) {
+		errno = barg.ret;
+		ERR("!cannot build the type index");
+		goto error;
+	}
+
+	return 0;
+
+error:
+	type_index_trees_free(idx);
+	idx->stale = 1;
+	return -1;
+}
+
+/*
+ * type_index_acquire -- (internal) returns the locked, up to date index of
+ *	the pool, creates it on first use. Returns NULL if the index cannot be
+ *	built.
+ *
+ * The index is locked exclusively if it had to be rebuilt, shared otherwise.
+ */
+static struct type_index *
+type_index_acquire(PMEMobjpool *pop)
+{
+	struct type_index *idx = pop->type_index;
+
+	if (idx == NULL) {
+		idx = Zalloc(sizeof(*idx));
+		if (idx == NULL) {
+			ERR("!Zalloc");
+			return NULL;
+		}
+
+		util_rwlock_init(&idx->lock, NULL);
+		idx->stale = 1;
+
+		if (!__sync_bool_compare_and_swap(&pop->type_index,
+				NULL, idx)) {
+			/* somebody else was faster */
+			util_rwlock_destroy(&idx->lock);
+			Free(idx);
+
+			idx = pop->type_index;
+		}
+	}
+
+	util_rwlock_rdlock(&idx->lock);
+	if (!idx->stale)
+		return idx;
+	util_rwlock_unlock(&idx->lock);
+
+	util_rwlock_wrlock(&idx->lock);
+	if (idx->stale && type_index_rebuild(idx, pop) != 0) {
+		util_rwlock_unlock(&idx->lock);
+		return NULL;
+	}
+
+	return idx;
+}
+
+/*
+ * type_index_next -- finds the first object of the type that follows the
+ *	offset in the pool order, 0 if there is none
+ *
+ * Returns -1 if the index is not available.
+ */
+int
+type_index_next(PMEMobjpool *pop, uint64_t type_num, uint64_t off,
+	uint64_t *next)
+{
+	struct type_index *idx = type_index_acquire(pop);
+	if (idx == NULL)
+		return -1;
+
+	*next = 0;
+
+	struct type_entry *e = type_index_lookup(idx, type_num);
+	if (e != NULL) {
+		uint64_t key = TYPE_INDEX_KEY(off) - 1;
+
+		util_mutex_lock(&e->lock);
+		*next = ctree_find_le_unlocked(e->objs, &key);
+		util_mutex_unlock(&e->lock);
+	}
+
+	util_rwlock_unlock(&idx->lock);
+
+	return 0;
+}
+
+/*
+ * type_index_first -- finds the first object of the type in the pool order,
+ *	0 if there is none
+ *
+ * Returns -1 if the index is not available.
+ */
+int
+type_index_first(PMEMobjpool *pop, uint64_t type_num, uint64_t *off)
+{
+	return type_index_next(pop, type_num, 0, off);
+}
+
+/*
+ * type_index_count -- returns the number of objects of the type
+ *
+ * Returns -1 if the index is not available.
+ */
+int
+type_index_count(PMEMobjpool *pop, uint64_t type_num, size_t *count)
+{
+	struct type_index *idx = type_index_acquire(pop);
+	if (idx == NULL)
+		return -1;
+
+	*count = 0;
+
+	struct type_entry *e = type_index_lookup(idx, type_num);
+	if (e != NULL) {
+		util_mutex_lock(&e->lock);
+		*count = e->count;
+		util_mutex_unlock(&e->lock);
+	}
+
+	util_rwlock_unlock(&idx->lock);
+
+	return 0;
+}
+
+/*
+ * type_index_insert -- records a newly created or modified object, the type
+ *	is read from the object header
+ */
+void
+type_index_insert(struct type_index *idx, PMEMobjpool *pop, uint64_t off)
+{
+	if (obj_hdr_is_internal(pop, off))
+		return;
+
+	uint64_t type_num = *obj_hdr_type_num(pop, off);
+
+	util_rwlock_rdlock(&idx->lock);
+	if (idx->stale)
+		goto out;
+
+	struct type_entry *e = type_index_lookup(idx, type_num);
+	if (e == NULL) {
+		/* a new type, the tree of the types has to be modified */
+		util_rwlock_unlock(&idx->lock);
+		util_rwlock_wrlock(&idx->lock);
+		if (idx->stale)
+			goto out;
+
+		e = type_index_entry(idx, type_num);
+	}
+
+	if (e != NULL) {
+		util_mutex_lock(&e->lock);
+		int ret = type_index_add(e, off);
+		util_mutex_unlock(&e->lock);
+
+		if (ret == 0)
+			goto out;
+	}
+
+	LOG(2, "type index update failed, will be rebuilt");
+	idx->stale = 1;
+
+out:
+	util_rwlock_unlock(&idx->lock);
+}
+
+/*
+ * type_index_remove -- forgets an object which is about to be freed or
+ *	modified, the type is read from the object header
+ *
+ * Returns the generation of the index, which has to be passed to
+ * type_index_validate once the object is freed.
+ */
+uint64_t
+type_index_remove(struct type_index *idx, PMEMobjpool *pop, uint64_t off)
+{
+	util_rwlock_rdlock(&idx->lock);
+
+	uint64_t gen = idx->gen;
+
+	if (!idx->stale && !obj_hdr_is_internal(pop, off)) {
+		struct type_entry *e = type_index_lookup(idx,
+			*obj_hdr_type_num(pop, off));
+		if (e != NULL) {
+			util_mutex_lock(&e->lock);
+			type_index_del(e, off);
+			util_mutex_unlock(&e->lock);
+		}
+	}
+
+	util_rwlock_unlock(&idx->lock);
+
+	return gen;
+}
+
+/*
+ * type_index_validate -- marks the index stale if it has been rebuilt since
+ *	the given generation
+ *
+ * The heap walk of a rebuild which ran while an object was being freed might
+ * have recorded the object. It can't be removed from the index afterwards,
+ * because its memory might be already reused by a new object, which is
+ * recorded under the same offset.
+ */
+void
+type_index_validate(struct type_index *idx, uint64_t gen)
+{
+	util_rwlock_rdlock(&idx->lock);
+
+	if (idx->gen != gen && !idx->stale) {
+		LOG(2, "type index rebuilt during a free, will be rebuilt");
+		idx->stale = 1;
+	}
+
+	util_rwlock_unlock(&idx->lock);
+}
+
+/*
+ * type_index_cleanup -- frees the type index of the pool
+ */
+void
+type_index_cleanup(PMEMobjpool *pop)
+{
+	struct type_index *idx = pop->type_index;
+	if (idx == NULL)
+		return;
+
+	type_index_trees_free(idx);
+	util_rwlock_destroy(&idx->lock);
+	Free(idx);
+
+	pop->type_index = NULL;
+}
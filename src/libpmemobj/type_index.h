@@ -0,0 +1,61 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * type_index.h -- internal definitions for the volatile index of objects
+ *	by type number
+ */
+
+#ifndef LIBPMEMOBJ_TYPE_INDEX_H
+#define LIBPMEMOBJ_TYPE_INDEX_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "obj.h"
+
+struct type_index;
+
+int type_index_first(PMEMobjpool *pop, uint64_t type_num, uint64_t *off);
+int type_index_next(PMEMobjpool *pop, uint64_t type_num, uint64_t off,
+	uint64_t *next);
+int type_index_count(PMEMobjpool *pop, uint64_t type_num, size_t *count);
+
+void type_index_insert(struct type_index *idx, PMEMobjpool *pop,
+	uint64_t off);
+uint64_t type_index_remove(struct type_index *idx, PMEMobjpool *pop,
+	uint64_t off);
+void type_index_validate(struct type_index *idx, uint64_t gen);
+
+void type_index_cleanup(PMEMobjpool *pop);
+
+#endif
@@ -43,6 +43,8 @@
 #include "libpmempool.h"
 #include "pmempool.h"
 #include "pool.h"
+#include "lane.h"
+#include "obj.h"
 #include "set.h"
 #include "check_util.h"
 
@@ -220,6 +222,24 @@ pool_hdr_checksum(PMEMpoolcheck *ppc, union location *loc)
 	return 0;
 }
 
+/*
+ * pool_hdr_optional_incompat -- (internal) returns incompat features which
+ *	may be set in a valid pool header of the given type
+ */
+static uint32_t
+pool_hdr_optional_incompat(enum pool_type type)
+{
+	if (type == POOL_TYPE_OBJ)
+		return OBJ_INCOMPAT_LANES | OBJ_INCOMPAT_EXT_REDO |
+			OBJ_INCOMPAT_COMPACT_HEADERS |
+			OBJ_INCOMPAT_HUGE_ALIGNED |
+			OBJ_INCOMPAT_ALIGNED_ALLOCS |
+			OBJ_INCOMPAT_RANGE_CACHE_SLOTS |
+			OBJ_INCOMPAT_LAZY_ZONES;
+
+	return 0;
+}
+
 /*
  * pool_hdr_default_check -- (internal) check some default values in pool header
  */
@@ -236,6 +256,7 @@ pool_hdr_default_check(PMEMpoolcheck *ppc, union location *loc)
 
 	struct pool_hdr def_hdr;
 	pool_hdr_default(ppc->pool->params.type, &def_hdr);
+	uint32_t optional = pool_hdr_optional_incompat(ppc->pool->params.type);
 
 	if (memcmp(hdr.signature, def_hdr.signature, POOL_HDR_SIG_LEN)) {
 		CHECK_ASK(ppc, Q_DEFAULT_SIGNATURE,
@@ -256,7 +277,7 @@ pool_hdr_default_check(PMEMpoolcheck *ppc, union location *loc)
 			def_hdr.compat_features);
 	}
 
-	if (hdr.incompat_features != def_hdr.incompat_features) {
+	if ((hdr.incompat_features & ~optional) != def_hdr.incompat_features) {
 		CHECK_ASK(ppc, Q_DEFAULT_INCOMPAT_FEATURES,
 			"%spool_hdr.incompat_features is not valid.|Do you "
 			"want to set it to default value 0x%x?", loc->prefix,
@@ -311,7 +332,9 @@ pool_hdr_default_fix(PMEMpoolcheck *ppc, struct check_step_data *location,
 	case Q_DEFAULT_INCOMPAT_FEATURES:
 		CHECK_INFO(ppc, "setting pool_hdr.incompat_features to 0x%x",
 			ctx->def_hdr.incompat_features);
-		ctx->hdr.incompat_features = ctx->def_hdr.incompat_features;
+		ctx->hdr.incompat_features = ctx->def_hdr.incompat_features |
+			(ctx->hdr.incompat_features &
+			pool_hdr_optional_incompat(ppc->pool->params.type));
 		break;
 	case Q_DEFAULT_RO_COMPAT_FEATURES:
 		CHECK_INFO(ppc, "setting pool_hdr.ro_compat_features to 0x%x",
@@ -0,0 +1,303 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_alloc_aligned.c -- unit test for aligned allocations
+ *
+ * usage: obj_alloc_aligned file
+ */
+#include <stddef.h>
+
+#include "unittest.h"
+
+#define LAYOUT_NAME "alloc_aligned"
+
+#define TEST_POOL_SIZE	(64 << 20)
+#define TEST_TYPE	1
+#define TEST_MIN_ALIGN	8
+#define TEST_NSIZES	4
+#define TEST_CHUNK_SIZE	(256 << 10)
+#define TEST_NOBJS	64
+
+static const size_t Sizes[TEST_NSIZES] = {
+	1, 200, 3000, 300000 /* larger than a chunk */
+};
+
+struct root {
+	PMEMoid objs[TEST_NSIZES];
+};
+
+/*
+ * fill -- (internal) constructor which fills the object with a pattern
+ */
+static int
+fill(PMEMobjpool *pop, void *ptr, void *arg)
+{
+	size_t size = *(size_t *)arg;
+	pmemobj_memset_persist(pop, ptr, (int)(size & 0xff), size);
+
+	return 0;
+}
+
+/*
+ * check_obj -- (internal) verifies the alignment and contents of the object
+ */
+static void
+check_obj(PMEMobjpool *pop, PMEMoid oid, size_t size, size_t alignment)
+{
+	UT_ASSERT(!OID_IS_NULL(oid));
+	UT_ASSERTeq(oid.off % alignment, 0);
+	UT_ASSERTeq(((uintptr_t)pmemobj_direct(oid) -
+		(uintptr_t)pop) % alignment, 0);
+	UT_ASSERT(pmemobj_alloc_usable_size(oid) >= size);
+	UT_ASSERTeq(pmemobj_type_num(oid), TEST_TYPE);
+
+	unsigned char *p = pmemobj_direct(oid);
+	for (size_t i = 0; i < size; ++i)
+		UT_ASSERTeq(p[i], (unsigned char)(size & 0xff));
+}
+
+/*
+ * count -- (internal) returns the number of objects in the pool and verifies
+ *	that all of them are known
+ */
+static unsigned
+count(PMEMobjpool *pop, struct root *rootp)
+{
+	unsigned n = 0;
+
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid) {
+		int found = 0;
+		for (int i = 0; i < TEST_NSIZES; ++i)
+			found |= oid.off == rootp->objs[i].off;
+
+		UT_ASSERT(found);
+		n++;
+	}
+
+	return n;
+}
+
+/*
+ * test_alloc -- (internal) allocates objects of all sizes with all of the
+ *	alignments using the atomic API
+ */
+static void
+test_alloc(PMEMobjpool *pop, struct root *rootp)
+{
+	for (size_t a = TEST_MIN_ALIGN; a <= PMEMOBJ_MAX_ALIGNMENT; a <<= 1) {
+		for (int i = 0; i < TEST_NSIZES; ++i) {
+			size_t size = Sizes[i];
+			int ret = pmemobj_alloc_aligned(pop, &rootp->objs[i],
+				size, a, TEST_TYPE, fill, &size);
+			UT_ASSERTeq(ret, 0);
+			check_obj(pop, rootp->objs[i], size, a);
+		}
+
+		UT_ASSERTeq(count(pop, rootp), TEST_NSIZES);
+
+		for (int i = 0; i < TEST_NSIZES; ++i) {
+			pmemobj_free(&rootp->objs[i]);
+			UT_ASSERT(OID_IS_NULL(rootp->objs[i]));
+		}
+
+		UT_ASSERTeq(count(pop, rootp), 0);
+	}
+
+	PMEMoid oid;
+	size_t invalid[] = {0, 3, 96, PMEMOBJ_MAX_ALIGNMENT << 1};
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+		int ret = pmemobj_alloc_aligned(pop, &oid, 64, invalid[i],
+			TEST_TYPE, NULL, NULL);
+		UT_ASSERTeq(ret, -1);
+		UT_ASSERTeq(errno, EINVAL);
+	}
+}
+
+/*
+ * test_space -- (internal) verifies that the aligned objects do not take more
+ *	space than the other ones
+ */
+static void
+test_space(PMEMobjpool *pop)
+{
+	PMEMoid oids[TEST_NOBJS];
+	size_t size = 1000;
+	size_t a = 4096;
+
+	/* the blocks of the class of the alignment are aligned themselves */
+	for (int i = 0; i < TEST_NOBJS; ++i) {
+		int ret = pmemobj_alloc_aligned(pop, &oids[i], size, a,
+			TEST_TYPE, fill, &size);
+		UT_ASSERTeq(ret, 0);
+		check_obj(pop, oids[i], size, a);
+		UT_ASSERT(pmemobj_alloc_usable_size(oids[i]) < a);
+	}
+
+	for (int i = 0; i < TEST_NOBJS; ++i)
+		pmemobj_free(&oids[i]);
+
+	/* huge objects are moved by less than a chunk */
+	size = Sizes[3];
+	a = PMEMOBJ_MAX_ALIGNMENT;
+	for (int i = 0; i < TEST_NOBJS / 8; ++i) {
+		int ret = pmemobj_alloc_aligned(pop, &oids[i], size, a,
+			TEST_TYPE, fill, &size);
+		UT_ASSERTeq(ret, 0);
+		check_obj(pop, oids[i], size, a);
+		UT_ASSERT(pmemobj_alloc_usable_size(oids[i]) <
+			size + TEST_CHUNK_SIZE);
+	}
+
+	for (int i = 0; i < TEST_NOBJS / 8; ++i)
+		pmemobj_free(&oids[i]);
+}
+
+/*
+ * test_realloc -- (internal) resizes an aligned object
+ */
+static void
+test_realloc(PMEMobjpool *pop, struct root *rootp)
+{
+	size_t size = Sizes[1];
+	int ret = pmemobj_alloc_aligned(pop, &rootp->objs[0], size, 4096,
+		TEST_TYPE, fill, &size);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_realloc(pop, &rootp->objs[0], Sizes[2], TEST_TYPE);
+	UT_ASSERTeq(ret, 0);
+	check_obj(pop, rootp->objs[0], 0, 64);
+
+	unsigned char *p = pmemobj_direct(rootp->objs[0]);
+	for (size_t i = 0; i < size; ++i)
+		UT_ASSERTeq(p[i], (unsigned char)(size & 0xff));
+
+	pmemobj_free(&rootp->objs[0]);
+}
+
+/*
+ * test_tx_alloc -- (internal) allocates aligned objects in transactions
+ */
+static void
+test_tx_alloc(PMEMobjpool *pop, struct root *rootp)
+{
+	size_t a = 1 << 16;
+
+	TX_BEGIN(pop) {
+		PMEMoid oid = pmemobj_tx_zalloc_aligned(Sizes[3], a,
+			TEST_TYPE);
+		UT_ASSERTeq(oid.off % a, 0);
+		pmemobj_tx_abort(-1);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(count(pop, rootp), 0);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(rootp, sizeof(*rootp));
+		for (int i = 0; i < TEST_NSIZES; ++i) {
+			size_t size = Sizes[i];
+			rootp->objs[i] = pmemobj_tx_alloc_aligned(size, a,
+				TEST_TYPE);
+			memset(pmemobj_direct(rootp->objs[i]),
+				(int)(size & 0xff), size);
+		}
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	for (int i = 0; i < TEST_NSIZES; ++i)
+		check_obj(pop, rootp->objs[i], Sizes[i], a);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_alloc_aligned(64, 3, TEST_TYPE);
+		UT_ASSERT(0);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_ONABORT {
+		UT_ASSERTeq(errno, EINVAL);
+	} TX_END
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_alloc_aligned");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT_NAME, TEST_POOL_SIZE,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	PMEMoid root = pmemobj_root(pop, sizeof(struct root));
+	struct root *rootp = pmemobj_direct(root);
+
+	test_alloc(pop, rootp);
+	test_space(pop);
+	test_realloc(pop, rootp);
+	test_tx_alloc(pop, rootp);
+
+	pmemobj_close(pop);
+
+	UT_ASSERTeq(pmemobj_check(path, LAYOUT_NAME), 1);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	rootp = pmemobj_direct(pmemobj_root(pop, sizeof(struct root)));
+
+	UT_ASSERTeq(count(pop, rootp), TEST_NSIZES);
+	for (int i = 0; i < TEST_NSIZES; ++i) {
+		check_obj(pop, rootp->objs[i], Sizes[i], 1 << 16);
+		pmemobj_free(&rootp->objs[i]);
+	}
+
+	UT_ASSERTeq(count(pop, rootp), 0);
+
+	/* the runs of the aligned classes are reused */
+	test_alloc(pop, rootp);
+	test_space(pop);
+
+	pmemobj_close(pop);
+
+	UT_ASSERTeq(pmemobj_check(path, LAYOUT_NAME), 1);
+
+	DONE(NULL);
+}
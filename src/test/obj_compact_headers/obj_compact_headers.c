@@ -0,0 +1,303 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_compact_headers.c -- unit test for pools with compact object headers
+ *
+ * usage: obj_compact_headers file
+ */
+#include <string.h>
+
+#include "bucket.h"
+#include "obj.h"
+#include "unittest.h"
+#include "util.h"
+
+#define LAYOUT_NAME "compact_headers"
+
+#define TEST_NOBJS	64
+#define TEST_SIZE	40	/* fits in a single 64 byte block */
+#define TEST_ROOT_SIZE	100
+#define TEST_ALIGNMENT	256
+#define TEST_TYPE	7
+#define TEST_SMALL_NOBJS	(2 * RUN_NALLOCS(64))
+
+/*
+ * get_incompat -- (internal) reads incompat features from the pool header
+ */
+static uint32_t
+get_incompat(const char *path)
+{
+	struct pool_hdr hdr;
+
+	int fd = OPEN(path, O_RDONLY);
+	UT_ASSERTeq(READ(fd, &hdr, sizeof(hdr)), sizeof(hdr));
+	CLOSE(fd);
+
+	return le32toh(hdr.incompat_features);
+}
+
+/*
+ * count_objs -- (internal) returns the number of objects visible to the user
+ */
+static unsigned
+count_objs(PMEMobjpool *pop, uint64_t type_num)
+{
+	unsigned n = 0;
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid) {
+		UT_ASSERTeq(oid.off % 16, 0);
+		if (pmemobj_type_num(oid) == type_num)
+			n++;
+	}
+
+	return n;
+}
+
+/*
+ * test_alloc -- (internal) small objects take a single block
+ */
+static void
+test_alloc(PMEMobjpool *pop)
+{
+	PMEMoid oids[TEST_NOBJS];
+
+	for (unsigned i = 0; i < TEST_NOBJS; ++i) {
+		int ret = pmemobj_zalloc(pop, &oids[i], TEST_SIZE, i);
+		UT_ASSERTeq(ret, 0);
+		UT_ASSERTeq(oids[i].off % 16, 0);
+		UT_ASSERTeq(pmemobj_alloc_usable_size(oids[i]), 48);
+		UT_ASSERTeq(pmemobj_type_num(oids[i]), i);
+	}
+
+	/* the objects are packed next to each other */
+	UT_ASSERTeq(oids[1].off - oids[0].off, 64);
+
+	for (unsigned i = 0; i < TEST_NOBJS; ++i)
+		UT_ASSERTeq(count_objs(pop, i), 1);
+
+	/* the type number changes together with the size */
+	int ret = pmemobj_realloc(pop, &oids[0], 1024, TEST_TYPE);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERT(pmemobj_alloc_usable_size(oids[0]) >= 1024);
+	UT_ASSERTeq(pmemobj_type_num(oids[0]), TEST_TYPE);
+
+	ret = pmemobj_realloc(pop, &oids[0], 1024, 0);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(pmemobj_type_num(oids[0]), 0);
+
+	PMEMoid aligned;
+	ret = pmemobj_alloc_aligned(pop, &aligned, TEST_SIZE, TEST_ALIGNMENT,
+		TEST_TYPE, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(aligned.off % TEST_ALIGNMENT, 0);
+	UT_ASSERTeq(pmemobj_type_num(aligned), TEST_TYPE);
+	UT_ASSERT(pmemobj_alloc_usable_size(aligned) >= TEST_SIZE);
+
+	for (unsigned i = 1; i < TEST_NOBJS; ++i)
+		pmemobj_free(&oids[i]);
+
+	UT_ASSERTeq(count_objs(pop, 0), 1);
+	UT_ASSERTeq(count_objs(pop, TEST_TYPE), 1);
+}
+
+/*
+ * obj_chunk -- (internal) returns the chunk of the first zone of an object
+ */
+static size_t
+obj_chunk(PMEMobjpool *pop, PMEMoid oid)
+{
+	struct zone *z = ZID_TO_ZONE(pop->heap.layout, 0);
+
+	return (size_t)((uintptr_t)pmemobj_direct(oid) -
+		(uintptr_t)&z->chunks[0]) / CHUNKSIZE;
+}
+
+/*
+ * test_small_classes -- (internal) the runs of the smallest blocks are used
+ *	whole and the objects of up to 80 bytes have classes of their own
+ */
+static void
+test_small_classes(PMEMobjpool *pop)
+{
+	PMEMoid *oids = MALLOC(sizeof(*oids) * TEST_SMALL_NOBJS);
+	size_t *nobjs = ZALLOC(sizeof(*nobjs) * MAX_CHUNK);
+
+	for (size_t i = 0; i < TEST_SMALL_NOBJS; ++i) {
+		int ret = pmemobj_alloc(pop, &oids[i], TEST_SIZE, 0,
+				NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+		nobjs[obj_chunk(pop, oids[i])]++;
+	}
+
+	/* a run is filled with more objects than its header bitmap covers */
+	size_t max = 0;
+	for (size_t c = 0; c < MAX_CHUNK; ++c)
+		if (nobjs[c] > max)
+			max = nobjs[c];
+	UT_ASSERTeq(max, RUN_NALLOCS(64));
+	UT_ASSERT(max > RUN_BITMAP_SIZE);
+
+	for (size_t i = 0; i < TEST_SMALL_NOBJS; ++i)
+		pmemobj_free(&oids[i]);
+
+	FREE(nobjs);
+	FREE(oids);
+
+	static const size_t sizes[] = {64, 80};
+	for (size_t s = 0; s < ARRAY_SIZE(sizes); ++s) {
+		PMEMoid a, b;
+		UT_ASSERTeq(pmemobj_alloc(pop, &a, sizes[s], 0,
+			NULL, NULL), 0);
+		UT_ASSERTeq(pmemobj_alloc(pop, &b, sizes[s], 0,
+			NULL, NULL), 0);
+
+		/* the size of the block is the object and its header */
+		UT_ASSERTeq(pmemobj_alloc_usable_size(a), sizes[s]);
+		UT_ASSERTeq(b.off - a.off, sizes[s] + 16);
+
+		pmemobj_free(&a);
+		pmemobj_free(&b);
+	}
+}
+
+/*
+ * test_root -- (internal) the root object is hidden from iteration
+ */
+static void
+test_root(PMEMobjpool *pop)
+{
+	PMEMoid root = pmemobj_root(pop, TEST_ROOT_SIZE);
+	UT_ASSERT(!OID_IS_NULL(root));
+	UT_ASSERTeq(pmemobj_root_size(pop), TEST_ROOT_SIZE);
+	UT_ASSERTeq(pmemobj_type_num(root), POBJ_ROOT_TYPE_NUM);
+
+	root = pmemobj_root(pop, TEST_ROOT_SIZE * 10);
+	UT_ASSERT(!OID_IS_NULL(root));
+	UT_ASSERTeq(pmemobj_root_size(pop), TEST_ROOT_SIZE * 10);
+
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid)
+		UT_ASSERTne(oid.off, root.off);
+}
+
+/*
+ * test_tx -- (internal) objects allocated by transactions
+ */
+static void
+test_tx(PMEMobjpool *pop)
+{
+	unsigned nobjs = count_objs(pop, TEST_TYPE);
+	PMEMoid oid = OID_NULL;
+
+	TX_BEGIN(pop) {
+		PMEMoid tmp = pmemobj_tx_alloc(TEST_SIZE, TEST_TYPE);
+		UT_ASSERTeq(pmemobj_tx_free(tmp), 0);
+
+		oid = pmemobj_tx_zalloc(TEST_SIZE, TEST_TYPE);
+		UT_ASSERTeq(oid.off % 16, 0);
+
+		/* the new object does not need a snapshot */
+		pmemobj_tx_add_range(oid, 0, TEST_SIZE);
+		memset(pmemobj_direct(oid), 0xc, TEST_SIZE);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(pmemobj_type_num(oid), TEST_TYPE);
+	UT_ASSERTeq(((char *)pmemobj_direct(oid))[TEST_SIZE - 1], 0xc);
+	UT_ASSERTeq(count_objs(pop, TEST_TYPE), nobjs + 1);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range(oid, 0, TEST_SIZE);
+		memset(pmemobj_direct(oid), 0xd, TEST_SIZE);
+
+		pmemobj_tx_alloc(TEST_SIZE, TEST_TYPE);
+		pmemobj_tx_abort(EINVAL);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(((char *)pmemobj_direct(oid))[TEST_SIZE - 1], 0xc);
+	UT_ASSERTeq(count_objs(pop, TEST_TYPE), nobjs + 1);
+}
+
+/*
+ * test_verify -- (internal) checks the pool contents after reopen
+ */
+static void
+test_verify(PMEMobjpool *pop)
+{
+	UT_ASSERTeq(pop->heap.header_type, HEADER_COMPACT);
+	UT_ASSERTeq(pmemobj_root_size(pop), TEST_ROOT_SIZE * 10);
+	UT_ASSERTeq(count_objs(pop, 0), 1);
+	UT_ASSERTeq(count_objs(pop, TEST_TYPE), 2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_compact_headers");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file", argv[0]);
+
+	const char *path = argv[1];
+
+	struct pobj_pool_attr attr = { 0, 0, 0, POBJ_POOL_COMPACT_HEADERS };
+
+	PMEMobjpool *pop = pmemobj_create_attr(path, LAYOUT_NAME,
+			PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR, &attr);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create_attr: %s", path);
+
+	UT_ASSERTeq(pop->heap.header_type, HEADER_COMPACT);
+
+	test_small_classes(pop);
+	test_alloc(pop);
+	test_root(pop);
+	test_tx(pop);
+
+	pmemobj_close(pop);
+	UT_ASSERTne(get_incompat(path) & OBJ_INCOMPAT_COMPACT_HEADERS, 0);
+
+	UT_ASSERTeq(pmemobj_check(path, LAYOUT_NAME), 1);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	test_verify(pop);
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
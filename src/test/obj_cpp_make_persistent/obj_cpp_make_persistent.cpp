@@ -145,6 +145,46 @@ test_make_args(nvobj::pool<struct root> &pop)
 	UT_ASSERT(r->pfoo == nullptr);
 }
 
+/*
+ * test_make_aligned -- (internal) test make_persistent_aligned
+ */
+void
+test_make_aligned(nvobj::pool<struct root> &pop)
+{
+	nvobj::persistent_ptr<root> r = pop.get_root();
+
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			UT_ASSERT(r->pfoo == nullptr);
+
+			r->pfoo = nvobj::make_persistent_aligned<foo>(4096, 5);
+			r->pfoo->check_foo(5, 5);
+			UT_ASSERTeq(r->pfoo.raw().off % 4096, 0);
+
+			nvobj::delete_persistent<foo>(r->pfoo);
+			r->pfoo = nullptr;
+		});
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+
+	UT_ASSERT(r->pfoo == nullptr);
+
+	bool exception_thrown = false;
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			r->pfoo = nvobj::make_persistent_aligned<foo>(3);
+		});
+	} catch (nvml::transaction_alloc_error &) {
+		exception_thrown = true;
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+
+	UT_ASSERT(exception_thrown);
+	UT_ASSERT(r->pfoo == nullptr);
+}
+
 /*
  * test_additional_delete -- (internal) test double delete and delete rollback
  */
@@ -220,6 +260,7 @@ main(int argc, char *argv[])
 
 	test_make_no_args(pop);
 	test_make_args(pop);
+	test_make_aligned(pop);
 	test_additional_delete(pop);
 
 	pop.close();
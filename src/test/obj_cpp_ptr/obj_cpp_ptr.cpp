@@ -63,6 +63,7 @@ test_null_ptr(nvobj::persistent_ptr<int> &f)
 	UT_ASSERT(!f);
 	UT_ASSERTeq(f.get(), NULL);
 	UT_ASSERT(f == nullptr);
+	f.prefetch();
 }
 
 /*
@@ -187,6 +188,8 @@ test_ptr_transactional(nvobj::pool<root> &pop)
 		UT_ASSERT(0);
 	}
 
+	pfoo.prefetch();
+	UT_ASSERT(pfoo == r->pfoo);
 	UT_ASSERTeq(pfoo->bar, TEST_INT);
 	for (auto c : pfoo->arr) {
 		UT_ASSERTeq(c, TEST_CHAR);
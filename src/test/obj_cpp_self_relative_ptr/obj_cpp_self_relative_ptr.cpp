@@ -0,0 +1,199 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_cpp_self_relative_ptr.cpp -- cpp self_relative_ptr test
+ *
+ */
+
+#include "unittest.h"
+
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/self_relative_ptr.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#define LAYOUT "cpp"
+
+namespace nvobj = nvml::obj;
+
+namespace
+{
+
+const int TEST_NNODES = 16;
+
+struct node {
+	nvobj::self_relative_ptr<node> next;
+	nvobj::p<int> value;
+};
+
+struct root {
+	nvobj::self_relative_ptr<node> head;
+	nvobj::persistent_ptr<node> first;
+};
+
+/*
+ * test_null_ptr -- verifies the behavior of a null pointer
+ */
+void
+test_null_ptr()
+{
+	nvobj::self_relative_ptr<node> n;
+	UT_ASSERTeq(n.raw(), 0);
+	UT_ASSERT(!n);
+	UT_ASSERT(n == nullptr);
+	UT_ASSERTeq(n.get(), NULL);
+	UT_ASSERT(n.to_persistent_ptr() == nullptr);
+
+	nvobj::self_relative_ptr<node> m = nullptr;
+	UT_ASSERT(n == m);
+
+	static_assert(sizeof(n) == sizeof(uint64_t),
+		      "self_relative_ptr is not 8 bytes");
+}
+
+/*
+ * test_build -- builds a list of nodes linked by self-relative pointers
+ */
+void
+test_build(nvobj::pool<root> &pop)
+{
+	auto r = pop.get_root();
+
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			for (int i = TEST_NNODES - 1; i >= 0; --i) {
+				auto n = nvobj::make_persistent<node>();
+				n->value = i;
+				n->next = r->head;
+				r->head = n;
+			}
+			r->first = r->head.to_persistent_ptr();
+		});
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+
+	UT_ASSERT(r->head != nullptr);
+	UT_ASSERTeq(r->head.get(), r->first.get());
+
+	/* a copy points at the same object from a different address */
+	nvobj::self_relative_ptr<node> copy = r->head;
+	UT_ASSERT(copy == r->head);
+	UT_ASSERTne(copy.raw(), r->head.raw());
+}
+
+/*
+ * test_abort -- an aborted assignment restores the pointer
+ */
+void
+test_abort(nvobj::pool<root> &pop)
+{
+	auto r = pop.get_root();
+	node *head = r->head.get();
+
+	bool exception_thrown = false;
+	try {
+		nvobj::transaction::exec_tx(pop, [&] {
+			r->head = r->head->next;
+			UT_ASSERTeq(r->head->value, 1);
+			nvobj::transaction::abort(EINVAL);
+		});
+	} catch (nvml::manual_tx_abort &) {
+		exception_thrown = true;
+	} catch (...) {
+		UT_ASSERT(0);
+	}
+
+	UT_ASSERT(exception_thrown);
+	UT_ASSERTeq(r->head.get(), head);
+}
+
+/*
+ * test_verify -- walks the list
+ */
+void
+test_verify(nvobj::pool<root> &pop)
+{
+	auto r = pop.get_root();
+
+	UT_ASSERTeq(r->head.get(), r->first.get());
+
+	int i = 0;
+	for (auto n = r->head.get(); n != nullptr; n = n->next.get())
+		UT_ASSERTeq(n->value, i++);
+
+	UT_ASSERTeq(i, TEST_NNODES);
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_cpp_self_relative_ptr");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<root> pop;
+
+	try {
+		pop = nvobj::pool<struct root>::create(
+			path, LAYOUT, PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	} catch (nvml::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	test_null_ptr();
+	test_build(pop);
+	test_abort(pop);
+	test_verify(pop);
+
+	pop.close();
+
+	/* the pool might be mapped at a different address after reopening */
+	try {
+		pop = nvobj::pool<struct root>::open(path, LAYOUT);
+	} catch (nvml::pool_error &pe) {
+		UT_FATAL("!pool::open: %s %s", pe.what(), path);
+	}
+
+	test_verify(pop);
+
+	pop.close();
+
+	DONE(NULL);
+}
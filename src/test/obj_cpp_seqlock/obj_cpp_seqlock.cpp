@@ -0,0 +1,173 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_cpp_seqlock.cpp -- cpp seqlock test
+ */
+
+#include "unittest.h"
+
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/seqlock.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+#include <mutex>
+#include <thread>
+
+#define LAYOUT "cpp"
+
+namespace nvobj = nvml::obj;
+
+namespace
+{
+
+/* pool root structure */
+struct root {
+	nvobj::seqlock plock;
+	int a;
+	int b;
+};
+
+/* number of ops per thread */
+const int num_ops = 200;
+
+/* the number of threads */
+const int num_threads = 30;
+
+/*
+ * writer -- (internal) bump up both counters
+ */
+void
+writer(nvobj::persistent_ptr<root> proot)
+{
+	for (int i = 0; i < num_ops; ++i) {
+		std::lock_guard<nvobj::seqlock> lock(proot->plock);
+		++(proot->a);
+		++(proot->b);
+	}
+}
+
+/*
+ * reader -- (internal) verify that the counters are read consistently
+ */
+void
+reader(nvobj::persistent_ptr<root> proot)
+{
+	for (int i = 0; i < num_ops; ++i) {
+		int a, b;
+		proot->plock.read([&] {
+			a = *(volatile int *)&proot->a;
+			b = *(volatile int *)&proot->b;
+		});
+		UT_ASSERTeq(a, b);
+	}
+}
+
+/*
+ * seqlock_test -- (internal) launch worker threads to test the seqlock
+ */
+void
+seqlock_test(nvobj::pool<root> &pop)
+{
+	const int total_threads = num_threads * 2;
+	std::thread threads[total_threads];
+
+	nvobj::persistent_ptr<root> proot = pop.get_root();
+
+	for (int i = 0; i < total_threads; i += 2) {
+		threads[i] = std::thread(writer, proot);
+		threads[i + 1] = std::thread(reader, proot);
+	}
+
+	for (int i = 0; i < total_threads; ++i)
+		threads[i].join();
+}
+
+/*
+ * seqlock_tx_test -- (internal) use the seqlock as a transaction lock
+ */
+void
+seqlock_tx_test(nvobj::pool<root> &pop)
+{
+	nvobj::persistent_ptr<root> proot = pop.get_root();
+
+	uint64_t seq = proot->plock.read_begin();
+
+	nvobj::transaction::exec_tx(pop,
+				    [&] {
+					    UT_ASSERT(!proot->plock.try_lock());
+					    pmemobj_tx_add_range_direct(
+						    &proot->a, 2 * sizeof(int));
+					    ++(proot->a);
+					    ++(proot->b);
+				    },
+				    proot->plock);
+
+	UT_ASSERT(proot->plock.read_retry(seq));
+	UT_ASSERT(proot->plock.try_lock());
+	proot->plock.unlock();
+}
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_cpp_seqlock");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	nvobj::pool<root> pop;
+
+	try {
+		pop = nvobj::pool<root>::create(path, LAYOUT, PMEMOBJ_MIN_POOL,
+						S_IWUSR | S_IRUSR);
+	} catch (nvml::pool_error &pe) {
+		UT_FATAL("!pool::create: %s %s", pe.what(), path);
+	}
+
+	int expected = num_threads * num_ops;
+	seqlock_test(pop);
+	UT_ASSERTeq(pop.get_root()->a, expected);
+	UT_ASSERTeq(pop.get_root()->b, expected);
+
+	seqlock_tx_test(pop);
+	UT_ASSERTeq(pop.get_root()->a, expected + 1);
+	UT_ASSERTeq(pop.get_root()->b, expected + 1);
+
+	pop.close();
+
+	DONE(NULL);
+}
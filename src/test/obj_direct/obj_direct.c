@@ -60,6 +60,54 @@ test_worker(void *arg)
 	return NULL;
 }
 
+/*
+ * test_prefetch -- prefetching must not change the objects and must be
+ *	harmless for null handles and handles of closed pools
+ */
+static void
+test_prefetch(PMEMoid *oids, int noids)
+{
+	pmemobj_prefetch(OID_NULL);
+	pmemobj_prefetch_n(oids, (size_t)noids);
+
+	for (int i = 0; i < noids; ++i) {
+		char *ptr = pmemobj_direct(oids[i]);
+		char saved = *ptr;
+
+		pmemobj_prefetch(oids[i]);
+		UT_ASSERTeq(pmemobj_direct(oids[i]), ptr);
+		UT_ASSERTeq(*ptr, saved);
+	}
+}
+
+#ifndef _WIN32
+/*
+ * test_pool_table -- handles of pools which are not in the pool table
+ *	or which only share a slot with an open pool must be handled correctly
+ */
+static void
+test_pool_table(PMEMobjpool **pops, PMEMoid *oids, int npools)
+{
+	for (int i = 0; i < npools; ++i) {
+		struct _pobj_pool_slot *slot =
+			&_pobj_pools[pops[i]->uuid_lo % _POBJ_POOL_TABLE_SIZE];
+
+		PMEMoid other = oids[i];
+		other.pool_uuid_lo += _POBJ_POOL_TABLE_SIZE;
+		UT_ASSERTeq(pmemobj_direct(other), NULL);
+
+		struct _pobj_pool_slot saved = *slot;
+		slot->pop = NULL;
+		slot->uuid_lo = 0;
+
+		UT_ASSERTeq((char *)pmemobj_direct(oids[i]) - oids[i].off,
+			(char *)pops[i]);
+
+		*slot = saved;
+	}
+}
+#endif
+
 int
 main(int argc, char *argv[])
 {
@@ -103,6 +151,12 @@ main(int argc, char *argv[])
 		UT_ASSERTeq(r, 0);
 	}
 
+	test_prefetch(tmpoids, npools);
+
+#ifndef _WIN32
+	test_pool_table(pops, oids, npools);
+#endif
+
 	r = pmemobj_alloc(pops[0], &thread_oid, 100, 2, NULL, NULL);
 	UT_ASSERTeq(r, 0);
 	UT_ASSERTne(pmemobj_direct(thread_oid), NULL);
@@ -124,6 +178,7 @@ main(int argc, char *argv[])
 		UT_ASSERTeq(pmemobj_direct(tmpoids[i]), NULL);
 		pmemobj_close(pops[i]);
 		UT_ASSERTeq(pmemobj_direct(oids[i]), NULL);
+		pmemobj_prefetch(oids[i]);
 	}
 	pthread_mutex_unlock(&lock);
 
@@ -0,0 +1,268 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_fast_reopen.c -- unit test for reopening a cleanly closed pool
+ *
+ * usage: obj_fast_reopen file
+ */
+#include <stddef.h>
+
+#include "heap.h"
+#include "obj.h"
+#include "unittest.h"
+
+#define LAYOUT_NAME "fast_reopen"
+
+#define TEST_POOL_SIZE	(32 << 20)
+#define TEST_NOBJS	200
+#define TEST_HUGE_SIZE	(300 << 10)
+#define TEST_FILL_SIZE	4000
+
+struct root {
+	PMEMoid objs[TEST_NOBJS];
+};
+
+/*
+ * obj_size -- (internal) returns the size of the n-th object
+ */
+static size_t
+obj_size(unsigned n)
+{
+	return n % 20 == 0 ? TEST_HUGE_SIZE : 64 + (n % 7) * 200;
+}
+
+/*
+ * objs_create -- (internal) allocates the objects, frees half of them
+ */
+static void
+objs_create(PMEMobjpool *pop)
+{
+	struct root *root = pmemobj_direct(pmemobj_root(pop,
+		sizeof(struct root)));
+
+	for (unsigned n = 0; n < TEST_NOBJS; ++n) {
+		PMEMoid *oidp = &root->objs[n];
+		int ret = pmemobj_alloc(pop, oidp, obj_size(n), n, NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+		pmemobj_memset_persist(pop, pmemobj_direct(*oidp), (int)n,
+			obj_size(n));
+	}
+
+	for (unsigned n = 1; n < TEST_NOBJS; n += 2)
+		pmemobj_free(&root->objs[n]);
+}
+
+/*
+ * objs_verify -- (internal) checks the contents of the remaining objects
+ */
+static void
+objs_verify(PMEMobjpool *pop)
+{
+	struct root *root = pmemobj_direct(pmemobj_root(pop,
+		sizeof(struct root)));
+
+	for (unsigned n = 0; n < TEST_NOBJS; ++n) {
+		PMEMoid oid = root->objs[n];
+		if (n % 2) {
+			UT_ASSERT(OID_IS_NULL(oid));
+			continue;
+		}
+
+		UT_ASSERTeq(pmemobj_type_num(oid), n);
+		unsigned char *data = pmemobj_direct(oid);
+		for (size_t i = 0; i < obj_size(n); ++i)
+			UT_ASSERTeq(data[i], (unsigned char)n);
+	}
+}
+
+/*
+ * objs_fill -- (internal) allocates objects until the pool is full, frees
+ *	them and returns their number
+ */
+static unsigned
+objs_fill(PMEMobjpool *pop)
+{
+	PMEMoid head = OID_NULL;
+	unsigned n = 0;
+
+	PMEMoid oid;
+	while (pmemobj_alloc(pop, &oid, TEST_FILL_SIZE, 0, NULL, NULL) == 0) {
+		*(PMEMoid *)pmemobj_direct(oid) = head;
+		head = oid;
+		n++;
+	}
+
+	while (!OID_IS_NULL(head)) {
+		oid = *(PMEMoid *)pmemobj_direct(head);
+		pmemobj_free(&head);
+		head = oid;
+	}
+
+	return n;
+}
+
+/*
+ * pool_map -- (internal) maps the closed pool file
+ */
+static PMEMobjpool *
+pool_map(const char *path, size_t *len)
+{
+	int is_pmem;
+	PMEMobjpool *pop = pmem_map_file(path, 0, 0, 0, len, &is_pmem);
+	UT_ASSERTne(pop, NULL);
+
+	return pop;
+}
+
+/*
+ * pool_unmap -- (internal) persists the changes and unmaps the pool file
+ */
+static void
+pool_unmap(PMEMobjpool *pop, size_t len)
+{
+	UT_ASSERTeq(pmem_msync(pop, len), 0);
+	UT_ASSERTeq(pmem_unmap(pop, len), 0);
+}
+
+/*
+ * check_clean -- (internal) verifies the clean shutdown marker and the heap
+ *	summary of a closed pool
+ */
+static void
+check_clean(const char *path)
+{
+	size_t len;
+	PMEMobjpool *pop = pool_map(path, &len);
+
+	UT_ASSERTeq(pop->clean_run_id, pop->run_id);
+	UT_ASSERTne(pop->heap_summary_offset, 0);
+
+	struct heap_summary *s = (struct heap_summary *)((uintptr_t)pop +
+		pop->heap_offset + pop->heap_summary_offset);
+	UT_ASSERTne(s->nzones, 0);
+	UT_ASSERTne(s->nentries, 0);
+
+	pool_unmap(pop, len);
+}
+
+/*
+ * break_marker -- (internal) simulates an unclean shutdown
+ */
+static void
+break_marker(const char *path)
+{
+	size_t len;
+	PMEMobjpool *pop = pool_map(path, &len);
+
+	pop->clean_run_id = 0;
+
+	pool_unmap(pop, len);
+}
+
+/*
+ * break_summary -- (internal) corrupts the heap summary
+ */
+static void
+break_summary(const char *path)
+{
+	size_t len;
+	PMEMobjpool *pop = pool_map(path, &len);
+
+	struct heap_summary *s = (struct heap_summary *)((uintptr_t)pop +
+		pop->heap_offset + pop->heap_summary_offset);
+	s->entries[0].size_idx++;
+
+	pool_unmap(pop, len);
+}
+
+/*
+ * reopen_fill -- (internal) opens the pool, verifies the objects and returns
+ *	the number of objects that fit in the free space
+ */
+static unsigned
+reopen_fill(const char *path)
+{
+	PMEMobjpool *pop = pmemobj_open(path, LAYOUT_NAME);
+	UT_ASSERTne(pop, NULL);
+
+	objs_verify(pop);
+	unsigned n = objs_fill(pop);
+	UT_ASSERTne(n, 0);
+	objs_verify(pop);
+
+	pmemobj_close(pop);
+
+	return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_fast_reopen");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT_NAME, TEST_POOL_SIZE,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	objs_create(pop);
+	objs_verify(pop);
+	pmemobj_close(pop);
+
+	check_clean(path);
+	reopen_fill(path);
+
+	/* the fill leaves the heap in the same state every time */
+	check_clean(path);
+	unsigned clean = reopen_fill(path);
+
+	check_clean(path);
+	break_marker(path);
+	unsigned full = reopen_fill(path);
+	UT_ASSERTeq(clean, full);
+
+	check_clean(path);
+	break_summary(path);
+	unsigned fallback = reopen_fill(path);
+	UT_ASSERTeq(clean, fallback);
+
+	check_clean(path);
+	UT_ASSERTeq(reopen_fill(path), clean);
+
+	DONE(NULL);
+}
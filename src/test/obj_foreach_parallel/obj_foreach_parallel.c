@@ -0,0 +1,168 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_foreach_parallel.c -- unit test for parallel object traversal
+ *
+ * usage: obj_foreach_parallel file
+ */
+#include "libpmemobj.h"
+#include "unittest.h"
+
+#define LAYOUT_NAME "foreach_parallel"
+
+#define TEST_POOL_SIZE	(64 << 20)
+#define TEST_NTYPES	4
+#define TEST_NSMALL	3000
+#define TEST_NHUGE	24
+#define TEST_HUGE_TYPE	TEST_NTYPES
+#define TEST_STOP	100
+#define TEST_STOP_RET	5
+
+struct counts {
+	uint64_t nobjs[TEST_NTYPES + 1];
+	uint64_t offsum; /* sum of the offsets of all visited objects */
+};
+
+/*
+ * count_cb -- (internal) parallel traversal callback, counts the objects
+ */
+static int
+count_cb(PMEMoid oid, void *arg)
+{
+	struct counts *c = arg;
+
+	uint64_t t = pmemobj_type_num(oid);
+	UT_ASSERT(t <= TEST_NTYPES);
+
+	__sync_fetch_and_add(&c->nobjs[t], 1);
+	__sync_fetch_and_add(&c->offsum, oid.off);
+
+	return 0;
+}
+
+/*
+ * stop_cb -- (internal) parallel traversal callback, stops the traversal
+ *	after a number of objects
+ */
+static int
+stop_cb(PMEMoid oid, void *arg)
+{
+	unsigned *n = arg;
+
+	return __sync_add_and_fetch(n, 1) == TEST_STOP ? TEST_STOP_RET : 0;
+}
+
+/*
+ * count_serial -- (internal) counts the objects with a serial walk
+ */
+static void
+count_serial(PMEMobjpool *pop, struct counts *c)
+{
+	memset(c, 0, sizeof(*c));
+
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid) {
+		c->nobjs[pmemobj_type_num(oid)]++;
+		c->offsum += oid.off;
+	}
+}
+
+/*
+ * test_parallel -- (internal) compares parallel traversals with the serial
+ *	one
+ */
+static void
+test_parallel(PMEMobjpool *pop, unsigned nthreads)
+{
+	struct counts expected;
+	count_serial(pop, &expected);
+
+	struct counts c;
+	memset(&c, 0, sizeof(c));
+	UT_ASSERTeq(pmemobj_foreach_parallel(pop, nthreads, count_cb, &c), 0);
+	UT_ASSERTeq(memcmp(&c, &expected, sizeof(c)), 0);
+
+	for (uint64_t t = 0; t <= TEST_NTYPES; ++t) {
+		memset(&c, 0, sizeof(c));
+		int ret = pmemobj_foreach_type_parallel(pop, t, nthreads,
+				count_cb, &c);
+		UT_ASSERTeq(ret, 0);
+
+		for (uint64_t i = 0; i <= TEST_NTYPES; ++i)
+			UT_ASSERTeq(c.nobjs[i], i == t ? expected.nobjs[i] : 0);
+	}
+
+	unsigned n = 0;
+	UT_ASSERTeq(pmemobj_foreach_parallel(pop, nthreads, stop_cb, &n),
+			TEST_STOP_RET);
+	UT_ASSERT(n >= TEST_STOP);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_foreach_parallel");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file", argv[0]);
+
+	PMEMobjpool *pop = pmemobj_create(argv[1], LAYOUT_NAME,
+			TEST_POOL_SIZE, S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", argv[1]);
+
+	PMEMoid huge[TEST_NHUGE];
+	for (int i = 0; i < TEST_NHUGE; ++i) {
+		int ret = pmemobj_alloc(pop, &huge[i], 1 << 20,
+				TEST_HUGE_TYPE, NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+
+	/* leave free chunks in between the used ones */
+	for (int i = 0; i < TEST_NHUGE; i += 3)
+		pmemobj_free(&huge[i]);
+
+	for (int i = 0; i < TEST_NSMALL; ++i) {
+		uint64_t t = (uint64_t)i % (TEST_NTYPES - 1) + 1;
+		int ret = pmemobj_alloc(pop, NULL, 64 + (size_t)i % 512, t,
+				NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+
+	test_parallel(pop, 1);
+	test_parallel(pop, 4);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
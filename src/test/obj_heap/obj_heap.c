@@ -126,7 +126,7 @@ test_heap()
 	blocksp[2] = &next;
 
 	struct operation_context ctx;
-	operation_init(&ctx, pop, NULL, NULL);
+	operation_init(&ctx, pop, NULL, NULL, 0);
 	ctx.p_ops = &pop->p_ops;
 	struct memory_block result =
 		heap_coalesce(heap, blocksp, MAX_BLOCKS, HDR_OP_FREE, &ctx);
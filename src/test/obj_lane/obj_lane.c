@@ -362,6 +362,78 @@ test_lane_cleanup_in_separate_thread(void)
 	UT_ASSERTeq(pop.p.lanes_desc.lane_locks, NULL);
 }
 
+#define HOLD_THREADS 8
+#define HOLD_LOOPS 10000
+
+static unsigned Lane_owners[MAX_MOCK_LANES];
+
+/*
+ * test_lane_hold_worker -- (internal) repeatedly holds a lane and verifies
+ *	that no other thread holds the same one
+ */
+static void *
+test_lane_hold_worker(void *arg)
+{
+	PMEMobjpool *pop = arg;
+	struct lane_section *sec;
+
+	for (int i = 0; i < HOLD_LOOPS; ++i) {
+		unsigned idx = lane_hold(pop, &sec, LANE_SECTION_ALLOCATOR);
+		UT_ASSERT(idx < pop->lanes_desc.runtime_nlanes);
+		UT_ASSERTeq(sec, &pop->lanes_desc.lane[idx].sections[
+			LANE_SECTION_ALLOCATOR]);
+
+		UT_ASSERTeq(__sync_fetch_and_add(&Lane_owners[idx], 1), 0);
+		if (i % 16 == 0)
+			sched_yield();
+		UT_ASSERTeq(__sync_fetch_and_sub(&Lane_owners[idx], 1), 1);
+
+		lane_release(pop);
+	}
+
+	lane_info_destroy();
+
+	return NULL;
+}
+
+/*
+ * test_lane_hold_oversubscribed -- more threads than lanes hold and release
+ *	lanes concurrently
+ */
+static void
+test_lane_hold_oversubscribed(void)
+{
+	struct mock_pop pop = {
+		.p = {
+			.nlanes = MAX_MOCK_LANES,
+			.lanes_desc = {
+				.runtime_nlanes = 2
+			}
+		}
+	};
+	base_ptr = &pop.p;
+	pop.p.lanes_offset = (uint64_t)&pop.l - (uint64_t)&pop.p;
+
+	lane_info_boot();
+	UT_ASSERTeq(lane_boot(&pop.p), 0);
+
+	pthread_t threads[HOLD_THREADS];
+	for (int i = 0; i < HOLD_THREADS; ++i)
+		PTHREAD_CREATE(&threads[i], NULL, test_lane_hold_worker,
+			&pop.p);
+
+	for (int i = 0; i < HOLD_THREADS; ++i)
+		PTHREAD_JOIN(threads[i], NULL);
+
+	UT_ASSERTeq(pop.p.lanes_desc.slow_acquirers, 0);
+	UT_ASSERTeq(pop.p.lanes_desc.waiters, 0);
+	for (unsigned i = 0; i < pop.p.lanes_desc.runtime_nlanes; ++i)
+		UT_ASSERTeq(pop.p.lanes_desc.lane_locks[i], 0);
+
+	lane_cleanup(&pop.p);
+	lane_info_destroy();
+}
+
 static void
 usage(const char *app)
 {
@@ -390,6 +462,7 @@ main(int argc, char *argv[])
 		/* multithreaded scenarios */
 		test_lane_info_destroy_in_separate_thread();
 		test_lane_cleanup_in_separate_thread();
+		test_lane_hold_oversubscribed();
 		break;
 	default:
 		usage(argv[0]);
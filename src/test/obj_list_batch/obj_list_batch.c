@@ -0,0 +1,234 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_list_batch.c -- unit test for batched atomic list operations
+ *
+ * usage: obj_list_batch file
+ */
+#include <stddef.h>
+
+#include "libpmemobj.h"
+#include "unittest.h"
+
+/* more elements than fit in the redo log of a single lane */
+#define TEST_NITEMS	100
+#define TEST_NHEAD	3
+#define TEST_NRUN	20
+
+POBJ_LAYOUT_BEGIN(list_batch);
+POBJ_LAYOUT_ROOT(list_batch, struct root);
+POBJ_LAYOUT_TOID(list_batch, struct item);
+POBJ_LAYOUT_END(list_batch);
+
+struct item {
+	int id;
+	POBJ_LIST_ENTRY(struct item) next;
+};
+
+struct root {
+	POBJ_LIST_HEAD(list_a, struct item) a;
+	POBJ_LIST_HEAD(list_b, struct item) b;
+	TOID(struct item) items[TEST_NITEMS + TEST_NHEAD];
+};
+
+#define PE_OFFSET offsetof(struct item, next)
+
+/*
+ * check_list -- (internal) verifies the ids of the list elements in both
+ *	directions
+ */
+static void
+check_list(PMEMobjpool *pop, void *head, const int *ids, int nids)
+{
+	struct list_a *h = head;
+	TOID(struct item) item;
+
+	int i = 0;
+	POBJ_LIST_FOREACH(item, h, next) {
+		UT_ASSERT(i < nids);
+		UT_ASSERTeq(D_RO(item)->id, ids[i]);
+		i++;
+	}
+	UT_ASSERTeq(i, nids);
+
+	POBJ_LIST_FOREACH_REVERSE(item, h, next) {
+		i--;
+		UT_ASSERTeq(D_RO(item)->id, ids[i]);
+	}
+	UT_ASSERTeq(i, 0);
+}
+
+/*
+ * test_insert -- (internal) inserts the items at the tail and then a few
+ *	more at the head of the list
+ */
+static void
+test_insert(PMEMobjpool *pop, struct root *r)
+{
+	PMEMoid oids[TEST_NITEMS + TEST_NHEAD];
+	int ids[TEST_NITEMS + TEST_NHEAD];
+
+	for (int i = 0; i < TEST_NITEMS + TEST_NHEAD; ++i) {
+		POBJ_ZNEW(pop, &r->items[i], struct item);
+		UT_ASSERT(!TOID_IS_NULL(r->items[i]));
+		D_RW(r->items[i])->id = i;
+		pmemobj_persist(pop, D_RW(r->items[i]), sizeof(struct item));
+		oids[i] = r->items[i].oid;
+	}
+
+	/* an empty batch is a no-op */
+	UT_ASSERTeq(pmemobj_list_insert_batch(pop, PE_OFFSET, &r->a,
+		OID_NULL, POBJ_LIST_DEST_TAIL, oids, 0), 0);
+	UT_ASSERT(POBJ_LIST_EMPTY(&r->a));
+
+	UT_ASSERTeq(pmemobj_list_insert_batch(pop, PE_OFFSET, &r->a,
+		OID_NULL, POBJ_LIST_DEST_TAIL, oids, TEST_NITEMS), 0);
+
+	for (int i = 0; i < TEST_NITEMS; ++i)
+		ids[i] = i;
+	check_list(pop, &r->a, ids, TEST_NITEMS);
+
+	UT_ASSERTeq(pmemobj_list_insert_batch(pop, PE_OFFSET, &r->a,
+		OID_NULL, POBJ_LIST_DEST_HEAD, &oids[TEST_NITEMS],
+		TEST_NHEAD), 0);
+
+	for (int i = 0; i < TEST_NHEAD; ++i)
+		ids[i] = TEST_NITEMS + i;
+	for (int i = 0; i < TEST_NITEMS; ++i)
+		ids[TEST_NHEAD + i] = i;
+	check_list(pop, &r->a, ids, TEST_NITEMS + TEST_NHEAD);
+}
+
+/*
+ * test_move -- (internal) moves the even items to the other list and a run
+ *	of adjacent items to the head of the same list
+ */
+static void
+test_move(PMEMobjpool *pop, struct root *r)
+{
+	PMEMoid oids[TEST_NITEMS];
+	int ids_a[TEST_NITEMS + TEST_NHEAD];
+	int ids_b[TEST_NITEMS];
+	int na = 0;
+	int nb = 0;
+
+	for (int i = 0; i < TEST_NITEMS; i += 2) {
+		oids[nb] = r->items[i].oid;
+		ids_b[nb++] = i;
+	}
+
+	UT_ASSERTeq(pmemobj_list_move_batch(pop, PE_OFFSET, &r->a,
+		PE_OFFSET, &r->b, OID_NULL, POBJ_LIST_DEST_TAIL,
+		oids, (size_t)nb), 0);
+
+	check_list(pop, &r->b, ids_b, nb);
+
+	/* the odd items, the last TEST_NRUN of them moved to the head */
+	for (int i = TEST_NITEMS - 2 * TEST_NRUN + 1; i < TEST_NITEMS; i += 2)
+		ids_a[na++] = i;
+	for (int i = 0; i < TEST_NHEAD; ++i)
+		ids_a[na++] = TEST_NITEMS + i;
+	for (int i = 1; i < TEST_NITEMS - 2 * TEST_NRUN; i += 2)
+		ids_a[na++] = i;
+
+	for (int i = 0; i < TEST_NRUN; ++i)
+		oids[i] = r->items[ids_a[i]].oid;
+
+	UT_ASSERTeq(pmemobj_list_move_batch(pop, PE_OFFSET, &r->a,
+		PE_OFFSET, &r->a, OID_NULL, POBJ_LIST_DEST_HEAD,
+		oids, TEST_NRUN), 0);
+
+	check_list(pop, &r->a, ids_a, na);
+}
+
+/*
+ * test_remove -- (internal) removes a run of adjacent items from one list
+ *	and frees all of the items of the other one
+ */
+static void
+test_remove(PMEMobjpool *pop, struct root *r)
+{
+	PMEMoid oids[TEST_NITEMS];
+	int ids[TEST_NITEMS + TEST_NHEAD];
+	int n = 0;
+
+	/* keep the run moved to the head, remove everything else */
+	TOID(struct item) item;
+	POBJ_LIST_FOREACH(item, &r->a, next) {
+		if (n < TEST_NRUN)
+			ids[n] = D_RO(item)->id;
+		else
+			oids[n - TEST_NRUN] = item.oid;
+		n++;
+	}
+
+	UT_ASSERTeq(pmemobj_list_remove_batch(pop, PE_OFFSET, &r->a,
+		oids, (size_t)(n - TEST_NRUN), 0), 0);
+	check_list(pop, &r->a, ids, TEST_NRUN);
+
+	n = 0;
+	POBJ_LIST_FOREACH(item, &r->b, next)
+		oids[n++] = item.oid;
+
+	UT_ASSERTeq(pmemobj_list_remove_batch(pop, PE_OFFSET, &r->b,
+		oids, (size_t)n, 1), 0);
+	UT_ASSERT(POBJ_LIST_EMPTY(&r->b));
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_list_batch");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop = pmemobj_create(path, POBJ_LAYOUT_NAME(list_batch),
+			PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	struct root *r = D_RW(POBJ_ROOT(pop, struct root));
+
+	test_insert(pop, r);
+	test_move(pop, r);
+	test_remove(pop, r);
+
+	pmemobj_close(pop);
+
+	UT_ASSERTeq(pmemobj_check(path, POBJ_LAYOUT_NAME(list_batch)), 1);
+
+	DONE(NULL);
+}
@@ -289,6 +289,41 @@ do_lock_mt(TOID(struct locks) lock, unsigned f_num)
 						(D_RO(lock)->data[i] == 0));
 }
 
+/*
+ * do_lock_stats -- verify contention statistics of the locks
+ */
+static void
+do_lock_stats(PMEMobjpool *pop, TOID(struct locks) lock)
+{
+	UT_ASSERTeq(pmemobj_lock_set_max_spin(pop, UINT_MAX), EINVAL);
+	UT_ASSERTeq(pmemobj_lock_stats_enable(pop, 1), 0);
+
+	unsigned spins[] = {0, 1000};
+	for (int s = 0; s < 2; ++s) {
+		UT_ASSERTeq(pmemobj_lock_set_max_spin(pop, spins[s]), 0);
+
+		do_lock_mt(lock, 0);
+		do_lock_mt(lock, 2);
+	}
+
+	struct pobj_lock_stats stats;
+	for (int i = 0; i < NUM_LOCKS; i++) {
+		pmemobj_mutex_stats(pop, &D_RW(lock)->mtx[i], &stats);
+		UT_ASSERTeq(stats.acquired, 2 * NUM_THREADS);
+		UT_ASSERTeq(stats.contended, stats.spun + stats.parked);
+
+		pmemobj_rwlock_stats(pop, &D_RW(lock)->rwlk[i], &stats);
+		UT_ASSERTeq(stats.acquired, 2 * NUM_THREADS);
+		UT_ASSERTeq(stats.contended, stats.spun + stats.parked);
+	}
+
+	UT_ASSERTeq(pmemobj_lock_stats_enable(pop, 0), 0);
+	do_lock_mt(lock, 0);
+
+	pmemobj_mutex_stats(pop, &D_RW(lock)->mtx[0], &stats);
+	UT_ASSERTeq(stats.acquired, 2 * NUM_THREADS);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -310,6 +345,8 @@ main(int argc, char *argv[])
 	for (int i = 0; i < MAX_FUNC; i++)
 		do_lock_mt(lock, i);
 
+	do_lock_stats(pop, lock);
+
 	POBJ_FREE(&lock);
 
 	pmemobj_close(pop);
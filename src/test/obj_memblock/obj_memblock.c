@@ -140,7 +140,7 @@ test_block_offset()
 	UT_ASSERTeq(MEMBLOCK_OPS(, &mhuge)->block_offset(&mhuge, heap, NULL),
 			0);
 
-	void *ptr = (char *)run->data + 300;
+	void *ptr = (char *)run->data + RUN_DATA_OFFSET(100) + 300;
 
 	UT_ASSERTeq(MEMBLOCK_OPS(, &mrun)->block_offset(&mrun, heap, ptr), 3);
 }
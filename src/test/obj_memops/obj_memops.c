@@ -0,0 +1,303 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_memops.c -- unit test for operations larger than the lane redo log
+ *
+ * usage: obj_memops file
+ */
+#include "obj.h"
+#include "memops.h"
+#include "pmalloc.h"
+#include "redo.h"
+#include "unittest.h"
+
+#define LAYOUT_NAME "memops"
+
+#define TEST_EXT_ENTRIES	256
+#define TEST_NVALUES		200
+#define TEST_NTRANSIENT		64
+
+struct root {
+	uint64_t values[TEST_NVALUES];
+};
+
+static uint64_t Transient[TEST_NTRANSIENT];
+
+/*
+ * get_root -- (internal) returns the root object of the pool
+ */
+static struct root *
+get_root(PMEMobjpool *pop)
+{
+	PMEMoid root = pmemobj_root(pop, sizeof(struct root));
+	UT_ASSERT(!OID_IS_NULL(root));
+
+	return pmemobj_direct(root);
+}
+
+/*
+ * test_process -- (internal) processes an operation with 'npersistent'
+ *	persistent and TEST_NTRANSIENT transient entries in one step
+ */
+static void
+test_process(PMEMobjpool *pop, size_t npersistent, uint64_t base)
+{
+	struct root *r = get_root(pop);
+
+	struct redo_log *redo = pmalloc_redo_hold(pop);
+
+	struct operation_context ctx;
+	operation_init(&ctx, pop, pop->redo, redo,
+		pmalloc_redo_nentries(pop));
+
+	for (size_t i = 0; i < npersistent; ++i)
+		operation_add_entry(&ctx, &r->values[i], base + i,
+			OPERATION_SET);
+
+	for (size_t i = 0; i < TEST_NTRANSIENT; ++i)
+		operation_add_entry(&ctx, &Transient[i], base + i,
+			OPERATION_SET);
+
+	/* duplicate entries modify the already added ones */
+	operation_add_entry(&ctx, &r->values[0], 1, OPERATION_OR);
+
+	UT_ASSERTeq(ctx.nentries[ENTRY_PERSISTENT], npersistent);
+	UT_ASSERTeq(ctx.nentries[ENTRY_TRANSIENT], TEST_NTRANSIENT);
+
+	operation_process(&ctx);
+
+	pmalloc_redo_release(pop);
+
+	UT_ASSERTeq(r->values[0], base | 1);
+	for (size_t i = 1; i < npersistent; ++i)
+		UT_ASSERTeq(r->values[i], base + i);
+
+	for (size_t i = 0; i < TEST_NTRANSIENT; ++i)
+		UT_ASSERTeq(Transient[i], base + i);
+}
+
+/*
+ * failing_malloc -- (internal) malloc which always fails
+ */
+static void *
+failing_malloc(size_t size)
+{
+	errno = ENOMEM;
+	return NULL;
+}
+
+/*
+ * prep_values -- (internal) adds 'n' persistent entries to the operation
+ */
+static void
+prep_values(struct operation_context *ctx, struct root *r, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+		operation_add_entry(ctx, &r->values[i], ~0ULL, OPERATION_SET);
+}
+
+/*
+ * test_fail -- (internal) an operation which cannot be stored fails as
+ *	a whole and leaves the heap usable
+ */
+static void
+test_fail(PMEMobjpool *pop)
+{
+	struct root *r = get_root(pop);
+	size_t nentries = pmalloc_redo_nentries(pop);
+	struct redo_log *redo = pmalloc_redo_hold(pop);
+
+	struct operation_context ctx;
+	operation_init(&ctx, pop, pop->redo, redo, nentries);
+
+	/* too large for the lane redo log */
+	prep_values(&ctx, r, nentries + 1);
+	operation_add_entry(&ctx, &Transient[0], ~0ULL, OPERATION_SET);
+	errno = 0;
+	UT_ASSERTeq(operation_process(&ctx), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	/* the entries cannot be allocated */
+	pmemobj_set_funcs(failing_malloc, NULL, NULL, NULL);
+	prep_values(&ctx, r, OPERATION_EMBEDDED_ENTRIES + 1);
+	pmemobj_set_funcs(NULL, NULL, NULL, NULL);
+	errno = 0;
+	UT_ASSERTeq(operation_process(&ctx), -1);
+	UT_ASSERTeq(errno, ENOMEM);
+
+	for (size_t i = 0; i <= nentries; ++i)
+		UT_ASSERTeq(r->values[i], 0);
+	UT_ASSERTeq(Transient[0], 0);
+
+	/* an allocation which does not fit is rolled back */
+	uint64_t off = 0;
+	prep_values(&ctx, r, nentries);
+	errno = 0;
+	UT_ASSERTne(pmalloc_operation(&pop->heap, 0, &off, 128, 0, NULL, NULL,
+		&ctx), 0);
+	UT_ASSERTeq(errno, EINVAL);
+	UT_ASSERTeq(off, 0);
+
+	/* so is a free */
+	UT_ASSERTeq(pmalloc_operation(&pop->heap, 0, &off, 128, 0, NULL, NULL,
+		&ctx), 0);
+	UT_ASSERTne(off, 0);
+	uint64_t alloc_off = off;
+
+	prep_values(&ctx, r, nentries);
+	errno = 0;
+	UT_ASSERTne(pmalloc_operation(&pop->heap, off, &off, 0, 0, NULL, NULL,
+		&ctx), 0);
+	UT_ASSERTeq(errno, EINVAL);
+	UT_ASSERTeq(off, alloc_off);
+
+	UT_ASSERTeq(pmalloc_operation(&pop->heap, off, &off, 0, 0, NULL, NULL,
+		&ctx), 0);
+	UT_ASSERTeq(off, 0);
+
+	pmalloc_redo_release(pop);
+
+	for (size_t i = 0; i <= nentries; ++i)
+		UT_ASSERTeq(r->values[i], 0);
+
+	/* the freed block is reused */
+	UT_ASSERTeq(pmalloc(pop, &off, 128), 0);
+	UT_ASSERTeq(off, alloc_off);
+	pfree(pop, &off);
+}
+
+/*
+ * test_no_ext -- (internal) a pool without the extension redo log still
+ *	handles operations which fit in the lane redo log
+ */
+static void
+test_no_ext(const char *path)
+{
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT_NAME,
+			PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	UT_ASSERTeq(pop->ext_redo_nentries, 0);
+	UT_ASSERTeq(redo_log_ext_hold(pop->redo, 1), NULL);
+
+	test_fail(pop);
+	test_process(pop, pmalloc_redo_nentries(pop), 0x100);
+
+	pmemobj_close(pop);
+	UNLINK(path);
+}
+
+/*
+ * test_ext -- (internal) operations larger than the lane redo log go to
+ *	the extension redo log
+ */
+static void
+test_ext(const char *path)
+{
+	struct pobj_pool_attr attr = { 0, 0, TEST_EXT_ENTRIES };
+
+	PMEMobjpool *pop = pmemobj_create_attr(path, LAYOUT_NAME,
+			PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR, &attr);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create_attr: %s", path);
+
+	UT_ASSERTeq(pop->ext_redo_nentries, TEST_EXT_ENTRIES);
+	UT_ASSERT(pop->ext_redo_offset >= pop->lanes_offset);
+	UT_ASSERT(pop->ext_redo_offset +
+		TEST_EXT_ENTRIES * sizeof(struct redo_log) <= pop->heap_offset);
+
+	/* too large for the extension redo log */
+	UT_ASSERTeq(redo_log_ext_hold(pop->redo, TEST_EXT_ENTRIES + 1), NULL);
+
+	test_process(pop, TEST_NVALUES, 0x200);
+
+	pmemobj_close(pop);
+	UT_ASSERTeq(pmemobj_check(path, LAYOUT_NAME), 1);
+}
+
+/*
+ * test_ext_recovery -- (internal) an interrupted operation stored in the
+ *	extension redo log is finished on the next open
+ */
+static void
+test_ext_recovery(const char *path)
+{
+	PMEMobjpool *pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	struct root *r = get_root(pop);
+
+	struct redo_log *ext = redo_log_ext_hold(pop->redo, TEST_NVALUES);
+	UT_ASSERTne(ext, NULL);
+
+	size_t i;
+	for (i = 0; i < TEST_NVALUES; ++i)
+		redo_log_store(pop->redo, ext, i,
+			(uintptr_t)&r->values[i] - (uintptr_t)pop, 0x300 + i);
+
+	/* the log is complete but none of the values are written */
+	redo_log_set_last(pop->redo, ext, i - 1);
+	redo_log_ext_release(pop->redo);
+
+	pmemobj_close(pop);
+	UT_ASSERTeq(pmemobj_check(path, LAYOUT_NAME), 1);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	r = get_root(pop);
+	for (i = 0; i < TEST_NVALUES; ++i)
+		UT_ASSERTeq(r->values[i], 0x300 + i);
+
+	pmemobj_close(pop);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_memops");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file", argv[0]);
+
+	const char *path = argv[1];
+
+	test_no_ext(path);
+	test_ext(path);
+	test_ext_recovery(path);
+
+	DONE(NULL);
+}
@@ -121,7 +121,7 @@ obj_memset(void *ctx, void *ptr, int c, size_t sz)
 	return ptr;
 }
 
-static void
+static size_t
 test_oom_allocs(size_t size)
 {
 	uint64_t max_allocs = MOCK_POOL_SIZE / size;
@@ -143,6 +143,8 @@ test_oom_allocs(size_t size)
 	}
 	UT_ASSERT(count != 0);
 	FREE(allocs);
+
+	return count;
 }
 
 static void
@@ -228,9 +230,11 @@ test_mock_pool_allocs()
 	 * Allocating till OOM and freeing the objects in a loop for different
 	 * buckets covers basically all code paths except error cases.
 	 */
-	test_oom_allocs(TEST_HUGE_ALLOC_SIZE);
+	size_t nhuge = test_oom_allocs(TEST_HUGE_ALLOC_SIZE);
 	test_oom_allocs(TEST_TINY_ALLOC_SIZE);
-	test_oom_allocs(TEST_HUGE_ALLOC_SIZE);
+
+	/* the empty runs kept after the small allocations are reclaimed */
+	UT_ASSERTeq(test_oom_allocs(TEST_HUGE_ALLOC_SIZE), nhuge);
 	test_oom_allocs(TEST_SMALL_ALLOC_SIZE);
 	test_oom_allocs(TEST_MEGA_ALLOC_SIZE);
 
@@ -0,0 +1,265 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_pool_attr.c -- unit test for pmemobj_create_attr
+ *
+ * usage: obj_pool_attr file
+ */
+#include <string.h>
+
+#include "obj.h"
+#include "unittest.h"
+
+#define LAYOUT_NAME "pool_attr"
+
+#define TEST_NLANES		4
+#define TEST_SECTION_SIZE	4096
+#define TEST_NOBJS		32
+
+POBJ_LAYOUT_BEGIN(pool_attr);
+POBJ_LAYOUT_ROOT(pool_attr, struct root);
+POBJ_LAYOUT_TOID(pool_attr, struct item);
+POBJ_LAYOUT_END(pool_attr);
+
+struct item {
+	uint64_t value;
+	POBJ_LIST_ENTRY(struct item) next;
+};
+
+struct root {
+	TOID(struct item) objs[TEST_NOBJS];
+	POBJ_LIST_HEAD(item_list, struct item) list;
+};
+
+/*
+ * get_incompat -- (internal) reads incompat features from the pool header
+ */
+static uint32_t
+get_incompat(const char *path)
+{
+	struct pool_hdr hdr;
+
+	int fd = OPEN(path, O_RDONLY);
+	UT_ASSERTeq(READ(fd, &hdr, sizeof(hdr)), sizeof(hdr));
+	CLOSE(fd);
+
+	return le32toh(hdr.incompat_features);
+}
+
+/*
+ * test_invalid -- (internal) pool creation with invalid attributes must fail
+ */
+static void
+test_invalid(const char *path)
+{
+	struct pobj_pool_attr attrs[] = {
+		{ OBJ_NLANES_MAX + 1, 0 },
+		{ 0, LANE_SECTION_LEN / 2 },
+		{ 0, LANE_SECTION_LEN + 1 },
+		{ 0, LANE_SECTION_LEN_MAX * 2 },
+		{ 0, 0, OBJ_EXT_REDO_NENTRIES_MAX + 1 },
+		{ 0, 0, 0, ~(POBJ_POOL_COMPACT_HEADERS |
+			POBJ_POOL_HUGE_ALIGNED) },
+	};
+
+	for (size_t i = 0; i < sizeof(attrs) / sizeof(attrs[0]); ++i) {
+		PMEMobjpool *pop = pmemobj_create_attr(path, LAYOUT_NAME,
+				PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR, &attrs[i]);
+		UT_ASSERTeq(pop, NULL);
+		UT_ASSERTeq(errno, EINVAL);
+	}
+}
+
+/*
+ * test_default -- (internal) default attributes must not change the layout
+ */
+static void
+test_default(const char *path)
+{
+	struct pobj_pool_attr attr = { 0, 0 };
+
+	PMEMobjpool *pop = pmemobj_create_attr(path, LAYOUT_NAME,
+			PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR, &attr);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create_attr: %s", path);
+
+	UT_ASSERTeq(pop->nlanes, OBJ_NLANES);
+	UT_ASSERTeq(OBJ_LANE_SECTION_LEN(pop), LANE_SECTION_LEN);
+
+	pmemobj_close(pop);
+	UT_ASSERTeq(get_incompat(path) & (OBJ_INCOMPAT_LANES |
+		OBJ_INCOMPAT_EXT_REDO | OBJ_INCOMPAT_COMPACT_HEADERS |
+		OBJ_INCOMPAT_HUGE_ALIGNED), 0);
+
+	/* features used by all of the pools of this version */
+	UT_ASSERTne(get_incompat(path) & OBJ_INCOMPAT_ALIGNED_ALLOCS, 0);
+	UT_ASSERTne(get_incompat(path) & OBJ_INCOMPAT_RANGE_CACHE_SLOTS, 0);
+	UT_ASSERTne(get_incompat(path) & OBJ_INCOMPAT_LAZY_ZONES, 0);
+	UNLINK(path);
+}
+
+/*
+ * test_populate -- (internal) exercises all lane sections of the pool
+ */
+static void
+test_populate(PMEMobjpool *pop)
+{
+	TOID(struct root) root = POBJ_ROOT(pop, struct root);
+
+	/* a single transaction touching more objects than there are lanes */
+	TX_BEGIN(pop) {
+		for (int i = 0; i < TEST_NOBJS; ++i) {
+			TX_ADD_FIELD(root, objs[i]);
+			D_RW(root)->objs[i] = TX_NEW(struct item);
+			D_RW(D_RW(root)->objs[i])->value = (uint64_t)i;
+		}
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	for (int i = 0; i < TEST_NOBJS; ++i) {
+		TOID(struct item) item;
+		POBJ_LIST_INSERT_NEW_TAIL(pop, &D_RW(root)->list, next,
+				sizeof(struct item), NULL, NULL);
+		item = POBJ_LIST_LAST(&D_RW(root)->list, next);
+		UT_ASSERT(!TOID_IS_NULL(item));
+	}
+
+	TOID(struct item) item = POBJ_LIST_FIRST(&D_RO(root)->list);
+	POBJ_LIST_REMOVE_FREE(pop, &D_RW(root)->list, item, next);
+}
+
+/*
+ * test_verify -- (internal) checks the pool contents
+ */
+static void
+test_verify(PMEMobjpool *pop)
+{
+	TOID(struct root) root = POBJ_ROOT(pop, struct root);
+
+	for (int i = 0; i < TEST_NOBJS; ++i)
+		UT_ASSERTeq(D_RO(D_RO(root)->objs[i])->value, (uint64_t)i);
+
+	int n = 0;
+	TOID(struct item) item;
+	POBJ_LIST_FOREACH(item, &D_RO(root)->list, next)
+		n++;
+	UT_ASSERTeq(n, TEST_NOBJS - 1);
+}
+
+/*
+ * test_huge_aligned -- (internal) the first chunk of a huge aligned pool
+ *	starts at a huge page boundary
+ */
+static void
+test_huge_aligned(const char *path)
+{
+	struct pobj_pool_attr attr = { 0, 0, 0, POBJ_POOL_HUGE_ALIGNED };
+
+	PMEMobjpool *pop = pmemobj_create_attr(path, LAYOUT_NAME,
+			PMEMOBJ_MIN_POOL * 2, S_IWUSR | S_IRUSR, &attr);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create_attr: %s", path);
+
+	UT_ASSERTeq((pop->heap_offset + HEAP_ZONE0_CHUNKS_OFFSET) %
+		OBJ_HUGE_PAGE_SIZE, 0);
+
+	test_populate(pop);
+	test_verify(pop);
+	pmemobj_close(pop);
+	UT_ASSERTne(get_incompat(path) & OBJ_INCOMPAT_HUGE_ALIGNED, 0);
+
+	UT_ASSERTeq(pmemobj_check(path, LAYOUT_NAME), 1);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	test_verify(pop);
+	pmemobj_close(pop);
+	UNLINK(path);
+}
+
+/*
+ * test_custom -- (internal) pool with custom lanes survives reopen
+ */
+static void
+test_custom(const char *path)
+{
+	struct pobj_pool_attr attr = { TEST_NLANES, TEST_SECTION_SIZE };
+
+	PMEMobjpool *pop = pmemobj_create_attr(path, LAYOUT_NAME,
+			PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR, &attr);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create_attr: %s", path);
+
+	UT_ASSERTeq(pop->nlanes, TEST_NLANES);
+	UT_ASSERTeq(pop->lane_section_len, TEST_SECTION_SIZE);
+
+	test_populate(pop);
+	test_verify(pop);
+	pmemobj_close(pop);
+	UT_ASSERTne(get_incompat(path) & OBJ_INCOMPAT_LANES, 0);
+	UT_ASSERTeq(get_incompat(path) & OBJ_INCOMPAT_EXT_REDO, 0);
+
+	UT_ASSERTeq(pmemobj_check(path, LAYOUT_NAME), 1);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	UT_ASSERTeq(pop->nlanes, TEST_NLANES);
+	UT_ASSERTeq(pop->lane_section_len, TEST_SECTION_SIZE);
+	UT_ASSERT(pop->lanes_desc.runtime_nlanes <= TEST_NLANES);
+
+	test_verify(pop);
+	pmemobj_close(pop);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_pool_attr");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file", argv[0]);
+
+	const char *path = argv[1];
+
+	test_invalid(path);
+	test_default(path);
+	test_huge_aligned(path);
+	test_custom(path);
+
+	DONE(NULL);
+}
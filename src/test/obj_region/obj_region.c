@@ -0,0 +1,315 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_region.c -- unit test for regions
+ *
+ * usage: obj_region file
+ */
+#include <stddef.h>
+
+#include "unittest.h"
+
+#define LAYOUT_NAME "region"
+
+#define TEST_REGION_SIZE	(64 * 1024)
+#define TEST_REGION_TYPE	1
+#define TEST_OBJ_SIZE		100
+#define TEST_OBJ_ALIGNED	112 /* TEST_OBJ_SIZE aligned to 16 bytes */
+#define TEST_NOBJS		16
+
+struct root {
+	PMEMoid region;
+	PMEMoid objs[TEST_NOBJS];
+};
+
+/*
+ * constructor -- (internal) fills the object with its index
+ */
+static int
+constructor(PMEMobjpool *pop, void *ptr, void *arg)
+{
+	pmemobj_memset_persist(pop, ptr, (int)(uintptr_t)arg, TEST_OBJ_SIZE);
+
+	return 0;
+}
+
+/*
+ * constructor_fail -- (internal) constructor which always fails
+ */
+static int
+constructor_fail(PMEMobjpool *pop, void *ptr, void *arg)
+{
+	return -1;
+}
+
+/*
+ * check_obj -- (internal) verifies the contents of the object
+ */
+static void
+check_obj(PMEMoid oid, int c)
+{
+	unsigned char *p = pmemobj_direct(oid);
+	UT_ASSERTne(p, NULL);
+
+	for (size_t i = 0; i < TEST_OBJ_SIZE; ++i)
+		UT_ASSERTeq(p[i], (unsigned char)c);
+}
+
+/*
+ * count -- (internal) returns the number of objects in the heap
+ */
+static unsigned
+count(PMEMobjpool *pop)
+{
+	unsigned n = 0;
+
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid)
+		n++;
+
+	return n;
+}
+
+/*
+ * test_alloc -- (internal) allocates objects from a region with the atomic API
+ */
+static void
+test_alloc(PMEMobjpool *pop, struct root *rootp)
+{
+	int ret = pmemobj_region_create(pop, &rootp->region, TEST_REGION_SIZE,
+		TEST_REGION_TYPE);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(pmemobj_type_num(rootp->region), TEST_REGION_TYPE);
+	UT_ASSERTeq(count(pop), 1);
+
+	for (int i = 0; i < TEST_NOBJS; ++i) {
+		ret = pmemobj_region_alloc(rootp->region, &rootp->objs[i],
+			TEST_OBJ_SIZE, constructor, (void *)(uintptr_t)i);
+		UT_ASSERTeq(ret, 0);
+		UT_ASSERTeq(rootp->objs[i].pool_uuid_lo,
+			rootp->region.pool_uuid_lo);
+		UT_ASSERTeq(rootp->objs[i].off % 16, 0);
+		if (i != 0)
+			UT_ASSERTeq(rootp->objs[i].off,
+				rootp->objs[i - 1].off + TEST_OBJ_ALIGNED);
+	}
+
+	/* objects allocated from a region are not visible in the heap */
+	UT_ASSERTeq(count(pop), 1);
+
+	/* a failed constructor does not consume the space */
+	PMEMoid oid;
+	ret = pmemobj_region_alloc(rootp->region, &oid, TEST_OBJ_SIZE,
+		constructor_fail, NULL);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ECANCELED);
+
+	ret = pmemobj_region_zalloc(rootp->region, &oid, TEST_OBJ_SIZE);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(oid.off,
+		rootp->objs[TEST_NOBJS - 1].off + TEST_OBJ_ALIGNED);
+	check_obj(oid, 0);
+
+	ret = pmemobj_region_alloc(rootp->region, &oid, TEST_REGION_SIZE,
+		NULL, NULL);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ENOMEM);
+
+	ret = pmemobj_region_alloc(rootp->region, &oid, 0, NULL, NULL);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	for (int i = 0; i < TEST_NOBJS; ++i)
+		check_obj(rootp->objs[i], i);
+}
+
+/*
+ * test_reset -- (internal) resets the region and fills it completely
+ */
+static void
+test_reset(PMEMobjpool *pop, struct root *rootp)
+{
+	pmemobj_region_reset(rootp->region);
+
+	PMEMoid oid;
+	int ret = pmemobj_region_alloc(rootp->region, &oid, TEST_OBJ_SIZE,
+		NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(oid.off, rootp->objs[0].off);
+
+	unsigned n = 1;
+	while (pmemobj_region_alloc(rootp->region, NULL, TEST_OBJ_SIZE,
+			NULL, NULL) == 0)
+		n++;
+
+	UT_ASSERTeq(errno, ENOMEM);
+	UT_ASSERTeq(n, TEST_REGION_SIZE / TEST_OBJ_ALIGNED);
+
+	/* restore the objects verified after reopen */
+	pmemobj_region_reset(rootp->region);
+	for (int i = 0; i < TEST_NOBJS; ++i) {
+		ret = pmemobj_region_alloc(rootp->region, &rootp->objs[i],
+			TEST_OBJ_SIZE, constructor, (void *)(uintptr_t)i);
+		UT_ASSERTeq(ret, 0);
+	}
+}
+
+/*
+ * test_tx -- (internal) allocates objects from regions in transactions
+ */
+static void
+test_tx(PMEMobjpool *pop, struct root *rootp)
+{
+	PMEMoid next = OID_NULL;
+
+	/* an aborted allocation does not consume the space */
+	TX_BEGIN(pop) {
+		next = pmemobj_tx_region_zalloc(rootp->region, TEST_OBJ_SIZE);
+		UT_ASSERT(!OID_IS_NULL(next));
+		check_obj(next, 0);
+		pmemobj_tx_abort(-1);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	PMEMoid oid;
+	int ret = pmemobj_region_alloc(rootp->region, &oid, TEST_OBJ_SIZE,
+		constructor, (void *)1);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(oid.off, next.off);
+
+	TX_BEGIN(pop) {
+		next = pmemobj_tx_region_alloc(rootp->region, TEST_OBJ_SIZE);
+		UT_ASSERTeq(next.off, oid.off + TEST_OBJ_ALIGNED);
+		memset(pmemobj_direct(next), 2, TEST_OBJ_SIZE);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_obj(next, 2);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_region_alloc(rootp->region, TEST_REGION_SIZE);
+		UT_ASSERT(0);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_ONABORT {
+		UT_ASSERTeq(errno, ENOMEM);
+	} TX_END
+
+	/* a region created and used within the same transaction */
+	PMEMoid region = OID_NULL;
+	TX_BEGIN(pop) {
+		region = pmemobj_tx_region_create(TEST_REGION_SIZE,
+			TEST_REGION_TYPE);
+		for (int i = 0; i < TEST_NOBJS; ++i) {
+			oid = pmemobj_tx_region_alloc(region, TEST_OBJ_SIZE);
+			memset(pmemobj_direct(oid), i, TEST_OBJ_SIZE);
+		}
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(count(pop), 2);
+	check_obj(oid, TEST_NOBJS - 1);
+
+	/* a region freed in an aborted transaction stays allocated */
+	TX_BEGIN(pop) {
+		pmemobj_tx_region_free(region);
+		pmemobj_tx_abort(-1);
+	} TX_END
+
+	UT_ASSERTeq(count(pop), 2);
+	check_obj(oid, TEST_NOBJS - 1);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_region_free(region);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(count(pop), 1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_region");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT_NAME, PMEMOBJ_MIN_POOL,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	PMEMoid root = pmemobj_root(pop, sizeof(struct root));
+	UT_ASSERT(!OID_IS_NULL(root));
+	struct root *rootp = pmemobj_direct(root);
+
+	test_alloc(pop, rootp);
+	test_reset(pop, rootp);
+	test_tx(pop, rootp);
+
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	rootp = pmemobj_direct(pmemobj_root(pop, sizeof(struct root)));
+
+	for (int i = 0; i < TEST_NOBJS; ++i)
+		check_obj(rootp->objs[i], i);
+
+	/* the space used before close is still allocated */
+	PMEMoid oid;
+	int ret = pmemobj_region_alloc(rootp->region, &oid, TEST_OBJ_SIZE,
+		NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(oid.off,
+		rootp->objs[TEST_NOBJS - 1].off + 3 * TEST_OBJ_ALIGNED);
+
+	pmemobj_region_free(&rootp->region);
+	UT_ASSERT(OID_IS_NULL(rootp->region));
+	UT_ASSERTeq(count(pop), 0);
+
+	pmemobj_close(pop);
+
+	UT_ASSERTeq(pmemobj_check(path, LAYOUT_NAME), 1);
+
+	DONE(NULL);
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_relptr.c -- unit test for self-relative pointers
+ *
+ * usage: obj_relptr file
+ */
+#include "unittest.h"
+
+#define LAYOUT_NAME "relptr"
+
+#define TEST_NNODES	16
+
+POBJ_LAYOUT_BEGIN(relptr);
+POBJ_LAYOUT_ROOT(relptr, struct root);
+POBJ_LAYOUT_TOID(relptr, struct node);
+POBJ_LAYOUT_END(relptr);
+
+struct node {
+	RELPTR(struct node) next;
+	uint64_t value;
+};
+
+struct root {
+	RELPTR(struct node) head;
+	RELPTR(struct node) tail;
+};
+
+/*
+ * test_build -- (internal) builds a list of nodes linked by relative pointers
+ */
+static void
+test_build(PMEMobjpool *pop)
+{
+	TOID(struct root) root = POBJ_ROOT(pop, struct root);
+	struct root *r = D_RW(root);
+
+	UT_ASSERT(RELPTR_IS_NULL(r->head));
+	UT_ASSERTeq(RELPTR_D_RO(r->head), NULL);
+	UT_ASSERT(OID_IS_NULL(RELPTR_OID(r->head)));
+
+	TX_BEGIN(pop) {
+		for (int i = TEST_NNODES - 1; i >= 0; --i) {
+			TOID(struct node) n = TX_ZNEW(struct node);
+			D_RW(n)->value = (uint64_t)i;
+			RELPTR_COPY(D_RW(n)->next, r->head);
+			TX_RELPTR_ASSIGN(r->head, D_RW(n));
+			if (RELPTR_IS_NULL(r->tail))
+				TX_RELPTR_ASSIGN(r->tail, D_RW(n));
+		}
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	/* the last node points at itself */
+	struct node *tail = RELPTR_D_RW(r->tail);
+	TX_BEGIN(pop) {
+		TX_RELPTR_ASSIGN(tail->next, tail);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERT(!RELPTR_IS_NULL(tail->next));
+	UT_ASSERTeq(RELPTR_D_RO(tail->next), tail);
+	UT_ASSERT(OID_EQUALS(RELPTR_OID(tail->next), pmemobj_oid(tail)));
+	UT_ASSERTeq(pmemobj_direct(RELPTR_OID(r->head)), RELPTR_D_RO(r->head));
+}
+
+/*
+ * test_abort -- (internal) an aborted assignment restores the pointer
+ */
+static void
+test_abort(PMEMobjpool *pop)
+{
+	TOID(struct root) root = POBJ_ROOT(pop, struct root);
+	struct root *r = D_RW(root);
+	const struct node *head = RELPTR_D_RO(r->head);
+
+	TX_BEGIN(pop) {
+		TX_RELPTR_ASSIGN(r->head, RELPTR_D_RW(r->tail));
+		UT_ASSERT(RELPTR_EQUALS(r->head, r->tail));
+		pmemobj_tx_abort(ECANCELED);
+	} TX_END
+
+	UT_ASSERTeq(RELPTR_D_RO(r->head), head);
+	UT_ASSERT(!RELPTR_EQUALS(r->head, r->tail));
+}
+
+/*
+ * test_verify -- (internal) walks the list
+ */
+static void
+test_verify(PMEMobjpool *pop)
+{
+	TOID(struct root) root = POBJ_ROOT(pop, struct root);
+	const struct root *r = D_RO(root);
+
+	const struct node *n = RELPTR_D_RO(r->head);
+	for (uint64_t i = 0; i < TEST_NNODES; ++i) {
+		UT_ASSERTne(n, NULL);
+		UT_ASSERTeq(n->value, i);
+		UT_ASSERT(OID_INSTANCEOF(pmemobj_oid(n), struct node));
+		if (i != TEST_NNODES - 1)
+			n = RELPTR_D_RO(n->next);
+	}
+
+	UT_ASSERTeq(n, RELPTR_D_RO(r->tail));
+	UT_ASSERTeq(RELPTR_D_RO(n->next), n);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_relptr");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file", argv[0]);
+
+	const char *path = argv[1];
+
+	UT_COMPILE_ERROR_ON(sizeof(RELPTR(struct node)) != sizeof(uint64_t));
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT_NAME,
+			PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	UT_ASSERT(OID_IS_NULL(pmemobj_oid(NULL)));
+	UT_ASSERT(OID_IS_NULL(pmemobj_oid(&pop)));
+
+	test_build(pop);
+	test_abort(pop);
+	test_verify(pop);
+	pmemobj_close(pop);
+
+	/* the pool might be mapped at a different address after reopening */
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	test_verify(pop);
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_replicas_mt.c -- multithreaded test of updates of the local replicas
+ *
+ * The threads update their own parts of the root object with all of the kinds
+ * of the replicated operations, while a shadow copy of the expected contents
+ * is kept in volatile memory. Each thread also allocates and frees objects on
+ * its own list, which updates the lists and the heap through the redo logs.
+ * Once the pool is closed, the contents of every replica file is compared with
+ * the shadow copy and the lists are walked in every replica file.
+ */
+
+#include "unittest.h"
+
+#define LAYOUT_NAME "replicas_mt"
+#define MAX_THREADS 16
+#define AREA_SIZE 4096
+#define MAX_RANGE 512
+#define MAX_ITEMS 64
+
+TOID_DECLARE(struct item, 1);
+
+struct item {
+	POBJ_LIST_ENTRY(struct item) next;
+	uint64_t data[];
+};
+
+struct root {
+	unsigned char areas[MAX_THREADS][AREA_SIZE];
+	POBJ_LIST_HEAD(item_list, struct item) lists[MAX_THREADS];
+};
+
+static PMEMobjpool *Pop;
+static struct root *Root;
+static unsigned char Shadow[MAX_THREADS][AREA_SIZE];
+static unsigned Nops;
+static struct item Items[MAX_THREADS][MAX_ITEMS];
+static unsigned Nitems[MAX_THREADS];
+
+/*
+ * worker -- updates the area of the thread with all of the operations
+ */
+static void *
+worker(void *arg)
+{
+	unsigned idx = (unsigned)(uintptr_t)arg;
+	unsigned char *area = Root->areas[idx];
+	unsigned char *shadow = Shadow[idx];
+	unsigned char buf[MAX_RANGE];
+	unsigned seed = idx;
+
+	for (unsigned i = 0; i < Nops; ++i) {
+		size_t len = 1 + (size_t)rand_r(&seed) % MAX_RANGE;
+		size_t off = (size_t)rand_r(&seed) % (AREA_SIZE - len);
+		unsigned char c = (unsigned char)(i + idx);
+
+		switch (i % 4) {
+		case 0:
+			memset(buf, c, len);
+			pmemobj_memcpy_persist(Pop, area + off, buf, len);
+			break;
+		case 1:
+			pmemobj_memset_persist(Pop, area + off, c, len);
+			break;
+		case 2:
+			memset(area + off, c, len);
+			pmemobj_persist(Pop, area + off, len);
+			break;
+		case 3:
+			/* two overlapping flushes completed by one drain */
+			memset(area + off, c, len);
+			pmemobj_flush(Pop, area + off, len);
+			memset(area + off, c + 1, len / 2);
+			pmemobj_flush(Pop, area + off, len / 2);
+			pmemobj_drain(Pop);
+
+			memset(shadow + off, c, len);
+			c++;
+			len /= 2;
+			break;
+		}
+
+		memset(shadow + off, c, len);
+	}
+
+	struct item_list *list = &Root->lists[idx];
+	unsigned nitems = 0;
+
+	for (unsigned i = 0; i < Nops; ++i) {
+		size_t size = sizeof(struct item) +
+			(size_t)rand_r(&seed) % MAX_RANGE;
+
+		if (nitems == MAX_ITEMS || (nitems != 0 && i % 3 == 2)) {
+			POBJ_LIST_REMOVE_FREE(Pop, list,
+				POBJ_LIST_LAST(list, next), next);
+			nitems--;
+		} else {
+			if (OID_IS_NULL(POBJ_LIST_INSERT_NEW_HEAD(Pop, list,
+					next, size, NULL, NULL)))
+				UT_FATAL("!POBJ_LIST_INSERT_NEW_HEAD");
+			nitems++;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * check_replica -- compares the root object of the replica with the shadow
+ */
+static void
+check_replica(const char *path, uint64_t root_off)
+{
+	static unsigned char areas[MAX_THREADS][AREA_SIZE];
+
+	int fd = OPEN(path, O_RDONLY);
+	LSEEK(fd, (off_t)root_off, SEEK_SET);
+	READ(fd, areas, sizeof(areas));
+	CLOSE(fd);
+
+	for (unsigned i = 0; i < MAX_THREADS; ++i) {
+		if (memcmp(areas[i], Shadow[i], AREA_SIZE) != 0)
+			UT_FATAL("%s: area %u differs", path, i);
+	}
+}
+
+/*
+ * read_at -- reads an object of the replica file at the given offset
+ */
+static void
+read_at(int fd, uint64_t off, void *buf, size_t len)
+{
+	LSEEK(fd, (off_t)off, SEEK_SET);
+	UT_ASSERTeq(READ(fd, buf, len), (ssize_t)len);
+}
+
+/*
+ * save_lists -- records the contents of the lists of all the threads
+ */
+static void
+save_lists(void)
+{
+	for (unsigned i = 0; i < MAX_THREADS; ++i) {
+		unsigned n = 0;
+		TOID(struct item) it;
+		POBJ_LIST_FOREACH(it, &Root->lists[i], next) {
+			UT_ASSERT(n < MAX_ITEMS);
+			Items[i][n++] = *D_RO(it);
+		}
+		Nitems[i] = n;
+	}
+}
+
+/*
+ * check_lists -- walks the lists of all the threads in the replica file and
+ *	compares them with the lists of the pool
+ */
+static void
+check_lists(const char *path, uint64_t root_off)
+{
+	int fd = OPEN(path, O_RDONLY);
+
+	for (unsigned i = 0; i < MAX_THREADS; ++i) {
+		struct item_list head;
+		read_at(fd, root_off + offsetof(struct root, lists[i]),
+			&head, sizeof(head));
+
+		PMEMoid oid = head.pe_first.oid;
+		for (unsigned n = 0; n < Nitems[i]; ++n) {
+			UT_ASSERT(!OID_IS_NULL(oid));
+
+			struct item item;
+			read_at(fd, oid.off, &item, sizeof(item));
+			if (memcmp(&item, &Items[i][n], sizeof(item)) != 0)
+				UT_FATAL("%s: item %u of list %u differs",
+					path, n, i);
+
+			oid = item.next.pe_next.oid;
+		}
+
+		/* the lists are circular */
+		if (Nitems[i] != 0)
+			UT_ASSERT(OID_EQUALS(oid, head.pe_first.oid));
+	}
+
+	CLOSE(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_replicas_mt");
+
+	if (argc < 5)
+		UT_FATAL("usage: %s poolset nthreads nops replica...",
+			argv[0]);
+
+	unsigned nthreads = (unsigned)atoi(argv[2]);
+	Nops = (unsigned)atoi(argv[3]);
+
+	if (nthreads > MAX_THREADS)
+		UT_FATAL("at most %u threads are supported", MAX_THREADS);
+
+	Pop = pmemobj_create(argv[1], LAYOUT_NAME, 0, S_IWUSR | S_IRUSR);
+	if (Pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", argv[1]);
+
+	PMEMoid root = pmemobj_root(Pop, sizeof(struct root));
+	UT_ASSERT(!OID_IS_NULL(root));
+	Root = pmemobj_direct(root);
+
+	pthread_t threads[MAX_THREADS];
+	for (unsigned i = 0; i < nthreads; ++i)
+		PTHREAD_CREATE(&threads[i], NULL, worker,
+			(void *)(uintptr_t)i);
+
+	for (unsigned i = 0; i < nthreads; ++i)
+		PTHREAD_JOIN(threads[i], NULL);
+
+	UT_ASSERTeq(memcmp(Root->areas, Shadow, sizeof(Shadow)), 0);
+	save_lists();
+
+	pmemobj_close(Pop);
+
+	/* every replica consists of a single part, mapped at its beginning */
+	for (int i = 4; i < argc; ++i) {
+		check_replica(argv[i], root.off);
+		check_lists(argv[i], root.off);
+	}
+
+	DONE(NULL);
+}
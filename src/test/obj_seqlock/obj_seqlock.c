@@ -0,0 +1,210 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_seqlock.c -- unit test for PMEMseqlock
+ */
+#include "unittest.h"
+
+#define LAYOUT_NAME "obj_seqlock"
+#define NUM_WRITERS 4
+#define NUM_READERS 8
+#define NUM_OPS 1000
+
+struct root {
+	PMEMseqlock lock;
+	uint64_t a;
+	uint64_t b;
+};
+
+static PMEMobjpool *pop;
+static struct root *rootp;
+
+/*
+ * writer -- (internal) increment both counters in a write-side section
+ */
+static void *
+writer(void *arg)
+{
+	for (int i = 0; i < NUM_OPS; ++i) {
+		UT_ASSERTeq(pmemobj_seqlock_write_lock(pop, &rootp->lock), 0);
+		rootp->a++;
+		rootp->b++;
+		UT_ASSERTeq(pmemobj_seqlock_write_unlock(pop,
+			&rootp->lock), 0);
+	}
+
+	return NULL;
+}
+
+/*
+ * reader -- (internal) verify that the counters are always read consistently
+ */
+static void *
+reader(void *arg)
+{
+	uint64_t prev = 0;
+
+	for (int i = 0; i < NUM_OPS; ++i) {
+		uint64_t seq;
+		uint64_t a;
+		uint64_t b;
+		do {
+			seq = pmemobj_seqlock_read_begin(pop, &rootp->lock);
+			a = *(volatile uint64_t *)&rootp->a;
+			b = *(volatile uint64_t *)&rootp->b;
+		} while (pmemobj_seqlock_read_retry(pop, &rootp->lock, seq));
+
+		UT_ASSERTeq(a, b);
+		UT_ASSERT(a >= prev);
+		prev = a;
+	}
+
+	return NULL;
+}
+
+/*
+ * test_mt -- (internal) run concurrent readers and writers
+ */
+static void
+test_mt(void)
+{
+	pthread_t threads[NUM_WRITERS + NUM_READERS];
+
+	for (int i = 0; i < NUM_WRITERS + NUM_READERS; ++i)
+		PTHREAD_CREATE(&threads[i], NULL,
+			i < NUM_WRITERS ? writer : reader, NULL);
+
+	for (int i = 0; i < NUM_WRITERS + NUM_READERS; ++i)
+		PTHREAD_JOIN(threads[i], NULL);
+
+	UT_ASSERTeq(rootp->a, NUM_WRITERS * NUM_OPS);
+	UT_ASSERTeq(rootp->b, NUM_WRITERS * NUM_OPS);
+}
+
+/*
+ * test_basic -- (internal) single threaded lock semantics
+ */
+static void
+test_basic(void)
+{
+	UT_ASSERTeq(pmemobj_seqlock_write_unlock(pop, &rootp->lock), EPERM);
+
+	uint64_t seq = pmemobj_seqlock_read_begin(pop, &rootp->lock);
+	UT_ASSERTeq(seq % 2, 0);
+	UT_ASSERTeq(pmemobj_seqlock_read_retry(pop, &rootp->lock, seq), 0);
+
+	UT_ASSERTeq(pmemobj_seqlock_write_trylock(pop, &rootp->lock), 0);
+	UT_ASSERTeq(pmemobj_seqlock_write_trylock(pop, &rootp->lock), EBUSY);
+	UT_ASSERTeq(pmemobj_seqlock_write_unlock(pop, &rootp->lock), 0);
+
+	UT_ASSERTne(pmemobj_seqlock_read_retry(pop, &rootp->lock, seq), 0);
+}
+
+/*
+ * test_tx -- (internal) seqlock as a transaction lock
+ */
+static void
+test_tx(void)
+{
+	uint64_t seq = pmemobj_seqlock_read_begin(pop, &rootp->lock);
+
+	TX_BEGIN_LOCK(pop, TX_LOCK_SEQLOCK, &rootp->lock, TX_LOCK_NONE) {
+		UT_ASSERTeq(pmemobj_seqlock_write_trylock(pop, &rootp->lock),
+			EBUSY);
+		pmemobj_tx_add_range_direct(&rootp->a, 2 * sizeof(uint64_t));
+		rootp->a++;
+		rootp->b++;
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTne(pmemobj_seqlock_read_retry(pop, &rootp->lock, seq), 0);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_lock(TX_LOCK_SEQLOCK, &rootp->lock);
+		pmemobj_tx_add_range_direct(&rootp->a, 2 * sizeof(uint64_t));
+		rootp->a++;
+		rootp->b++;
+		pmemobj_tx_abort(ECANCELED);
+	} TX_END
+
+	UT_ASSERTeq(rootp->a, rootp->b);
+	UT_ASSERTeq(pmemobj_seqlock_write_trylock(pop, &rootp->lock), 0);
+	UT_ASSERTeq(pmemobj_seqlock_write_unlock(pop, &rootp->lock), 0);
+}
+
+/*
+ * test_reinit -- (internal) a seqlock left locked is usable after reopen
+ */
+static void
+test_reinit(const char *path)
+{
+	UT_ASSERTeq(pmemobj_seqlock_write_lock(pop, &rootp->lock), 0);
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	UT_ASSERTne(pop, NULL);
+	rootp = pmemobj_direct(pmemobj_root(pop, sizeof(struct root)));
+
+	uint64_t seq = pmemobj_seqlock_read_begin(pop, &rootp->lock);
+	UT_ASSERTeq(seq % 2, 0);
+	UT_ASSERTeq(pmemobj_seqlock_write_trylock(pop, &rootp->lock), 0);
+	UT_ASSERTeq(pmemobj_seqlock_write_unlock(pop, &rootp->lock), 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_seqlock");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s [file]", argv[0]);
+
+	pop = pmemobj_create(argv[1], LAYOUT_NAME, PMEMOBJ_MIN_POOL,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create");
+
+	rootp = pmemobj_direct(pmemobj_root(pop, sizeof(struct root)));
+	pmemobj_seqlock_zero(pop, &rootp->lock);
+
+	test_basic();
+	test_mt();
+	test_tx();
+	test_reinit(argv[1]);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -569,6 +569,80 @@ do_tx_add_range_too_large(PMEMobjpool *pop)
 	UT_ASSERTne(errno, 0);
 }
 
+#define MEDIUM_NOBJS	20
+#define MEDIUM_MAX_SIZE	256
+
+/*
+ * do_tx_add_range_medium -- (internal) snapshots medium sized ranges of
+ * the given objects, fills them with the value and commits or aborts
+ */
+static void
+do_tx_add_range_medium(PMEMobjpool *pop, TOID(struct object) *objs,
+	int value, int abort)
+{
+	TX_BEGIN(pop) {
+		for (int i = 0; i < MEDIUM_NOBJS; ++i) {
+			size_t off = 0;
+			for (size_t size = 40; off + size <= DATA_SIZE;
+					size += 72) {
+				int ret = pmemobj_tx_add_range(objs[i].oid,
+					DATA_OFF + off, size);
+				UT_ASSERTeq(ret, 0);
+
+				memset(D_RW(objs[i])->data + off, value, size);
+				off += size + 8;
+			}
+		}
+
+		if (abort)
+			pmemobj_tx_abort(-1);
+	} TX_ONABORT {
+		UT_ASSERT(abort);
+	} TX_ONCOMMIT {
+		UT_ASSERT(!abort);
+	} TX_END
+}
+
+/*
+ * do_tx_add_range_cached_medium -- call pmemobj_tx_add_range on medium sized
+ * ranges which are stored in the range cache and span several cache slots
+ */
+static void
+do_tx_add_range_cached_medium(PMEMobjpool *pop)
+{
+	int ret = pmemobj_tx_set_max_cached_range(pop,
+		TX_MAX_CACHED_RANGE_LIMIT + 1);
+	UT_ASSERTeq(ret, EINVAL);
+
+	ret = pmemobj_tx_set_max_cached_range(pop, MEDIUM_MAX_SIZE);
+	UT_ASSERTeq(ret, 0);
+
+	TOID(struct object) objs[MEDIUM_NOBJS];
+	for (int i = 0; i < MEDIUM_NOBJS; ++i) {
+		TOID_ASSIGN(objs[i], do_tx_zalloc(pop, TYPE_OBJ));
+		UT_ASSERT(!TOID_IS_NULL(objs[i]));
+	}
+
+	do_tx_add_range_medium(pop, objs, TEST_VALUE_1, 1);
+	for (int i = 0; i < MEDIUM_NOBJS; ++i)
+		UT_ASSERT(util_is_zeroed(D_RO(objs[i])->data, DATA_SIZE));
+
+	do_tx_add_range_medium(pop, objs, TEST_VALUE_2, 0);
+	do_tx_add_range_medium(pop, objs, TEST_VALUE_1, 1);
+	for (int i = 0; i < MEDIUM_NOBJS; ++i) {
+		size_t off = 0;
+		for (size_t size = 40; off + size <= DATA_SIZE; size += 72) {
+			for (size_t j = off; j < off + size; ++j)
+				UT_ASSERTeq(D_RO(objs[i])->data[j],
+					TEST_VALUE_2);
+			off += size + 8;
+		}
+	}
+
+	ret = pmemobj_tx_set_max_cached_range(pop, MAX_CACHED_RANGE_SIZE);
+	UT_ASSERTeq(ret, 0);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -611,6 +685,8 @@ main(int argc, char *argv[])
 		VALGRIND_WRITE_STATS;
 		do_tx_add_range_too_large(pop);
 		VALGRIND_WRITE_STATS;
+		do_tx_add_range_cached_medium(pop);
+		VALGRIND_WRITE_STATS;
 		pmemobj_close(pop);
 	}
 
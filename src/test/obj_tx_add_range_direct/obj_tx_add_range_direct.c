@@ -508,6 +508,84 @@ test_tx_corruption_bug(PMEMobjpool *pop)
 	pmemobj_free(&obj.oid);
 }
 
+/*
+ * do_tx_memcpy_memset -- test pmemobj_tx_memcpy and pmemobj_tx_memset
+ */
+static void
+do_tx_memcpy_memset(PMEMobjpool *pop)
+{
+	TOID(struct object) obj;
+	TOID_ASSIGN(obj, do_tx_zalloc(pop, TYPE_OBJ));
+
+	char buf[DATA_SIZE];
+	memset(buf, TEST_VALUE_1, DATA_SIZE);
+
+	TX_BEGIN(pop) {
+		struct object *o = D_RW(obj);
+		int ret = pmemobj_tx_memcpy(o->data, buf, DATA_SIZE);
+		UT_ASSERTeq(ret, 0);
+		ret = pmemobj_tx_memset(&o->value, TEST_VALUE_2, VALUE_SIZE);
+		UT_ASSERTeq(ret, 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	size_t i;
+	for (i = 0; i < DATA_SIZE; i++)
+		UT_ASSERTeq(D_RO(obj)->data[i], TEST_VALUE_1);
+	UT_ASSERTeq(D_RO(obj)->value, 0x0202020202020202);
+
+	/* the changes are rolled back on abort */
+	TX_BEGIN(pop) {
+		struct object *o = D_RW(obj);
+		pmemobj_tx_memset(o->data, TEST_VALUE_2, DATA_SIZE);
+		pmemobj_tx_memcpy(&o->value, buf, VALUE_SIZE);
+		UT_ASSERTeq(o->data[0], TEST_VALUE_2);
+		pmemobj_tx_abort(EINVAL);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	for (i = 0; i < DATA_SIZE; i++)
+		UT_ASSERTeq(D_RO(obj)->data[i], TEST_VALUE_1);
+	UT_ASSERTeq(D_RO(obj)->value, 0x0202020202020202);
+
+	/* regular stores after re-adding the range, including a nested tx */
+	TX_BEGIN(pop) {
+		struct object *o = D_RW(obj);
+		pmemobj_tx_memset(o->data, TEST_VALUE_2, DATA_SIZE);
+		TX_BEGIN(pop) {
+			pmemobj_tx_add_range_direct(o->data, 16);
+			o->data[0] = TEST_VALUE_1;
+			pmemobj_tx_memset(o->data + DATA_SIZE - 16, 0, 16);
+		} TX_ONABORT {
+			UT_ASSERT(0);
+		} TX_END
+		TX_ADD_DIRECT(o);
+		o->value = TEST_VALUE_1;
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(D_RO(obj)->value, TEST_VALUE_1);
+	UT_ASSERTeq(D_RO(obj)->data[0], TEST_VALUE_1);
+	for (i = 1; i < DATA_SIZE - 16; i++)
+		UT_ASSERTeq(D_RO(obj)->data[i], TEST_VALUE_2);
+	for (; i < DATA_SIZE; i++)
+		UT_ASSERTeq(D_RO(obj)->data[i], 0);
+
+	/* destination outside of the pool */
+	TX_BEGIN(pop) {
+		pmemobj_tx_memcpy(buf, buf, VALUE_SIZE);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(errno, EINVAL);
+
+	pmemobj_free(&obj.oid);
+}
+
 static void
 do_tx_add_range_too_large(PMEMobjpool *pop)
 {
@@ -564,6 +642,8 @@ main(int argc, char *argv[])
 	VALGRIND_WRITE_STATS;
 	do_tx_add_range_too_large(pop);
 	VALGRIND_WRITE_STATS;
+	do_tx_memcpy_memset(pop);
+	VALGRIND_WRITE_STATS;
 
 	pmemobj_close(pop);
 
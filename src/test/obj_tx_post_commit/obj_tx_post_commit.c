@@ -0,0 +1,185 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_tx_post_commit.c -- unit test for deferred post commit phase
+ *
+ * The test is executed with PMEMOBJ_TX_DEFERRED_POST_COMMIT set, which makes
+ * the lanes stay in the committed state after the transaction ends.
+ */
+#include "unittest.h"
+
+#define LAYOUT_NAME "tx_post_commit"
+#define NVALUES 64
+#define NLOOPS 100
+#define VALUE 0xC0FFEE
+
+TOID_DECLARE_ROOT(struct root);
+TOID_DECLARE(struct object, 1);
+
+struct object {
+	uint64_t value;
+};
+
+struct root {
+	uint64_t values[NVALUES];
+	uint64_t small;
+	TOID(struct object) obj;
+};
+
+/*
+ * do_tx -- modifies the root object, replaces its object and frees the old one
+ */
+static void
+do_tx(PMEMobjpool *pop, TOID(struct root) root, uint64_t value)
+{
+	TX_BEGIN(pop) {
+		TX_ADD_FIELD(root, values);
+		TX_ADD_FIELD(root, small);
+		TX_ADD_FIELD(root, obj);
+
+		for (int i = 0; i < NVALUES; ++i)
+			D_RW(root)->values[i] = value;
+		D_RW(root)->small = value;
+
+		if (!TOID_IS_NULL(D_RO(root)->obj))
+			TX_FREE(D_RO(root)->obj);
+
+		D_RW(root)->obj = TX_NEW(struct object);
+		D_RW(D_RW(root)->obj)->value = value;
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+/*
+ * check_root -- verifies the root object contents
+ */
+static void
+check_root(TOID(struct root) root, uint64_t value)
+{
+	const struct root *r = D_RO(root);
+
+	for (int i = 0; i < NVALUES; ++i)
+		UT_ASSERTeq(r->values[i], value);
+	UT_ASSERTeq(r->small, value);
+	UT_ASSERTeq(D_RO(r->obj)->value, value);
+}
+
+/*
+ * count_objects -- returns the number of user objects in the pool
+ */
+static int
+count_objects(PMEMobjpool *pop)
+{
+	int n = 0;
+	TOID(struct object) obj;
+	POBJ_FOREACH_TYPE(pop, obj)
+		n++;
+
+	return n;
+}
+
+/*
+ * do_abort -- checks that aborted transaction reverts its changes after
+ * the deferred post commit phase of the previous one
+ */
+static void
+do_abort(PMEMobjpool *pop, TOID(struct root) root, uint64_t value)
+{
+	TX_BEGIN(pop) {
+		TX_ADD_FIELD(root, values);
+		for (int i = 0; i < NVALUES; ++i)
+			D_RW(root)->values[i] = value + 1;
+
+		pmemobj_tx_abort(ECANCELED);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_root(root, value);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_post_commit");
+
+	if (argc != 3 || strchr("co", argv[2][0]) == NULL)
+		UT_FATAL("usage: %s [file] [c|o]", argv[0]);
+
+	const char *path = argv[1];
+	PMEMobjpool *pop;
+	TOID(struct root) root;
+
+	if (argv[2][0] == 'c') {
+		pop = pmemobj_create(path, LAYOUT_NAME, PMEMOBJ_MIN_POOL,
+			S_IWUSR | S_IRUSR);
+		if (pop == NULL)
+			UT_FATAL("!pmemobj_create: %s", path);
+
+		root = POBJ_ROOT(pop, struct root);
+
+		for (uint64_t i = 1; i <= NLOOPS; ++i) {
+			do_tx(pop, root, i);
+			check_root(root, i);
+
+			/* freed objects must not be visible after commit */
+			UT_ASSERTeq(count_objects(pop), 1);
+		}
+
+		do_abort(pop, root, NLOOPS);
+		do_tx(pop, root, VALUE);
+
+		/* lane is left in the committed state */
+		exit(0); /* simulate a crash */
+	} else {
+		pop = pmemobj_open(path, LAYOUT_NAME);
+		if (pop == NULL)
+			UT_FATAL("!pmemobj_open: %s", path);
+
+		root = POBJ_ROOT(pop, struct root);
+
+		check_root(root, VALUE);
+		UT_ASSERTeq(count_objects(pop), 1);
+
+		do_tx(pop, root, VALUE + 1);
+		check_root(root, VALUE + 1);
+
+		pmemobj_close(pop);
+
+		int ret = pmemobj_check(path, LAYOUT_NAME);
+		UT_ASSERTeq(ret, 1);
+	}
+
+	DONE(NULL);
+}
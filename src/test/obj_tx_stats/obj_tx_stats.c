@@ -0,0 +1,212 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_tx_stats.c -- unit test for transaction statistics
+ */
+#include "unittest.h"
+
+#define LAYOUT_NAME "tx_stats"
+
+TOID_DECLARE(struct object, 1);
+
+struct object {
+	uint64_t data[8];
+};
+
+/*
+ * get_stats -- retrieves transaction statistics of the pool
+ */
+static void
+get_stats(PMEMobjpool *pop, struct pobj_tx_stats *stats)
+{
+	int ret = pmemobj_tx_stats(pop, stats);
+	UT_ASSERTeq(ret, 0);
+}
+
+/*
+ * stats_is_zero -- checks whether all of the statistics are zeroed
+ */
+static int
+stats_is_zero(struct pobj_tx_stats *stats)
+{
+	static struct pobj_tx_stats zero;
+
+	return memcmp(stats, &zero, sizeof(zero)) == 0;
+}
+
+/*
+ * hist_sum -- returns the number of samples in the histogram
+ */
+static uint64_t
+hist_sum(struct pobj_tx_stats *stats, enum pobj_tx_stats_hist h)
+{
+	uint64_t sum = 0;
+	for (int b = 0; b < PMEMOBJ_TX_STATS_HIST_BUCKETS; ++b)
+		sum += stats->hist[h][b];
+
+	return sum;
+}
+
+/*
+ * do_tx_disabled -- verifies that nothing is counted by default
+ */
+static void
+do_tx_disabled(PMEMobjpool *pop, TOID(struct object) obj)
+{
+	TX_BEGIN(pop) {
+		TX_ADD(obj);
+	} TX_END
+
+	struct pobj_tx_stats stats;
+	get_stats(pop, &stats);
+
+	UT_ASSERT(stats_is_zero(&stats));
+}
+
+/*
+ * do_tx_commit -- verifies counters of a committed transaction
+ */
+static void
+do_tx_commit(PMEMobjpool *pop, TOID(struct object) obj)
+{
+	TX_BEGIN(pop) {
+		TX_ADD(obj);
+		/* already snapshotted, only the call is counted */
+		TX_ADD_FIELD(obj, data[1]);
+
+		TOID(struct object) tmp = TX_NEW(struct object);
+		TX_FREE(tmp);
+
+		/* nested transaction is accounted to the outer one */
+		TX_BEGIN(pop) {
+			TOID(struct object) tmp2 = TX_ZNEW(struct object);
+			(void) tmp2;
+		} TX_END
+	} TX_END
+
+	struct pobj_tx_stats stats;
+	get_stats(pop, &stats);
+
+	UT_ASSERTeq(stats.commits, 1);
+	UT_ASSERTeq(stats.aborts, 0);
+	UT_ASSERTeq(stats.add_ranges, 2);
+	UT_ASSERTeq(stats.snapshot_bytes, sizeof(struct object));
+	UT_ASSERTeq(stats.allocs, 2);
+	UT_ASSERTeq(stats.frees, 1);
+	UT_ASSERT(stats.commit_ns >= stats.pre_commit_ns);
+	UT_ASSERT(stats.commit_ns >= stats.post_commit_ns);
+
+	/* 64 bytes fall into [2^6, 2^7) */
+	UT_ASSERTeq(stats.hist[TX_STATS_HIST_SNAPSHOT_BYTES][7], 1);
+	UT_ASSERTeq(stats.hist[TX_STATS_HIST_ADD_RANGES][2], 1);
+	UT_ASSERTeq(stats.hist[TX_STATS_HIST_ALLOCS][2], 1);
+	UT_ASSERTeq(stats.hist[TX_STATS_HIST_FREES][1], 1);
+	UT_ASSERTeq(hist_sum(&stats, TX_STATS_HIST_COMMIT_NS), 1);
+}
+
+/*
+ * do_tx_abort -- verifies counters of an aborted transaction
+ */
+static void
+do_tx_abort(PMEMobjpool *pop, TOID(struct object) obj)
+{
+	TX_BEGIN(pop) {
+		TX_ADD_FIELD(obj, data[0]);
+		pmemobj_tx_abort(ECANCELED);
+	} TX_END
+
+	struct pobj_tx_stats stats;
+	get_stats(pop, &stats);
+
+	UT_ASSERTeq(stats.commits, 1);
+	UT_ASSERTeq(stats.aborts, 1);
+	UT_ASSERTeq(stats.add_ranges, 3);
+	UT_ASSERTeq(stats.snapshot_bytes,
+		sizeof(struct object) + sizeof(uint64_t));
+
+	/* only commits are timed */
+	UT_ASSERTeq(hist_sum(&stats, TX_STATS_HIST_COMMIT_NS), 1);
+	UT_ASSERTeq(hist_sum(&stats, TX_STATS_HIST_SNAPSHOT_BYTES), 2);
+	UT_ASSERTeq(stats.hist[TX_STATS_HIST_SNAPSHOT_BYTES][4], 1);
+}
+
+/*
+ * do_tx_reset -- verifies that statistics can be zeroed and turned off
+ */
+static void
+do_tx_reset(PMEMobjpool *pop, TOID(struct object) obj)
+{
+	struct pobj_tx_stats stats;
+
+	pmemobj_tx_stats_reset(pop);
+	get_stats(pop, &stats);
+	UT_ASSERT(stats_is_zero(&stats));
+
+	UT_ASSERTeq(pmemobj_tx_stats_enable(pop, 0), 0);
+
+	TX_BEGIN(pop) {
+		TX_ADD(obj);
+	} TX_END
+
+	get_stats(pop, &stats);
+	UT_ASSERT(stats_is_zero(&stats));
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_stats");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s [file]", argv[0]);
+
+	PMEMobjpool *pop;
+	if ((pop = pmemobj_create(argv[1], LAYOUT_NAME, PMEMOBJ_MIN_POOL,
+	    S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create");
+
+	TOID(struct object) obj;
+	POBJ_ZNEW(pop, &obj, struct object);
+
+	do_tx_disabled(pop, obj);
+
+	UT_ASSERTeq(pmemobj_tx_stats_enable(pop, 1), 0);
+
+	do_tx_commit(pop, obj);
+	do_tx_abort(pop, obj);
+	do_tx_reset(pop, obj);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
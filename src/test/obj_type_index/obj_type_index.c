@@ -0,0 +1,231 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_type_index.c -- unit test for type-indexed object iteration
+ *
+ * usage: obj_type_index file
+ */
+#include <stddef.h>
+#include <pthread.h>
+
+#include "libpmemobj.h"
+#include "unittest.h"
+
+#define LAYOUT_NAME "type_index"
+
+#define TEST_NTYPES	3
+#define TEST_NOBJS	300
+#define TEST_SIZE	64
+#define TEST_NTHREADS	4
+#define TEST_NOPS	200
+
+POBJ_LAYOUT_BEGIN(type_index);
+POBJ_LAYOUT_TOID(type_index, struct foo);
+POBJ_LAYOUT_END(type_index);
+
+struct foo {
+	int id;
+};
+
+/*
+ * check_type -- (internal) verifies the indexed iteration and the count of
+ *	the objects of the type against a walk over all objects
+ */
+static void
+check_type(PMEMobjpool *pop, uint64_t type_num, size_t expected)
+{
+	size_t nobjs = 0;
+	PMEMoid idx = pmemobj_first_type(pop, type_num);
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid) {
+		if (pmemobj_type_num(oid) != type_num)
+			continue;
+
+		UT_ASSERT(OID_EQUALS(idx, oid));
+		idx = pmemobj_next_type(idx);
+		nobjs++;
+	}
+	UT_ASSERT(OID_IS_NULL(idx));
+	UT_ASSERTeq(nobjs, expected);
+	UT_ASSERTeq(pmemobj_type_count(pop, type_num), expected);
+}
+
+/*
+ * check_all -- (internal) verifies all of the types used by the test
+ */
+static void
+check_all(PMEMobjpool *pop, const size_t *expected)
+{
+	for (uint64_t t = 0; t <= TEST_NTYPES; ++t)
+		check_type(pop, t, expected[t]);
+}
+
+struct worker_arg {
+	PMEMobjpool *pop;
+	uint64_t type_num;
+	size_t nobjs; /* number of objects left allocated by the worker */
+};
+
+/*
+ * worker -- (internal) allocates and frees objects of a single type, the
+ *	memory of the freed objects is reused by the other workers
+ */
+static void *
+worker(void *arg)
+{
+	struct worker_arg *a = arg;
+	PMEMoid oids[TEST_NOPS];
+
+	for (int i = 0; i < TEST_NOPS; ++i) {
+		int ret = pmemobj_alloc(a->pop, &oids[i], TEST_SIZE,
+				a->type_num, NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+		a->nobjs++;
+
+		if (i % 2 == 1) {
+			pmemobj_free(&oids[i - 1]);
+			a->nobjs--;
+		}
+
+		if (i % 16 == 0)
+			UT_ASSERT(pmemobj_type_count(a->pop, a->type_num) > 0);
+	}
+
+	return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_type_index");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file", argv[0]);
+
+	PMEMobjpool *pop = pmemobj_create(argv[1], LAYOUT_NAME,
+			PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", argv[1]);
+
+	/* the root object is internal and never reported */
+	UT_ASSERT(!OID_IS_NULL(pmemobj_root(pop, TEST_SIZE)));
+
+	size_t expected[TEST_NTYPES + 1] = {0};
+	PMEMoid oids[TEST_NOBJS];
+
+	/* objects allocated before the index exists */
+	for (int i = 0; i < TEST_NOBJS / 2; ++i) {
+		uint64_t t = (uint64_t)i % TEST_NTYPES + 1;
+		int ret = pmemobj_alloc(pop, &oids[i], TEST_SIZE, t,
+				NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+		expected[t]++;
+	}
+	check_all(pop, expected);
+
+	/* ... and after */
+	for (int i = TEST_NOBJS / 2; i < TEST_NOBJS; ++i) {
+		uint64_t t = (uint64_t)i % TEST_NTYPES + 1;
+		int ret = pmemobj_alloc(pop, &oids[i], TEST_SIZE, t,
+				NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+		expected[t]++;
+	}
+	check_all(pop, expected);
+
+	/* free every fourth object */
+	for (int i = 0; i < TEST_NOBJS; i += 4) {
+		expected[pmemobj_type_num(oids[i])]--;
+		pmemobj_free(&oids[i]);
+	}
+	check_all(pop, expected);
+
+	/* change the type of objects from a run and from a huge chunk */
+	expected[pmemobj_type_num(oids[1])]--;
+	expected[0]++;
+	UT_ASSERTeq(pmemobj_realloc(pop, &oids[1], TEST_SIZE * 2, 0), 0);
+	expected[pmemobj_type_num(oids[2])]--;
+	expected[0]++;
+	UT_ASSERTeq(pmemobj_realloc(pop, &oids[2], TEST_SIZE * 4096, 0), 0);
+	check_all(pop, expected);
+
+	/* aborted transactional allocation leaves no trace */
+	TX_BEGIN(pop) {
+		pmemobj_tx_alloc(TEST_SIZE, 1);
+		pmemobj_tx_abort(ECANCELED);
+	} TX_END
+	check_all(pop, expected);
+
+	TX_BEGIN(pop) {
+		oids[0] = pmemobj_tx_alloc(TEST_SIZE, 1);
+	} TX_END
+	expected[1]++;
+	check_all(pop, expected);
+
+	/* typed iteration with removal */
+	TOID(struct foo) foo, nfoo;
+	POBJ_FOREACH_SAFE_TYPE(pop, foo, nfoo) {
+		expected[TOID_TYPE_NUM(struct foo)]--;
+		POBJ_FREE(&foo);
+	}
+	UT_ASSERTeq(expected[TOID_TYPE_NUM(struct foo)], 0);
+	check_all(pop, expected);
+
+	/* concurrent updates of the index */
+	pthread_t threads[TEST_NTHREADS];
+	struct worker_arg args[TEST_NTHREADS];
+	for (int i = 0; i < TEST_NTHREADS; ++i) {
+		args[i].pop = pop;
+		args[i].type_num = (uint64_t)i % TEST_NTYPES + 1;
+		args[i].nobjs = 0;
+		PTHREAD_CREATE(&threads[i], NULL, worker, &args[i]);
+	}
+	for (int i = 0; i < TEST_NTHREADS; ++i) {
+		PTHREAD_JOIN(threads[i], NULL);
+		expected[args[i].type_num] += args[i].nobjs;
+	}
+	check_all(pop, expected);
+
+	pmemobj_close(pop);
+
+	/* the index is rebuilt after the pool is reopened */
+	pop = pmemobj_open(argv[1], LAYOUT_NAME);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", argv[1]);
+
+	check_all(pop, expected);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
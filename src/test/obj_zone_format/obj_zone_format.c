@@ -0,0 +1,190 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_zone_format.c -- unit test for on-demand zone formatting
+ *
+ * usage: obj_zone_format file preformat
+ */
+#include <stddef.h>
+
+#include "heap.h"
+#include "obj.h"
+#include "unittest.h"
+
+#define LAYOUT_NAME "zone_format"
+
+#define TEST_POOL_SIZE	(32 << 20)
+#define TEST_ALLOC_SIZE	4000
+#define TEST_TYPE	1
+#define TEST_WAIT_USEC	10000
+#define TEST_WAIT_MAX	1000 /* 10 seconds */
+
+/*
+ * heap_layout -- (internal) returns the heap of the pool
+ */
+static struct heap_layout *
+heap_layout(PMEMobjpool *pop)
+{
+	return (struct heap_layout *)((uintptr_t)pop + pop->heap_offset);
+}
+
+/*
+ * zone_formatted -- (internal) checks whether the first zone is formatted
+ */
+static int
+zone_formatted(PMEMobjpool *pop)
+{
+	struct heap_layout *layout = heap_layout(pop);
+	struct zone_header *hdr = &ZID_TO_ZONE(layout, 0)->header;
+
+	return hdr->magic == ZONE_HEADER_MAGIC &&
+		hdr->format_id == layout->header.zone_format_id;
+}
+
+/*
+ * check_zone -- (internal) verifies the state of the first zone right after
+ *	the pool is created
+ */
+static void
+check_zone(PMEMobjpool *pop, int preformat)
+{
+	UT_ASSERTne(heap_layout(pop)->header.zone_format_id, 0);
+
+	/* the background formatter is not synchronized with the pool open */
+	for (int i = 0; preformat && i < TEST_WAIT_MAX &&
+			!zone_formatted(pop); ++i)
+		usleep(TEST_WAIT_USEC);
+
+	/* the first zone is formatted to fill the default bucket */
+	UT_ASSERT(zone_formatted(pop));
+}
+
+/*
+ * fill -- (internal) allocates objects until the pool is full
+ */
+static unsigned
+fill(PMEMobjpool *pop)
+{
+	unsigned n = 0;
+	while (pmemobj_alloc(pop, NULL, TEST_ALLOC_SIZE, TEST_TYPE,
+			NULL, NULL) == 0)
+		n++;
+
+	UT_ASSERT(zone_formatted(pop));
+
+	return n;
+}
+
+/*
+ * count -- (internal) returns the number of objects in the pool
+ */
+static unsigned
+count(PMEMobjpool *pop)
+{
+	unsigned n = 0;
+
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid) {
+		UT_ASSERTeq(pmemobj_type_num(oid), TEST_TYPE);
+		n++;
+	}
+
+	return n;
+}
+
+/*
+ * pool_hdr_clear -- (internal) clears the pool header, so that a new pool
+ *	can be created in place of the old one
+ */
+static void
+pool_hdr_clear(const char *path)
+{
+	size_t len;
+	int is_pmem;
+	void *addr = pmem_map_file(path, 0, 0, 0, &len, &is_pmem);
+	UT_ASSERTne(addr, NULL);
+
+	memset(addr, 0, sizeof(struct pool_hdr));
+
+	UT_ASSERTeq(pmem_msync(addr, len), 0);
+	UT_ASSERTeq(pmem_unmap(addr, len), 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_zone_format");
+
+	if (argc != 3)
+		UT_FATAL("usage: %s file preformat", argv[0]);
+
+	const char *path = argv[1];
+	int preformat = atoi(argv[2]);
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT_NAME, TEST_POOL_SIZE,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	check_zone(pop, preformat);
+	uint64_t format_id = heap_layout(pop)->header.zone_format_id;
+
+	unsigned nobjs = fill(pop);
+	UT_ASSERTne(nobjs, 0);
+	UT_ASSERTeq(count(pop), nobjs);
+	pmemobj_close(pop);
+
+	/* the new pool has to ignore the zone formatted by the old one */
+	pool_hdr_clear(path);
+	pop = pmemobj_create(path, LAYOUT_NAME, 0, S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	UT_ASSERTne(heap_layout(pop)->header.zone_format_id, format_id);
+	check_zone(pop, preformat);
+	UT_ASSERTeq(count(pop), 0);
+
+	UT_ASSERTeq(fill(pop), nobjs);
+	pmemobj_close(pop);
+
+	UT_ASSERTeq(pmemobj_check(path, LAYOUT_NAME), 1);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	UT_ASSERTeq(count(pop), nobjs);
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -1134,6 +1134,7 @@ util_heap_max_zone(size_t size)
 
 /*
  * util_heap_get_bitmap_params -- return bitmap parameters of given block size
+ *	and chunk header flags of a run
  *
  * The function returns the following values:
  * - number of allocations
@@ -1141,19 +1142,25 @@ util_heap_max_zone(size_t size)
  * - initial value of last used entry
  */
 int
-util_heap_get_bitmap_params(uint64_t block_size, uint64_t *nallocsp,
-		uint64_t *nvalsp, uint64_t *last_valp)
+util_heap_get_bitmap_params(uint64_t block_size, uint16_t flags,
+		uint64_t *nallocsp, uint64_t *nvalsp, uint64_t *last_valp)
 {
-	assert(RUNSIZE / block_size <= UINT32_MAX);
-	uint32_t nallocs = (uint32_t)(RUNSIZE / block_size);
+	if (block_size < RUN_MIN_BLOCK_SIZE)
+		return -1;
+
+	assert(RUN_NALLOCS(block_size) <= UINT32_MAX);
+	uint32_t nallocs = (uint32_t)RUN_NALLOCS(block_size);
+	if (flags & CHUNK_FLAG_ALIGNED)
+		nallocs = (uint32_t)RUN_ALIGNED_NALLOCS(block_size);
 
-	assert(nallocs <= RUN_BITMAP_SIZE);
-	unsigned unused_bits = RUN_BITMAP_SIZE - nallocs;
+	unsigned max_values = (unsigned)RUN_BITMAP_VALUES(block_size);
+	assert(nallocs <= max_values * BITS_PER_VALUE);
+	unsigned unused_bits = max_values * BITS_PER_VALUE - nallocs;
 
 	unsigned unused_values = unused_bits / BITS_PER_VALUE;
 
-	assert(MAX_BITMAP_VALUES >= unused_values);
-	uint64_t nvals = MAX_BITMAP_VALUES - unused_values;
+	assert(max_values >= unused_values);
+	uint64_t nvals = max_values - unused_values;
 
 	assert(unused_bits >= unused_values * BITS_PER_VALUE);
 	unused_bits -= unused_values * BITS_PER_VALUE;
@@ -1161,7 +1168,7 @@ util_heap_get_bitmap_params(uint64_t block_size, uint64_t *nallocsp,
 	uint64_t last_val = unused_bits ? (((1ULL << unused_bits) - 1ULL) <<
 				(BITS_PER_VALUE - unused_bits)) : 0;
 
-	if (nvals >= MAX_BITMAP_VALUES || nvals == 0)
+	if (nvals > max_values || nvals == 0)
 		return -1;
 
 	if (nallocsp)
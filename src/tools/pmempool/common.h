@@ -115,21 +115,10 @@ for ((entry) = PLIST_OFF_TO_PTR(pop, (head)->pe_first.off);\
 #define ENTRY_TO_DATA(entry)\
 ((void *)((uintptr_t)(entry) + sizeof(struct oob_header)))
 
-#define OBJH_FROM_PTR(ptr)\
-((void *)((uintptr_t)ptr - sizeof(struct obj_header)))
-
 #define DEFAULT_HDR_SIZE	4096UL /* 4 KB */
 #define DEFAULT_DESC_SIZE	4096UL /* 4 KB */
 #define POOL_HDR_DESC_SIZE	(DEFAULT_HDR_SIZE + DEFAULT_DESC_SIZE)
 
-#define PTR_TO_ALLOC_HDR(ptr)\
-((void *)((uintptr_t)(ptr) -\
-	sizeof(struct oob_header) -\
-	sizeof(struct allocation_header)))
-
-#define OBJH_TO_PTR(objh)\
-((void *)((uintptr_t)objh + sizeof(struct obj_header)))
-
 struct obj_header {
 	struct allocation_header ahdr;
 	struct oob_header oobh;
@@ -241,8 +230,8 @@ char ask_yn(char op, char def_ans, const char *fmt, va_list ap);
 char ask_Yn(char op, const char *fmt, ...);
 char ask_yN(char op, const char *fmt, ...);
 unsigned util_heap_max_zone(size_t size);
-int util_heap_get_bitmap_params(uint64_t block_size, uint64_t *nallocsp,
-		uint64_t *nvalsp, uint64_t *last_valp);
+int util_heap_get_bitmap_params(uint64_t block_size, uint16_t flags,
+		uint64_t *nallocsp, uint64_t *nvalsp, uint64_t *last_valp);
 size_t util_plist_nelements(struct pmemobjpool *pop, struct list_head *headp);
 struct list_entry *util_plist_get_entry(struct pmemobjpool *pop,
 	struct list_head *headp, size_t n);
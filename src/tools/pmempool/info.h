@@ -171,6 +171,7 @@ struct pmem_info {
 		struct pmem_obj_stats stats;
 		uint64_t uuid_lo;
 		uint64_t objid;
+		int compact; /* objects have compact headers */
 	} obj;
 };
 
@@ -35,11 +35,13 @@
  */
 #include <stdlib.h>
 #include <stdbool.h>
+#include <endian.h>
 #include <err.h>
 #include <signal.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <assert.h>
+#include <inttypes.h>
 
 #include "common.h"
 #include "output.h"
@@ -79,7 +81,10 @@ lane_need_recovery_list(struct pmem_info *pip,
 	 * The list section needs recovery if redo log needs recovery or
 	 * object's offset or size are nonzero.
 	 */
-	return lane_need_recovery_redo(&section->redo[0], REDO_NUM_ENTRIES) ||
+	size_t nentries = LANE_REDO_NUM_ENTRIES(
+			OBJ_LANE_SECTION_LEN(pip->obj.pop));
+
+	return lane_need_recovery_redo(&section->redo[0], nentries) ||
 		section->obj_offset;
 }
 
@@ -93,8 +98,11 @@ lane_need_recovery_alloc(struct pmem_info *pip,
 	struct lane_alloc_layout *section =
 		(struct lane_alloc_layout *)layout;
 
+	size_t nentries = ALLOC_REDO_NUM_ENTRIES(
+			OBJ_LANE_SECTION_LEN(pip->obj.pop));
+
 	/* there is just a redo log */
-	return lane_need_recovery_redo(&section->redo[0], ALLOC_REDO_LOG_SIZE);
+	return lane_need_recovery_redo(&section->redo[0], nentries);
 }
 
 #define PVECTOR_EMPTY(_pvec) ((_pvec).embedded[0] == 0)
@@ -131,18 +139,32 @@ lane_need_recovery_tx(struct pmem_info *pip,
 		set_cache);
 }
 
+/*
+ * lane_get_section -- return pointer to the given section of the given lane
+ */
+static struct lane_section_layout *
+lane_get_section(struct pmem_info *pip, uint64_t lane,
+	enum lane_section_type type)
+{
+	struct pmemobjpool *pop = pip->obj.pop;
+
+	return (void *)((char *)pop + pop->lanes_offset +
+			lane * OBJ_LANE_SIZE(pop) +
+			(uint64_t)type * OBJ_LANE_SECTION_LEN(pop));
+}
+
 /*
  * lane_need_recovery -- return 1 if lane section needs recovery
  */
 static int
-lane_need_recovery(struct pmem_info *pip, struct lane_layout *lane)
+lane_need_recovery(struct pmem_info *pip, uint64_t lane)
 {
 	int alloc = lane_need_recovery_alloc(pip,
-			&lane->sections[LANE_SECTION_ALLOCATOR]);
+			lane_get_section(pip, lane, LANE_SECTION_ALLOCATOR));
 	int list = lane_need_recovery_list(pip,
-			&lane->sections[LANE_SECTION_LIST]);
+			lane_get_section(pip, lane, LANE_SECTION_LIST));
 	int tx = lane_need_recovery_tx(pip,
-			&lane->sections[LANE_SECTION_TRANSACTION]);
+			lane_get_section(pip, lane, LANE_SECTION_TRANSACTION));
 
 	return alloc || list || tx;
 }
@@ -178,23 +200,38 @@ heap_class_to_size(int class)
  * get_bitmap_size -- get number of used bits in chunk run's bitmap
  */
 static uint32_t
-get_bitmap_size(struct chunk_run *run)
+get_bitmap_size(struct chunk_header *hdr, struct chunk_run *run)
 {
-	uint64_t size = RUNSIZE / run->block_size;
+	uint64_t size = hdr->flags & CHUNK_FLAG_ALIGNED ?
+		RUN_ALIGNED_NALLOCS(run->block_size) :
+		RUN_NALLOCS(run->block_size);
 	assert(size <= UINT32_MAX);
 	return (uint32_t)size;
 }
 
+/*
+ * get_bitmap_values -- get number of values of chunk run's bitmap
+ */
+static unsigned
+get_bitmap_values(struct chunk_run *run)
+{
+	if (run->block_size < RUN_MIN_BLOCK_SIZE)
+		return MAX_BITMAP_VALUES;
+
+	return (unsigned)RUN_BITMAP_VALUES(run->block_size);
+}
+
 /*
  * get_bitmap_reserved -- get number of reserved blocks in chunk run
  */
 static int
-get_bitmap_reserved(struct chunk_run *run, uint32_t *reserved)
+get_bitmap_reserved(struct chunk_header *hdr, struct chunk_run *run,
+	uint32_t *reserved)
 {
 	uint64_t nvals = 0;
 	uint64_t last_val = 0;
-	if (util_heap_get_bitmap_params(run->block_size, NULL, &nvals,
-			&last_val))
+	if (util_heap_get_bitmap_params(run->block_size, hdr->flags, NULL,
+			&nvals, &last_val))
 		return -1;
 
 	uint32_t ret = 0;
@@ -281,11 +318,13 @@ info_obj_redo(int v, struct redo_log *redo, size_t nentries)
  * info_obj_lane_alloc -- print allocator's lane section
  */
 static void
-info_obj_lane_alloc(int v, struct lane_section_layout *layout)
+info_obj_lane_alloc(struct pmem_info *pip, int v,
+	struct lane_section_layout *layout)
 {
 	struct lane_alloc_layout *section =
 		(struct lane_alloc_layout *)layout;
-	info_obj_redo(v, &section->redo[0], ALLOC_REDO_LOG_SIZE);
+	info_obj_redo(v, &section->redo[0],
+		ALLOC_REDO_NUM_ENTRIES(OBJ_LANE_SECTION_LEN(pip->obj.pop)));
 }
 
 /*
@@ -298,7 +337,8 @@ info_obj_lane_list(struct pmem_info *pip, int v,
 	struct lane_list_layout *section = (struct lane_list_layout *)layout;
 
 	outv_field(v, "Object offset", "0x%016lx", section->obj_offset);
-	info_obj_redo(v, &section->redo[0], REDO_NUM_ENTRIES);
+	info_obj_redo(v, &section->redo[0],
+		LANE_REDO_NUM_ENTRIES(OBJ_LANE_SECTION_LEN(pip->obj.pop)));
 }
 
 static void
@@ -355,10 +395,121 @@ info_obj_alloc_hdr(struct pmem_info *pip, int v,
 			sizeof(*alloc), PTR_TO_OFF(pip->obj.pop, alloc), 1);
 	outv_field(v, "Zone id", "%u", alloc->zone_id);
 	outv_field(v, "Chunk id", "%u", alloc->chunk_id);
-	outv_field(v, "Size", "%s", out_get_size_str(alloc->size,
+	outv_field(v, "Size", "%s", out_get_size_str(ALLOC_HDR_SIZE(alloc),
+				pip->args.human));
+	if (ALLOC_HDR_PAD(alloc) != 0)
+		outv_field(v, "Padding", "%s",
+			out_get_size_str(ALLOC_HDR_PAD(alloc),
+				pip->args.human));
+}
+
+/*
+ * info_obj_compact_hdr -- print compact object header
+ */
+static void
+info_obj_compact_hdr(struct pmem_info *pip, int v,
+	struct allocation_header_compact *hdr)
+{
+	outv_title(v, "Compact Header");
+	outv_hexdump(v && pip->args.vhdrdump, hdr,
+			sizeof(*hdr), PTR_TO_OFF(pip->obj.pop, hdr), 1);
+	if (hdr->size & ALLOC_HDR_FLAG_USER)
+		outv_field(v, "Internal value", "0x%016lx", hdr->extra);
+	else
+		outv_field(v, "Type Number", "0x%016lx", hdr->extra);
+	outv_field(v, "Size", "%s", out_get_size_str(ALLOC_HDR_SIZE(hdr),
+				pip->args.human));
+	if (ALLOC_HDR_PAD(hdr) != 0)
+		outv_field(v, "Padding", "%s",
+			out_get_size_str(ALLOC_HDR_PAD(hdr),
 				pip->args.human));
 }
 
+/*
+ * info_obj_hdr_size -- (internal) returns the size of the headers which
+ *	precede each object of the pool
+ */
+static size_t
+info_obj_hdr_size(struct pmem_info *pip)
+{
+	return pip->obj.compact ? sizeof(struct allocation_header_compact) :
+		sizeof(struct obj_header);
+}
+
+/*
+ * info_obj_alloc_hdr_of -- (internal) returns the header of the object with
+ *	the allocation size, it is either an allocation or a compact header
+ */
+static struct allocation_header *
+info_obj_alloc_hdr_of(struct pmem_info *pip, void *data)
+{
+	return (void *)((uintptr_t)data - info_obj_hdr_size(pip));
+}
+
+/*
+ * info_obj_type_num -- (internal) returns the type number of the object
+ */
+static uint64_t
+info_obj_type_num(struct pmem_info *pip, void *data)
+{
+	if (pip->obj.compact)
+		return ((struct allocation_header_compact *)data - 1)->extra;
+
+	return OOB_HEADER_FROM_PTR(data)->type_num;
+}
+
+/*
+ * info_obj_is_internal -- (internal) checks whether the object is one of the
+ *	internal objects of the library
+ */
+static int
+info_obj_is_internal(struct pmem_info *pip, void *data)
+{
+	if (pip->obj.compact)
+		return (((struct allocation_header_compact *)data - 1)->size &
+			ALLOC_HDR_FLAG_USER) != 0;
+
+	return OOB_HEADER_FROM_PTR(data)->size != 0;
+}
+
+/*
+ * info_obj_block_id -- (internal) returns the zone and chunk of the object,
+ *	compact headers do not store them
+ */
+static void
+info_obj_block_id(struct pmem_info *pip, void *data,
+	uint32_t *zone_id, uint32_t *chunk_id)
+{
+	struct allocation_header *alloc = info_obj_alloc_hdr_of(pip, data);
+	if (!pip->obj.compact) {
+		*zone_id = alloc->zone_id;
+		*chunk_id = alloc->chunk_id;
+		return;
+	}
+
+	struct pmemobjpool *pop = pip->obj.pop;
+	struct heap_layout *layout = OFF_TO_PTR(pop, pop->heap_offset);
+	uintptr_t block = (uintptr_t)alloc - ALLOC_HDR_PAD(alloc);
+
+	*zone_id = (uint32_t)((block - (uintptr_t)&layout->zone0) /
+		ZONE_MAX_SIZE);
+	struct zone *z = ZID_TO_ZONE(layout, *zone_id);
+	*chunk_id = (uint32_t)((block - (uintptr_t)&z->chunks[0]) / CHUNKSIZE);
+}
+
+/*
+ * info_obj_block_data -- (internal) returns the object stored in a memory
+ *	block, the headers of an aligned object are moved away from the block
+ */
+static void *
+info_obj_block_data(struct pmem_info *pip, void *block)
+{
+	struct allocation_header *alloc = block;
+
+	return (void *)((uintptr_t)block + ALLOC_HDR_PAD(alloc) +
+		info_obj_hdr_size(pip));
+}
+
 /*
  * info_obj_object_hdr -- print object headers and data
  */
@@ -367,8 +518,7 @@ info_obj_object_hdr(struct pmem_info *pip, int v, int vid,
 	void *ptr, uint64_t id)
 {
 	struct pmemobjpool *pop = pip->obj.pop;
-	struct oob_header *oob = OOB_HEADER_FROM_PTR(ptr);
-	struct allocation_header *alloc = PTR_TO_ALLOC_HDR(ptr);
+	struct allocation_header *alloc = info_obj_alloc_hdr_of(pip, ptr);
 	void *data = ptr;
 
 	outv_nl(vid);
@@ -380,11 +530,16 @@ info_obj_object_hdr(struct pmem_info *pip, int v, int vid,
 
 	outv_indent(vahdr || voobh, 1);
 
-	info_obj_alloc_hdr(pip, vahdr, alloc);
-	info_obj_oob_hdr(pip, voobh, oob);
+	if (pip->obj.compact) {
+		info_obj_compact_hdr(pip, vahdr || voobh,
+			(struct allocation_header_compact *)alloc);
+	} else {
+		info_obj_alloc_hdr(pip, vahdr, alloc);
+		info_obj_oob_hdr(pip, voobh, OOB_HEADER_FROM_PTR(ptr));
+	}
 
-	outv_hexdump(v && pip->args.vdata, data,
-			alloc->size, PTR_TO_OFF(pip->obj.pop, data), 1);
+	outv_hexdump(v && pip->args.vdata, data, ALLOC_HDR_SIZE(alloc),
+			PTR_TO_OFF(pip->obj.pop, data), 1);
 
 	outv_indent(vahdr || voobh, -1);
 }
@@ -419,8 +574,10 @@ set_entry_cache_cb(struct pmem_info *pip, int v, int vid,
 	info_obj_object_hdr(pip, v, vid, ptr, i);
 
 	int title = 0;
-	for (int i = 0; i < MAX_CACHED_RANGES; ++i) {
-		struct tx_range *range = (struct tx_range *)&cache->range[i];
+	size_t slot = 0;
+	while (slot < MAX_CACHED_RANGES) {
+		struct tx_range *range =
+			(struct tx_range *)&cache->range[slot];
 		if (range->offset == 0 || range->size == 0)
 			break;
 
@@ -429,8 +586,12 @@ set_entry_cache_cb(struct pmem_info *pip, int v, int vid,
 			outv_indent(v, 1);
 			title = 1;
 		}
-		outv(v, "%010u: Offset: 0x%016lx Size: %s\n", i, range->offset,
+		outv(v, "%010zu: Offset: 0x%016lx Size: %s\n", slot,
+			range->offset,
 			out_get_size_str(range->size, pip->args.human));
+
+		/* larger ranges occupy more than one slot */
+		slot += TX_RANGE_CACHE_SLOTS(range->size);
 	}
 	if (title)
 		outv_indent(v, -1);
@@ -463,7 +624,7 @@ info_obj_lane_tx(struct pmem_info *pip, int v,
  * info_obj_lane_section -- print lane's section
  */
 static void
-info_obj_lane_section(struct pmem_info *pip, int v, struct lane_layout *lane,
+info_obj_lane_section(struct pmem_info *pip, int v, uint64_t lane,
 	enum lane_section_type type)
 {
 	if (!(pip->args.obj.lane_sections & (1ULL << type)))
@@ -472,20 +633,21 @@ info_obj_lane_section(struct pmem_info *pip, int v, struct lane_layout *lane,
 	outv_nl(v);
 	outv_field(v, "Lane section", "%s", out_get_lane_section_str(type));
 
-	size_t lane_off = PTR_TO_OFF(pip->obj.pop, &lane->sections[type]);
-	outv_hexdump(v && pip->args.vhdrdump, &lane->sections[type],
-			LANE_SECTION_LEN, lane_off, 1);
+	struct lane_section_layout *section = lane_get_section(pip, lane, type);
+	size_t lane_off = PTR_TO_OFF(pip->obj.pop, section);
+	outv_hexdump(v && pip->args.vhdrdump, section,
+			OBJ_LANE_SECTION_LEN(pip->obj.pop), lane_off, 1);
 
 	outv_indent(v, 1);
 	switch (type) {
 	case LANE_SECTION_ALLOCATOR:
-		info_obj_lane_alloc(v, &lane->sections[type]);
+		info_obj_lane_alloc(pip, v, section);
 		break;
 	case LANE_SECTION_LIST:
-		info_obj_lane_list(pip, v, &lane->sections[type]);
+		info_obj_lane_list(pip, v, section);
 		break;
 	case LANE_SECTION_TRANSACTION:
-		info_obj_lane_tx(pip, v, &lane->sections[type]);
+		info_obj_lane_tx(pip, v, section);
 		break;
 	default:
 		break;
@@ -509,8 +671,6 @@ info_obj_lanes(struct pmem_info *pip)
 	 * Iterate through all lanes from specified range and print
 	 * specified sections.
 	 */
-	struct lane_layout *lanes = (void *)((char *)pip->obj.pop +
-			pop->lanes_offset);
 	struct range *curp = NULL;
 	FOREACH_RANGE(curp, &pip->args.obj.lane_ranges) {
 		for (uint64_t i = curp->first;
@@ -518,18 +678,18 @@ info_obj_lanes(struct pmem_info *pip)
 
 			/* For -R check print lane only if needs recovery */
 			if (pip->args.obj.lanes_recovery &&
-				!lane_need_recovery(pip, &lanes[i]))
+				!lane_need_recovery(pip, i))
 				continue;
 
 			outv_title(v, "Lane", "%d", i);
 
 			outv_indent(v, 1);
 
-			info_obj_lane_section(pip, v, &lanes[i],
+			info_obj_lane_section(pip, v, i,
 					LANE_SECTION_ALLOCATOR);
-			info_obj_lane_section(pip, v, &lanes[i],
+			info_obj_lane_section(pip, v, i,
 					LANE_SECTION_LIST);
-			info_obj_lane_section(pip, v, &lanes[i],
+			info_obj_lane_section(pip, v, i,
 					LANE_SECTION_TRANSACTION);
 
 			outv_indent(v, -1);
@@ -560,51 +720,72 @@ info_obj_heap(struct pmem_info *pip)
 	outv_field(v, "Chunk size", "%s",
 			out_get_size_str(heap->chunksize, pip->args.human));
 	outv_field(v, "Chunks per zone", "%ld", heap->chunks_per_zone);
+	outv_field(v, "Zone format id", "0x%016" PRIx64, heap->zone_format_id);
 	outv_field(v, "Checksum", "%s", out_get_checksum(heap, sizeof(*heap),
 				&heap->checksum));
 }
 
+/*
+ * info_obj_zone_is_formatted -- (internal) checks whether the zone was
+ *	formatted as a part of this heap
+ *
+ * The zones are formatted on demand, a zone which was never used can contain
+ * anything, including a zone header left by a previous pool.
+ */
+static int
+info_obj_zone_is_formatted(struct heap_layout *layout, struct zone *zone)
+{
+	return zone->header.magic == ZONE_HEADER_MAGIC &&
+		zone->header.format_id == layout->header.zone_format_id;
+}
+
 /*
  * info_obj_zone -- print information about zone
  */
 static void
-info_obj_zone_hdr(struct pmem_info *pip, int v, struct zone_header *zone)
+info_obj_zone_hdr(struct pmem_info *pip, int v, struct zone_header *zone,
+	uint64_t format_id)
 {
 	outv_hexdump(v && pip->args.vhdrdump, zone, sizeof(*zone),
 			PTR_TO_OFF(pip->obj.pop, zone), 1);
 	outv_field(v, "Magic", "%s", out_get_zone_magic_str(zone->magic));
 	outv_field(v, "Size idx", "%u", zone->size_idx);
+	outv_field(v, "Format id", "0x%016" PRIx64 " [%s]", zone->format_id,
+			zone->format_id == format_id ? "OK" : "other heap");
 }
 
 /*
  * info_obj_object -- print information about object
  */
 static void
-info_obj_object(struct pmem_info *pip, struct obj_header *objh,
-	uint64_t objid)
+info_obj_object(struct pmem_info *pip, void *data, uint64_t objid)
 {
-	uint64_t real_size = objh->ahdr.size - sizeof(struct obj_header);
+	struct allocation_header *alloc = info_obj_alloc_hdr_of(pip, data);
+	uint64_t real_size = ALLOC_HDR_SIZE(alloc) -
+		ALLOC_HDR_PAD(alloc) - info_obj_hdr_size(pip);
+	uint64_t type_num = info_obj_type_num(pip, data);
+
+	uint32_t zone_id;
+	uint32_t chunk_id;
+	info_obj_block_id(pip, data, &zone_id, &chunk_id);
 
 	if (!util_ranges_contain(&pip->args.ranges, objid))
 		return;
 
-	if (!util_ranges_contain(&pip->args.obj.type_ranges,
-			objh->oobh.type_num))
+	if (!util_ranges_contain(&pip->args.obj.type_ranges, type_num))
 		return;
 
-	if (!util_ranges_contain(&pip->args.obj.zone_ranges,
-			objh->ahdr.zone_id))
+	if (!util_ranges_contain(&pip->args.obj.zone_ranges, zone_id))
 		return;
 
-	if (!util_ranges_contain(&pip->args.obj.chunk_ranges,
-			objh->ahdr.chunk_id))
+	if (!util_ranges_contain(&pip->args.obj.chunk_ranges, chunk_id))
 		return;
 
 	pip->obj.stats.n_total_objects++;
 	pip->obj.stats.n_total_bytes += real_size;
 
 	struct pmem_obj_type_stats *type_stats =
-		pmem_obj_stats_get_type(&pip->obj.stats, objh->oobh.type_num);
+		pmem_obj_stats_get_type(&pip->obj.stats, type_num);
 
 	type_stats->n_objects++;
 	type_stats->n_bytes += real_size;
@@ -614,7 +795,7 @@ info_obj_object(struct pmem_info *pip, struct obj_header *objh,
 	int v = pip->args.obj.vobjects;
 
 	outv_indent(v, 1);
-	info_obj_object_hdr(pip, v, vid, OBJH_TO_PTR(objh), objid);
+	info_obj_object_hdr(pip, v, vid, data, objid);
 	outv_indent(v, -1);
 }
 
@@ -622,9 +803,14 @@ info_obj_object(struct pmem_info *pip, struct obj_header *objh,
  * info_obj_run_objects -- print information about objects from chunk run
  */
 static void
-info_obj_run_objects(struct pmem_info *pip, int v, struct chunk_run *run)
+info_obj_run_objects(struct pmem_info *pip, int v, struct chunk_header *hdr,
+	struct chunk_run *run)
 {
-	uint32_t bsize = get_bitmap_size(run);
+	uint32_t bsize = get_bitmap_size(hdr, run);
+	uint8_t *run_data = run->data + RUN_DATA_OFFSET(run->block_size);
+	if (hdr->flags & CHUNK_FLAG_ALIGNED)
+		run_data += RUN_ALIGNED_OFFSET(PTR_TO_OFF(pip->obj.pop,
+			run_data), info_obj_hdr_size(pip), run->block_size);
 	uint32_t i = 0;
 	while (i < bsize) {
 		uint32_t nval = i / BITS_PER_VALUE;
@@ -636,16 +822,18 @@ info_obj_run_objects(struct pmem_info *pip, int v, struct chunk_run *run)
 			continue;
 		}
 
-		struct obj_header *objh =
-			(struct obj_header *)&run->data[run->block_size * i];
+		struct allocation_header *alloc = (struct allocation_header *)
+			&run_data[run->block_size * i];
+
+		i += (uint32_t)(ALLOC_HDR_SIZE(alloc) / run->block_size);
+
+		void *data = info_obj_block_data(pip, alloc);
 
 		/* skip root object */
-		if (!objh->oobh.size) {
-			info_obj_object(pip, objh, pip->obj.objid);
+		if (!info_obj_is_internal(pip, data)) {
+			info_obj_object(pip, data, pip->obj.objid);
 			pip->obj.objid++;
 		}
-
-		i += (uint32_t)(objh->ahdr.size / run->block_size);
 	}
 }
 
@@ -653,13 +841,13 @@ info_obj_run_objects(struct pmem_info *pip, int v, struct chunk_run *run)
  * info_obj_run_bitmap -- print chunk run's bitmap
  */
 static void
-info_obj_run_bitmap(int v, struct chunk_run *run)
+info_obj_run_bitmap(int v, struct chunk_header *hdr, struct chunk_run *run)
 {
-	uint32_t bsize = get_bitmap_size(run);
+	uint32_t bsize = get_bitmap_size(hdr, run);
 
 	if (outv_check(v) && outv_check(VERBOSE_MAX)) {
 		/* print all values from bitmap for higher verbosity */
-		for (int i = 0; i < MAX_BITMAP_VALUES; i++) {
+		for (unsigned i = 0; i < get_bitmap_values(run); i++) {
 			outv(VERBOSE_MAX, "%s\n",
 					get_bitmap_str(run->bitmap[i],
 						BITS_PER_VALUE));
@@ -709,12 +897,11 @@ info_obj_chunk(struct pmem_info *pip, uint64_t c,
 			stats->class_stats[DEFAULT_BUCKET].n_used +=
 				chunk_hdr->size_idx;
 
-			struct obj_header *objh =
-				(struct obj_header *)chunk->data;
+			void *data = info_obj_block_data(pip, chunk->data);
 
 			/* skip root object */
-			if (!objh->oobh.size) {
-				info_obj_object(pip, objh, pip->obj.objid);
+			if (!info_obj_is_internal(pip, data)) {
+				info_obj_object(pip, data, pip->obj.objid);
 				pip->obj.objid++;
 			}
 		}
@@ -723,7 +910,8 @@ info_obj_chunk(struct pmem_info *pip, uint64_t c,
 		struct chunk_run *run = (struct chunk_run *)chunk;
 
 		outv_hexdump(v && pip->args.vhdrdump, run,
-				sizeof(run->block_size) + sizeof(run->bitmap),
+				sizeof(run->block_size) +
+				get_bitmap_values(run) * sizeof(uint64_t),
 				PTR_TO_OFF(pop, run), 1);
 
 		int class = heap_size_to_class(run->block_size);
@@ -732,9 +920,9 @@ info_obj_chunk(struct pmem_info *pip, uint64_t c,
 					out_get_size_str(run->block_size,
 						pip->args.human));
 
-			uint32_t units = get_bitmap_size(run);
+			uint32_t units = get_bitmap_size(chunk_hdr, run);
 			uint32_t used = 0;
-			if (get_bitmap_reserved(run,  &used)) {
+			if (get_bitmap_reserved(chunk_hdr, run,  &used)) {
 				outv_field(v, "Bitmap", "[error]");
 			} else {
 				stats->class_stats[class].n_units += units;
@@ -743,9 +931,10 @@ info_obj_chunk(struct pmem_info *pip, uint64_t c,
 				outv_field(v, "Bitmap", "%u / %u", used, units);
 			}
 
-			info_obj_run_bitmap(v && pip->args.obj.vbitmap, run);
+			info_obj_run_bitmap(v && pip->args.obj.vbitmap,
+					chunk_hdr, run);
 			info_obj_run_objects(pip, v && pip->args.obj.vobjects,
-					run);
+					chunk_hdr, run);
 		} else {
 			outv_field(v, "Block size", "%s [invalid!]",
 					out_get_size_str(run->block_size,
@@ -806,16 +995,17 @@ info_obj_root_obj(struct pmem_info *pip)
 	}
 
 	void *data = OFF_TO_PTR(pop, pop->root_offset);
-	struct obj_header *objh = OBJH_FROM_PTR(data);
 
 	outv_title(v, "Root object");
 	outv_field(v, "Offset", "0x%016x", PTR_TO_OFF(pop, data));
-	uint64_t root_size = objh->oobh.size & ~OBJ_INTERNAL_OBJECT_MASK;
+	uint64_t root_size = pip->obj.compact ?
+		((struct allocation_header_compact *)data - 1)->extra :
+		OOB_HEADER_FROM_PTR(data)->size & ~OBJ_INTERNAL_OBJECT_MASK;
 	outv_field(v, "Size",
 			out_get_size_str(root_size, pip->args.human));
 
 	/* do not print object id and offset for root object */
-	info_obj_object_hdr(pip, v, VERBOSE_SILENT, OBJH_TO_PTR(objh), 0);
+	info_obj_object_hdr(pip, v, VERBOSE_SILENT, data, 0);
 }
 
 /*
@@ -848,12 +1038,16 @@ info_obj_zones_chunks(struct pmem_info *pip)
 
 			outv_title(vvv, "Zone", "%lu", i);
 
-			if (zone->header.magic == ZONE_HEADER_MAGIC)
-				pip->obj.stats.n_zones_used++;
-
 			info_obj_zone_hdr(pip, pip->args.obj.vheap &&
 					pip->args.obj.vzonehdr,
-					&zone->header);
+					&zone->header,
+					layout->header.zone_format_id);
+
+			/* the chunks of a zone not yet formatted are garbage */
+			if (!info_obj_zone_is_formatted(layout, zone))
+				continue;
+
+			pip->obj.stats.n_zones_used++;
 
 			outv_indent(vvv, 1);
 			info_obj_zone_chunks(pip, zone,
@@ -896,6 +1090,12 @@ info_obj_descriptor(struct pmem_info *pip)
 	outv_field(v, "Number of lanes", "%lu", pop->nlanes);
 	outv_field(v, "Heap offset", "0x%lx", pop->heap_offset);
 	outv_field(v, "Heap size", "%lu", pop->heap_size);
+	if (pop->ext_redo_nentries) {
+		outv_field(v, "Extension redo log offset", "0x%lx",
+				pop->ext_redo_offset);
+		outv_field(v, "Extension redo log entries", "%lu",
+				pop->ext_redo_nentries);
+	}
 	outv_field(v, "Checksum", "%s", out_get_checksum(dscp, OBJ_DSC_P_SIZE,
 				&pop->checksum));
 	outv_field(v, "Root offset", "0x%lx", pop->root_offset);
@@ -1190,6 +1390,8 @@ pmempool_info_obj(struct pmem_info *pip)
 
 
 	pip->obj.uuid_lo = pmemobj_get_uuid_lo(pip->obj.pop);
+	pip->obj.compact = (le32toh(pip->obj.pop->hdr.incompat_features) &
+		OBJ_INCOMPAT_COMPACT_HEADERS) != 0;
 
 	info_obj_descriptor(pip);
 	info_obj_lanes(pip);
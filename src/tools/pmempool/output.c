@@ -635,7 +635,10 @@ out_get_chunk_type_str(unsigned type)
 const char *
 out_get_chunk_flags(uint16_t flags)
 {
-	return flags & CHUNK_FLAG_ZEROED ? "zeroed" : "";
+	if (flags & CHUNK_FLAG_ZEROED)
+		return "zeroed";
+
+	return flags & CHUNK_FLAG_ALIGNED ? "aligned" : "";
 }
 
 /*
@@ -61,6 +61,7 @@ typedef long _off_t;		/* NOTE: _off_t must be defined as 'long'! */
 #include <malloc.h>
 #include <signal.h>
 #include <intrin.h>
+#include <time.h>
 
 /* use uuid_t definition from util.h */
 #ifdef uuid_t
@@ -247,6 +248,28 @@ sched_yield(void)
 	return 0;		/* always succeeds */
 }
 
+/* time.h */
+#define CLOCK_MONOTONIC 1
+
+/*
+ * clock_gettime -- monotonic clock based on the performance counter
+ */
+__inline int
+clock_gettime(int id, struct timespec *ts)
+{
+	LARGE_INTEGER freq;
+	LARGE_INTEGER cnt;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&cnt);
+
+	ts->tv_sec = (time_t)(cnt.QuadPart / freq.QuadPart);
+	ts->tv_nsec = (long)((cnt.QuadPart % freq.QuadPart) * 1000000000 /
+		freq.QuadPart);
+
+	return 0;
+}
+
 /*
  * helper macros for library ctor/dtor function declarations
  */